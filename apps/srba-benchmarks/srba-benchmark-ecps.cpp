@@ -0,0 +1,278 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+// Compares the edge creation policies "local_areas_fixed_size" and "local_areas_adaptive"
+//  on any of the tutorial datasets: total and local optimization times, number of
+//  kf-to-kf edges and final RMSE.
+//
+// Usage: srba-benchmark-ecps PROBLEM DATASET.cfg DATASET_SENSOR.txt [MAX_LOCAL_OPT_TIME]
+//  - PROBLEM: The suffix of the tutorial dataset, "datasets/tutorials_dataset-<PROBLEM>.cfg", i.e. one of:
+//     "range-bearing-2d", "range-bearing-3d", "cartesian", "cartesian-3d", "monocular", "stereo-2d", "stereo-3d".
+//     The problem types (KF poses, landmarks, observations) are those of the corresponding C++ tutorial.
+//  - DATASET.cfg: The config file the dataset was generated from, where camera parameters are read from.
+//  - DATASET_SENSOR.txt: The observations generated by rwt-dataset-simulator from DATASET.cfg (see datasets/README.txt).
+//     Columns are "KF_ID  LM_ID  [SENSOR-SPECIFIC FIELDS]".
+//  - MAX_LOCAL_OPT_TIME: Optional value for "local_areas_adaptive::parameters_t::max_local_opt_time" (seconds).
+
+#include <srba.h>
+#include <mrpt/math/CMatrixD.h>
+#include <mrpt/utils/CConfigFile.h>
+#include <mrpt/utils/CTicTac.h>
+#include <mrpt/system/filesystem.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace srba;
+using namespace std;
+
+/** How to read each type of observation from the rows of a *_SENSOR.txt file, and its sensor parameters from the dataset .cfg file */
+template <class OBS_TYPE> struct TDatasetObsReader;
+
+template <>
+struct TDatasetObsReader<observations::RangeBearing_2D>
+{
+	typedef options::sensor_pose_on_robot_none sensor_pose_on_robot_t;
+	static const size_t NUM_COLS = 2+2; // KF_ID LM_ID | RANGE YAW
+
+	static void read(const mrpt::math::CMatrixD &OBS, size_t i, observations::RangeBearing_2D::obs_data_t &o) {
+		o.range = OBS(i,2); o.yaw = OBS(i,3);
+	}
+	template <class RBA>
+	static void load_sensor_params(RBA &, const mrpt::utils::CConfigFile &) { }
+};
+
+template <>
+struct TDatasetObsReader<observations::RangeBearing_3D>
+{
+	typedef options::sensor_pose_on_robot_none sensor_pose_on_robot_t;
+	static const size_t NUM_COLS = 2+3; // KF_ID LM_ID | RANGE YAW PITCH
+
+	static void read(const mrpt::math::CMatrixD &OBS, size_t i, observations::RangeBearing_3D::obs_data_t &o) {
+		o.range = OBS(i,2); o.yaw = OBS(i,3); o.pitch = OBS(i,4);
+	}
+	template <class RBA>
+	static void load_sensor_params(RBA &, const mrpt::utils::CConfigFile &) { }
+};
+
+template <>
+struct TDatasetObsReader<observations::Cartesian_2D>
+{
+	typedef options::sensor_pose_on_robot_none sensor_pose_on_robot_t;
+	static const size_t NUM_COLS = 2+2; // KF_ID LM_ID | X Y
+
+	static void read(const mrpt::math::CMatrixD &OBS, size_t i, observations::Cartesian_2D::obs_data_t &o) {
+		o.pt.x = OBS(i,2); o.pt.y = OBS(i,3);
+	}
+	template <class RBA>
+	static void load_sensor_params(RBA &, const mrpt::utils::CConfigFile &) { }
+};
+
+template <>
+struct TDatasetObsReader<observations::Cartesian_3D>
+{
+	typedef options::sensor_pose_on_robot_none sensor_pose_on_robot_t;
+	static const size_t NUM_COLS = 2+3; // KF_ID LM_ID | X Y Z
+
+	static void read(const mrpt::math::CMatrixD &OBS, size_t i, observations::Cartesian_3D::obs_data_t &o) {
+		o.pt.x = OBS(i,2); o.pt.y = OBS(i,3); o.pt.z = OBS(i,4);
+	}
+	template <class RBA>
+	static void load_sensor_params(RBA &, const mrpt::utils::CConfigFile &) { }
+};
+
+template <>
+struct TDatasetObsReader<observations::MonocularCamera>
+{
+	typedef options::sensor_pose_on_robot_se3 sensor_pose_on_robot_t;
+	static const size_t NUM_COLS = 2+2; // KF_ID LM_ID | PX.X PX.Y
+
+	static void read(const mrpt::math::CMatrixD &OBS, size_t i, observations::MonocularCamera::obs_data_t &o) {
+		o.px.x = OBS(i,2); o.px.y = OBS(i,3);
+	}
+	template <class RBA>
+	static void load_sensor_params(RBA &rba, const mrpt::utils::CConfigFile &cfg)
+	{
+		rba.parameters.sensor.camera_calib.loadFromConfigFile("sensor",cfg);
+		// Camera pointing forwards (camera's +Z is robot +X), as in the tutorials and srba-slam:
+		rba.parameters.sensor_pose.relative_pose = mrpt::poses::CPose3D(0,0,0,DEG2RAD(-90),DEG2RAD(0),DEG2RAD(-90) );
+	}
+};
+
+template <>
+struct TDatasetObsReader<observations::StereoCamera>
+{
+	typedef options::sensor_pose_on_robot_se3 sensor_pose_on_robot_t;
+	static const size_t NUM_COLS = 2+4; // KF_ID LM_ID | LEFT_PX.X LEFT_PX.Y RIGHT_PX.X RIGHT_PX.Y
+
+	static void read(const mrpt::math::CMatrixD &OBS, size_t i, observations::StereoCamera::obs_data_t &o) {
+		o.left_px.x  = OBS(i,2); o.left_px.y  = OBS(i,3);
+		o.right_px.x = OBS(i,4); o.right_px.y = OBS(i,5);
+	}
+	template <class RBA>
+	static void load_sensor_params(RBA &rba, const mrpt::utils::CConfigFile &cfg)
+	{
+		// Sections [sensor_LEFT], [sensor_RIGHT], [sensor_LEFT2RIGHT_POSE]:
+		rba.parameters.sensor.camera_calib.loadFromConfigFile("sensor",cfg);
+		ASSERT_(rba.parameters.sensor.camera_calib.rightCameraPose.x()!=0)
+		// Camera pointing forwards (camera's +Z is robot +X), as in the tutorials and srba-slam:
+		rba.parameters.sensor_pose.relative_pose = mrpt::poses::CPose3D(0,0,0,DEG2RAD(-90),DEG2RAD(0),DEG2RAD(-90) );
+	}
+};
+
+template <class ECP, class SENSOR_POSE_ON_ROBOT>
+struct RBA_OPTIONS_BENCHMARK : public RBA_OPTIONS_DEFAULT
+{
+	typedef ECP                   edge_creation_policy_t;
+	typedef SENSOR_POSE_ON_ROBOT  sensor_pose_on_robot_t;
+};
+
+struct TBenchmarkResults
+{
+	size_t nKFs, nEdges;
+	double total_time, mean_opt_time, max_opt_time, mean_rmse;
+};
+
+template <class my_srba_t>
+void run_benchmark(my_srba_t &rba, const mrpt::math::CMatrixD &OBS, TBenchmarkResults &res)
+{
+	typedef TDatasetObsReader<typename my_srba_t::obs_t> reader_t;
+
+	rba.setVerbosityLevel(0);
+	rba.enable_time_profiler(false);
+
+	const size_t nTotalObs = OBS.getRowCount();
+	res = TBenchmarkResults();
+
+	double sum_rmse=0;
+	mrpt::utils::CTicTac tictac;
+	tictac.Tic();
+
+	for (size_t obsIdx=0; obsIdx<nTotalObs; )
+	{
+		typename my_srba_t::new_kf_observations_t  list_obs;
+		typename my_srba_t::new_kf_observation_t   obs_field;
+		obs_field.is_fixed = false;
+		obs_field.is_unknown_with_init_val = false;
+
+		const size_t kf_idx = OBS(obsIdx,0);
+		for ( ; obsIdx<nTotalObs && static_cast<size_t>(OBS(obsIdx,0))==kf_idx; obsIdx++)
+		{
+			obs_field.obs.feat_id = OBS(obsIdx,1);
+			reader_t::read(OBS,obsIdx,obs_field.obs.obs_data);
+			list_obs.push_back(obs_field);
+		}
+
+		typename my_srba_t::TNewKeyFrameInfo new_kf_info;
+		rba.define_new_keyframe(list_obs,new_kf_info,true);
+
+		const double t_opt = rba.get_last_local_optimization_time();
+		res.mean_opt_time += t_opt;
+		res.max_opt_time = std::max(res.max_opt_time, t_opt);
+		sum_rmse += new_kf_info.optimize_results.obs_rmse;
+		res.nKFs++;
+	}
+
+	res.total_time = tictac.Tac();
+	res.nEdges = rba.get_k2k_edges().size();
+	if (res.nKFs)
+	{
+		res.mean_opt_time /= res.nKFs;
+		res.mean_rmse = sum_rmse/res.nKFs;
+	}
+}
+
+void print_results(const char *name, const TBenchmarkResults &res)
+{
+	printf("%-24s %8u %8u %12.3f %14.3f %14.3f %12.3e\n", name,
+		static_cast<unsigned int>(res.nKFs), static_cast<unsigned int>(res.nEdges),
+		res.total_time, 1e3*res.mean_opt_time, 1e3*res.max_opt_time, res.mean_rmse);
+}
+
+/** Runs both ECPs on one dataset, for the given problem types. */
+template <class KF2KF_POSE_TYPE, class LM_TYPE, class OBS_TYPE>
+void run_problem(const mrpt::utils::CConfigFile &cfg, const mrpt::math::CMatrixD &OBS, const double *max_local_opt_time)
+{
+	typedef TDatasetObsReader<OBS_TYPE> reader_t;
+	typedef typename reader_t::sensor_pose_on_robot_t sensor_pose_t;
+	typedef RbaEngine<KF2KF_POSE_TYPE, LM_TYPE, OBS_TYPE, RBA_OPTIONS_BENCHMARK<ecps::local_areas_fixed_size,sensor_pose_t> >  srba_fixed_t;
+	typedef RbaEngine<KF2KF_POSE_TYPE, LM_TYPE, OBS_TYPE, RBA_OPTIONS_BENCHMARK<ecps::local_areas_adaptive,sensor_pose_t> >    srba_adaptive_t;
+
+	ASSERTMSG_(OBS.getColCount()==reader_t::NUM_COLS, "Unexpected number of columns in the dataset for this PROBLEM")
+
+	printf("%-24s %8s %8s %12s %14s %14s %12s\n", "ECP", "#KFs", "#edges", "total [s]", "mean opt [ms]", "max opt [ms]", "mean RMSE");
+
+	TBenchmarkResults res;
+	{
+		srba_fixed_t rba;
+		reader_t::load_sensor_params(rba,cfg);
+		run_benchmark(rba,OBS,res);
+		print_results("local_areas_fixed_size",res);
+	}
+	{
+		srba_adaptive_t rba;
+		reader_t::load_sensor_params(rba,cfg);
+		if (max_local_opt_time)
+			rba.parameters.ecp.max_local_opt_time = *max_local_opt_time;
+		run_benchmark(rba,OBS,res);
+		print_results("local_areas_adaptive",res);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		if (argc!=4 && argc!=5)
+		{
+			fprintf(stderr,"Usage: %s PROBLEM DATASET.cfg DATASET_SENSOR.txt [MAX_LOCAL_OPT_TIME]\n"
+				" PROBLEM: range-bearing-2d | range-bearing-3d | cartesian | cartesian-3d | monocular | stereo-2d | stereo-3d\n", argv[0]);
+			return -1;
+		}
+
+		const char *problem = argv[1];
+
+		ASSERT_FILE_EXISTS_(argv[2])
+		const mrpt::utils::CConfigFile cfg(argv[2]);
+
+		mrpt::math::CMatrixD OBS;
+		OBS.loadFromTextFile(argv[3]);
+
+		const double max_local_opt_time = argc==5 ? atof(argv[4]) : 0;
+		const double *opt_time = argc==5 ? &max_local_opt_time : NULL;
+
+		printf("Dataset: %s (%s), %u observations\n", argv[3], problem, static_cast<unsigned int>(OBS.getRowCount()));
+
+		if (!strcmp(problem,"range-bearing-2d"))
+			run_problem<kf2kf_poses::SE2, landmarks::Euclidean2D, observations::RangeBearing_2D>(cfg,OBS,opt_time);
+		else if (!strcmp(problem,"range-bearing-3d"))
+			run_problem<kf2kf_poses::SE3, landmarks::Euclidean3D, observations::RangeBearing_3D>(cfg,OBS,opt_time);
+		else if (!strcmp(problem,"cartesian"))
+			run_problem<kf2kf_poses::SE2, landmarks::Euclidean2D, observations::Cartesian_2D>(cfg,OBS,opt_time);
+		else if (!strcmp(problem,"cartesian-3d"))
+			run_problem<kf2kf_poses::SE3, landmarks::Euclidean3D, observations::Cartesian_3D>(cfg,OBS,opt_time);
+		else if (!strcmp(problem,"monocular"))
+			run_problem<kf2kf_poses::SE3, landmarks::Euclidean3D, observations::MonocularCamera>(cfg,OBS,opt_time);
+		else if (!strcmp(problem,"stereo-2d"))
+			run_problem<kf2kf_poses::SE2, landmarks::Euclidean3D, observations::StereoCamera>(cfg,OBS,opt_time);
+		else if (!strcmp(problem,"stereo-3d"))
+			run_problem<kf2kf_poses::SE3, landmarks::Euclidean3D, observations::StereoCamera>(cfg,OBS,opt_time);
+		else
+		{
+			fprintf(stderr,"Unknown PROBLEM: '%s'\n", problem);
+			return -1;
+		}
+		return 0;
+	}
+	catch (std::exception &e)
+	{
+		std::cerr << "Exception: " << e.what() << std::endl;
+		return -1;
+	}
+}
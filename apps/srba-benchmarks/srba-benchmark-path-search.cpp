@@ -0,0 +1,122 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+// Compares the cost of the shortest path searches between keyframes
+//  (unidirectional BFS, bidirectional BFS and A* guided by the spanning trees)
+//  for growing synthetic maps: a long trajectory with random loop closures.
+
+#include <srba.h>
+#include <mrpt/random.h>
+#include <mrpt/utils/CTicTac.h>
+#include <cstdio>
+
+using namespace srba;
+using namespace mrpt::random;
+using namespace std;
+
+typedef RbaEngine<
+	kf2kf_poses::SE2,                // Parameterization  KF-to-KF poses
+	landmarks::RelativePoses2D,      // Parameterization of landmark positions
+	observations::RelativePoses_2D   // Type of observations
+	>
+	my_srba_t;
+
+const double PROB_LOOP_CLOSURE = 0.02;
+const size_t NUM_QUERIES = 200;
+
+void build_random_map(my_srba_t &rba, const size_t nKFs)
+{
+	my_srba_t::traits_t::new_kf_observations_t  dummy_obs; // Not used
+
+	for (size_t kf=0;kf<nKFs;kf++)
+	{
+		const TKeyFrameID new_kf = rba.alloc_keyframe();
+		if (!new_kf) continue; // First KF has no edge!
+
+		std::vector<TPairKeyFrameID> new_edges;
+		new_edges.push_back( TPairKeyFrameID(new_kf-1, new_kf) );
+		if (new_kf>2)
+		{
+			while ( randomGenerator.drawUniform(0,1)<PROB_LOOP_CLOSURE )
+			{
+				TKeyFrameID id;
+				randomGenerator.drawUniformUnsignedIntRange(id,0,new_kf-2);
+				if ( !rba.get_rba_state().are_keyframes_connected(id,new_kf) )
+					new_edges.push_back( TPairKeyFrameID(id,new_kf) );
+			}
+		}
+
+		for (size_t i=0;i<new_edges.size();i++)
+			rba.create_kf2kf_edge(new_kf, new_edges[i], dummy_obs, mrpt::poses::CPose2D(1.0,0,0) );
+	}
+}
+
+int main()
+{
+	try
+	{
+		const size_t lst_nKFs[] = { 1000, 5000, 20000, 50000 };
+		const topo_dist_t max_depth = 4;
+
+		printf("%8s %12s %12s %12s %10s\n", "#KFs", "BFS [us]", "BiBFS [us]", "A* [us]", "avr.dist");
+
+		for (size_t n=0;n<sizeof(lst_nKFs)/sizeof(lst_nKFs[0]);n++)
+		{
+			const size_t nKFs = lst_nKFs[n];
+			randomGenerator.randomize(1234);
+
+			my_srba_t rba;
+			rba.enable_time_profiler(false);
+			rba.parameters.srba.max_tree_depth = max_depth;
+			build_random_map(rba,nKFs);
+
+			std::vector<std::pair<TKeyFrameID,TKeyFrameID> > queries(NUM_QUERIES);
+			for (size_t i=0;i<NUM_QUERIES;i++)
+			{
+				randomGenerator.drawUniformUnsignedIntRange(queries[i].first,0,nKFs-1);
+				randomGenerator.drawUniformUnsignedIntRange(queries[i].second,0,nKFs-1);
+			}
+
+			std::vector<TKeyFrameID> path;
+			double total_dist = 0;
+			my_srba_t::TPathSearchWorkspace path_search_ws; // Reused by all the queries
+			mrpt::utils::CTicTac tictac;
+
+			tictac.Tic();
+			for (size_t i=0;i<NUM_QUERIES;i++)
+			{
+				rba.get_rba_state().find_path_bfs_unidirectional(queries[i].first,queries[i].second,&path);
+				total_dist += path.size();
+			}
+			const double t_bfs = tictac.Tac()/NUM_QUERIES;
+
+			tictac.Tic();
+			for (size_t i=0;i<NUM_QUERIES;i++)
+			{
+				rba.find_path_bfs(queries[i].first,queries[i].second,path,&path_search_ws);
+			}
+			const double t_bibfs = tictac.Tac()/NUM_QUERIES;
+
+			tictac.Tic();
+			for (size_t i=0;i<NUM_QUERIES;i++)
+			{
+				rba.find_path_astar(queries[i].first,queries[i].second,path,&path_search_ws);
+			}
+			const double t_astar = tictac.Tac()/NUM_QUERIES;
+
+			printf("%8u %12.2f %12.2f %12.2f %10.1f\n", static_cast<unsigned int>(nKFs), 1e6*t_bfs, 1e6*t_bibfs, 1e6*t_astar, total_dist/NUM_QUERIES);
+		}
+		return 0;
+	}
+	catch (std::exception &e)
+	{
+		std::cerr << "Exception: " << e.what() << std::endl;
+		return -1;
+	}
+}
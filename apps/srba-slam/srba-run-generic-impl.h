@@ -189,7 +189,11 @@ struct RBA_Run : public RBA_Run_Base
 			cout << endl;
 		}
 
-		const unsigned int	INCREMENTAL_FRAMES_AT_ONCE  = 1;
+		// Insert KFs one by one (define_new_keyframe), or in batches (define_new_keyframes):
+		const unsigned int	INCREMENTAL_FRAMES_AT_ONCE  = std::max(1u, cfg.arg_batch_kfs.getValue());
+		const bool          USE_BATCH_KFS = (INCREMENTAL_FRAMES_AT_ONCE>1);
+		if (USE_BATCH_KFS)
+			cout << "Inserting KFs in batches of: " << INCREMENTAL_FRAMES_AT_ONCE << endl;
 		//const unsigned int	MAX_KNOWN_FEATS_PER_FRAME   =cfg.arg_max_known_feats_per_frame.getValue();
 
 		//const double REL_POS_NOISE_STD_KNOWN    = 0.0001;  // m
@@ -347,6 +351,7 @@ struct RBA_Run : public RBA_Run_Base
 			//mrpt::vision::TSequenceFeatureObservations  feats_to_draw; // For the GUI
 
 			typename my_srba_t::TNewKeyFrameInfo new_kf_info;
+			typename my_srba_t::new_kf_observations_batch_t batch_obs; // Only used if USE_BATCH_KFS
 
 			while (obsIdx<nTotalObs && curFrameIdx<frameIdxMax)
 			{
@@ -452,6 +457,18 @@ struct RBA_Run : public RBA_Run_Base
 
 				ASSERT_(!new_obs_in_this_frame.empty())
 
+				if (USE_BATCH_KFS)
+				{
+					// Defer the insertion: all KFs in this round are inserted at once below.
+					batch_obs.push_back( new_obs_in_this_frame );
+					next_rba_keyframe_ID++;
+					if (obsIdx<nTotalObs)
+					{
+						ASSERT_EQUAL_(next_rba_keyframe_ID, curFrameIdx)  // This should occur if key_frames in simulation are ordered
+					}
+					continue;
+				}
+
 				// Append new key_frame to the RBA state:
 
 				mytimer2.Tic();
@@ -508,6 +525,30 @@ struct RBA_Run : public RBA_Run_Base
 
 			} // end while (for each KF to process at once)
 
+			if (USE_BATCH_KFS && !batch_obs.empty())
+			{
+				typename my_srba_t::new_kf_info_vector_t new_kf_infos;
+
+				mytimer2.Tic();
+				rba.define_new_keyframes(
+					batch_obs,
+					new_kf_infos,
+					true // Optimize?
+					);
+				new_kf_time = mytimer2.Tac();
+
+				new_kf_info = new_kf_infos.back();
+
+				// Append optimization stat as new entries in the time logger:
+				{
+					mrpt::utils::CTimeLogger &tl = rba.get_time_profiler();
+					tl.registerUserMeasure("num_jacobians", new_kf_info.optimize_results.num_jacobians );
+					tl.registerUserMeasure("num_kf2kf_edges_optimized", new_kf_info.optimize_results.num_kf2kf_edges_optimized );
+					tl.registerUserMeasure("num_kf2lm_edges_optimized", new_kf_info.optimize_results.num_kf2lm_edges_optimized );
+					tl.registerUserMeasure("batch_kfs_time_per_kf", new_kf_time/new_kf_infos.size() );
+				}
+			}
+
 			// Eval RMSE:
 			const double RMSE = new_kf_info.optimize_results.num_observations ? std::sqrt(new_kf_info.optimize_results.total_sqr_error_final / new_kf_info.optimize_results.num_observations) : 0;
 
@@ -744,7 +785,9 @@ struct RBA_Run : public RBA_Run_Base
 		if (cfg.arg_eval_overall_sqr_error.isSet())
 		{
 			cout << "Evaluating overall observation errors...\n"; cout.flush();
-			double total_obs_sqr_err = rba.eval_overall_squared_error();
+			typename my_srba_t::TEvalOverallErrorParams eval_params;
+			eval_params.single_spanning_tree = cfg.arg_eval_sqr_error_single_spantree.isSet();
+			double total_obs_sqr_err = rba.eval_overall_squared_error(eval_params);
 			cout << "total_obs_sqr_err = " << total_obs_sqr_err << endl;
 
 			const size_t nObs = rba.get_rba_state().all_observations.size();
@@ -44,6 +44,7 @@ struct RBASLAM_Params
 	TCLAP::ValueArg<double> arg_max_lambda;
 	TCLAP::ValueArg<unsigned int> arg_max_iters;
 	TCLAP::ValueArg<unsigned int> arg_submap_size;
+	TCLAP::ValueArg<unsigned int> arg_batch_kfs;
 	TCLAP::ValueArg<unsigned int> arg_verbose;
 	TCLAP::ValueArg<int> arg_random_seed;
 	TCLAP::ValueArg<std::string> arg_rba_params_cfg_file;
@@ -55,6 +56,7 @@ struct RBASLAM_Params
 	TCLAP::ValueArg<std::string> arg_save_final_graph;
 	TCLAP::ValueArg<std::string> arg_save_final_graph_landmarks;
 	TCLAP::SwitchArg   arg_eval_overall_sqr_error;
+	TCLAP::SwitchArg   arg_eval_sqr_error_single_spantree;
 	TCLAP::SwitchArg   arg_eval_overall_se3_error;
 	TCLAP::SwitchArg   arg_eval_connectivity;
 
@@ -89,6 +89,7 @@ RBASLAM_Params::RBASLAM_Params(int argc, char**argv) :
 	arg_max_lambda("","max-lambda","Marq-Lev. optimization: maximum lambda to stop iterating",false,1e20,"depth",cmd),
 	arg_max_iters("","max-iters","Max. number of optimization iterations.",false,20,"",cmd),
 	arg_submap_size("","submap-size","Number of KFs in each 'submap' of the arc-creation policy.",false,20,"20",cmd),
+	arg_batch_kfs("","batch-kfs","Number of KFs to insert at once with define_new_keyframes() and optimize jointly (Default:1, one KF at a time).",false,1,"N",cmd),
 	arg_verbose("v","verbose","0:quiet, 1:informative, 2:tons of info",false,1,"",cmd),
 	arg_random_seed("","random-seed","<0: randomize; >=0, use this random seed.",false,-1,"",cmd),
 	arg_rba_params_cfg_file("","cfg-file-rba","Config file (*.cfg) for the RBA parameters",false,"","rba.cfg",cmd),
@@ -100,6 +101,7 @@ RBASLAM_Params::RBASLAM_Params(int argc, char**argv) :
 	arg_save_final_graph("","save-final-graph","Save the final graph-map of KFs to a .dot file",false,"","final-map.dot",cmd),
 	arg_save_final_graph_landmarks("","save-final-graph-landmarks","Save the final graph-map (all KFs and all Landmarks) to a .dot file",false,"","final-map.dot",cmd),
 	arg_eval_overall_sqr_error("","eval-overall-sqr-error","At end, evaluate the overall square error for all the observations with the final estimated model",cmd, false),
+	arg_eval_sqr_error_single_spantree("","eval-sqr-error-single-spantree","With --eval-overall-sqr-error, derive all relative poses from one single spanning tree (much faster for large maps)",cmd, false),
 	arg_eval_overall_se3_error("","eval-overall-se3-error","At end, evaluate the overall SE3 error for all relative poses",cmd, false),
 	arg_eval_connectivity("","eval-connectivity","At end, make stats on the graph connectivity",cmd, false)
 {
@@ -15,6 +15,7 @@
 #include "srba/version.h"
 #include "srba/srba_types.h"
 #include "srba/RbaEngine.h"
+#include "srba/srba_autodiff.h"
 
 // Models:
 #include "srba/models/kf2kf_poses.h"
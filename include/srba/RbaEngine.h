@@ -20,6 +20,7 @@
 #include <mrpt/graphs/CNetworkOfPoses.h>
 #include <mrpt/system/os.h>
 #include <mrpt/system/memory.h> // MRPT_MAKE_ALIGNED_OPERATOR_NEW 
+#include <mrpt/math/distributions.h> // chi2inv()
 #include "impl/make_ordered_list_base_kfs.h"  // Internal aux function
 
 #include "srba_types.h"
@@ -30,6 +31,8 @@
 
 namespace srba
 {
+	template <class HESS_f, class HESS_Apf> class SchurLandmarkCache; // Fwd decl. (See impl/schur.h)
+
 	/** The set of default settings for RbaEngine. Use it to inherit your custom RBA_OPTIONS struct (see docs and examples).
 	  * Expected types: 
 	  * - kf2kf_pose_t The parameterization of keyframe-to-keyframe relative poses (edges, problem unknowns).
@@ -42,6 +45,7 @@ namespace srba
 		typedef options::sensor_pose_on_robot_none      sensor_pose_on_robot_t;  //!< The sensor pose coincides with the robot pose
 		typedef options::observation_noise_identity     obs_noise_matrix_t;      //!< The sensor noise matrix is the same for all observations and equal to \sigma * I(identity)
 		typedef options::solver_LM_schur_dense_cholesky solver_t;                //!< Solver algorithm (Default: Lev-Marq, with Schur, with dense Cholesky)
+		typedef options::robust_kernel_pseudo_huber     robust_kernel_t;         //!< Robust kernel applied (as IRLS weights) when parameters.srba.use_robust_kernel=true (Default: pseudo-Huber)
 	};
 
 	/** The main class for the mrpt-srba: it defines a Relative Bundle-Adjustment (RBA) problem with (optionally, partially known) landmarks,
@@ -83,9 +87,12 @@ namespace srba
 
 		typedef typename kf2kf_pose_t::se_traits_t  se_traits_t; //!< The SE(2) or SE(3) traits struct (for Lie algebra log/exp maps, etc.)
 
+		typedef typename options::internal::robust_kernel<RBA_OPTIONS>::type robust_kernel_t; //!< The robust kernel (see RBA_OPTIONS::robust_kernel_t)
+
 		typedef rba_joint_parameterization_traits_t<kf2kf_pose_t,landmark_t,obs_t>  traits_t;
 		typedef jacobian_traits<kf2kf_pose_t,landmark_t,obs_t>                      jacobian_traits_t;
 		typedef hessian_traits<kf2kf_pose_t,landmark_t,obs_t>                       hessian_traits_t;
+		typedef SchurLandmarkCache<typename hessian_traits_t::TSparseBlocksHessian_f,typename hessian_traits_t::TSparseBlocksHessian_Apf> schur_landmark_cache_t; //!< See optimize_edges()
 		typedef kf2kf_pose_traits<kf2kf_pose_t>                                     kf2kf_pose_traits_t;
 		typedef landmark_traits<landmark_t>                                               landmark_traits_t;
 		typedef observation_traits<obs_t>                                           observation_traits_t;
@@ -93,11 +100,13 @@ namespace srba
 		typedef sensor_model<landmark_t,obs_t>   sensor_model_t; //!< The sensor model for the specified combination of LM parameterization + observation type.
 
 		typedef typename kf2kf_pose_t::pose_t  pose_t; //!< The type of relative poses (e.g. mrpt::poses::CPose3D)
+		typedef typename kf2kf_pose_t::global_graph_t  global_graph_t; //!< The type of global pose graphs (e.g. mrpt::graphs::CNetworkOfPoses3D)
 		typedef TRBA_Problem_state<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS> rba_problem_state_t;
 
 		typedef typename rba_problem_state_t::k2f_edge_t k2f_edge_t;
 		typedef typename rba_problem_state_t::k2k_edge_t k2k_edge_t;
 		typedef typename rba_problem_state_t::k2k_edges_deque_t  k2k_edges_deque_t;  //!< A list (deque) of KF-to-KF edges (unknown relative poses).
+		typedef typename rba_problem_state_t::TPathSearchWorkspace  TPathSearchWorkspace; //!< Reusable working space for find_path_bfs(), find_path_astar()
 
 		typedef typename kf2kf_pose_traits_t::pose_flag_t pose_flag_t;
 		typedef typename kf2kf_pose_traits_t::frameid2pose_map_t  frameid2pose_map_t;
@@ -114,8 +123,13 @@ namespace srba
 		typedef typename observation_traits_t::residual_t          residual_t;
 		typedef typename observation_traits_t::vector_residuals_t  vector_residuals_t;
 
-		typedef typename jacobian_traits<kf2kf_pose_t,landmark_t,obs_t>::TSparseBlocksJacobians_dh_dAp TSparseBlocksJacobians_dh_dAp;
-		typedef typename jacobian_traits<kf2kf_pose_t,landmark_t,obs_t>::TSparseBlocksJacobians_dh_df TSparseBlocksJacobians_dh_df;
+		typedef typename jacobian_traits_t::TSparseBlocksJacobians_dh_dAp TSparseBlocksJacobians_dh_dAp;
+		typedef typename jacobian_traits_t::TSparseBlocksJacobians_dh_df TSparseBlocksJacobians_dh_df;
+
+		typedef typename options::internal::resulting_pose_t<typename RBA_OPTIONS::sensor_pose_on_robot_t,REL_POSE_DIMS>::pose_t  sensor_pose_t; //!< The type of poses relative to the sensor (see RBA_OPTIONS::sensor_pose_on_robot_t)
+
+		/** Whether the sensor model provides the fused residual + Jacobian evaluation observe_error_and_jacob() */
+		static const bool SENSOR_HAS_FUSED_OBS_JACOB = internal::has_observe_error_and_jacob<sensor_model_t,sensor_pose_t>::value;
 		/** @} */
 
 		/** Default constructor */
@@ -137,9 +151,14 @@ namespace srba
 			size_t  num_kf_optimized;            //!< Number of individual keyframes taken into account in the optimization
 			size_t  num_lm_optimized;            //!< Number of individual landmarks taken into account in the optimization
 			size_t  num_span_tree_numeric_updates; //!< Number of poses updated in the spanning tree numeric-update stage.
+			size_t  num_relin_skipped_jacobians;      //!< Number of Jacobian blocks not re-evaluated in relinearizations, since their unknowns barely moved (see TSRBAParameters::relinearize_threshold_k2k)
+			size_t  num_relin_skipped_hessian_blocks; //!< Number of Hessian blocks not re-evaluated in relinearizations, since their unknowns barely moved (see TSRBAParameters::relinearize_threshold_k2k)
+			size_t  num_schur_cached_blocks_reused;     //!< Only with Schur solvers: number of Hf/HApf blocks whose Schur terms were reused from the engine cache (possibly from previous optimizations)
+			size_t  num_schur_cached_blocks_recomputed; //!< Only with Schur solvers: number of Hf/HApf blocks whose Schur terms had to be recomputed
 			double  obs_rmse; //!< RMSE for each observation after optimization
 			double  total_sqr_error_init, total_sqr_error_final; //!< Initial and final total squared error for all the observations
 			double  HAp_condition_number; //!< To be computed only if enabled in parameters.compute_condition_number
+			double  elapsed_time; //!< Wall-clock time (in seconds) spent in the optimization
 
 			/** Sparsity stats of (the active part of) the Jacobian matrix and hessian matrices: total number of blocks and how many of them are non-zero
 			  * To be computed only if enabled in parameters.compute_sparsity_stats
@@ -149,6 +168,7 @@ namespace srba
 
 			std::vector<size_t> optimized_k2k_edge_indices; //!< The 0-based indices of all kf-to-kf edges which were considered in the optimization
 			std::vector<size_t> optimized_landmark_indices; //!< The 0-based indices of all landmarks whose relative positions were considered as unknowns in the optimization
+			std::vector<size_t> outlier_obs_indices;        //!< The 0-based indices (in rba_state.all_observations) of observations rejected by the chi-square gating in this optimization. See TSRBAParameters::outlier_rejection
 
 			/** Other solver-specific output information */
 			typename RBA_OPTIONS::solver_t::extra_results_t   extra_results;
@@ -163,13 +183,19 @@ namespace srba
 				num_kf_optimized = 0;
 				num_lm_optimized = 0;
 				num_span_tree_numeric_updates=0;
+				num_relin_skipped_jacobians=0;
+				num_relin_skipped_hessian_blocks=0;
+				num_schur_cached_blocks_reused=0;
+				num_schur_cached_blocks_recomputed=0;
 				total_sqr_error_init=0.;
 				total_sqr_error_final=0.;
 				HAp_condition_number=0.;
+				elapsed_time=0.;
 				sparsity_dh_dAp_nnz = sparsity_dh_dAp_max_size = sparsity_dh_df_nnz = sparsity_dh_df_max_size = 
 				sparsity_HAp_nnz = sparsity_HAp_max_size = sparsity_Hf_nnz = sparsity_Hf_max_size =  sparsity_HApf_nnz = sparsity_HApf_max_size = 0;
 				optimized_k2k_edge_indices.clear();
 				optimized_landmark_indices.clear();
+				outlier_obs_indices.clear();
 				extra_results.clear();
 			}
 
@@ -210,6 +236,27 @@ namespace srba
 			const bool           run_local_optimization = true
 			);
 
+		typedef std::vector<new_kf_observations_t>  new_kf_observations_batch_t; //!< Observations for a sequence of new KFs, one entry per KF \sa define_new_keyframes()
+		typedef typename mrpt::aligned_containers<TNewKeyFrameInfo>::vector_t  new_kf_info_vector_t; //!< \sa define_new_keyframes()
+
+		/** Batched version of define_new_keyframe(): appends N keyframes at once (e.g. while replaying logs or catching up after a stall).
+		  *  Edges are created with the edge-creation policy and the symbolic spanning trees are updated for each KF in order (exactly as
+		  *  N calls to define_new_keyframe() without optimization would do), and the new edges of each KF are initialized right after
+		  *  creating it (if \a optimize_new_edges_alone), so the initial guesses of the next KFs build upon them. The expensive part is
+		  *  amortized: one single least-squares problem is solved for the union of the local areas (of depth \a max_optimize_depth)
+		  *  around all the new KFs.
+		  *
+		  * \param[in]  batch Observations of each new KF, in chronological order. Must not be empty.
+		  * \param[out] out_new_kf_infos One entry per new KF. The results of the joint optimization are returned in the \a optimize_results field of the last entry.
+		  * \param[in]  run_local_optimization Whether to run the joint optimization at all.
+		  * \sa define_new_keyframe
+		  */
+		void define_new_keyframes(
+			const new_kf_observations_batch_t & batch,
+			new_kf_info_vector_t              & out_new_kf_infos,
+			const bool                          run_local_optimization = true
+			);
+
 		/** Parameters for optimize_local_area() */
 		struct TOptimizeLocalAreaParams
 		{
@@ -291,14 +338,34 @@ namespace srba
 			const bool set_node_coordinates
 			) const;
 
+		/** Parameters for eval_overall_squared_error() */
+		struct TEvalOverallErrorParams
+		{
+			/** If true, only one complete spanning tree is built (one per connected component of the graph) and the relative pose between
+			  * each observing and base KF is derived from the resulting global poses. Much faster in large maps, but relative poses are then
+			  * composed along the tree path instead of the shortest path between each pair of KFs, which may differ across loops. (Default=false) */
+			bool        single_spanning_tree;
+			TKeyFrameID root_kf_id;          //!< The KF to use as a root of the spanning tree if single_spanning_tree=true (default=0)
+			/** Observations are evaluated in chunks of this size (in parallel, if built with OpenMP: see SRBA_ENABLE_OPENMP in CMake), whose partial
+			  * sums are then added in a fixed order, so the result doesn't depend on the number of threads. (Default=4096) */
+			size_t      parallel_chunk_size;
+			/** If not NULL, it will be resized and filled with the squared error of each observation, indexed by its global observation index. (Default=NULL) */
+			std::vector<double> * out_obs_sqerr;
+
+			TEvalOverallErrorParams() : single_spanning_tree(false), root_kf_id(0), parallel_chunk_size(4096), out_obs_sqerr(NULL) {}
+		};
+
 		/** Evaluates the quality of the overall map/landmark estimations, by computing the sum of the squared
 		  *  error contributions for all observations. For this, this method may have to compute *very long* shortest paths
 		  *  between distant keyframes if no loop-closure edges exist in order to evaluate the best approximation of relative
 		  *  coordinates between observing KFs and features' reference KFs.
+		  *  Each squared error is weighted with the observation noise model (RBA_OPTIONS::obs_noise_matrix_t), as in optimizations.
 		  *
-		  * The worst-case time consumed by this method is O(M*log(N) + N^2 + N E), N=# of KFs, E=# of edges, M=# of observations.
+		  * The worst-case time consumed by this method is O(M*log(N) + N^2 + N E), N=# of KFs, E=# of edges, M=# of observations,
+		  * or O(M + N log(N) + E) with TEvalOverallErrorParams::single_spanning_tree=true.
+		  * \sa TEvalOverallErrorParams
 		  */
-		double eval_overall_squared_error() const;
+		double eval_overall_squared_error(const TEvalOverallErrorParams &params = TEvalOverallErrorParams()) const;
 
 		struct ExportGraphSLAM_Params
 		{
@@ -363,23 +430,107 @@ namespace srba
 			std::vector<bool>  * aux_ws = NULL
 			) const;
 
-		/** An unconstrained breadth-first search (BFS) for the shortest path between two keyframes.
+		/** Returns the "global" pose of keyframe \a kf_id, i.e. relative to \a root_id, from an engine-maintained cache built from a complete
+		  *  spanning tree (the same than create_complete_spanning_tree() with unlimited depth). The cache is kept across calls: only the poses
+		  *  below the k2k edges modified since the last query (e.g. by the optimizer) are recomputed, lazily, and new keyframes are incrementally
+		  *  attached to the tree. Changing \a root_id or loop closures which shorten the tree paths trigger a complete rebuild.
+		  * \return NULL if \a kf_id is not connected to \a root_id. The pointer is valid until the next change in the graph or the next query.
+		  * \sa get_global_poses, invalidate_global_pose_cache
+		  */
+		const pose_t * get_global_pose(const TKeyFrameID kf_id, const TKeyFrameID root_id = 0) const;
+
+		/** Returns the global poses of all the keyframes connected to \a root_id, like create_complete_spanning_tree() with unlimited depth,
+		  *  but reusing the cache of global poses (see get_global_pose()).
+		  * \param[out] span_tree The output with all found relative poses. Its previous contents are cleared. */
+		void get_global_poses(const TKeyFrameID root_id, frameid2pose_map_t & span_tree) const;
+
+		/** Forces a complete rebuild of the cache of global poses in the next query. Only needed if k2k edges are modified by other means
+		  * than the methods of this class. \sa get_global_pose */
+		void invalidate_global_pose_cache() const
+		{
+			m_global_pose_cache.clear();
+			m_global_pose_cache_root = SRBA_INVALID_KEYFRAMEID;
+		}
+
+		/** An unconstrained, bidirectional breadth-first search (BFS) for the shortest path between two keyframes.
 		  *  Note that this method does NOT use the depth-limited spanning trees which are built incrementally with the graph. So, it takes the extra cost of
 		  *  really running a BFS algorithm. For the other precomputed trees, see get_rba_state()
 		  *  Edge direction is ignored during the search, i.e. as if we had an undirected graph of Keyframes.
 		  *  If both source and target KF coincide, an empty path is returned.
 		  * \return true if a path was found.
+		  * \param[in] aux_ws Optional working space, to be reused between calls (one per thread). See TRBA_Problem_state::find_path_bfs()
 		  * \note Worst-case computational complexity is that of a BFS over the entire graph: O(V+E), V=number of nodes, E=number of edges.
-		  * \sa create_complete_spanning_tree
+		  * \sa create_complete_spanning_tree, find_path_astar
 		  */
 		bool find_path_bfs(
 			const TKeyFrameID           src_kf,
 			const TKeyFrameID           trg_kf,
-			std::vector<TKeyFrameID>    & found_path) const
+			std::vector<TKeyFrameID>    & found_path,
+			TPathSearchWorkspace        * aux_ws = NULL) const
+		{
+			return rba_state.find_path_bfs(src_kf,trg_kf,&found_path,NULL,aux_ws);
+		}
+
+		/** Like find_path_bfs(), but with an A* search which uses the distances in the prebuilt spanning trees as heuristic.
+		  *  Usually explores much less keyframes than find_path_bfs() for targets beyond the spanning tree depth. See TRBA_Problem_state::find_path_astar()
+		  * \return true if a path was found.
+		  */
+		bool find_path_astar(
+			const TKeyFrameID           src_kf,
+			const TKeyFrameID           trg_kf,
+			std::vector<TKeyFrameID>    & found_path,
+			TPathSearchWorkspace        * aux_ws = NULL) const
 		{
-			return rba_state.find_path_bfs(src_kf,trg_kf,&found_path);
+			return rba_state.find_path_astar(src_kf,trg_kf,parameters.srba.max_tree_depth,&found_path,NULL,aux_ws);
 		}
 
+		/** Returns all the KFs which share at least \a min_shared_lms observed landmarks with \a kf_id, in descending order by the number of shared landmarks.
+		  * See TRBA_Problem_state::find_covisible_keyframes() */
+		void find_covisible_keyframes(
+			const TKeyFrameID   kf_id,
+			const size_t        min_shared_lms,
+			base_sorted_lst_t & out_covisible_kfs) const
+		{
+			rba_state.find_covisible_keyframes(kf_id,min_shared_lms,out_covisible_kfs);
+		}
+
+		/** Moves the base KF of the landmark \a lm_id (with an unknown position) to \a new_base_id, re-expressing its relative position through the
+		  *  current estimates of the k2k edges along the shortest path between both KFs (its information matrix in TRBA_Problem_state::unknown_lms_inf_matrices,
+		  *  if any, is rotated into the new base frame too). All its observations are then linked again to the linear system,
+		  *  which shortens their Jacobian chains and also brings in those previously left out because their observer was beyond the spanning tree of the
+		  *  old base KF (see TRBA_Problem_state::unlinked_observations).
+		  *  This is done automatically after each optimization of new KFs for landmarks with observations left out (see TSRBAParameters::reanchor_landmarks).
+		  * \return false if the landmark can't be re-anchored: it has a known position, it's not a point landmark, or there's no path between both KFs.
+		  */
+		bool reanchor_landmark(const TLandmarkID lm_id, const TKeyFrameID new_base_id);
+
+		/** The coarse layer of the two-level optimization (see TSRBAParameters::coarse_layer): a condensed pose graph of the area centers,
+		  *  as given by the ECP (see get_center_kf_for_kf() in each ECP), with global poses wrt KF #0. */
+		struct TCoarseGraph
+		{
+			/** Nodes: the global poses of the area centers. Edges: the k2k edges between two different area centers, with their values
+			  * as of the last optimization of this graph */
+			global_graph_t       graph;
+			std::vector<size_t>  k2k_edge_ids;      //!< The IDs of the k2k edges in \a graph
+			std::vector<size_t>  new_k2k_edge_ids;  //!< New k2k edges not processed yet, since their values were not optimized yet (e.g. KFs inserted with define_new_keyframes())
+			std::vector<size_t>  pending_k2k_edge_ids; //!< Edges between two area centers not connected (yet) to KF #0, to be added as soon as one of them is
+			size_t               num_optimizations; //!< Number of times the graph has been optimized (once per loop closure)
+
+			TCoarseGraph() : num_optimizations(0) { }
+
+			void clear()
+			{
+				graph.clear();
+				k2k_edge_ids.clear();
+				new_k2k_edge_ids.clear();
+				pending_k2k_edge_ids.clear();
+				num_optimizations = 0;
+			}
+		};
+
+		/** Returns the coarse graph of area centers, whose poses are globally consistent after each loop closure (only if TSRBAParameters::coarse_layer is enabled) */
+		const TCoarseGraph & get_coarse_graph() const { return m_coarse_graph; }
+
 		/** Returns the up-to-date relative pose of Keyframe `kf_query` with respect to `kf_reference`, 
 		  *  or NULL if the relative pose is not immediately available from any numeric spanning tree. */
 		const pose_t * get_kf_relative_pose(const TKeyFrameID kf_query, const TKeyFrameID kf_reference) const
@@ -398,6 +549,7 @@ namespace srba
 
 		/** Visits all k2k & k2f edges following a BFS starting at a given starting node and up to a given maximum depth.
 		  * Only k2k edges are considered for BFS paths.
+		  * \note It uses an engine-owned working space, so its cost is O(visited elements) without memory allocations, but it's not thread-safe.
 		  */
 		template <
 			class KF_VISITOR,
@@ -440,14 +592,20 @@ namespace srba
 			// Parameters for optimize_*()
 			// -------------------------------------
 			bool   optimize_new_edges_alone; //!< (Default:true) Before running a whole "local area" optimization, try to optimize new edges one by one to have a better starting point.
-			bool   use_robust_kernel;
-			bool   use_robust_kernel_stage1;
-			double kernel_param;
+			bool   use_robust_kernel;        //!< (Default:false) Apply the robust kernel RBA_OPTIONS::robust_kernel_t to all observations.
+			bool   use_robust_kernel_stage1; //!< (Default:false) Like \a use_robust_kernel, for the optimization of new edges alone.
+			double kernel_param;             //!< (Default:3) The parameter of the robust kernel (in the same units than the observation errors).
 			size_t max_iters;
 			double max_error_per_obs_to_stop; //!< default: 1e-9
 			double max_rho; //!< default: 1.0
 			double max_lambda; //!< default: 1e20
 			double min_error_reduction_ratio_to_relinearize; //!< default 0.01
+			/** (Default:0=disabled) Lazy relinearization: upon relinearization, only re-evaluate the Jacobian and Hessian blocks of observations
+			  * depending on some unknown whose accumulated increment (infinity norm, in the Lie algebra for k2k edges) since its last linearization
+			  * is above these thresholds. With both set to 0, all blocks are always re-evaluated.
+			  * When the robust kernel is enabled, observations whose IRLS weight changed since their last linearization are always relinearized. */
+			double relinearize_threshold_k2k;
+			double relinearize_threshold_k2f; //!< (Default:0=disabled) See \a relinearize_threshold_k2k
 			bool   numeric_jacobians; //!< (Default:false) Use a numeric approximation of the Jacobians (very slow!) instead of analytical ones.
 			void (*feedback_user_iteration)(unsigned int iter, const double total_sq_err, const double mean_sqroot_error);
 			bool   compute_condition_number; //!< Compute and return to the user the Hessian condition number of k2k edges (default=false)
@@ -455,6 +613,25 @@ namespace srba
 			double max_rmse_show_red_warning; //!< Minimum RSME to show optimization error in red color (default=0.5)
 
 			TCovarianceRecoveryPolicy  cov_recovery; //!< Recover covariance? What method to use? (Default: crpLandmarksApprox)
+
+			/** (Default:false) After each optimization, compare the squared Mahalanobis error of each observation against the chi-square
+			  * threshold for OBS_DIMS degrees of freedom. Those above it are marked as outliers (see TRBA_Problem_state::all_observations_is_outlier)
+			  * and the optimization is re-run, warm-started from the current solution. */
+			bool   outlier_rejection;
+			double outlier_rejection_confidence; //!< (Default:0.999) Confidence level of the chi-square test in \a outlier_rejection
+			/** (Default:10) The dh_dAp Jacobian blocks of a k2k edge are only created when the edge enters an optimization, and freed again
+			  * after this number of optimizations not involving it (0: never free them). */
+			size_t dh_dAp_release_after;
+			/** (Default:10) Cached Schur terms of landmarks (see SchurLandmarkCache) not involved in this number of optimizations are freed (0: never free them). */
+			size_t schur_cache_release_after;
+			/** (Default:true) After each optimization of new KFs, re-anchor landmarks with observations from KFs beyond the spanning tree of their base KF
+			  * to the observer KF that links most of their observations to the linear system (see RbaEngine::reanchor_landmark()). */
+			bool   reanchor_landmarks;
+			/** (Default:false) Maintain a coarse pose graph of the area centers (see RbaEngine::get_coarse_graph()), optimized with Lev-Marq on each
+			  * loop closure between areas at a cost proportional to the number of areas, not KFs. It gives globally consistent poses of the area
+			  * centers, and does not modify the relative poses estimated by SRBA. */
+			bool   coarse_layer;
+			size_t coarse_layer_max_iters; //!< (Default:20) Max. number of Lev-Marq iterations in each optimization of the coarse graph
 			// -------------------------------------
 
 		};
@@ -491,6 +668,10 @@ namespace srba
 		/** Access to the time profiler */
 		inline mrpt::utils::CTimeLogger & get_time_profiler() { return m_profiler; }
 
+		/** Wall-clock time (in seconds) of the last local optimization run by define_new_keyframe() or define_new_keyframes() (0 if none yet).
+		  * Measured even if the time profiler is disabled. \sa ecps::local_areas_adaptive */
+		inline double get_last_local_optimization_time() const { return m_last_local_opt_time; }
+
 		/** Changes the verbosity level: 0=None (only critical msgs), 1=verbose, 2=so verbose you'll have to say "Stop!" */
 		inline void setVerbosityLevel(int level) { m_verbose_level = level; }
 
@@ -508,10 +689,12 @@ namespace srba
 		/** Rebuild the Hessian symbolic information from the internal pointers to blocks of Jacobians.
 			*  Only the upper triangle is filled-in (all what is needed for Cholesky) for square Hessians, in whole for rectangular ones (it depends on the symbolic decomposition, done elsewhere).
 			* \tparam SPARSEBLOCKHESSIAN can be: TSparseBlocksHessian_6x6, TSparseBlocksHessian_3x3 or TSparseBlocksHessian_6x3
+			* \param[in] obs_to_relinearize If provided, only Hessian blocks with at least one observation marked with a non-zero in this vector (indexed by global observation index) are updated.
+			* \param[out] out_num_skipped_blocks If provided, the number of Hessian blocks skipped due to \a obs_to_relinearize will be added to it.
 			* \return The number of Jacobian multiplications skipped due to its observation being marked as "invalid"
 			*/
 		template <class SPARSEBLOCKHESSIAN>
-		size_t sparse_hessian_update_numeric( SPARSEBLOCKHESSIAN & H ) const;
+		size_t sparse_hessian_update_numeric( SPARSEBLOCKHESSIAN & H, const std::vector<char> * obs_to_relinearize = NULL, size_t * out_num_skipped_blocks = NULL ) const;
 
 
 	protected:
@@ -539,20 +722,34 @@ namespace srba
 
 		/** @} */
 
-		/** Aux visitor struct, used in optimize_local_area() */
+		/** Aux visitor struct, used in optimize_local_area(). Non-copyable, since it holds a reference to its working space. */
 		struct VisitorOptimizeLocalArea
 		{
-			VisitorOptimizeLocalArea(const rba_problem_state_t & rba_state_, const TOptimizeLocalAreaParams &params_) :
+			/** \param lm_times_seen_ws Working space for the landmark counters (reset here), to be reused by successive visitors so no memory is allocated for them.
+			  *  Only one visitor can use it at a time. */
+			VisitorOptimizeLocalArea(const rba_problem_state_t & rba_state_, const TOptimizeLocalAreaParams &params_, stamped_array_t<size_t> & lm_times_seen_ws) :
 				rba_state(rba_state_),
-				params(params_)
-			{ }
+				params(params_),
+				lm_times_seen(lm_times_seen_ws)
+			{
+				lm_times_seen.reset();
+			}
 
 			const rba_problem_state_t & rba_state;
 			const TOptimizeLocalAreaParams &params;
 
 			std::vector<size_t> k2k_edges_to_optimize, lm_IDs_to_optimize;
-			std::map<TLandmarkID,size_t>  lm_times_seen;
 
+			/** Number of visited observations of landmark \a lm_ID (this replaces the former public std::map "lm_times_seen") */
+			inline size_t get_times_seen(const TLandmarkID lm_ID) const { return lm_times_seen.get(lm_ID); }
+
+		private:
+			stamped_array_t<size_t> & lm_times_seen; //!< Number of visited observations of each landmark
+
+			VisitorOptimizeLocalArea(const VisitorOptimizeLocalArea &);              // Not copyable
+			VisitorOptimizeLocalArea & operator =(const VisitorOptimizeLocalArea &); // Not copyable
+
+		public:
 			/* Implementation of FEAT_VISITOR */
 			inline bool visit_filter_feat(const TLandmarkID lm_ID,const topo_dist_t cur_dist)
 			{
@@ -622,6 +819,23 @@ namespace srba
 
 		mutable std::vector<bool> m_complete_st_ws; //!< Temporary working space used in \a create_complete_spanning_tree()
 
+		/** Reusable working space for bfs_visitor(), so traversals cost O(visited) without memory allocations. */
+		struct TBFSVisitorWorkspace
+		{
+			TBFSVisitorWorkspace() : in_use(false) { }
+
+			stamped_array_t<topo_dist_t>  kf_dist;      //!< Distance from the root of each KF already reached (and tested against visit_filter_kf())
+			stamped_array_t<char>         lm_visited;   //!< Indexed by landmark ID
+			stamped_array_t<char>         k2k_visited;  //!< Indexed by k2k edge ID
+			std::vector<TKeyFrameID>      pending;      //!< BFS queue (popped by advancing an index, not erased)
+			std::vector<std::pair<TKeyFrameID,topo_dist_t> > st_kfs; //!< KFs (and their distances) in the prebuilt spanning tree of the root
+			bool                          in_use;       //!< Set while running, so nested calls from visitors use their own working space
+		};
+		mutable TBFSVisitorWorkspace    m_bfs_visitor_ws;
+		mutable stamped_array_t<size_t> m_lm_times_seen_ws; //!< Working space for VisitorOptimizeLocalArea
+
+		schur_landmark_cache_t  m_schur_lm_cache; //!< Persistent Schur terms of landmarks, reused between calls to optimize_edges() (only with Schur solvers)
+
 		/** Profiler for all SRBA operations
 		  *  Enabled by default, can be disabled with \a enable_time_profiler(false)
 		  */
@@ -634,6 +848,8 @@ namespace srba
 		  *
 		  * \return The 0-based index of the new observation
 		  *
+		  * \param[in] obs_information If not NULL, the information matrix of this observation (only used with options::observation_noise_per_observation). Default: identity.
+		  *
 		  * \note Both \a fixed_relative_position and \a unknown_relative_position_init_val CAN'T be set to !=NULL at once.
 		  *
 		  * \note If new edges had been introduced before this observation, make sure the symbolic spanning trees are up-to-date!
@@ -646,7 +862,8 @@ namespace srba
 			const TKeyFrameID         observing_kf_id,
 			const typename observation_traits_t::observation_t     & new_obs,
 			const array_landmark_t * fixed_relative_position = NULL,
-			const array_landmark_t * unknown_relative_position_init_val = NULL
+			const array_landmark_t * unknown_relative_position_init_val = NULL,
+			const typename traits_t::obs_information_matrix_t * obs_information = NULL
 			);
 
 		/** Prepare the list of all required KF roots whose spanning trees need numeric updates with each optimization iteration */
@@ -656,11 +873,65 @@ namespace srba
 			const std::vector<typename TSparseBlocksJacobians_dh_df::col_t*>  &lst_JacobCols_df );
 
 
-		/** Re-evaluate all Jacobians numerically using their symbolic info. Return overall number of block Jacobians */
+		/** Re-evaluate all Jacobians numerically using their symbolic info. Return overall number of block Jacobians
+		  * \param[in] obs_to_relinearize If provided, only the Jacobians of observations marked with a non-zero in this vector (indexed by global observation index) are re-evaluated. */
 		size_t recompute_all_Jacobians(
 			std::vector<typename TSparseBlocksJacobians_dh_dAp::col_t*> &lst_JacobCols_dAp,
 			std::vector<typename TSparseBlocksJacobians_dh_df::col_t*>  &lst_JacobCols_df,
-			std::vector<const pose_flag_t*>    * out_list_of_required_num_poses = NULL );
+			std::vector<const pose_flag_t*>    * out_list_of_required_num_poses = NULL,
+			const std::vector<char>            * obs_to_relinearize = NULL );
+
+		/** Creates the dh_dAp Jacobian block described by the compact record \a rec in the column of edge \a edge_id. \sa materialize_dh_dAp_column */
+		void materialize_dh_dAp_block(const size_t edge_id, const typename rba_problem_state_t::TLazyJacobBlock_dh_dAp & rec);
+
+		/** Makes sure all the dh_dAp Jacobian blocks of edge \a edge_id exist (O(1) if they already did), and marks the column as used in the current optimization.
+		  * Until an edge takes part in an optimization, its blocks are only stored in compact form in \a TLinearSystem::dh_dAp_lazy. */
+		void materialize_dh_dAp_column(const size_t edge_id);
+
+		/** Frees the dh_dAp columns not involved in the last \a TSRBAParameters::dh_dAp_release_after optimizations (they can be rebuilt on demand) */
+		void release_unused_dh_dAp_columns();
+
+		/** True if the compact dh_dAp record \a rec was left obsolete by re-anchoring its landmark */
+		inline bool is_obsolete_dh_dAp_record(const typename rba_problem_state_t::TLazyJacobBlock_dh_dAp & rec) const {
+			return rec.anchor_version != rba_state.all_lms[ rba_state.all_observations[rec.obs_idx].obs.obs.feat_id ].anchor_version;
+		}
+
+		/** Adds the Jacobian blocks (dh_dAp & dh_df) of the observation \a obs_idx to the linear system, according to the current base KF of its landmark.
+		  * \return false if the observer KF is not within the spanning tree of the base KF, so the observation can't be part of the system. */
+		bool link_observation(const size_t obs_idx);
+
+		/** Topological distance between two KFs as given by the symbolic spanning trees, or std::numeric_limits<topo_dist_t>::max() if beyond their depth */
+		topo_dist_t spanning_tree_distance(const TKeyFrameID kf1, const TKeyFrameID kf2) const;
+
+		/** Among the KFs observing the landmark \a lm_id and its current base, the one which links most of its observations \a obs_idxs to the linear
+		  * system (ties: the shortest overall Jacobian chains, then the current base or the most recent KF) */
+		TKeyFrameID find_best_landmark_base(const TLandmarkID lm_id, const std::vector<size_t> & obs_idxs) const;
+
+		/** Re-anchors, if worth it, the landmarks in \a m_lms_pending_reanchor. \sa reanchor_landmark */
+		void reanchor_pending_landmarks();
+
+		std::vector<TLandmarkID> m_lms_pending_reanchor; //!< Landmarks with observations left out of the linear system since the last reanchor_pending_landmarks()
+		TPathSearchWorkspace     m_path_search_ws;       //!< Working space for the path searches of reanchor_landmark()
+
+		double m_last_local_opt_time; //!< See get_last_local_optimization_time()
+
+		TCoarseGraph m_coarse_graph; //!< See get_coarse_graph()
+
+		/** True if \a kf_id is the center of its area, according to the ECP */
+		inline bool is_area_center(const TKeyFrameID kf_id) const {
+			return edge_creation_policy.get_center_kf_for_kf(kf_id,parameters.ecp)==kf_id;
+		}
+
+		/** Adds to the coarse graph those among the k2k edges in TCoarseGraph::new_k2k_edge_ids that join two area centers, and optimizes it if any of them
+		  * closes a loop. Must be called only once these edges have been optimized. \sa TSRBAParameters::coarse_layer */
+		void update_coarse_graph();
+
+		/** Tries to add the k2k edge \a edge_id (between two area centers) to the coarse graph, initializing the pose of its new end, if any.
+		  * \return false if none of its ends is in the graph yet. \param[out] loop_closed Set to true if both ends were already in the graph */
+		bool add_coarse_graph_edge(const size_t edge_id, bool & loop_closed);
+
+		/** Optimizes the coarse graph, warm-started from its current node poses, with the current values of its k2k edges */
+		void optimize_coarse_graph();
 
 	public:
 
@@ -713,6 +984,91 @@ namespace srba
 
 		const pose_t aux_null_pose; //!< A fixed SE(3) pose at the origin (used when we need a pointer or a reference to a "null transformation").
 
+		/** A cached relative transformation between an observer KF and the base KF of an observed landmark. These are shared by
+		  * the evaluation of residuals and Jacobians, so each distinct transformation is computed only once per linearization.
+		  * \sa find_rel_transform(), set_rel_transform(), invalidate_transform_cache() */
+		struct TRelTransformCacheEntry
+		{
+			TRelTransformCacheEntry() : base_id(SRBA_INVALID_KEYFRAMEID), R_valid(false) { }
+
+			TKeyFrameID  base_id; //!< The base KF (the observer KF is the index of the TRelTransformCacheSlot holding this entry)
+			pose_t  base_pose_wrt_observer; //!< Pose of the base KF wrt the observer KF
+			sensor_pose_t  base_pose_wrt_sensor; //!< The same pose, wrt the sensor (see RBA_OPTIONS::sensor_pose_on_robot_t)
+			mrpt::math::CMatrixFixedNumeric<double,LM_DIMS,LM_DIMS>  R; //!< Rotation matrix of \a base_pose_wrt_observer (only if \a R_valid; filled in on demand by Jacobians dh_df)
+			bool    R_valid;
+
+			MRPT_MAKE_ALIGNED_OPERATOR_NEW  // Required by Eigen containers
+		};
+		/** All the cached transformations with the same observer KF. Its entries are only valid while \a epoch equals \a m_transform_cache_epoch */
+		struct TRelTransformCacheSlot
+		{
+			TRelTransformCacheSlot() : epoch(static_cast<size_t>(-1)) { }
+
+			size_t  epoch;
+			typename mrpt::aligned_containers<TRelTransformCacheEntry>::vector_t  entries; //!< One per base KF seen from this observer (a few, within its local area): linear search
+		};
+		typedef std::deque<TRelTransformCacheSlot>  transform_cache_t; //!< Indexed by observer KF ID
+
+		mutable transform_cache_t  m_transform_cache;       //!< observer => (base => transformation). \sa TRelTransformCacheEntry
+		mutable size_t             m_transform_cache_epoch; //!< Incremented each time \a m_transform_cache is invalidated (also the validity stamp of TObsFusedJacobian)
+
+		/** Returns the cached transformation of \a base_id wrt \a observer_id, or NULL if it has not been evaluated since the last invalidate_transform_cache() */
+		inline TRelTransformCacheEntry * find_rel_transform(const TKeyFrameID observer_id, const TKeyFrameID base_id) const
+		{
+			if (observer_id>=m_transform_cache.size()) return NULL;
+			TRelTransformCacheSlot & slot = m_transform_cache[observer_id];
+			if (slot.epoch!=m_transform_cache_epoch) return NULL;
+			for (size_t i=0;i<slot.entries.size();i++)
+				if (slot.entries[i].base_id==base_id)
+					return &slot.entries[i];
+			return NULL;
+		}
+		/** Stores the transformation of \a base_id wrt \a observer_id in the cache, and returns the new entry.
+		  * \note The returned pointer (and those returned by find_rel_transform()) is only valid until the next call to this method. */
+		TRelTransformCacheEntry * set_rel_transform(const TKeyFrameID observer_id, const TKeyFrameID base_id, const pose_t & base_pose_wrt_observer) const;
+
+		/** Invalidates all cached transformations (their memory is reused by the next linearization).
+		  * Must be called whenever the numeric spanning trees change. Runs in O(1). */
+		inline void invalidate_transform_cache() const
+		{
+			++m_transform_cache_epoch;
+		}
+
+		/** One node of the cache of global poses (see get_global_pose()), indexed by keyframe ID */
+		struct TGlobalPoseCacheNode
+		{
+			TGlobalPoseCacheNode() : parent(SRBA_INVALID_KEYFRAMEID), edge(NULL), depth(0), in_tree(false), pose_valid(false) { }
+
+			TKeyFrameID               parent;   //!< Parent KF in the spanning tree
+			const k2k_edge_t        * edge;     //!< The edge to the parent KF
+			topo_dist_t               depth;    //!< Topological distance to the root
+			std::vector<TKeyFrameID>  children; //!< Children KFs in the spanning tree
+			pose_t                    pose;     //!< Pose wrt the root (only if \a pose_valid)
+			bool                      in_tree;  //!< Whether this KF is connected to the root
+			bool                      pose_valid; //!< If false, so are all the nodes in its subtree
+
+			MRPT_MAKE_ALIGNED_OPERATOR_NEW  // Needed because we have fixed-length Eigen matrices (within CPose3D)
+		};
+		mutable typename mrpt::aligned_containers<TGlobalPoseCacheNode>::deque_t m_global_pose_cache; //!< \sa get_global_pose()
+		mutable TKeyFrameID  m_global_pose_cache_root; //!< The root of \a m_global_pose_cache, or SRBA_INVALID_KEYFRAMEID if it must be rebuilt.
+
+		void global_pose_cache_rebuild(const TKeyFrameID root_id) const; //!< Builds the tree of the cache of global poses with a BFS from \a root_id
+		void global_pose_cache_update(const TKeyFrameID kf_id) const;    //!< Recomputes the pose of \a kf_id and its invalid ancestors, if needed
+		void global_pose_cache_attach(const TKeyFrameID kf_id, const TKeyFrameID parent_id, const k2k_edge_t * edge) const;
+		/** Updates the tree of the cache of global poses after creating a new k2k edge (attaching new KFs, or invalidating the tree if a loop closure shortens its paths) */
+		void global_pose_cache_on_new_edge(const k2k_edge_t & edge) const;
+		/** Invalidates the cached global poses below a k2k edge whose relative pose changed. Runs in O(1) for non-tree edges, O(subtree size) otherwise */
+		void global_pose_cache_on_edge_changed(const k2k_edge_t & edge) const;
+
+		/** Returns the dh_dx of the given observation evaluated together with its residual at the current linearization point,
+		  * or NULL if not available (the sensor model has no observe_error_and_jacob(), or the linearization point changed since then) */
+		inline const typename rba_problem_state_t::TObsFusedJacobian * find_fused_dh_dx(const size_t obs_idx) const
+		{
+			if (!SENSOR_HAS_FUSED_OBS_JACOB || obs_idx>=rba_state.all_observations_fused_dh_dx.size()) return NULL;
+			const typename rba_problem_state_t::TObsFusedJacobian & f = rba_state.all_observations_fused_dh_dx[obs_idx];
+			return f.epoch==m_transform_cache_epoch ? &f : NULL;
+		}
+
 		struct TNumeric_dh_dAp_params
 		{
 			TNumeric_dh_dAp_params(
@@ -801,16 +1157,13 @@ namespace srba
 		}; // end of TObsUsed
 
 
+		/** Evaluates the residuals and returns the total (robustified, if applicable) squared error.
+		  * If the robust kernel is enabled, the IRLS weights of each observation are also updated in \a rba_state.all_observations_robust_weight,
+		  * and so are the fused Jacobians in \a rba_state.all_observations_fused_dh_dx (for sensor models with observe_error_and_jacob()) */
 		inline double reprojection_residuals(
 			vector_residuals_t & residuals, // Out:
 			const std::vector<TObsUsed> & observations // In:
-			) const;
-
-		/** pseudo-huber cost function */
-		static inline double huber_kernel(double delta, const double kernel_param)
-		{
-			return std::abs(2*mrpt::utils::square(kernel_param)*(std::sqrt(1+mrpt::utils::square(delta/kernel_param))-1));
-		}
+			);
 
 		MRPT_MAKE_ALIGNED_OPERATOR_NEW  // Required by Eigen containers
 	}; // end of class "RbaEngine"
@@ -826,6 +1179,7 @@ namespace srba
 #include "impl/alloc_kf2kf_edge.h"
 #include "impl/create_kf2kf_edge.h"
 #include "impl/define_new_keyframe.h"
+#include "impl/define_new_keyframes.h"
 #include "impl/jacobians.h"
 #include "impl/rba_problem_common.h"
 #include "impl/schur.h"
@@ -836,6 +1190,7 @@ namespace srba
 #include "impl/spantree_update_symbolic.h"
 #include "impl/spantree_update_numeric.h"
 #include "impl/spantree_misc.h"
+#include "impl/spantree_find_path.h"
 #include "impl/jacobians.h"
 
 #include "impl/export_opengl.h"
@@ -844,6 +1199,12 @@ namespace srba
 #include "impl/eval_overall_error.h"
 #include "impl/determine_kf2kf_edges_to_create.h"
 #include "impl/reprojection_residuals.h"
+#include "impl/transform_cache.h"
+#include "impl/global_pose_cache.h"
+#include "impl/lazy_jacobians.h"
+#include "impl/reanchor_landmarks.h"
+#include "impl/coarse_graph.h"
+#include "impl/find_covisible_keyframes.h"
 #include "impl/compute_minus_gradient.h"
 #include "impl/optimize_edges.h"
 #include "impl/lev-marq_solvers.h"
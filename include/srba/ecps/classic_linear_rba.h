@@ -43,6 +43,13 @@ struct classic_linear_rba
 		}
 	};
 	
+	/** In this policy there are no areas of several KFs: each KF is the center of its own one */
+	TKeyFrameID get_center_kf_for_kf(const TKeyFrameID kf_id, const parameters_t &params) const
+	{
+		MRPT_UNUSED_PARAM(params);
+		return kf_id;
+	}
+
 	/** Implements the edge-creation policy. 
 	 * \tparam traits_t Use rba_joint_parameterization_traits_t<kf2kf_pose_t,landmark_t,obs_t>
 	 */
@@ -0,0 +1,165 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#pragma once
+#include <mrpt/utils/CConfigFileBase.h> // MRPT_LOAD_CONFIG_VAR
+#include <algorithm>
+#include <deque>
+#include <map>
+#include "local_areas_common.h"
+
+namespace srba {
+namespace ecps {
+
+/** Edge creation policy: Like local_areas_fixed_size, but the size of each area adapts to the motion of the sensor.
+    * Each new KF joins the area of the previous one, unless:
+    *  - the fraction of its observations of landmarks also observed from the area center drops below \a min_covisibility_ratio, or
+    *  - the last local optimization took longer than \a max_local_opt_time,
+    * in which case it becomes the center of a new area. Hence, slow motion does not create many redundant areas, while
+    * fast motion does not create large and weakly connected ones. Loop closures are handled as in local_areas_fixed_size.
+    *
+    * \note This policy has an internal state (the area of each KF), so the same object must be used for all the KFs of one map.
+    * \ingroup mrpt_srba_ecps
+	*/
+struct local_areas_adaptive
+{
+	struct parameters_t
+	{
+		double              min_covisibility_ratio; //!< Default:0.3, Start a new area if the fraction of observations of the new KF shared with the area center is below this ratio
+		double              max_local_opt_time;     //!< Default:0 (disabled), Start a new area if the last local optimization took longer than this time (seconds)
+		size_t              min_submap_size;        //!< Default:3, Min. number of KFs in an area before starting a new one
+		size_t              max_submap_size;        //!< Default:40, Max. number of KFs in an area
+		size_t              min_obs_to_loop_closure; //!< Default:4, reduce to 1 for relative graph-slam
+
+		/** Ctor for default values */
+		parameters_t() :
+			min_covisibility_ratio ( 0.3 ),
+			max_local_opt_time     ( 0 ),
+			min_submap_size        ( 3 ),
+			max_submap_size        ( 40 ),
+			min_obs_to_loop_closure ( 4 )
+		{ }
+
+		/** See docs of mrpt::utils::CLoadableOptions */
+		void loadFromConfigFile(const mrpt::utils::CConfigFileBase & source,const std::string & section)
+		{
+			MRPT_LOAD_CONFIG_VAR(min_covisibility_ratio,double,source,section)
+			MRPT_LOAD_CONFIG_VAR(max_local_opt_time,double,source,section)
+			MRPT_LOAD_CONFIG_VAR(min_submap_size,uint64_t,source,section)
+			MRPT_LOAD_CONFIG_VAR(max_submap_size,uint64_t,source,section)
+			MRPT_LOAD_CONFIG_VAR(min_obs_to_loop_closure,uint64_t,source,section)
+		}
+
+		/** See docs of mrpt::utils::CLoadableOptions */
+		void saveToConfigFile(mrpt::utils::CConfigFileBase & out,const std::string & section) const
+		{
+			out.write(section,"min_covisibility_ratio",min_covisibility_ratio, /* text width */ 30, 30, "Min. ratio of observations shared with the area center to stay in the area");
+			out.write(section,"max_local_opt_time",max_local_opt_time, /* text width */ 30, 30, "Max. local optimization time (s) to stay in the area (0=disabled)");
+			out.write(section,"min_submap_size",static_cast<uint64_t>(min_submap_size), /* text width */ 30, 30, "Min. number of KFs in an area");
+			out.write(section,"max_submap_size",static_cast<uint64_t>(max_submap_size), /* text width */ 30, 30, "Max. number of KFs in an area");
+			out.write(section,"min_obs_to_loop_closure",static_cast<uint64_t>(min_obs_to_loop_closure), /* text width */ 30, 30, "Min. num. of covisible observations to add a loop closure edge");
+		}
+	};
+
+	/** Returns the center KF of the area of the given KF, as decided when it was inserted (KFs not seen by eval() yet belong to the last area) */
+	TKeyFrameID get_center_kf_for_kf(const TKeyFrameID kf_id, const parameters_t &params) const
+	{
+		MRPT_UNUSED_PARAM(params);
+		if (kf_id<m_kf_centers.size())
+			return m_kf_centers[kf_id];
+		return m_kf_centers.empty() ? 0 : m_kf_centers.back();
+	}
+
+	/** Implements the edge-creation policy. 
+	 * \tparam traits_t Use rba_joint_parameterization_traits_t<kf2kf_pose_t,landmark_t,obs_t>
+	 */
+	template <class traits_t,class rba_engine_t>
+	void eval(
+		const TKeyFrameID               new_kf_id,
+		const typename traits_t::new_kf_observations_t   & obs,
+		std::vector<TNewEdgeInfo> &new_k2k_edge_ids,
+		rba_engine_t       & rba_engine,
+		const parameters_t &params)
+	{
+		ASSERT_(new_kf_id>=1) // We can run an ECP only if we have 2 KFs in the map
+
+		// The first KF, which is never passed to eval(), is the center of the first area:
+		if (m_kf_centers.empty())
+			m_kf_centers.push_back(0);
+		ASSERTMSG_(new_kf_id==m_kf_centers.size(), "local_areas_adaptive: KFs must be passed to eval() in order (was the ECP object reused for another map?)")
+
+		const TKeyFrameID cur_center = m_kf_centers.back();
+		m_kf_centers.push_back( start_new_area<traits_t>(new_kf_id,obs,rba_engine,params) ? new_kf_id : cur_center );
+
+		srba::internal::eval_local_areas_ecp<traits_t>(*this, new_kf_id, obs, new_k2k_edge_ids, rba_engine, params);
+	} // end eval<>()
+
+	local_areas_adaptive() : m_cached_center(SRBA_INVALID_KEYFRAMEID)
+	{ }
+
+private:
+	std::deque<TKeyFrameID>  m_kf_centers;    //!< The center KF of each KF's area, indexed by KF ID
+	TKeyFrameID              m_cached_center; //!< The area center whose observed landmarks are in \a m_center_lm_ids
+	std::vector<TLandmarkID> m_center_lm_ids; //!< Sorted IDs of the landmarks observed from \a m_cached_center
+
+	/** Decides whether \a new_kf_id must start a new area (see struct docs) */
+	template <class traits_t,class rba_engine_t>
+	bool start_new_area(
+		const TKeyFrameID               new_kf_id,
+		const typename traits_t::new_kf_observations_t   & obs,
+		const rba_engine_t & rba_engine,
+		const parameters_t &params)
+	{
+		const TKeyFrameID cur_center = m_kf_centers.back();
+		const size_t cur_area_size = new_kf_id - cur_center; // Areas are always made of consecutive KFs
+
+		if (cur_area_size<params.min_submap_size)
+			return false;
+		if (cur_area_size>=params.max_submap_size)
+			return true;
+
+		// Time budget:
+		if (params.max_local_opt_time>0 && rba_engine.get_last_local_optimization_time()>params.max_local_opt_time)
+			return true;
+
+		// Covisibility with the area center. All its observations were added when it was defined, so its list of landmarks never changes:
+		if (m_cached_center!=cur_center)
+		{
+			const std::deque<typename rba_engine_t::k2f_edge_t*> & center_obs = rba_engine.get_rba_state().keyframes[cur_center].adjacent_k2f_edges;
+			m_center_lm_ids.resize(center_obs.size());
+			for (size_t i=0;i<center_obs.size();i++)
+				m_center_lm_ids[i] = center_obs[i]->obs.obs.feat_id;
+			std::sort(m_center_lm_ids.begin(),m_center_lm_ids.end());
+			m_cached_center = cur_center;
+		}
+
+		if (obs.empty())
+			return false;
+		size_t num_shared = 0;
+		for (typename traits_t::new_kf_observations_t::const_iterator it=obs.begin();it!=obs.end();++it)
+			if (std::binary_search(m_center_lm_ids.begin(),m_center_lm_ids.end(), it->obs.feat_id))
+				num_shared++;
+
+		if (num_shared >= params.min_covisibility_ratio*obs.size())
+			return false;
+
+		// Don't start a new area if it couldn't be linked to any previous one (see eval_local_areas_ecp()):
+		base_sorted_lst_t  obs_for_each_base_sorted;
+		srba::internal::make_ordered_list_base_kfs<traits_t,typename rba_engine_t::rba_problem_state_t>(obs, rba_engine.get_rba_state(), obs_for_each_base_sorted);
+
+		std::map<TKeyFrameID,size_t>  obs_for_each_area;
+		for (base_sorted_lst_t::const_iterator it=obs_for_each_base_sorted.begin();it!=obs_for_each_base_sorted.end();++it)
+			if ( (obs_for_each_area[get_center_kf_for_kf(it->second,params)] += it->first) >= params.min_obs_to_loop_closure)
+				return true;
+		return false;
+	}
+
+};  // end of struct
+
+} } // End of namespaces
@@ -18,7 +18,8 @@ size_t RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::add_observation(
 	const TKeyFrameID            observing_kf_id,
 	const typename observation_traits<obs_t>::observation_t     & new_obs,
 	const array_landmark_t * fixed_relative_position,
-	const array_landmark_t * unknown_relative_position_init_val
+	const array_landmark_t * unknown_relative_position_init_val,
+	const typename traits_t::obs_information_matrix_t * obs_information
 	)
 {
 	m_profiler.enter("add_observation");
@@ -39,7 +40,13 @@ size_t RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::add_observation(
 
 	rba_state.all_observations.push_back(k2f_edge_t()); // Create new k2f_edge -- O(1)
 	rba_state.all_observations_Jacob_validity.push_back(1);  // Also grow this vector (its content now are irrelevant, they'll be updated in optimization)
-	char * const jacob_valid_bit = &(*rba_state.all_observations_Jacob_validity.rbegin());
+	rba_state.all_observations_robust_weight.push_back(1.0);  // Idem (only used with robust kernels)
+	rba_state.all_observations_is_outlier.push_back(0);
+	rba_state.all_observations_noise_data.push_back( typename rba_problem_state_t::noise_data_per_obs_t() ); // Idem (default noise data, e.g. identity information matrix)
+	if (obs_information)
+		RBA_OPTIONS::obs_noise_matrix_t::init_noise_data_per_obs(rba_state.all_observations_noise_data.back(), *obs_information);
+	if (SENSOR_HAS_FUSED_OBS_JACOB)
+		rba_state.all_observations_fused_dh_dx.push_back( typename rba_problem_state_t::TObsFusedJacobian() ); // Idem (filled in by reprojection_residuals())
 
 	// Get a ref. to observation info, filled in below:
 	k2f_edge_t & new_k2f_edge = *rba_state.all_observations.rbegin();
@@ -97,10 +104,12 @@ size_t RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::add_observation(
 		}
 	}
 
+	// Landmark track (reverse index): Amortized O(1)
+	if (new_obs.feat_id >= rba_state.lm_observations.size()) rba_state.lm_observations.resize(new_obs.feat_id+1);
+	rba_state.lm_observations[new_obs.feat_id].push_back(new_obs_idx);
+
 	// Maintain a pointer to the relative position wrt its base keyframe:
 	TRelativeLandmarkPos *lm_rel_pos = rba_state.all_lms[new_obs.feat_id].rfp;
-	// and get the ID of the base keyframe for the observed landmark:
-	const TKeyFrameID base_id = lm_rel_pos->id_frame_base;
 
 	// Fill in kf-to-feature edge data:
 	// ------------------------------------
@@ -123,23 +132,48 @@ size_t RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::add_observation(
 
 
 	// Update linear system:
+	m_profiler.enter("add_observation.jacobs.sym");
+
+	if (!link_observation(new_obs_idx))
+	{
+		// Keep it aside, so it can still join the linear system if the landmark gets re-anchored:
+		if (!is_fixed)
+		{
+			rba_state.unlinked_observations[new_obs.feat_id].push_back(new_obs_idx);
+			if (parameters.srba.reanchor_landmarks)
+				m_lms_pending_reanchor.push_back(new_obs.feat_id);
+		}
+	}
+
+	m_profiler.leave("add_observation.jacobs.sym");
+
+	m_profiler.leave("add_observation");
+
+	return new_obs_idx;
+}
+
+/** link_observation (See header for docs) */
+template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
+bool RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::link_observation(const size_t obs_idx)
+{
+	const k2f_edge_t & obs = rba_state.all_observations[obs_idx];
+	const TKeyFrameID observing_kf_id = obs.obs.kf_id;
+	const TKeyFrameID base_id = obs.feat_rel_pos->id_frame_base;
 
 	//  If the observed feat has a known rel. pos., only dh_dAp; otherwise, both dh_dAp and dh_df
 	// ---------------------------------------------------------------------
-	// Add a new (block) row for this new observation (row index = "new_obs_idx" defined above)
+	// Add a new (block) row for this observation (row index = "obs_idx")
 	// We must create a block for each edge in between the observing and the ref. base id.
 	// Note: no error checking here in find's for efficiency...
-	m_profiler.enter("add_observation.jacobs.sym");
-
 	// ===========================
 	// Jacob 1/2: dh_dAp
 	// ===========================
 	bool graph_says_ignore_this_obs = false;
 
-	if (base_id!=new_k2f_edge.obs.kf_id) // If this is a feat with unknown rel.pos. and it's its first observation, the dh_dAp part of the Jacobian is empty.
+	if (base_id!=observing_kf_id) // If this is a feat with unknown rel.pos. observed from its base KF (e.g. its first observation), the dh_dAp part of the Jacobian is empty.
 	{
 #if OBS_SUPER_VERBOSE
-		std::cout << "Jacobian dh_dAp for obs #"<<new_obs_idx << " has these edges [obs_kf="<<observing_kf_id<< " base_kf="<< base_id<<"]:\n";
+		std::cout << "Jacobian dh_dAp for obs #"<<obs_idx << " has these edges [obs_kf="<<observing_kf_id<< " base_kf="<< base_id<<"]:\n";
 #endif
 
 		// Since "all_edges" is symmetric, only the (i,j), i>j entries are stored:
@@ -152,10 +186,12 @@ size_t RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::add_observation(
 		ASSERTMSG_(it_map != rba_state.spanning_tree.sym.all_edges.end(), mrpt::format("No ST.all_edges found for observing_id=%u, base_id=%u", static_cast<unsigned int>(observing_kf_id), static_cast<unsigned int>(base_id) ) )
 
 		typename std::map<TKeyFrameID, typename rba_problem_state_t::k2k_edge_vector_t >::const_iterator it_obs_ed = it_map->second.find(to);
-		//ASSERTMSG_(it_obs_ed != it_map->second.end(), mrpt::format("No spanning-tree found from KF #%u to KF #%u, base of observation of landmark #%u", static_cast<unsigned int>(observing_kf_id),static_cast<unsigned int>(base_id),static_cast<unsigned int>(new_obs.feat_id) ))
+		//ASSERTMSG_(it_obs_ed != it_map->second.end(), mrpt::format("No spanning-tree found from KF #%u to KF #%u, base of observation of landmark #%u", static_cast<unsigned int>(observing_kf_id),static_cast<unsigned int>(base_id),static_cast<unsigned int>(obs.obs.obs.feat_id) ))
 
 		if (it_obs_ed != it_map->second.end())
 		{
+			const unsigned int anchor_version = rba_state.all_lms[obs.obs.obs.feat_id].anchor_version;
+
 			const typename rba_problem_state_t::k2k_edge_vector_t & obs_edges = it_obs_ed->second;
 			ASSERT_(!obs_edges.empty())
 
@@ -175,33 +211,12 @@ size_t RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::add_observation(
 				std::cout << " * edge #"<<edge_id<< ": "<<obs_edges[i]->from <<" => "<<obs_edges[i]->to << " (inverse: " << (normal_dir ? "no":"yes") << ")\n";
 #endif
 
-				// Get sparse block column:
-				typename TSparseBlocksJacobians_dh_dAp::col_t & col = rba_state.lin_system.dh_dAp.getCol(edge_id);
-
-				// Create new entry: O(1) optimized insert if obs_idx is the largest index (as it will normally be):
-				typename TSparseBlocksJacobians_dh_dAp::col_t::iterator it_new_entry = col.insert(
-					col.end(),
-					typename TSparseBlocksJacobians_dh_dAp::col_t::value_type( new_obs_idx, typename TSparseBlocksJacobians_dh_dAp::TEntry() )
-					);
-
-				typename TSparseBlocksJacobians_dh_dAp::TEntry & entry = it_new_entry->second;
-
-				entry.sym.obs_idx          = new_obs_idx;
-				entry.sym.is_valid         = jacob_valid_bit;
-				entry.sym.edge_normal_dir  = normal_dir;
-				entry.sym.kf_d             = curKF;
-				entry.sym.kf_base          = base_id;
-				entry.sym.feat_rel_pos     = lm_rel_pos;
-				entry.sym.k2k_edge_id      = edge_id;
-				//entry.sym.rel_poses_path   = &obs_edges;  // Path OBSERVING_KF -> BASE_KF
-
-				// Pointers to placeholders of future numeric results of the spanning tree:
-				entry.sym.rel_pose_base_from_d1 = & rba_state.spanning_tree.num[curKF][base_id];
-				entry.sym.rel_pose_d1_from_obs  =
-					(curKF==observing_kf_id) ?
-						NULL // Use special value "NULL" when the CPose is fixed to the origin.
-						:
-						& rba_state.spanning_tree.num[observing_kf_id][curKF];
+				// Record the block in compact form, and only create it in dh_dAp if its column is currently materialized
+				// (otherwise, it will be created the next time this edge enters an optimization):
+				typename rba_problem_state_t::TLazyJacobColumn_dh_dAp & lazy_col = rba_state.lin_system.dh_dAp_lazy[edge_id];
+				lazy_col.blocks.push_back( typename rba_problem_state_t::TLazyJacobBlock_dh_dAp(obs_idx, curKF, normal_dir, anchor_version) );
+				if (lazy_col.last_used)
+					materialize_dh_dAp_block(edge_id, lazy_col.blocks.back());
 
 				// next node after this edge is:
 				curKF = normal_dir ? obs_edges[i]->from : obs_edges[i]->to;
@@ -217,10 +232,10 @@ size_t RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::add_observation(
 	// ===========================
 	// Jacob 2/2: dh_df
 	// ===========================
-	if (!is_fixed && !graph_says_ignore_this_obs) // Only for features with unknown rel.pos.
+	if (!obs.feat_has_known_rel_pos && !graph_says_ignore_this_obs) // Only for features with unknown rel.pos.
 	{
 		// "Remap indices" in dh_df for each column are the feature IDs of those feature with unknown positions.
-		const size_t remapIdx = new_k2f_edge.obs.obs.feat_id;
+		const size_t remapIdx = obs.obs.obs.feat_id;
 
 		const mrpt::utils::map_as_vector<size_t,size_t> &dh_df_remap = rba_state.lin_system.dh_df.getColInverseRemappedIndices();
 		const mrpt::utils::map_as_vector<size_t,size_t>::const_iterator it_idx = dh_df_remap.find(remapIdx);  // O(1) in mrpt::utils::map_as_vector()
@@ -229,38 +244,30 @@ size_t RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::add_observation(
 		const size_t col_idx = it_idx->second;
 
 #if OBS_SUPER_VERBOSE
-		cout << "dh_df: col_idx=" << col_idx << " feat_id=" << remapIdx << " obs_idx=" << new_obs_idx <<  endl;
+		cout << "dh_df: col_idx=" << col_idx << " feat_id=" << remapIdx << " obs_idx=" << obs_idx <<  endl;
 #endif
 		// Get sparse block column:
 		typename TSparseBlocksJacobians_dh_df::col_t & col = rba_state.lin_system.dh_df.getCol(col_idx);
 
-		// Create new entry: O(1) optimized insert if obs_idx is the largest index (as it will normally be):
-		typename TSparseBlocksJacobians_dh_df::col_t::iterator it_new_entry = col.insert(
-			col.end(),
-			typename TSparseBlocksJacobians_dh_df::col_t::value_type( new_obs_idx, typename TSparseBlocksJacobians_dh_df::TEntry() )
-			);
+		// Create new entry: O(1) append if obs_idx is the largest index (as it will normally be):
+		typename TSparseBlocksJacobians_dh_df::TEntry & entry = col[obs_idx];
 
-		typename TSparseBlocksJacobians_dh_df::TEntry & entry = it_new_entry->second;
-
-		entry.sym.obs_idx   = new_obs_idx;
-		entry.sym.is_valid  = jacob_valid_bit;
+		entry.sym.obs_idx   = obs_idx;
+		entry.sym.is_valid  = &rba_state.all_observations_Jacob_validity[obs_idx];
 
 		// Pointer to relative position:
-		entry.sym.feat_rel_pos = lm_rel_pos;
+		entry.sym.feat_rel_pos = obs.feat_rel_pos;
 
 		// Pointers to placeholders of future numeric results of the spanning tree:
 		entry.sym.rel_pose_base_from_obs  =
-			(new_k2f_edge.is_first_obs_of_unknown) ?
+			(observing_kf_id==base_id) ?
 				NULL // Use special value "NULL" when the CPose is fixed to the origin.
 				:
 				& rba_state.spanning_tree.num[observing_kf_id][base_id];
 	}
 
-	m_profiler.leave("add_observation.jacobs.sym");
-
-	m_profiler.leave("add_observation");
 
-	return new_obs_idx;
-}
+	return !graph_says_ignore_this_obs;
+} // end of link_observation
 
 } // end NS
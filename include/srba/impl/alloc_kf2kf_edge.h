@@ -55,6 +55,7 @@ size_t TRBA_Problem_state<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::alloc_k
 	const size_t remapIdx = new_edge.id;
 	//TSparseBlocksJacobians_dh_dAp::col_t & col =
 	lin_system.dh_dAp.appendCol(remapIdx);         // O(1) with map_as_vector
+	lin_system.dh_dAp_lazy.push_back(TLazyJacobColumn_dh_dAp()); // Its blocks are only kept in compact form until the edge is optimized
 
 	return new_edge.id;
 
@@ -27,28 +27,36 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::bfs_visitor(
 	K2K_EDGE_VISITOR & k2k_edge_visitor,
 	K2F_EDGE_VISITOR & k2f_edge_visitor ) const
 {
-	using namespace std;
-	set<TLandmarkID>   lm_visited;
-	set<const k2k_edge_t*> k2k_visited;
-	set<const k2f_edge_t*> k2f_visited;
+	// Use the engine working space, unless this is a nested call from within some visitor:
+	TBFSVisitorWorkspace   nested_ws;
+	TBFSVisitorWorkspace & ws = m_bfs_visitor_ws.in_use ? nested_ws : m_bfs_visitor_ws;
+
+	struct TInUseGuard
+	{
+		bool &in_use;
+		TInUseGuard(bool &in_use_) : in_use(in_use_) { in_use=true; }
+		~TInUseGuard() { in_use=false; }
+	} in_use_guard(ws.in_use);
+
+	ws.lm_visited.reset();
+	ws.k2k_visited.reset();
+	// Note: There is no need to keep track of visited k2f edges, since each one only appears in the adjacency list of its
+	//  observing KF, and each KF is visited once at most.
 
 	if (!rely_on_prebuilt_spanning_trees)
 	{	// Don't use prebuilt spanning-trees
 
-		set<TKeyFrameID>   kf_visited;
-		queue<TKeyFrameID> pending;
-		map<TKeyFrameID,topo_dist_t> distances;
+		std::vector<TKeyFrameID> & pending = ws.pending;
+		pending.clear();
+		ws.kf_dist.reset();
 
-		pending.push(root_id);
-		kf_visited.insert(root_id);
-		distances[root_id] = 0;
+		pending.push_back(root_id);
+		ws.kf_dist[root_id] = 0;
 
-		while (!pending.empty())
+		for (size_t pending_idx=0;pending_idx<pending.size();pending_idx++)
 		{
-			const TKeyFrameID next_kf = pending.front();
-			pending.pop();
-
-			const topo_dist_t cur_dist = distances[next_kf];
+			const TKeyFrameID next_kf = pending[pending_idx];
+			const topo_dist_t cur_dist = ws.kf_dist[next_kf];
 
 			kf_visitor.visit_kf(next_kf,cur_dist);
 
@@ -61,18 +69,13 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::bfs_visitor(
 			{
 				const k2f_edge_t* ed = kfi.adjacent_k2f_edges[i];
 				const TLandmarkID lm_ID = ed->obs.obs.feat_id;
-				if (!lm_visited.count(lm_ID))
+				if (ws.lm_visited.insert(lm_ID))
 				{
 					if (feat_visitor.visit_filter_feat(lm_ID,cur_dist) )
 						feat_visitor.visit_feat(lm_ID,cur_dist);
-					lm_visited.insert(lm_ID);
-				}
-				if (!k2f_visited.count(ed))
-				{
-					if (k2f_edge_visitor.visit_filter_k2f(next_kf,ed,cur_dist) )
-						k2f_edge_visitor.visit_k2f(next_kf,ed,cur_dist);
-					k2f_visited.insert(ed);
 				}
+				if (k2f_edge_visitor.visit_filter_k2f(next_kf,ed,cur_dist) )
+					k2f_edge_visitor.visit_k2f(next_kf,ed,cur_dist);
 			}
 
 			// Don't explore nearby keyframes if we are already at the maximum distance from root.
@@ -84,20 +87,18 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::bfs_visitor(
 			{
 				const k2k_edge_t* ed = kfi.adjacent_k2k_edges[i];
 				const TKeyFrameID new_kf = getTheOtherFromPair2(next_kf, *ed);
-				if (!kf_visited.count(new_kf))
+				if (ws.kf_dist.insert(new_kf))
 				{
 					if (kf_visitor.visit_filter_kf(new_kf,cur_dist) )
 					{
-						pending.push(new_kf);
-						distances[new_kf]=cur_dist+1;
+						pending.push_back(new_kf);
+						ws.kf_dist[new_kf]=cur_dist+1;
 					}
-					kf_visited.insert(new_kf);
 				}
-				if (!k2k_visited.count(ed))
+				if (ws.k2k_visited.insert(ed->id))
 				{
 					if (k2k_edge_visitor.visit_filter_k2k(next_kf,new_kf,ed,cur_dist) )
 						k2k_edge_visitor.visit_k2k(next_kf,new_kf,ed,cur_dist);
-					k2k_visited.insert(ed);
 				}
 			}
 		} // end for each "pending"
@@ -113,8 +114,8 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::bfs_visitor(
 		const std::map<TKeyFrameID,TSpanTreeEntry> & root_ST = it_ste->second;
 
 		// make a list with all the KFs in the root's ST, + the root itself:
-		std::vector< std::pair<TKeyFrameID,topo_dist_t> >  KFs;
-		KFs.reserve(root_ST.size()+1);
+		std::vector< std::pair<TKeyFrameID,topo_dist_t> > & KFs = ws.st_kfs;
+		KFs.clear();
 
 		KFs.push_back( std::pair<TKeyFrameID,topo_dist_t>(root_id, 0 /* distance */) );
 		for (typename std::map<TKeyFrameID,TSpanTreeEntry>::const_iterator it=root_ST.begin();it!=root_ST.end();++it)
@@ -145,18 +146,13 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::bfs_visitor(
 			{
 				const k2f_edge_t* ed = kfi.adjacent_k2f_edges[i];
 				const TLandmarkID lm_ID = ed->obs.obs.feat_id;
-				if (!lm_visited.count(lm_ID))
+				if (ws.lm_visited.insert(lm_ID))
 				{
 					if (feat_visitor.visit_filter_feat(lm_ID,cur_dist) )
 						feat_visitor.visit_feat(lm_ID,cur_dist);
-					lm_visited.insert(lm_ID);
-				}
-				if (!k2f_visited.count(ed))
-				{
-					if (k2f_edge_visitor.visit_filter_k2f(kf_id,ed,cur_dist) )
-						k2f_edge_visitor.visit_k2f(kf_id,ed,cur_dist);
-					k2f_visited.insert(ed);
 				}
+				if (k2f_edge_visitor.visit_filter_k2f(kf_id,ed,cur_dist) )
+					k2f_edge_visitor.visit_k2f(kf_id,ed,cur_dist);
 			}
 
 			// Visit all KF2KF edges:
@@ -165,11 +161,10 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::bfs_visitor(
 				const k2k_edge_t* ed = kfi.adjacent_k2k_edges[i];
 				const TKeyFrameID new_kf = getTheOtherFromPair2(kf_id, *ed);
 
-				if (!k2k_visited.count(ed))
+				if (ws.k2k_visited.insert(ed->id))
 				{
 					if (k2k_edge_visitor.visit_filter_k2k(kf_id,new_kf,ed,cur_dist) )
 						k2k_edge_visitor.visit_k2k(kf_id,new_kf,ed,cur_dist);
-					k2k_visited.insert(ed);
 				}
 			}
 		} // end for each KF node in the ST of root
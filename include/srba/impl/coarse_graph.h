@@ -0,0 +1,120 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#pragma once
+
+#include <mrpt/graphslam/levmarq.h>
+
+namespace srba {
+
+/** add_coarse_graph_edge (See header for docs) */
+template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
+bool RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::add_coarse_graph_edge(const size_t edge_id, bool & loop_closed)
+{
+	typedef typename global_graph_t::constraint_no_pdf_t global_pose_t;
+	typename global_graph_t::global_poses_t & nodes = m_coarse_graph.graph.nodes;
+
+	const k2k_edge_t & edge = rba_state.k2k_edges[edge_id];
+	const bool has_from = nodes.find(edge.from)!=nodes.end();
+	const bool has_to   = nodes.find(edge.to)!=nodes.end();
+
+	// Edges in RBA store *inverse* poses "from"->"to", that is, the pose of "from" as seen from "to":
+	if (has_from && has_to)
+		loop_closed = true;
+	else if (has_to)
+		nodes[edge.from] = nodes[edge.to] + global_pose_t(edge.inv_pose);
+	else if (has_from)
+		nodes[edge.to] = nodes[edge.from] + global_pose_t(-edge.inv_pose);
+	else return false;
+
+	m_coarse_graph.k2k_edge_ids.push_back(edge_id);
+	return true;
+}
+
+/** update_coarse_graph (See header for docs) */
+template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
+void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::update_coarse_graph()
+{
+	typedef typename global_graph_t::constraint_no_pdf_t global_pose_t;
+
+	// KF #0 is always an area center, and the origin of coordinates:
+	if (m_coarse_graph.graph.nodes.empty())
+	{
+		m_coarse_graph.graph.nodes[0] = global_pose_t();
+		m_coarse_graph.graph.root = 0;
+	}
+
+	bool loop_closed = false;
+	for (size_t i=0;i<m_coarse_graph.new_k2k_edge_ids.size();i++)
+	{
+		const size_t edge_id = m_coarse_graph.new_k2k_edge_ids[i];
+		const k2k_edge_t & edge = rba_state.k2k_edges[edge_id];
+		if (edge.from==edge.to || !is_area_center(edge.from) || !is_area_center(edge.to))
+			continue; // Edges within an area are summarized by its center
+
+		if (!add_coarse_graph_edge(edge_id,loop_closed))
+		{
+			m_coarse_graph.pending_k2k_edge_ids.push_back(edge_id); // Not connected (yet) to KF #0
+			continue;
+		}
+
+		// A new node may connect some pending edges (which, in turn, may bring in new nodes):
+		for (bool any_added=true; any_added && !m_coarse_graph.pending_k2k_edge_ids.empty(); )
+		{
+			any_added = false;
+			std::vector<size_t> & pending = m_coarse_graph.pending_k2k_edge_ids;
+			for (size_t j=0;j<pending.size(); )
+			{
+				if (add_coarse_graph_edge(pending[j],loop_closed))
+				{
+					pending.erase(pending.begin()+j);
+					any_added = true;
+				}
+				else j++;
+			}
+		}
+	}
+	m_coarse_graph.new_k2k_edge_ids.clear();
+
+	if (loop_closed)
+		optimize_coarse_graph();
+}
+
+/** optimize_coarse_graph (See header for docs) */
+template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
+void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::optimize_coarse_graph()
+{
+	typedef typename global_graph_t::constraint_no_pdf_t global_pose_t;
+
+	m_profiler.enter("optimize_coarse_graph");
+
+	// Refresh the edges with the latest estimates of SRBA (as in get_global_graphslam_problem()): O(#areas)
+	global_graph_t & graph = m_coarse_graph.graph;
+	graph.edges.clear();
+	for (size_t i=0;i<m_coarse_graph.k2k_edge_ids.size();i++)
+	{
+		const k2k_edge_t & edge = rba_state.k2k_edges[ m_coarse_graph.k2k_edge_ids[i] ];
+		graph.insertEdgeAtEnd(edge.to, edge.from, global_pose_t(edge.inv_pose));
+	}
+
+	// Warm-started from the previous solution, so only the areas around the new loop usually move:
+	mrpt::graphslam::TResultInfoSpaLevMarq  opt_info;
+	mrpt::utils::TParametersDouble          extra_params;
+	extra_params["max_iterations"] = parameters.srba.coarse_layer_max_iters;
+	extra_params["verbose"] = (m_verbose_level>=2) ? 1 : 0;
+
+	mrpt::graphslam::optimize_graph_spa_levmarq(graph, opt_info, NULL /* all nodes */, extra_params);
+	m_coarse_graph.num_optimizations++;
+
+	m_profiler.leave("optimize_coarse_graph");
+
+	VERBOSE_LEVEL(1) << "[optimize_coarse_graph] " << graph.nodes.size() << " area centers, " << graph.edges.size() << " edges, final sqr. error=" << opt_info.final_total_sq_error << "\n";
+}
+
+} // end NS
@@ -57,7 +57,14 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::compute_minus_grad
 			const size_t resid_idx = it_obs->second;
 
 			// Accumulate sub-gradient: // g += J^t * \Lambda * residual 
-			RBA_OPTIONS::obs_noise_matrix_t::template accum_Jtr(accum_g_i, itJ->second.num, residuals[ resid_idx ], obs_idx, this->parameters.obs_noise );
+			if (robust_kernel_t::IS_ROBUST && this->parameters.srba.use_robust_kernel)
+			{	// IRLS: g += w * J^t * \Lambda * residual
+				residual_t w_resid = residuals[ resid_idx ];
+				w_resid *= rba_state.all_observations_robust_weight[obs_idx];
+				RBA_OPTIONS::obs_noise_matrix_t::template accum_Jtr(accum_g_i, itJ->second.num, w_resid, obs_idx, this->parameters.obs_noise, rba_state.all_observations_noise_data[obs_idx] );
+			}
+			else
+				RBA_OPTIONS::obs_noise_matrix_t::template accum_Jtr(accum_g_i, itJ->second.num, residuals[ resid_idx ], obs_idx, this->parameters.obs_noise, rba_state.all_observations_noise_data[obs_idx] );
 		}
 		// Do scaling (if applicable):
 		RBA_OPTIONS::obs_noise_matrix_t::template scale_Jtr(accum_g_i, this->parameters.obs_noise );
@@ -81,7 +88,14 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::compute_minus_grad
 			const size_t resid_idx = it_obs->second;
 
 			// Accumulate sub-gradient: // g += J^t * \Lambda * residual 
-			RBA_OPTIONS::obs_noise_matrix_t::template accum_Jtr(accum_g_i, itJ->second.num, residuals[ resid_idx ], obs_idx, this->parameters.obs_noise );
+			if (robust_kernel_t::IS_ROBUST && this->parameters.srba.use_robust_kernel)
+			{	// IRLS: g += w * J^t * \Lambda * residual
+				residual_t w_resid = residuals[ resid_idx ];
+				w_resid *= rba_state.all_observations_robust_weight[obs_idx];
+				RBA_OPTIONS::obs_noise_matrix_t::template accum_Jtr(accum_g_i, itJ->second.num, w_resid, obs_idx, this->parameters.obs_noise, rba_state.all_observations_noise_data[obs_idx] );
+			}
+			else
+				RBA_OPTIONS::obs_noise_matrix_t::template accum_Jtr(accum_g_i, itJ->second.num, residuals[ resid_idx ], obs_idx, this->parameters.obs_noise, rba_state.all_observations_noise_data[obs_idx] );
 		}
 		// Do scaling (if applicable):
 		RBA_OPTIONS::obs_noise_matrix_t::template scale_Jtr(accum_g_i, this->parameters.obs_noise );
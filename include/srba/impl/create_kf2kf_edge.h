@@ -22,6 +22,8 @@ size_t RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::create_kf2kf_edg
 	// ---------------------------------------------------------------------------------
 	const size_t ed_id = rba_state.alloc_kf2kf_edge( new_edge, init_inv_pose_val );     // O(1)
 
+	global_pose_cache_on_new_edge( rba_state.k2k_edges[ed_id] );
+
 	m_profiler.enter("define_new_keyframe.st.update_symbolic");
 
 	// 2) Update symbolic spanning trees:
@@ -46,7 +46,7 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::define_new_keyfram
 		const typename landmark_traits_t::array_landmark_t *fixed_rel_pos       = it_obs->is_fixed                 ? &it_obs->feat_rel_pos : NULL;
 		const typename landmark_traits_t::array_landmark_t *unk_rel_pos_initval = it_obs->is_unknown_with_init_val ? &it_obs->feat_rel_pos : NULL;
 
-		this->add_observation( new_kf_id, it_obs->obs, fixed_rel_pos, unk_rel_pos_initval );
+		this->add_observation( new_kf_id, it_obs->obs, fixed_rel_pos, unk_rel_pos_initval, &it_obs->obs_information );
 	}
 
 	m_profiler.leave("define_new_keyframe.add_observations");
@@ -102,8 +102,21 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::define_new_keyfram
 			);
 
 		m_profiler.leave("define_new_keyframe.optimize");
+		m_last_local_opt_time = out_new_kf_info.optimize_results.elapsed_time;
+
+		// Now that all new edges have been initialized, move landmarks observed beyond the spanning tree of their base KF, if needed:
+		reanchor_pending_landmarks();
 	}
 
+	// Hierarchical optimization: keep the coarse graph of area centers up-to-date, but only with optimized edges
+	// ------------------------------------------------------------------------------------------------------------
+	if (parameters.srba.coarse_layer)
+	{
+		for (size_t i=0;i<new_k2k_edge_ids.size();i++)
+			m_coarse_graph.new_k2k_edge_ids.push_back(new_k2k_edge_ids[i].id);
+		if (run_local_optimization)
+			update_coarse_graph();
+	}
 
 	// Fill out_new_kf_info
 	// -----------------------------------------
@@ -0,0 +1,123 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#pragma once
+
+namespace srba {
+
+// Batched insertion of KFs. See .h for docs.
+template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
+void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::define_new_keyframes(
+	const new_kf_observations_batch_t & batch,
+	new_kf_info_vector_t              & out_new_kf_infos,
+	const bool                          run_local_optimization )
+{
+	ASSERTMSG_(!batch.empty(), "define_new_keyframes() called with an empty batch")
+
+	m_profiler.enter("define_new_keyframes");
+
+	// 1) Create all KFs, edges & observations, in order. Each ECP evaluation needs the symbolic
+	//    spanning trees to be up-to-date with all previous KFs, hence the KF-by-KF loop here.
+	//    The new edges of each KF are also initialized right after creating them (as in define_new_keyframe()),
+	//    so the initial guesses of the edges of the next KFs are built upon them.
+	//    The optimization of the local areas is deferred to step (2).
+	// ----------------------------------------------------------------------------------------
+	const size_t nKFs = batch.size();
+	out_new_kf_infos.resize(nKFs);
+
+	std::vector<size_t>  k2f_edges_to_opt;  // Empty: only initialize k2k edges.
+	std::vector<size_t>  k2k_edges_to_opt(1);
+
+	for (size_t i=0;i<nKFs;i++)
+	{
+		this->define_new_keyframe(batch[i], out_new_kf_infos[i], false /* don't optimize yet */ );
+
+		// Try to initialize the new edges in separate optimizations? (As in define_new_keyframe())
+		if (!run_local_optimization || !parameters.srba.optimize_new_edges_alone)
+			continue;
+
+		m_profiler.enter("define_new_keyframes.opt_new_edges");
+
+		// temporarily disable robust kernel for initialization (faster)
+		const bool old_kernel = parameters.srba.use_robust_kernel;
+		parameters.srba.use_robust_kernel= parameters.srba.use_robust_kernel_stage1;
+
+		const std::vector<TNewEdgeInfo> & new_k2k_edge_ids = out_new_kf_infos[i].created_edge_ids;
+		for (size_t j=0;j<new_k2k_edge_ids.size();j++)
+		{
+			if (new_k2k_edge_ids[j].has_approx_init_val)
+				continue;  // Already initialized, can skip it.
+			k2k_edges_to_opt[0] = new_k2k_edge_ids[j].id;
+
+			this->optimize_edges(
+				k2k_edges_to_opt,
+				k2f_edges_to_opt,
+				out_new_kf_infos[i].optimize_results_stg1
+				);
+		}
+
+		parameters.srba.use_robust_kernel = old_kernel;
+
+		m_profiler.leave("define_new_keyframes.opt_new_edges");
+	}
+
+	// 2) One single optimization for the union of all the local areas:
+	// ----------------------------------------------------------------------------------------
+	if (run_local_optimization)
+	{
+		m_profiler.enter("define_new_keyframes.find_edges2opt");
+
+		const unsigned int win_size = parameters.srba.max_optimize_depth;
+		const bool use_prebuilt_st = (win_size<= parameters.srba.max_tree_depth);
+
+		// Merge the unknowns in the local area of each new KF.
+		// Visitors are run separately for each root, so landmark observation counters are per-window, as in optimize_local_area().
+		TOptimizeLocalAreaParams opt_params; // Default values
+		std::set<size_t>  k2k_edges_union, lm_IDs_union;
+		for (size_t i=0;i<nKFs;i++)
+		{
+			VisitorOptimizeLocalArea my_visitor(this->rba_state,opt_params,m_lm_times_seen_ws);
+			this->bfs_visitor(
+				out_new_kf_infos[i].kf_id,  // Starting keyframe
+				win_size, // max. depth
+				use_prebuilt_st, // Use prebuilt spanning trees for speed-up
+				my_visitor, //kf_visitor,
+				my_visitor, //feat_visitor,
+				my_visitor, //k2k_edge_visitor,
+				my_visitor  //k2f_edge_visitor
+				);
+			k2k_edges_union.insert(my_visitor.k2k_edges_to_optimize.begin(),my_visitor.k2k_edges_to_optimize.end());
+			lm_IDs_union.insert(my_visitor.lm_IDs_to_optimize.begin(),my_visitor.lm_IDs_to_optimize.end());
+		}
+		const std::vector<size_t> k2k_edges_to_optimize(k2k_edges_union.begin(),k2k_edges_union.end());
+		const std::vector<size_t> lm_IDs_to_optimize(lm_IDs_union.begin(),lm_IDs_union.end());
+
+		m_profiler.leave("define_new_keyframes.find_edges2opt");
+
+		m_profiler.enter("define_new_keyframes.optimize");
+		if (!k2k_edges_to_optimize.empty() || !lm_IDs_to_optimize.empty())
+			this->optimize_edges(k2k_edges_to_optimize,lm_IDs_to_optimize, out_new_kf_infos.back().optimize_results);
+		m_profiler.leave("define_new_keyframes.optimize");
+		m_last_local_opt_time = out_new_kf_infos.back().optimize_results.elapsed_time;
+
+		// Now that all new edges have been initialized, move landmarks observed beyond the spanning tree of their base KF, if needed:
+		reanchor_pending_landmarks();
+
+		// The edges of all the new KFs, in order, are now optimized (see define_new_keyframe()):
+		if (parameters.srba.coarse_layer)
+			update_coarse_graph();
+	}
+
+	m_profiler.leave("define_new_keyframes");
+
+	VERBOSE_LEVEL(1) << "[define_new_keyframes] Done. " << nKFs << " new KFs: #" << out_new_kf_infos.front().kf_id << " - #" << out_new_kf_infos.back().kf_id << ".\n";
+} // end of RbaEngine::define_new_keyframes
+
+
+} // end NS
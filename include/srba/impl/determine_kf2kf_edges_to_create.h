@@ -260,6 +260,7 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::determine_kf2kf_ed
 		const k2k_edge_t & nei_edge = rba_state.k2k_edges[new_k2k_edge_ids[i].id];
 		rba_state.last_timestep_touched_kfs.insert( nei_edge.from );
 		rba_state.last_timestep_touched_kfs.insert( nei_edge.to );
+		global_pose_cache_on_edge_changed(nei_edge); // Its initial value may have been just set above
 	}
 
 
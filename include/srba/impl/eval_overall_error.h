@@ -12,127 +12,232 @@
 namespace srba {
 
 template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
-double RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::eval_overall_squared_error() const
+double RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::eval_overall_squared_error(const TEvalOverallErrorParams &params) const
 {
 	using namespace std;
 	using namespace mrpt::utils;
 
 	m_profiler.enter("eval_overall_squared_error");
 
-	double sqerr = 0;
+	const size_t nObs = rba_state.all_observations.size();
+	const size_t nKFs = rba_state.keyframes.size();
 
-	// ---------------------------------------------------------------------------
-	// Make a list of all the observing & base KFs needed by all observations:
-	// ---------------------------------------------------------------------------
-	vector<bool>                         base_ids(rba_state.keyframes.size(), false);
-	map<TKeyFrameID, set<TKeyFrameID> >  ob_pairs; // Minimum ID first index.
+	// all_rel_poses[SOURCE] |--> map[TARGET] = CPose3D of TARGET as seen from SOURCE  (if !single_spanning_tree)
+	TRelativePosesForEachTarget  all_rel_poses;
+
+	// Pose of each KF wrt the root of its connected component (if single_spanning_tree)
+	std::deque<frameid2pose_map_t> global_trees;
+	vector<const pose_t*>          global_poses;
+	vector<TKeyFrameID>            global_tree_root;
 
-	for (typename rba_problem_state_t::all_observations_deque_t::const_iterator itO=rba_state.all_observations.begin();itO!=rba_state.all_observations.end();++itO)
+	if (!params.single_spanning_tree)
 	{
-		const TKeyFrameID obs_id = itO->obs.kf_id;
-		const TKeyFrameID base_id = itO->feat_rel_pos->id_frame_base;
+		// ---------------------------------------------------------------------------
+		// Make a list of all the observing & base KFs needed by all observations:
+		// ---------------------------------------------------------------------------
+		map<TKeyFrameID, set<TKeyFrameID> >  ob_pairs; // Minimum ID first index.
 
-		base_ids[base_id] = true;
-		ob_pairs[ std::min(obs_id,base_id) ].insert( std::max(obs_id,base_id) );
-	}
+		for (typename rba_problem_state_t::all_observations_deque_t::const_iterator itO=rba_state.all_observations.begin();itO!=rba_state.all_observations.end();++itO)
+		{
+			const TKeyFrameID obs_id = itO->obs.kf_id;
+			const TKeyFrameID base_id = itO->feat_rel_pos->id_frame_base;
 
-	// ---------------------------------------------------------------------------
-	// Build all the needed shortest paths:
-	// ---------------------------------------------------------------------------
-	// all_rel_poses[SOURCE] |--> map[TARGET] = CPose3D of TARGET as seen from SOURCE
-	TRelativePosesForEachTarget  all_rel_poses;
-	for (map<TKeyFrameID, set<TKeyFrameID> >::const_iterator it1=ob_pairs.begin();it1!=ob_pairs.end();++it1)
-	{
-		const TKeyFrameID root = it1->first;
+			ob_pairs[ std::min(obs_id,base_id) ].insert( std::max(obs_id,base_id) );
+		}
 
-		// Build S.T. from this root:
-		m_profiler.enter("eval_overall_squared_error.complete_ST");
+		// ---------------------------------------------------------------------------
+		// Build all the needed shortest paths:
+		// ---------------------------------------------------------------------------
+		for (map<TKeyFrameID, set<TKeyFrameID> >::const_iterator it1=ob_pairs.begin();it1!=ob_pairs.end();++it1)
+		{
+			const TKeyFrameID root = it1->first;
 
-		frameid2pose_map_t span_tree;
-		this->create_complete_spanning_tree(root,span_tree);
+			// Build S.T. from this root:
+			m_profiler.enter("eval_overall_squared_error.complete_ST");
 
-		m_profiler.leave("eval_overall_squared_error.complete_ST");
+			frameid2pose_map_t span_tree;
+			this->create_complete_spanning_tree(root,span_tree);
+
+			m_profiler.leave("eval_overall_squared_error.complete_ST");
 
-		// Look for the "set_intersection":
-		typename frameid2pose_map_t::const_iterator       it_have     = span_tree.begin();
-		const typename frameid2pose_map_t::const_iterator it_have_end = span_tree.end();
+			// Look for the "set_intersection":
+			typename frameid2pose_map_t::const_iterator       it_have     = span_tree.begin();
+			const typename frameid2pose_map_t::const_iterator it_have_end = span_tree.end();
 
-		set<TKeyFrameID>::const_iterator         it_want     = it1->second.begin();
-		const set<TKeyFrameID>::const_iterator   it_want_end = it1->second.end();
+			set<TKeyFrameID>::const_iterator         it_want     = it1->second.begin();
+			const set<TKeyFrameID>::const_iterator   it_want_end = it1->second.end();
 
-		while (it_have!=it_have_end && it_want!=it_want_end)
+			while (it_have!=it_have_end && it_want!=it_want_end)
+			{
+				if (it_have->first<*it_want)
+					++it_have;
+				else if (*it_want<it_have->first)
+					++it_want;
+				else
+				{
+					// This means we need 1 or both of the poses:
+					//   root -> *it_want
+					//   *it_want -> root
+					all_rel_poses[root][*it_want] =  it_have->second;
+					all_rel_poses[*it_want][root] = pose_flag_t(-it_have->second.pose, it_have->second.updated);
+
+					++it_have;
+					++it_want;
+				}
+			}
+		}
+	}
+	else
+	{
+		// ---------------------------------------------------------------------------
+		// One complete spanning tree for each connected component with observations,
+		// starting with the one of the user-given root:
+		// ---------------------------------------------------------------------------
+		vector<bool> needed_kfs(nKFs, false);
+		for (typename rba_problem_state_t::all_observations_deque_t::const_iterator itO=rba_state.all_observations.begin();itO!=rba_state.all_observations.end();++itO)
 		{
-			if (it_have->first<*it_want)
-				++it_have;
-			else if (*it_want<it_have->first)
-				++it_want;
-			else
+			needed_kfs[itO->obs.kf_id] = true;
+			needed_kfs[itO->feat_rel_pos->id_frame_base] = true;
+		}
+
+		global_poses.assign(nKFs, NULL);
+		global_tree_root.assign(nKFs, SRBA_INVALID_KEYFRAMEID);
+
+		m_profiler.enter("eval_overall_squared_error.complete_ST");
+		for (size_t i=0;i<=nKFs;i++)
+		{
+			const TKeyFrameID root = (i==0) ? params.root_kf_id : static_cast<TKeyFrameID>(i-1);
+			if (root>=nKFs || !needed_kfs[root] || global_poses[root])
+				continue;
+
+			global_trees.push_back( frameid2pose_map_t() );
+			frameid2pose_map_t & span_tree = global_trees.back();
+			this->create_complete_spanning_tree(root,span_tree);
+
+			for (typename frameid2pose_map_t::const_iterator it=span_tree.begin();it!=span_tree.end();++it)
 			{
-				// This means we need 1 or both of the poses:
-				//   root -> *it_want
-				//   *it_want -> root
-				all_rel_poses[root][*it_want] =  it_have->second;
-				all_rel_poses[*it_want][root] = pose_flag_t(-it_have->second.pose, it_have->second.updated);
-
-				++it_have;
-				++it_want;
+				global_poses[it->first]     = &it->second.pose;
+				global_tree_root[it->first] = root;
 			}
 		}
+		m_profiler.leave("eval_overall_squared_error.complete_ST");
 	}
 
 	// ---------------------------------------------------------------------------
-	// Evaluate errors:
+	// Evaluate errors, in chunks of observations:
 	// ---------------------------------------------------------------------------
-	for (typename rba_problem_state_t::all_observations_deque_t::const_iterator itO=rba_state.all_observations.begin();itO!=rba_state.all_observations.end();++itO)
+	m_profiler.enter("eval_overall_squared_error.residuals");
+
+	// Per-observation errors, only if requested:
+	vector<double> * const obs_sqerr = params.out_obs_sqerr;
+	if (obs_sqerr)
+		obs_sqerr->assign(nObs, 0.0);
+
+	// Computed here, once, since the loop below may run in parallel:
+	typename RBA_OPTIONS::obs_noise_matrix_t::whitening_data_t whitening_data;
+	if (RBA_OPTIONS::obs_noise_matrix_t::PREWHITEN_JACOBIANS)
+		RBA_OPTIONS::obs_noise_matrix_t::get_whitening_data(this->parameters.obs_noise, whitening_data);
+
+	const size_t chunk_size = std::max<size_t>(1,params.parallel_chunk_size);
+	const int    nChunks    = static_cast<int>( (nObs+chunk_size-1)/chunk_size );
+	vector<double> chunk_sqerr(nChunks, 0.0);
+	std::string    error_msg;
+
+#if defined(_OPENMP)
+	#pragma omp parallel for schedule(dynamic)
+#endif
+	for (int chunk=0;chunk<nChunks;chunk++)
 	{
-		// Actually measured pixel coords: observations[i]->obs.px
-
-		const TKeyFrameID obs_frame_id = itO->obs.kf_id;
-		const TKeyFrameID base_id = itO->feat_rel_pos->id_frame_base;
-		const TRelativeLandmarkPos *feat_rel_pos = itO->feat_rel_pos;
-		ASSERTDEB_(feat_rel_pos!=NULL)
-
-		pose_t const * base_pose_wrt_observer=NULL;
-
-		// This case can occur with feats with unknown rel.pos:
-		if (base_id==obs_frame_id)
+		try
 		{
-			base_pose_wrt_observer = &aux_null_pose;
+			const size_t idx_end = std::min(nObs, (chunk+1)*chunk_size);
+			double sum = 0;
+			for (size_t idx=chunk*chunk_size;idx<idx_end;idx++)
+			{
+				const k2f_edge_t & obs = rba_state.all_observations[idx];
+
+				// Actually measured pixel coords: observations[i]->obs.px
+
+				const TKeyFrameID obs_frame_id = obs.obs.kf_id;
+				const TKeyFrameID base_id = obs.feat_rel_pos->id_frame_base;
+				const TRelativeLandmarkPos *feat_rel_pos = obs.feat_rel_pos;
+				ASSERTDEB_(feat_rel_pos!=NULL)
+
+				pose_t const * base_pose_wrt_observer=NULL;
+				pose_t         base_pose_from_global(mrpt::poses::UNINITIALIZED_POSE);
+
+				// This case can occur with feats with unknown rel.pos:
+				if (base_id==obs_frame_id)
+				{
+					base_pose_wrt_observer = &aux_null_pose;
+				}
+				else if (!params.single_spanning_tree)
+				{
+					// num[SOURCE] |--> map[TARGET] = CPose3D of TARGET as seen from SOURCE
+					const typename TRelativePosesForEachTarget::const_iterator itPoseMap_for_base_id = all_rel_poses.find(obs_frame_id);
+					ASSERT_( itPoseMap_for_base_id != all_rel_poses.end() )
+
+					const typename frameid2pose_map_t::const_iterator itRelPose = itPoseMap_for_base_id->second.find(base_id);
+					ASSERT_( itRelPose != itPoseMap_for_base_id->second.end() )
+
+					base_pose_wrt_observer = &itRelPose->second.pose;
+				}
+				else
+				{
+					// base wrt observer = (-observer wrt root) (+) base wrt root
+					ASSERT_( global_poses[obs_frame_id]!=NULL && global_tree_root[obs_frame_id]==global_tree_root[base_id] )
+					base_pose_from_global.composeFrom( -(*global_poses[obs_frame_id]), *global_poses[base_id] );
+					base_pose_wrt_observer = &base_pose_from_global;
+				}
+
+				// pose_robot2sensor(): pose wrt sensor = pose_wrt_robot (-) sensor_pose_on_the_robot
+				sensor_pose_t base_pose_wrt_sensor(mrpt::poses::UNINITIALIZED_POSE);
+				RBA_OPTIONS::sensor_pose_on_robot_t::pose_robot2sensor( *base_pose_wrt_observer, base_pose_wrt_sensor, this->parameters.sensor_pose );
+
+				// Stored observation:
+				const array_obs_t & z_real = obs.obs.obs_arr;
+
+				// Predict observation and compare to real obs:
+				residual_t delta;
+				sensor_model_t::observe_error(
+					delta,
+					z_real,
+					base_pose_wrt_sensor,
+					feat_rel_pos->pos, // Position of LM wrt its base_id
+					this->parameters.sensor
+					);
+
+				// Pre-whitened residuals (if applicable), weighted like in reprojection_residuals():
+				if (RBA_OPTIONS::obs_noise_matrix_t::PREWHITEN_JACOBIANS)
+					RBA_OPTIONS::obs_noise_matrix_t::whiten(delta, whitening_data, rba_state.all_observations_noise_data[idx] );
+				const double sqerr = RBA_OPTIONS::obs_noise_matrix_t::eval_sqr_error(delta, this->parameters.obs_noise, rba_state.all_observations_noise_data[idx] );
+				if (obs_sqerr)
+					(*obs_sqerr)[idx] = sqerr;
+				sum += sqerr;
+			}
+			chunk_sqerr[chunk] = sum;
 		}
-		else
+		catch (std::exception &e)
 		{
-			// num[SOURCE] |--> map[TARGET] = CPose3D of TARGET as seen from SOURCE
-			const typename TRelativePosesForEachTarget::const_iterator itPoseMap_for_base_id = all_rel_poses.find(obs_frame_id);
-			ASSERT_( itPoseMap_for_base_id != all_rel_poses.end() )
-
-			const typename frameid2pose_map_t::const_iterator itRelPose = itPoseMap_for_base_id->second.find(base_id);
-			ASSERT_( itRelPose != itPoseMap_for_base_id->second.end() )
-
-			base_pose_wrt_observer = &itRelPose->second.pose;
+			// Exceptions can't cross the parallel region: report after it.
+#if defined(_OPENMP)
+			#pragma omp critical
+#endif
+			error_msg = e.what();
 		}
-
-		// Sensor pose: base_pose_wrt_sensor = robot_pose (+) sensor_pose_on_the_robot
-		typename options::internal::resulting_pose_t<typename RBA_OPTIONS::sensor_pose_on_robot_t,REL_POSE_DIMS>::pose_t base_pose_wrt_sensor(mrpt::poses::UNINITIALIZED_POSE);
-		RBA_OPTIONS::sensor_pose_on_robot_t::robot2sensor( *base_pose_wrt_observer, base_pose_wrt_sensor, this->parameters.sensor_pose );
-
-		// Stored observation:
-		const array_obs_t & z_real = itO->obs.obs_arr;
-
-		// Predict observation and compare to real obs:
-		residual_t delta;
-		sensor_model_t::observe_error(
-			delta,
-			z_real,
-			base_pose_wrt_sensor,
-			feat_rel_pos->pos, // Position of LM wrt its base_id
-			this->parameters.sensor
-			);
-
-		sqerr+= delta.squaredNorm();
 	}
 
+	m_profiler.leave("eval_overall_squared_error.residuals");
 	m_profiler.leave("eval_overall_squared_error");
 
+	if (!error_msg.empty())
+		THROW_EXCEPTION(error_msg)
+
+	// Deterministic reduction:
+	double sqerr = 0;
+	for (int chunk=0;chunk<nChunks;chunk++)
+		sqerr += chunk_sqerr[chunk];
+
 	return sqerr;
 }
 
@@ -44,7 +44,9 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::build_opengl_repre
 			//  starting (root) at the given keyframe:
 
 			frameid2pose_map_t  spantree;
-			create_complete_spanning_tree(root_keyframe,spantree, options.span_tree_max_depth );
+			if (options.span_tree_max_depth==std::numeric_limits<size_t>::max())
+			     get_global_poses(root_keyframe,spantree);
+			else create_complete_spanning_tree(root_keyframe,spantree, options.span_tree_max_depth );
 
 			// For each key-frame, add a 3D corner:
 			for (typename frameid2pose_map_t::const_iterator itP = spantree.begin();itP!=spantree.end();++itP)
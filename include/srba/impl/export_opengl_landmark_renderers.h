@@ -47,7 +47,7 @@ template <> struct LandmarkRendererBase<landmark_rendering_as_point>
 		scene.insert(gl_lms);
 
 		vector<typename RBA::TRelativeLandmarkPosMap::const_iterator> lms_to_draw;
-		vector<const typename RBA::hessian_traits_t::TSparseBlocksHessian_f::matrix_t *> lms_to_draw_inf_covs;
+		vector<const typename RBA::hessian_traits_t::landmark_inf_matrix_t *> lms_to_draw_inf_covs;
 
 		for (typename RBA::TRelativeLandmarkPosMap::const_iterator itLM = rba.get_rba_state().known_lms.begin();itLM != rba.get_rba_state().known_lms.end();++itLM)
 		{
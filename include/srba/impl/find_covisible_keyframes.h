@@ -0,0 +1,52 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#pragma once
+
+namespace srba {
+
+/** find_covisible_keyframes (See header for docs) */
+template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
+void TRBA_Problem_state<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::find_covisible_keyframes(
+	const TKeyFrameID   kf_id,
+	const size_t        min_shared_lms,
+	base_sorted_lst_t & out_covisible_kfs) const
+{
+	out_covisible_kfs.clear();
+	ASSERTDEB_(kf_id<keyframes.size())
+
+	// Count the landmarks shared with each KF, following the track of each landmark seen from "kf_id".
+	// Landmarks observed more than once from one KF must only be counted once:
+	std::map<TKeyFrameID,size_t> num_shared;
+	std::set<TLandmarkID>        visited_lms;
+	std::set<TKeyFrameID>        kfs_seeing_lm;
+
+	const std::deque<k2f_edge_t*> & kf_obs = keyframes[kf_id].adjacent_k2f_edges;
+	for (size_t i=0;i<kf_obs.size();i++)
+	{
+		const TLandmarkID lm_id = kf_obs[i]->obs.obs.feat_id;
+		if (!visited_lms.insert(lm_id).second)
+			continue;
+
+		const std::vector<size_t> & track = lm_observations[lm_id];
+		kfs_seeing_lm.clear();
+		for (size_t j=0;j<track.size();j++)
+		{
+			const TKeyFrameID other_kf = all_observations[track[j]].obs.kf_id;
+			if (other_kf!=kf_id && kfs_seeing_lm.insert(other_kf).second)
+				num_shared[other_kf]++;
+		}
+	}
+
+	for (std::map<TKeyFrameID,size_t>::const_iterator it=num_shared.begin();it!=num_shared.end();++it)
+		if (it->second>=min_shared_lms)
+			out_covisible_kfs.insert( std::make_pair(it->second,it->first) );
+}
+
+} // end NS
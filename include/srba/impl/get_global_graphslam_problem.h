@@ -26,7 +26,7 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::get_global_graphsl
 	// 1) Initialize global poses with a Spanning-tree:
 	// ------------------------------------------------
 	frameid2pose_map_t  spantree;
-	create_complete_spanning_tree(params.root_kf_id,spantree); // Go thru COMPLETE graph (unbounded complexity, non O(1) )
+	get_global_poses(params.root_kf_id,spantree); // Go thru COMPLETE graph, but only recomputing what changed since the last call
 
 	// For each key-frame, add a 3D corner:
 	for (typename frameid2pose_map_t::const_iterator itP = spantree.begin();itP!=spantree.end();++itP)
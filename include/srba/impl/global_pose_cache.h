@@ -0,0 +1,218 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#pragma once
+
+#include <queue>
+#include <algorithm>
+
+namespace srba {
+
+/** get_global_pose (See header for docs) */
+template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
+const typename RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::pose_t *
+RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::get_global_pose(const TKeyFrameID kf_id, const TKeyFrameID root_id) const
+{
+	if (m_global_pose_cache_root!=root_id)
+		global_pose_cache_rebuild(root_id);
+
+	if (kf_id>=m_global_pose_cache.size() || !m_global_pose_cache[kf_id].in_tree)
+		return NULL;
+
+	global_pose_cache_update(kf_id);
+	return &m_global_pose_cache[kf_id].pose;
+}
+
+/** get_global_poses (See header for docs) */
+template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
+void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::get_global_poses(const TKeyFrameID root_id, frameid2pose_map_t & span_tree) const
+{
+	span_tree.clear();
+
+	if (m_global_pose_cache_root!=root_id)
+		global_pose_cache_rebuild(root_id);
+
+	for (size_t kf_id=0;kf_id<m_global_pose_cache.size();kf_id++)
+	{
+		if (!m_global_pose_cache[kf_id].in_tree)
+			continue;
+		global_pose_cache_update(kf_id);
+		span_tree[kf_id] = pose_flag_t(m_global_pose_cache[kf_id].pose, true);
+	}
+}
+
+template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
+void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::global_pose_cache_rebuild(const TKeyFrameID root_id) const
+{
+	m_profiler.enter("global_pose_cache.rebuild");
+
+	invalidate_global_pose_cache();
+
+	const size_t nKFs = rba_state.keyframes.size();
+	if (root_id<nKFs)
+	{
+		m_global_pose_cache.resize(nKFs);
+
+		TGlobalPoseCacheNode & root = m_global_pose_cache[root_id];
+		root.in_tree = true;
+		root.pose = pose_t();  // Origin
+		root.pose_valid = true;
+
+		// BFS, in the same order than create_complete_spanning_tree():
+		std::queue<TKeyFrameID> pending;
+		pending.push(root_id);
+
+		while (!pending.empty())
+		{
+			const TKeyFrameID cur_kf = pending.front();
+			pending.pop();
+
+			const keyframe_info & kfi = rba_state.keyframes[cur_kf];
+			for (size_t i=0;i<kfi.adjacent_k2k_edges.size();i++)
+			{
+				const k2k_edge_t* ed = kfi.adjacent_k2k_edges[i];
+				const TKeyFrameID new_kf = getTheOtherFromPair2(cur_kf, *ed);
+				if (!m_global_pose_cache[new_kf].in_tree)
+				{
+					global_pose_cache_attach(new_kf,cur_kf,ed);
+					pending.push(new_kf);
+				}
+			}
+		}
+
+		m_global_pose_cache_root = root_id;
+	}
+
+	m_profiler.leave("global_pose_cache.rebuild");
+}
+
+template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
+void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::global_pose_cache_attach(const TKeyFrameID kf_id, const TKeyFrameID parent_id, const k2k_edge_t * edge) const
+{
+	TGlobalPoseCacheNode & node = m_global_pose_cache[kf_id];
+	TGlobalPoseCacheNode & parent = m_global_pose_cache[parent_id];
+
+	node.parent = parent_id;
+	node.edge = edge;
+	node.depth = parent.depth+1;
+	node.in_tree = true;
+	node.pose_valid = false;
+	parent.children.push_back(kf_id);
+}
+
+template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
+void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::global_pose_cache_update(const TKeyFrameID kf_id) const
+{
+	// Go up until the first node with a valid pose (the root, at least):
+	std::vector<TKeyFrameID> path;
+	for (TKeyFrameID cur=kf_id; !m_global_pose_cache[cur].pose_valid; cur=m_global_pose_cache[cur].parent)
+		path.push_back(cur);
+
+	// And compose poses down to kf_id:
+	for (size_t i=path.size();i-->0;)
+	{
+		TGlobalPoseCacheNode & node = m_global_pose_cache[path[i]];
+		const pose_t & parent_pose = m_global_pose_cache[node.parent].pose;
+
+		// Is the edge direct or inverted?
+		if (node.edge->to==path[i])
+		{
+			// Edge: parent -> me
+			//  "inv_pose" in edge is really the inverse pose of me w.r.t. my parent:
+			node.pose.composeFrom(parent_pose, -node.edge->inv_pose );
+		}
+		else
+		{
+			// Edge: me -> parent
+			//  "inv_pose" in edge is directly the pose of me w.r.t. my parent:
+			node.pose.composeFrom(parent_pose, node.edge->inv_pose );
+		}
+		node.pose_valid = true;
+	}
+}
+
+template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
+void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::global_pose_cache_on_new_edge(const k2k_edge_t & edge) const
+{
+	if (m_global_pose_cache_root==SRBA_INVALID_KEYFRAMEID)
+		return; // Nothing to update, it will be built upon the next query
+
+	if (m_global_pose_cache.size()<rba_state.keyframes.size())
+		m_global_pose_cache.resize(rba_state.keyframes.size());
+
+	const bool from_in_tree = m_global_pose_cache[edge.from].in_tree;
+	const bool to_in_tree   = m_global_pose_cache[edge.to].in_tree;
+
+	if (!from_in_tree && !to_in_tree)
+		return; // Not connected to the root (yet)
+
+	if (from_in_tree!=to_in_tree)
+	{
+		// A new KF? Attach it as a leaf, otherwise it's a whole new connected component:
+		const TKeyFrameID parent_id = from_in_tree ? edge.from : edge.to;
+		const TKeyFrameID kf_id     = from_in_tree ? edge.to : edge.from;
+		if (rba_state.keyframes[kf_id].adjacent_k2k_edges.size()==1)
+			global_pose_cache_attach(kf_id,parent_id,&edge);
+		else invalidate_global_pose_cache();
+		return;
+	}
+
+	// Both ends already in the tree: the tree remains a BFS tree unless the new edge shortens the distance to the root:
+	const TKeyFrameID deeper_id    = m_global_pose_cache[edge.from].depth > m_global_pose_cache[edge.to].depth ? edge.from : edge.to;
+	const TKeyFrameID shallower_id = getTheOtherFromPair2(deeper_id, edge);
+	TGlobalPoseCacheNode & deeper = m_global_pose_cache[deeper_id];
+	const topo_dist_t new_depth = m_global_pose_cache[shallower_id].depth+1;
+
+	if (deeper.depth<=new_depth)
+		return;
+
+	// Typical case of a new KF with several edges: move the leaf closer to the root, if no other KF gets closer through it:
+	bool can_move_leaf = deeper.children.empty();
+	const keyframe_info & kfi = rba_state.keyframes[deeper_id];
+	for (size_t i=0;can_move_leaf && i<kfi.adjacent_k2k_edges.size();i++)
+		if (m_global_pose_cache[ getTheOtherFromPair2(deeper_id, *kfi.adjacent_k2k_edges[i]) ].depth > new_depth+1)
+			can_move_leaf = false;
+
+	if (can_move_leaf)
+	{
+		std::vector<TKeyFrameID> & siblings = m_global_pose_cache[deeper.parent].children;
+		siblings.erase( std::find(siblings.begin(),siblings.end(),deeper_id) );
+		global_pose_cache_attach(deeper_id,shallower_id,&edge);
+	}
+	else invalidate_global_pose_cache();
+}
+
+template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
+void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::global_pose_cache_on_edge_changed(const k2k_edge_t & edge) const
+{
+	if (m_global_pose_cache_root==SRBA_INVALID_KEYFRAMEID)
+		return;
+
+	// Only tree edges affect the cached poses, those of the subtree below the edge:
+	TKeyFrameID subtree_root;
+	if (edge.to<m_global_pose_cache.size() && m_global_pose_cache[edge.to].edge==&edge)
+		subtree_root = edge.to;
+	else if (edge.from<m_global_pose_cache.size() && m_global_pose_cache[edge.from].edge==&edge)
+		subtree_root = edge.from;
+	else return;
+
+	// Invalid nodes have all their subtree already invalid:
+	std::vector<TKeyFrameID> pending(1, subtree_root);
+	while (!pending.empty())
+	{
+		TGlobalPoseCacheNode & node = m_global_pose_cache[pending.back()];
+		pending.pop_back();
+		if (!node.pose_valid)
+			continue;
+		node.pose_valid = false;
+		pending.insert(pending.end(), node.children.begin(), node.children.end());
+	}
+}
+
+} // End of namespaces
@@ -12,12 +12,16 @@
 #include <mrpt/math/jacobians.h>
 #include <mrpt/poses/SE_traits.h>
 #include <srba/landmark_jacob_families.h>
+#include <srba/srba_autodiff.h>
 
 namespace srba {
 
 #ifndef SRBA_USE_NUMERIC_JACOBIANS
 #  define SRBA_USE_NUMERIC_JACOBIANS             0
 #endif
+#ifndef SRBA_USE_AUTODIFF_JACOBIANS
+#  define SRBA_USE_AUTODIFF_JACOBIANS            0   // Evaluate dh_dx by automatic differentiation of sensor_model<>::eval_observation<T>() instead of eval_jacob_dh_dx() (only for models providing it)
+#endif
 #ifndef SRBA_VERIFY_AGAINST_NUMERIC_JACOBIANS
 #  define SRBA_VERIFY_AGAINST_NUMERIC_JACOBIANS  0
 #endif
@@ -30,6 +34,29 @@ namespace srba {
 
 
 namespace internal {
+	/** Auxiliary template for evaluating dh_dx either with the analytic sensor_model<>::eval_jacob_dh_dx() or, if
+	 * SRBA_USE_AUTODIFF_JACOBIANS is enabled, by automatic differentiation of sensor_model<>::eval_observation<T>(). */
+	template <class SENSOR_MODEL, bool USE_AUTODIFF>
+	struct sensor_jacob_dh_dx {
+		static inline bool eval(typename SENSOR_MODEL::TJacobian_dh_dx & dh_dx, const typename SENSOR_MODEL::array_landmark_t & xji_l, const typename SENSOR_MODEL::TObservationParams & sensor_params) {
+			return SENSOR_MODEL::eval_jacob_dh_dx(dh_dx,xji_l,sensor_params);
+		}
+	};
+	template <class SENSOR_MODEL>
+	struct sensor_jacob_dh_dx<SENSOR_MODEL,true> {
+		static inline bool eval(typename SENSOR_MODEL::TJacobian_dh_dx & dh_dx, const typename SENSOR_MODEL::array_landmark_t & xji_l, const typename SENSOR_MODEL::TObservationParams & sensor_params) {
+			return autodiff::eval_jacob_dh_dx<SENSOR_MODEL>(dh_dx,xji_l,sensor_params);
+		}
+	};
+
+	/** Whether dh_dx is evaluated by automatic differentiation: only if SRBA_USE_AUTODIFF_JACOBIANS is enabled and the sensor model
+	 * provides eval_observation<T>(). Sensor models without it (e.g. relative poses, whose dh_dx is the identity) fall back to their
+	 * analytic eval_jacob_dh_dx(). */
+	template <class SENSOR_MODEL>
+	struct use_autodiff_jacob_dh_dx {
+		static const bool value = (SRBA_USE_AUTODIFF_JACOBIANS!=0) && has_eval_observation<SENSOR_MODEL>::value;
+	};
+
     /** Auxiliary template for evaluating the dh_df part in \a recompute_all_Jacobians().
 	 * The extra complexity of adding this auxiliary template with specializations is required to
 	 * avoid the compiler trying to evaluate the jacobians dh_df in relative SLAM problems, where
@@ -43,7 +70,8 @@ namespace internal {
         static size_t eval(
             RBAENGINE &rba,
             LSTJACOBCOLS  &lst_JacobCols_df,  // std::vector<typename RBAENGINE::TSparseBlocksJacobians_dh_df::col_t*>
-            LSTPOSES * out_list_of_required_num_poses ) // std::vector<const typename RBAENGINE::kf2kf_pose_traits<RBAENGINE::kf2kf_pose_t>::pose_flag_t*>
+            LSTPOSES * out_list_of_required_num_poses, // std::vector<const typename RBAENGINE::kf2kf_pose_traits<RBAENGINE::kf2kf_pose_t>::pose_flag_t*>
+            const std::vector<char> * obs_to_relinearize )
         {
             const size_t nUnknowns_k2f = lst_JacobCols_df.size();
             size_t nJacobs = 0;
@@ -55,6 +83,8 @@ namespace internal {
                 for (typename RBAENGINE::TSparseBlocksJacobians_dh_df::col_t::iterator it=col->begin();it!=col->end();++it)
                 {
                     const size_t obs_idx = it->first;
+                    if (obs_to_relinearize && !(*obs_to_relinearize)[obs_idx])
+                        continue;
                     typename RBAENGINE::TSparseBlocksJacobians_dh_df::TEntry & jacob_entry = it->second;
                     rba.compute_jacobian_dh_df(
                         jacob_entry,
@@ -74,10 +104,11 @@ namespace internal {
         static size_t eval(
             RBAENGINE &rba,
             LSTJACOBCOLS  &lst_JacobCols_df,  // std::vector<typename RBAENGINE::TSparseBlocksJacobians_dh_df::col_t*>
-            LSTPOSES * out_list_of_required_num_poses ) // std::vector<const typename RBAENGINE::kf2kf_pose_traits<RBAENGINE::kf2kf_pose_t>::pose_flag_t*>
+            LSTPOSES * out_list_of_required_num_poses, // std::vector<const typename RBAENGINE::kf2kf_pose_traits<RBAENGINE::kf2kf_pose_t>::pose_flag_t*>
+            const std::vector<char> * obs_to_relinearize )
         {
 			MRPT_UNUSED_PARAM(rba); MRPT_UNUSED_PARAM(lst_JacobCols_df);
-			MRPT_UNUSED_PARAM(out_list_of_required_num_poses);
+			MRPT_UNUSED_PARAM(out_list_of_required_num_poses); MRPT_UNUSED_PARAM(obs_to_relinearize);
             // Nothing to do: this will never be actually called.
             return 0;
         }
@@ -90,7 +121,7 @@ template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
 void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::numeric_dh_dAp(const array_pose_t &x, const TNumeric_dh_dAp_params& params, array_obs_t &y)
 {
 	pose_t incr(mrpt::poses::UNINITIALIZED_POSE);
-	mrpt::poses::SE_traits<pose_t::rotation_dimensions>::pseudo_exp(x,incr);
+	se_traits_t::pseudo_exp(x,incr);
 
 	pose_t base_from_obs(mrpt::poses::UNINITIALIZED_POSE);
 	if (!params.is_inverse_dir)
@@ -255,19 +286,31 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::compute_jacobian_d
 	}
 
 
-	// i<-l = d <- obs/l  (+)  base/i <- d
-	pose_t pose_i_wrt_l(mrpt::poses::UNINITIALIZED_POSE);
-	if (pose_d1_wrt_obs!=NULL)
-			pose_i_wrt_l.composeFrom( pose_d1_wrt_obs->pose, pose_base_wrt_d1.pose);
-	else	pose_i_wrt_l = pose_base_wrt_d1.pose;
+	// dh_dx already evaluated by reprojection_residuals() at this same linearization point? (only for sensor models with observe_error_and_jacob())
+	const typename rba_problem_state_t::TObsFusedJacobian * fused = find_fused_dh_dx(jacob.sym.obs_idx);
 
 	// First, we need x^{j,i}_i:
 	// LM parameters in: jacob.sym.feat_rel_pos->pos[0:N-1]
 	const array_landmark_t &xji_i = jacob.sym.feat_rel_pos->pos;
 
-	// xji_l = pose_i_wrt_l (+) xji_i
 	array_landmark_t xji_l = xji_i; //
-	landmark_t::composePosePoint(xji_l, pose_i_wrt_l);
+	if (!fused)
+	{
+		// i<-l = d <- obs/l  (+)  base/i <- d
+		//  (Shared by all the Jacobian blocks and residuals with the same observer & base KFs)
+		const TRelTransformCacheEntry * tf = find_rel_transform(observation.obs.kf_id, jacob.sym.kf_base);
+		if (!tf)
+		{
+			pose_t pose_i_wrt_l(mrpt::poses::UNINITIALIZED_POSE);
+			if (pose_d1_wrt_obs!=NULL)
+					pose_i_wrt_l.composeFrom( pose_d1_wrt_obs->pose, pose_base_wrt_d1.pose);
+			else	pose_i_wrt_l = pose_base_wrt_d1.pose;
+			tf = set_rel_transform(observation.obs.kf_id, jacob.sym.kf_base, pose_i_wrt_l);
+		}
+
+		// xji_l = pose_i_wrt_l (+) xji_i
+		landmark_t::composePosePoint(xji_l, tf->base_pose_wrt_observer);
+	}
 
 #if DEBUG_JACOBIANS_SUPER_VERBOSE  // Debug:
 	{
@@ -314,16 +357,30 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::compute_jacobian_d
 	// -----------------------------
 	Eigen::Matrix<double,OBS_DIMS,LM_DIMS>  dh_dx;
 
-	// Converts a point relative to the robot coordinate frame (P) into a point relative to the sensor (RES = P \ominus POSE_IN_ROBOT )
-	RBA_OPTIONS::sensor_pose_on_robot_t::template point_robot2sensor<landmark_t,array_landmark_t>(xji_l,xji_l,this->parameters.sensor_pose );
-
-	// Invoke sensor model:
-	if (!sensor_model_t::eval_jacob_dh_dx(dh_dx,xji_l, this->parameters.sensor))
+	if (fused)
 	{
-		// Invalid Jacobian:
-		*jacob.sym.is_valid = 0;
-		jacob.num.setZero();
-		return;
+		if (!fused->valid)
+		{
+			// Invalid Jacobian:
+			*jacob.sym.is_valid = 0;
+			jacob.num.setZero();
+			return;
+		}
+		dh_dx = fused->dh_dx;
+	}
+	else
+	{
+		// Converts a point relative to the robot coordinate frame (P) into a point relative to the sensor (RES = P \ominus POSE_IN_ROBOT )
+		RBA_OPTIONS::sensor_pose_on_robot_t::template point_robot2sensor<landmark_t,array_landmark_t>(xji_l,xji_l,this->parameters.sensor_pose );
+
+		// Invoke sensor model:
+		if (!internal::sensor_jacob_dh_dx<sensor_model_t,internal::use_autodiff_jacob_dh_dx<sensor_model_t>::value>::eval(dh_dx,xji_l, this->parameters.sensor))
+		{
+			// Invalid Jacobian:
+			*jacob.sym.is_valid = 0;
+			jacob.num.setZero();
+			return;
+		}
 	}
 
 	// take into account the possible displacement of the sensor wrt the keyframe:
@@ -890,7 +947,6 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::compute_jacobian_d
 	const k2f_edge_t & observation,
 	std::vector<const pose_flag_t*> *out_list_of_required_num_poses) const
 {
-	MRPT_UNUSED_PARAM(observation);
 	if (! *jacob.sym.is_valid )
 		return; // Another block of the same Jacobian row said this observation was invalid for some reason.
 
@@ -922,7 +978,14 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::compute_jacobian_d
 
 	array_landmark_t xji_l = xji_i; //
 
-	if (rel_pose_base_from_obs!=NULL)
+	// dh_dx already evaluated by reprojection_residuals() at this same linearization point? (only for sensor models with observe_error_and_jacob())
+	const typename rba_problem_state_t::TObsFusedJacobian * fused = find_fused_dh_dx(jacob.sym.obs_idx);
+
+	if (fused)
+	{
+		// xji_l not needed.
+	}
+	else if (rel_pose_base_from_obs!=NULL)
 	{
 #if 0
 		cout << "dh_df(ft_id="<< observation.obs.obs.feat_id << ", obs_kf="<< observation.obs.kf_id << "): o2b=" << *rel_pose_base_from_obs << endl;
@@ -964,16 +1027,30 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::compute_jacobian_d
 	// -----------------------------
 	Eigen::Matrix<double,OBS_DIMS,LM_DIMS>  dh_dx;
 
-	// Converts a point relative to the robot coordinate frame (P) into a point relative to the sensor (RES = P \ominus POSE_IN_ROBOT )
-	RBA_OPTIONS::sensor_pose_on_robot_t::template point_robot2sensor<landmark_t,array_landmark_t>(xji_l,xji_l,this->parameters.sensor_pose );
-
-	// Invoke sensor model:
-	if (!sensor_model_t::eval_jacob_dh_dx(dh_dx,xji_l, this->parameters.sensor))
+	if (fused)
 	{
-		// Invalid Jacobian:
-		*jacob.sym.is_valid = 0;
-		jacob.num.setZero();
-		return;
+		if (!fused->valid)
+		{
+			// Invalid Jacobian:
+			*jacob.sym.is_valid = 0;
+			jacob.num.setZero();
+			return;
+		}
+		dh_dx = fused->dh_dx;
+	}
+	else
+	{
+		// Converts a point relative to the robot coordinate frame (P) into a point relative to the sensor (RES = P \ominus POSE_IN_ROBOT )
+		RBA_OPTIONS::sensor_pose_on_robot_t::template point_robot2sensor<landmark_t,array_landmark_t>(xji_l,xji_l,this->parameters.sensor_pose );
+
+		// Invoke sensor model:
+		if (!internal::sensor_jacob_dh_dx<sensor_model_t,internal::use_autodiff_jacob_dh_dx<sensor_model_t>::value>::eval(dh_dx,xji_l, this->parameters.sensor))
+		{
+			// Invalid Jacobian:
+			*jacob.sym.is_valid = 0;
+			jacob.num.setZero();
+			return;
+		}
 	}
 
 	// take into account the possible displacement of the sensor wrt the keyframe:
@@ -983,9 +1060,17 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::compute_jacobian_d
 	// ------------------------------
 	if (rel_pose_base_from_obs!=NULL)
 	{
-		mrpt::math::CMatrixFixedNumeric<double,LM_DIMS,LM_DIMS> R(mrpt::math::UNINITIALIZED_MATRIX);
-		rel_pose_base_from_obs->pose.getRotationMatrix(R);
-		jacob.num.noalias() = dh_dx * R;
+		// Rotation shared by all the dh_df blocks with the same observer & base KFs:
+		const TKeyFrameID base_id = jacob.sym.feat_rel_pos->id_frame_base;
+		TRelTransformCacheEntry * tf = find_rel_transform(observation.obs.kf_id, base_id);
+		if (!tf)
+			tf = set_rel_transform(observation.obs.kf_id, base_id, rel_pose_base_from_obs->pose);
+		if (!tf->R_valid)
+		{
+			tf->base_pose_wrt_observer.getRotationMatrix(tf->R);
+			tf->R_valid = true;
+		}
+		jacob.num.noalias() = dh_dx * tf->R;
 	}
 	else
 	{
@@ -1083,7 +1168,8 @@ template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
 size_t RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::recompute_all_Jacobians(
 	std::vector<typename TSparseBlocksJacobians_dh_dAp::col_t*> &lst_JacobCols_dAp,
 	std::vector<typename TSparseBlocksJacobians_dh_df::col_t*>  &lst_JacobCols_df,
-	std::vector<const typename kf2kf_pose_traits<kf2kf_pose_t>::pose_flag_t*>    * out_list_of_required_num_poses )
+	std::vector<const typename kf2kf_pose_traits<kf2kf_pose_t>::pose_flag_t*>    * out_list_of_required_num_poses,
+	const std::vector<char> * obs_to_relinearize )
 {
 	size_t nJacobs=0;
 	if (out_list_of_required_num_poses) out_list_of_required_num_poses->clear();
@@ -1099,6 +1185,8 @@ size_t RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::recompute_all_Ja
 		for (typename TSparseBlocksJacobians_dh_dAp::col_t::iterator it=col->begin();it!=col->end();++it)
 		{
 			const size_t obs_idx = it->first;
+			if (obs_to_relinearize && !(*obs_to_relinearize)[obs_idx])
+				continue; // Lazy relinearization: keep the old linearization point
 			typename TSparseBlocksJacobians_dh_dAp::TEntry & jacob_entry = it->second;
 			compute_jacobian_dh_dp(
 				jacob_entry,
@@ -1111,7 +1199,24 @@ size_t RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::recompute_all_Ja
 
 	// k2f edges ------------------------------------------------------
 	// Only if we are in landmarks-based SLAM, not in graph-SLAM:
-	nJacobs += internal::recompute_all_Jacobians_dh_df<landmark_t::jacob_family>::eval(*this, lst_JacobCols_df,out_list_of_required_num_poses);
+	nJacobs += internal::recompute_all_Jacobians_dh_df<landmark_t::jacob_family>::eval(*this, lst_JacobCols_df,out_list_of_required_num_poses,obs_to_relinearize);
+
+	// Pre-whitening: J <- U*J, with \Lambda=U^t*U, so Hessians need no \Lambda (residuals are whitened in reprojection_residuals())
+	if (RBA_OPTIONS::obs_noise_matrix_t::PREWHITEN_JACOBIANS)
+	{
+		typename RBA_OPTIONS::obs_noise_matrix_t::whitening_data_t whitening_data;
+		RBA_OPTIONS::obs_noise_matrix_t::get_whitening_data(this->parameters.obs_noise, whitening_data);
+
+		for (size_t i=0;i<nUnknowns_k2k;i++)
+			for (typename TSparseBlocksJacobians_dh_dAp::col_t::iterator it=lst_JacobCols_dAp[i]->begin();it!=lst_JacobCols_dAp[i]->end();++it)
+				if (!obs_to_relinearize || (*obs_to_relinearize)[it->first])
+					RBA_OPTIONS::obs_noise_matrix_t::whiten(it->second.num, whitening_data, rba_state.all_observations_noise_data[it->first] );
+
+		for (size_t i=0;i<lst_JacobCols_df.size();i++)
+			for (typename TSparseBlocksJacobians_dh_df::col_t::iterator it=lst_JacobCols_df[i]->begin();it!=lst_JacobCols_df[i]->end();++it)
+				if (!obs_to_relinearize || (*obs_to_relinearize)[it->first])
+					RBA_OPTIONS::obs_noise_matrix_t::whiten(it->second.num, whitening_data, rba_state.all_observations_noise_data[it->first] );
+	}
 
 	return nJacobs;
 } // end of recompute_all_Jacobians()
@@ -0,0 +1,98 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#pragma once
+
+namespace srba {
+
+/** materialize_dh_dAp_block (See header for docs) */
+template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
+void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::materialize_dh_dAp_block(
+	const size_t edge_id,
+	const typename rba_problem_state_t::TLazyJacobBlock_dh_dAp & rec)
+{
+	const k2f_edge_t & obs = rba_state.all_observations[rec.obs_idx];
+	const TKeyFrameID observing_kf_id = obs.obs.kf_id;
+	const TKeyFrameID base_id         = obs.feat_rel_pos->id_frame_base;
+
+	// Create new entry: O(1) append if obs_idx is the largest index (as it will normally be):
+	typename TSparseBlocksJacobians_dh_dAp::TEntry & entry = rba_state.lin_system.dh_dAp.getCol(edge_id)[rec.obs_idx];
+
+	entry.sym.obs_idx          = rec.obs_idx;
+	entry.sym.is_valid         = &rba_state.all_observations_Jacob_validity[rec.obs_idx];
+	entry.sym.edge_normal_dir  = rec.edge_normal_dir;
+	entry.sym.kf_d             = rec.kf_d;
+	entry.sym.kf_base          = base_id;
+	entry.sym.feat_rel_pos     = obs.feat_rel_pos;
+	entry.sym.k2k_edge_id      = edge_id;
+
+	// Pointers to placeholders of future numeric results of the spanning tree:
+	entry.sym.rel_pose_base_from_d1 = & rba_state.spanning_tree.num[rec.kf_d][base_id];
+	entry.sym.rel_pose_d1_from_obs  =
+		(rec.kf_d==observing_kf_id) ?
+			NULL // Use special value "NULL" when the CPose is fixed to the origin.
+			:
+			& rba_state.spanning_tree.num[observing_kf_id][rec.kf_d];
+}
+
+/** materialize_dh_dAp_column (See header for docs) */
+template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
+void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::materialize_dh_dAp_column(const size_t edge_id)
+{
+	typename rba_problem_state_t::TLinearSystem & ls = rba_state.lin_system;
+	ASSERTDEB_(edge_id<ls.dh_dAp_lazy.size())
+
+	typename rba_problem_state_t::TLazyJacobColumn_dh_dAp & lazy_col = ls.dh_dAp_lazy[edge_id];
+	if (!lazy_col.last_used)
+	{
+		// Blocks are normally stored in increasing order of observations, so insertions are O(1) appends.
+		// Records left obsolete by re-anchored landmarks are dropped on the way:
+		std::vector<typename rba_problem_state_t::TLazyJacobBlock_dh_dAp> & blocks = lazy_col.blocks;
+		ls.dh_dAp.getCol(edge_id).reserve(blocks.size());
+		size_t n=0;
+		for (size_t i=0;i<blocks.size();i++)
+		{
+			if (is_obsolete_dh_dAp_record(blocks[i]))
+				continue;
+			materialize_dh_dAp_block(edge_id, blocks[i]);
+			if (n!=i) blocks[n] = blocks[i];
+			n++;
+		}
+		blocks.erase(blocks.begin()+n, blocks.end());
+		ls.dh_dAp_materialized.push_back(edge_id);
+	}
+	lazy_col.last_used = ls.dh_dAp_usage_counter;
+}
+
+/** release_unused_dh_dAp_columns (See header for docs) */
+template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
+void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::release_unused_dh_dAp_columns()
+{
+	const size_t release_after = parameters.srba.dh_dAp_release_after;
+	if (!release_after)
+		return;
+
+	typename rba_problem_state_t::TLinearSystem & ls = rba_state.lin_system;
+
+	size_t n=0;
+	for (size_t i=0;i<ls.dh_dAp_materialized.size();i++)
+	{
+		const size_t edge_id = ls.dh_dAp_materialized[i];
+		typename rba_problem_state_t::TLazyJacobColumn_dh_dAp & lazy_col = ls.dh_dAp_lazy[edge_id];
+		if (ls.dh_dAp_usage_counter - lazy_col.last_used >= release_after)
+		{
+			ls.dh_dAp.getCol(edge_id).clear_and_free();
+			lazy_col.last_used = 0;
+		}
+		else ls.dh_dAp_materialized[n++] = edge_id;
+	}
+	ls.dh_dAp_materialized.resize(n);
+}
+
+} // end NS
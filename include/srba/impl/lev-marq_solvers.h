@@ -55,7 +55,10 @@ namespace internal
 			typename hessian_traits_t::TSparseBlocksHessian_Apf &HApf_,
 			Eigen::VectorXd  &minus_grad_,
 			const size_t nUnknowns_k2k_,
-			const size_t nUnknowns_k2f_) :
+			const size_t nUnknowns_k2f_,
+			typename RBA_ENGINE::schur_landmark_cache_t * schur_cache = NULL,
+			const std::vector<size_t> * k2k_edge_ids = NULL,
+			const std::vector<size_t> * landmark_ids = NULL ) :
 				m_verbose_level(verbose_level),
 				m_profiler(profiler),
 				HAp(HAp_), Hf(Hf_), HApf(HApf_),
@@ -66,6 +69,8 @@ namespace internal
 				idx_start_f(POSE_DIMS*nUnknowns_k2k),
 				sS(NULL), sS_is_valid(false)
 		{
+			// No Schur complement, no need for its cache:
+			MRPT_UNUSED_PARAM(schur_cache); MRPT_UNUSED_PARAM(k2k_edge_ids); MRPT_UNUSED_PARAM(landmark_ids);
 		}
 
 		~solver_engine()
@@ -249,7 +254,10 @@ namespace internal
 			typename hessian_traits_t::TSparseBlocksHessian_Apf &HApf_,
 			Eigen::VectorXd  &minus_grad_,
 			const size_t nUnknowns_k2k_,
-			const size_t nUnknowns_k2f_) :
+			const size_t nUnknowns_k2f_,
+			typename RBA_ENGINE::schur_landmark_cache_t * schur_cache = NULL,
+			const std::vector<size_t> * k2k_edge_ids = NULL,
+			const std::vector<size_t> * landmark_ids = NULL ) :
 				m_verbose_level(verbose_level),
 				m_profiler(profiler),
 				nUnknowns_k2k(nUnknowns_k2k_),
@@ -261,7 +269,8 @@ namespace internal
 					HAp_,Hf_,HApf_, // The different symbolic/numeric Hessians
 					&minus_grad[0],  // minus gradient of the Ap part
 					// Handle case of no unknown features:
-					nUnknowns_k2f!=0 ? &minus_grad[POSE_DIMS*nUnknowns_k2k] : NULL   // minus gradient of the features part
+					nUnknowns_k2f!=0 ? &minus_grad[POSE_DIMS*nUnknowns_k2k] : NULL,   // minus gradient of the features part
+					schur_cache, k2k_edge_ids, landmark_ids // Persistent cache of landmark terms
 					)
 		{
 		}
@@ -448,7 +457,10 @@ namespace internal
 			typename hessian_traits_t::TSparseBlocksHessian_Apf &HApf_,
 			Eigen::VectorXd  &minus_grad_,
 			const size_t nUnknowns_k2k_,
-			const size_t nUnknowns_k2f_) :
+			const size_t nUnknowns_k2f_,
+			typename RBA_ENGINE::schur_landmark_cache_t * schur_cache = NULL,
+			const std::vector<size_t> * k2k_edge_ids = NULL,
+			const std::vector<size_t> * landmark_ids = NULL ) :
 				m_verbose_level(verbose_level),
 				m_profiler(profiler),
 				nUnknowns_k2k(nUnknowns_k2k_),
@@ -459,7 +471,8 @@ namespace internal
 					HAp_,Hf_,HApf_, // The different symbolic/numeric Hessians
 					&minus_grad[0],  // minus gradient of the Ap part
 					// Handle case of no unknown features:
-					nUnknowns_k2f!=0 ? &minus_grad[POSE_DIMS*nUnknowns_k2k] : NULL   // minus gradient of the features part
+					nUnknowns_k2f!=0 ? &minus_grad[POSE_DIMS*nUnknowns_k2k] : NULL,   // minus gradient of the features part
+					schur_cache, k2k_edge_ids, landmark_ids // Persistent cache of landmark terms
 					),
 				denseChol_is_uptodate (false),
 				hessian_is_valid (false)
@@ -10,6 +10,7 @@
 #pragma once
 
 #include <mrpt/math/ops_containers.h> // norm_inf()
+#include <mrpt/utils/CTicTac.h>
 
 namespace srba {
 
@@ -33,6 +34,20 @@ namespace internal
 	struct solver_engine;
 
 	// Implemented in lev-marq_solvers.h
+
+	/** Sets a variable to a new value during the lifetime of this object, restoring its former value on destruction (also if an exception is thrown) */
+	template <typename T>
+	class scoped_value_change
+	{
+	public:
+		scoped_value_change(T &var, const T &new_value) : m_var(var), m_old_value(var) { m_var = new_value; }
+		~scoped_value_change() { m_var = m_old_value; }
+	private:
+		T       & m_var;
+		const T   m_old_value;
+		scoped_value_change(const scoped_value_change &); // Non-copyable
+		scoped_value_change & operator =(const scoped_value_change &);
+	};
 }
 
 
@@ -54,9 +69,21 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::optimize_edges(
 	typedef internal::solver_engine<RBA_OPTIONS::solver_t::USE_SCHUR,RBA_OPTIONS::solver_t::DENSE_CHOLESKY,rba_engine_t> my_solver_t;
 	
 	m_profiler.enter("opt");
+	mrpt::utils::CTicTac opt_timer; // Unlike m_profiler, always enabled: ECPs may use it
+	opt_timer.Tic();
 
 	out_info.clear();
 
+	// Create the dh_dAp Jacobian blocks of the edges to optimize (if they were not already in memory),
+	//  and free those of edges which have been out of all optimizations for a while:
+	// -------------------------------------------------------------------------------
+	DETAILED_PROFILING_ENTER("opt.materialize_dh_dAp")
+	++rba_state.lin_system.dh_dAp_usage_counter;
+	for (size_t i=0;i<run_k2k_edges_in.size();i++)
+		materialize_dh_dAp_column(run_k2k_edges_in[i]);
+	release_unused_dh_dAp_columns();
+	DETAILED_PROFILING_LEAVE("opt.materialize_dh_dAp")
+
 	// Problem dimensions:
 	const size_t POSE_DIMS = kf2kf_pose_t::REL_POSE_DIMS;
 	const size_t LM_DIMS   = landmark_t::LM_DIMS;
@@ -254,9 +281,25 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::optimize_edges(
 	// -------------------------------------------------------------------------------
 	DETAILED_PROFILING_ENTER("opt.update_spanning_tree_num")
 	const size_t count_span_tree_num_update = rba_state.spanning_tree.update_numeric(kfs_num_spantrees_to_update, false /* don't skip those marked as updated, so update all */);
+	invalidate_transform_cache(); // Cached (observer,base) transformations are now outdated
 	DETAILED_PROFILING_LEAVE("opt.update_spanning_tree_num")
 
 
+	// Compute the reprojection errors:
+	//  residuals = "h(x)-z" (a vector of 2-vectors).
+	//  (Done before the Jacobians, which reuse the dh_dx evaluated here if the sensor model supports it, and
+	//   before the Hessian numeric update, since it also refreshes the robust kernel weights)
+	// ---------------------------------------------------------------------------------
+	vector_residuals_t  residuals(nObs);
+
+	DETAILED_PROFILING_ENTER("opt.reprojection_residuals")
+	double total_proj_error = reprojection_residuals(
+		residuals, // Out
+		involved_obs // In
+		);
+	DETAILED_PROFILING_LEAVE("opt.reprojection_residuals")
+
+
 	// Re-evaluate all Jacobians numerically:
 	// -------------------------------------------------------------------------------
 	std::vector<const pose_flag_t*>    list_of_required_num_poses; // Filled-in by Jacobian evaluation upon first call.
@@ -267,7 +310,7 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::optimize_edges(
 	//  If needed, they'll be marked as invalid by the Jacobian evaluator if just one of the components
 	//  for one observation leads to an error.
 	for (size_t i=0;i<nObs;i++)
-		rba_state.all_observations_Jacob_validity[ involved_obs[i].obs_idx ] = 1;
+		rba_state.all_observations_Jacob_validity[ involved_obs[i].obs_idx ] = rba_state.all_observations_is_outlier[ involved_obs[i].obs_idx ] ? 0 : 1;
 
 	DETAILED_PROFILING_LEAVE("opt.reset_Jacobs_validity")
 
@@ -377,9 +420,7 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::optimize_edges(
 		}
 		for (size_t i=0;i<nUnknowns_k2f;i++)
 		{
-			ASSERTDEB_(Hf.getCol(i).find(i)!=Hf.getCol(i).end())
-
-			const double Hii_max = Hf.getCol(i)[i].num.diagonal().maxCoeff();
+			const double Hii_max = Hf.getDiagonalBlock(i).diagonal().maxCoeff();
 			mrpt::utils::keep_max(Hess_diag_max, Hii_max);
 		}
 
@@ -389,18 +430,6 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::optimize_edges(
 		DETAILED_PROFILING_LEAVE("opt.guess lambda")
 	}
 
-	// Compute the reprojection errors:
-	//  residuals = "h(x)-z" (a vector of 2-vectors).
-	// ---------------------------------------------------------------------------------
-	vector_residuals_t  residuals(nObs);
-
-	DETAILED_PROFILING_ENTER("opt.reprojection_residuals")
-	double total_proj_error = reprojection_residuals(
-		residuals, // Out
-		involved_obs // In
-		);
-	DETAILED_PROFILING_LEAVE("opt.reprojection_residuals")
-
 	double RMSE = std::sqrt(total_proj_error/nObs);
 
 	out_info.num_observations     = nObs;
@@ -428,12 +457,17 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::optimize_edges(
 
 	// Build symbolic structures for Schur complement:
 	// ---------------------------------------------------------------------------------
+	// Free the cached Schur terms of landmarks & edges which have been out of all optimizations for a while:
+	m_schur_lm_cache.new_usage();
+	m_schur_lm_cache.release_unused(parameters.srba.schur_cache_release_after);
+	const size_t schur_cache_reused_before = m_schur_lm_cache.num_reused, schur_cache_recomputed_before = m_schur_lm_cache.num_recomputed;
 	my_solver_t my_solver(
 		m_verbose_level, m_profiler, 
 		HAp,Hf,HApf, // The different symbolic/numeric Hessian
 		minus_grad,  // minus gradient of the Ap part
 		nUnknowns_k2k,
-		nUnknowns_k2f);
+		nUnknowns_k2f,
+		&m_schur_lm_cache, &run_k2k_edges, &run_feat_ids); // Reuse Schur terms of landmarks whose Hessian blocks didn't change since previous optimizations
 	// Notice: At this point, the constructor of "my_solver_t" might have already built the Schur-complement 
 	// of HAp-HApf into HAp: it's overwritten there (Only if RBA_OPTIONS::solver_t::USE_SCHUR=true).
 
@@ -444,6 +478,23 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::optimize_edges(
 	vector<pose_flag_t>      old_span_tree; // In the same order than "list_of_required_num_poses"
 	vector<TRelativeLandmarkPos>  old_k2f_edge_unknowns;
 
+	// Lazy relinearization: accumulated increment of each unknown since its last linearization, and
+	// the list (indexed by global obs. index) of observations whose Jacobians must be re-evaluated:
+	const bool lazy_relinearization = this->parameters.srba.relinearize_threshold_k2k>0 || this->parameters.srba.relinearize_threshold_k2f>0;
+	vector<double>  k2k_incr_since_relin, k2f_incr_since_relin;
+	vector<char>    obs_to_relinearize;
+	// With robust kernels, the IRLS weight each observation had at its last linearization, so skipped Hessian blocks never keep stale weights:
+	const bool lazy_relin_robust_weights = lazy_relinearization && robust_kernel_t::IS_ROBUST && this->parameters.srba.use_robust_kernel;
+	vector<double>  robust_weight_at_relin;
+	if (lazy_relinearization)
+	{
+		k2k_incr_since_relin.assign(nUnknowns_k2k, 0.0);
+		k2f_incr_since_relin.assign(nUnknowns_k2f, 0.0);
+		obs_to_relinearize.assign(rba_state.all_observations.size(), 0);
+		if (lazy_relin_robust_weights)
+			robust_weight_at_relin.assign(rba_state.all_observations_robust_weight.begin(), rba_state.all_observations_robust_weight.end());
+	}
+
 #if SRBA_DETAILED_TIME_PROFILING
 	const std::string sLabelProfilerLM_iter = mrpt::format("opt.lm_iteration_k2k=%03u_k2f=%03u", static_cast<unsigned int>(nUnknowns_k2k), static_cast<unsigned int>(nUnknowns_k2f) );
 #endif
@@ -563,6 +614,7 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::optimize_edges(
 				list_of_required_num_poses[i]->mark_outdated();
 
 			rba_state.spanning_tree.update_numeric(kfs_num_spantrees_to_update, true /* Only those marked as outdated above */);
+			invalidate_transform_cache();
 			DETAILED_PROFILING_LEAVE("opt.update_spanning_tree_num")
 
 			// Compute new reprojection errors:
@@ -603,6 +655,66 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::optimize_edges(
 				total_proj_error = new_total_proj_error;
 				RMSE = new_RMSE;
 
+				// Lazy relinearization: only observations depending on unknowns which moved enough are relinearized.
+				const vector<char> * relin_obs_mask = NULL;
+				if (lazy_relinearization)
+				{
+					DETAILED_PROFILING_ENTER("opt.lazy_relinearization_mask")
+					for (size_t i=0;i<nUnknowns_k2k;i++)
+						k2k_incr_since_relin[i] += my_solver.delta_eps.segment(POSE_DIMS*i,POSE_DIMS).cwiseAbs().maxCoeff();
+					for (size_t i=0;i<nUnknowns_k2f;i++)
+						k2f_incr_since_relin[i] += my_solver.delta_eps.segment(idx_start_f+LM_DIMS*i,LM_DIMS).cwiseAbs().maxCoeff();
+
+					if (do_relinearize)
+					{
+						for (size_t i=0;i<nObs;i++)
+							obs_to_relinearize[ involved_obs[i].obs_idx ] = 0;
+
+						size_t nRelinUnknowns = 0;
+						for (size_t i=0;i<nUnknowns_k2k;i++)
+						{
+							if (k2k_incr_since_relin[i]<=this->parameters.srba.relinearize_threshold_k2k)
+								continue;
+							k2k_incr_since_relin[i] = 0;
+							nRelinUnknowns++;
+							for (typename TSparseBlocksJacobians_dh_dAp::col_t::const_iterator it=dh_dAp[i]->begin();it!=dh_dAp[i]->end();++it)
+								obs_to_relinearize[it->first] = 1;
+						}
+						for (size_t i=0;i<nUnknowns_k2f;i++)
+						{
+							if (k2f_incr_since_relin[i]<=this->parameters.srba.relinearize_threshold_k2f)
+								continue;
+							k2f_incr_since_relin[i] = 0;
+							nRelinUnknowns++;
+							for (typename TSparseBlocksJacobians_dh_df::col_t::const_iterator it=dh_df[i]->begin();it!=dh_df[i]->end();++it)
+								obs_to_relinearize[it->first] = 1;
+						}
+						// Observations whose robust weight changed must be re-evaluated even if their unknowns barely moved:
+						size_t nReweightedObs = 0;
+						if (lazy_relin_robust_weights)
+						{
+							for (size_t i=0;i<nObs;i++)
+							{
+								const size_t obs_idx = involved_obs[i].obs_idx;
+								const double w = rba_state.all_observations_robust_weight[obs_idx];
+								if (w!=robust_weight_at_relin[obs_idx])
+								{
+									obs_to_relinearize[obs_idx] = 1;
+									nReweightedObs++;
+								}
+								if (obs_to_relinearize[obs_idx])
+									robust_weight_at_relin[obs_idx] = w;
+							}
+						}
+						relin_obs_mask = &obs_to_relinearize;
+
+						VERBOSE_LEVEL(2) << "[OPT] Lazy relinearization: " << nRelinUnknowns << " out of " << (nUnknowns_k2k+nUnknowns_k2f) << " unknowns moved beyond the threshold, " << nReweightedObs << " observations reweighted.\n";
+						if (!nRelinUnknowns && !nReweightedObs)
+							do_relinearize = false;
+					}
+					DETAILED_PROFILING_LEAVE("opt.lazy_relinearization_mask")
+				}
+
 				if (do_relinearize)
 				{
 					DETAILED_PROFILING_ENTER("opt.reset_Jacobs_validity")
@@ -610,19 +722,24 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::optimize_edges(
 					//  If needed, they'll be marked as invalid by the Jacobian evaluator if just one of the components
 					//  for one observation leads to an error.
 					for (size_t i=0;i<nObs;i++)
-						rba_state.all_observations_Jacob_validity[ involved_obs[i].obs_idx ] = 1;
+					{
+						const size_t obs_idx = involved_obs[i].obs_idx;
+						if (!relin_obs_mask || obs_to_relinearize[obs_idx])
+							rba_state.all_observations_Jacob_validity[obs_idx] = rba_state.all_observations_is_outlier[obs_idx] ? 0 : 1;
+					}
 
 					DETAILED_PROFILING_LEAVE("opt.reset_Jacobs_validity")
 
 					DETAILED_PROFILING_ENTER("opt.recompute_all_Jacobians")
-					recompute_all_Jacobians(dh_dAp, dh_df);
+					const size_t nRecomputedJacobs = recompute_all_Jacobians(dh_dAp, dh_df, NULL, relin_obs_mask);
+					out_info.num_relin_skipped_jacobians += count_jacobians - nRecomputedJacobs;
 					DETAILED_PROFILING_LEAVE("opt.recompute_all_Jacobians")
 
 					// Recalculate Hessian:
 					DETAILED_PROFILING_ENTER("opt.sparse_hessian_update_numeric")
-					sparse_hessian_update_numeric(HAp);
-					sparse_hessian_update_numeric(Hf);
-					sparse_hessian_update_numeric(HApf);
+					sparse_hessian_update_numeric(HAp, relin_obs_mask, &out_info.num_relin_skipped_hessian_blocks);
+					sparse_hessian_update_numeric(Hf, relin_obs_mask, &out_info.num_relin_skipped_hessian_blocks);
+					sparse_hessian_update_numeric(HApf, relin_obs_mask, &out_info.num_relin_skipped_hessian_blocks);
 					DETAILED_PROFILING_LEAVE("opt.sparse_hessian_update_numeric")
 
 					my_solver.realize_relinearized();
@@ -669,6 +786,8 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::optimize_edges(
 					}
 				}
 
+				invalidate_transform_cache();
+
 				// Restore old edge values:
 				for (size_t i=0;i<nUnknowns_k2k;i++)
 				{
@@ -736,11 +855,8 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::optimize_edges(
 				if (!my_solver.was_ith_feature_invertible(i))
 					continue;
 
-				const typename hessian_traits_t::TSparseBlocksHessian_f::col_t & col_i = Hf.getCol(i);
-				ASSERT_(col_i.rbegin()->first==i)  // Make sure the last block matrix is the diagonal term of the upper-triangular matrix.
-
-				const typename hessian_traits_t::TSparseBlocksHessian_f::matrix_t & inf_mat_src = col_i.rbegin()->second.num;
-				typename hessian_traits_t::TSparseBlocksHessian_f::matrix_t & inf_mat_dst = rba_state.unknown_lms_inf_matrices[ run_feat_ids[i] ];
+				const typename hessian_traits_t::TSparseBlocksHessian_f::matrix_t & inf_mat_src = Hf.getDiagonalBlock(i);
+				typename hessian_traits_t::landmark_inf_matrix_t & inf_mat_dst = rba_state.unknown_lms_inf_matrices[ run_feat_ids[i] ];
 				inf_mat_dst = inf_mat_src;
 			}
 		}
@@ -764,6 +880,10 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::optimize_edges(
 		DETAILED_PROFILING_LEAVE("opt.condition_number")
 	}
 
+	// The global poses below the optimized edges are now outdated:
+	for (size_t i=0;i<k2k_edge_unknowns.size();i++)
+		global_pose_cache_on_edge_changed(*k2k_edge_unknowns[i]);
+
 	// Fill in any other extra info from the solver:
 	DETAILED_PROFILING_ENTER("opt.get_extra_results")
 	my_solver.get_extra_results(out_info.extra_results);
@@ -785,11 +905,64 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::optimize_edges(
 
 	m_profiler.leave("opt");
 	out_info.obs_rmse = RMSE;
+	out_info.num_schur_cached_blocks_reused     = m_schur_lm_cache.num_reused - schur_cache_reused_before;
+	out_info.num_schur_cached_blocks_recomputed = m_schur_lm_cache.num_recomputed - schur_cache_recomputed_before;
 
 	const bool rmse_too_high = (RMSE>parameters.srba.max_rmse_show_red_warning);
 	if (rmse_too_high && m_verbose_level>=1) mrpt::system::setConsoleColor(mrpt::system::CONCOL_RED);
 	VERBOSE_LEVEL(1) << "[OPT] Final RMSE=" <<  RMSE << " #iters=" << iter << "\n";
+	if (lazy_relinearization)
+		VERBOSE_LEVEL(1) << "[OPT] Lazy relinearization skipped " << out_info.num_relin_skipped_jacobians << " Jacobian blocks and " << out_info.num_relin_skipped_hessian_blocks << " Hessian blocks.\n";
 	if (rmse_too_high && m_verbose_level>=1) mrpt::system::setConsoleColor(mrpt::system::CONCOL_NORMAL);
+
+	// Chi-square outlier gating, then re-solve without outliers (optional):
+	// ------------------------------------------------------------------------
+	if (parameters.srba.outlier_rejection)
+	{
+		m_profiler.enter("opt.outlier_rejection");
+
+		const double chi2_thres = mrpt::math::chi2inv(parameters.srba.outlier_rejection_confidence, OBS_DIMS);
+
+		std::vector<size_t> new_outliers;
+		for (size_t i=0;i<nObs;i++)
+		{
+			const size_t obs_idx = involved_obs[i].obs_idx;
+			if (rba_state.all_observations_is_outlier[obs_idx])
+				continue; // Already disabled
+
+			const double sqr_mahalanobis = RBA_OPTIONS::obs_noise_matrix_t::eval_sqr_mahalanobis(residuals[i], parameters.obs_noise, rba_state.all_observations_noise_data[obs_idx] );
+			if (sqr_mahalanobis>chi2_thres)
+				new_outliers.push_back(obs_idx);
+		}
+
+		// Don't disable all the observations at once: that would most likely be a wrong noise model, not outliers.
+		if (!new_outliers.empty() && new_outliers.size()<nObs)
+		{
+			for (size_t i=0;i<new_outliers.size();i++)
+				rba_state.all_observations_is_outlier[ new_outliers[i] ] = 1;
+
+			VERBOSE_LEVEL(1) << "[OPT] Chi2 gating: " << new_outliers.size() << " outlier observations disabled. Re-running optimization.\n";
+
+			// Re-run, warm-started from the current solution (and without gating again):
+			TOptimizeExtraOutputInfo resolve_info;
+			{
+				const internal::scoped_value_change<bool> no_gating(parameters.srba.outlier_rejection, false);
+				this->optimize_edges(out_info.optimized_k2k_edge_indices, out_info.optimized_landmark_indices, resolve_info, in_observation_indices_to_optimize);
+			}
+
+			resolve_info.total_sqr_error_init = out_info.total_sqr_error_init;
+			out_info = resolve_info;
+			out_info.outlier_obs_indices.swap(new_outliers);
+		}
+		else
+		{
+			out_info.outlier_obs_indices.clear(); // Nothing was disabled
+		}
+
+		m_profiler.leave("opt.outlier_rejection");
+	}
+
+	out_info.elapsed_time = opt_timer.Tac(); // Including the re-run without outliers, if any
 }
 
 } // End of namespaces
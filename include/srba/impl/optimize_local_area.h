@@ -33,7 +33,7 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::optimize_local_are
 	// --------------------------------------------------
 	m_profiler.enter("optimize_local_area.find_edges2opt");
 
-	VisitorOptimizeLocalArea my_visitor(this->rba_state,params);
+	VisitorOptimizeLocalArea my_visitor(this->rba_state,params,m_lm_times_seen_ws);
 
 	this->bfs_visitor(
 		root_id,  // Starting keyframe
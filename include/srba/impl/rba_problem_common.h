@@ -19,7 +19,9 @@ template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
 RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::RbaEngine() :
 	m_verbose_level(1),
 	rba_state(),
-	m_profiler(true)
+	m_profiler(true),
+	m_transform_cache_epoch(0),
+	m_global_pose_cache_root(SRBA_INVALID_KEYFRAMEID)
 {
 	clear();
 }
@@ -29,6 +31,13 @@ template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
 void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::clear()
 {
 	this->rba_state.clear();
+	invalidate_transform_cache();
+	invalidate_global_pose_cache();
+	m_schur_lm_cache.clear();
+	m_lms_pending_reanchor.clear();
+	m_last_local_opt_time = 0;
+	m_coarse_graph.clear();
+	edge_creation_policy = typename RBA_OPTIONS::edge_creation_policy_t(); // Reset stateful ECPs
 }
 
 template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
@@ -46,12 +55,21 @@ RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::TSRBAParameters::TSRBAP
 	max_rho              ( 10.0 ),
 	max_lambda           ( 1e20 ),
 	min_error_reduction_ratio_to_relinearize ( 0.01 ),
+	relinearize_threshold_k2k ( 0 ),
+	relinearize_threshold_k2f ( 0 ),
 	numeric_jacobians    ( false ),
 	feedback_user_iteration(NULL),
 	compute_condition_number(false),
 	compute_sparsity_stats  (false),
 	max_rmse_show_red_warning(0.5),
-	cov_recovery         ( crpLandmarksApprox )
+	cov_recovery         ( crpLandmarksApprox ),
+	outlier_rejection    ( false ),
+	outlier_rejection_confidence ( 0.999 ),
+	dh_dAp_release_after ( 10 ),
+	schur_cache_release_after ( 10 ),
+	reanchor_landmarks   ( true ),
+	coarse_layer         ( false ),
+	coarse_layer_max_iters ( 20 )
 {
 }
 
@@ -70,6 +88,15 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::TSRBAParameters::l
 	MRPT_LOAD_CONFIG_VAR(kernel_param,double,source,section)
 	MRPT_LOAD_CONFIG_VAR(max_iters,uint64_t,source,section)
 	MRPT_LOAD_CONFIG_VAR(max_error_per_obs_to_stop,double,source,section)
+	MRPT_LOAD_CONFIG_VAR(relinearize_threshold_k2k,double,source,section)
+	MRPT_LOAD_CONFIG_VAR(relinearize_threshold_k2f,double,source,section)
+	MRPT_LOAD_CONFIG_VAR(outlier_rejection,bool,source,section)
+	MRPT_LOAD_CONFIG_VAR(outlier_rejection_confidence,double,source,section)
+	MRPT_LOAD_CONFIG_VAR(dh_dAp_release_after,uint64_t,source,section)
+	MRPT_LOAD_CONFIG_VAR(schur_cache_release_after,uint64_t,source,section)
+	MRPT_LOAD_CONFIG_VAR(reanchor_landmarks,bool,source,section)
+	MRPT_LOAD_CONFIG_VAR(coarse_layer,bool,source,section)
+	MRPT_LOAD_CONFIG_VAR(coarse_layer_max_iters,uint64_t,source,section)
 
 	cov_recovery = source.read_enum(section, "cov_recovery", cov_recovery);
 }
@@ -82,13 +109,22 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::TSRBAParameters::s
 	out.write(section,"max_optimize_depth",max_optimize_depth, /* text width */ 30, 30, "Max. local optimization distance");
 
 	out.write(section,"optimize_new_edges_alone",optimize_new_edges_alone,  /* text width */ 30, 30, "Optimize new edges alone before optimizing the entire local area?");
-	out.write(section,"use_robust_kernel",use_robust_kernel,  /* text width */ 30, 30, "Use pseudo-Huber kernel?");
-	out.write(section,"use_robust_kernel_stage1",use_robust_kernel_stage1,  /* text width */ 30, 30, "Use pseudo-Huber kernel at stage1?");
+	out.write(section,"use_robust_kernel",use_robust_kernel,  /* text width */ 30, 30, "Use robust kernel (RBA_OPTIONS::robust_kernel_t)?");
+	out.write(section,"use_robust_kernel_stage1",use_robust_kernel_stage1,  /* text width */ 30, 30, "Use robust kernel at stage1?");
 	out.write(section,"kernel_param",kernel_param,  /* text width */ 30, 30, "robust kernel parameter");
 	out.write(section,"max_rho",max_rho,  /* text width */ 30, 30, "Lev-Marq optimization: maximum rho value to stop");
 	out.write(section,"max_lambda",max_lambda,  /* text width */ 30, 30, "Lev-Marq optimization: maximum lambda to stop");
 	out.write(section,"max_iters",static_cast<uint64_t>(max_iters),  /* text width */ 30, 30, "Max. iterations for optimization");
 	out.write(section,"max_error_per_obs_to_stop",max_error_per_obs_to_stop,  /* text width */ 30, 30, "Another criterion for stopping optimization");
+	out.write(section,"relinearize_threshold_k2k",relinearize_threshold_k2k,  /* text width */ 30, 30, "Lazy relinearization: min. increment of k2k edges to re-evaluate their Jacobians (0=always)");
+	out.write(section,"relinearize_threshold_k2f",relinearize_threshold_k2f,  /* text width */ 30, 30, "Lazy relinearization: min. increment of landmarks to re-evaluate their Jacobians (0=always)");
+	out.write(section,"outlier_rejection",outlier_rejection,  /* text width */ 30, 30, "Chi-square gating of outliers after optimization?");
+	out.write(section,"outlier_rejection_confidence",outlier_rejection_confidence,  /* text width */ 30, 30, "Confidence of the chi-square gating");
+	out.write(section,"dh_dAp_release_after",static_cast<uint64_t>(dh_dAp_release_after),  /* text width */ 30, 30, "Free the dh_dAp Jacobian blocks of edges not optimized in this number of optimizations (0=never)");
+	out.write(section,"schur_cache_release_after",static_cast<uint64_t>(schur_cache_release_after),  /* text width */ 30, 30, "Free the cached Schur terms of landmarks not optimized in this number of optimizations (0=never)");
+	out.write(section,"reanchor_landmarks",reanchor_landmarks,  /* text width */ 30, 30, "Re-anchor landmarks observed beyond the spanning tree of their base KF?");
+	out.write(section,"coarse_layer",coarse_layer,  /* text width */ 30, 30, "Optimize a coarse pose graph of the area centers on each loop closure?");
+	out.write(section,"coarse_layer_max_iters",static_cast<uint64_t>(coarse_layer_max_iters),  /* text width */ 30, 30, "Max. number of iterations in each optimization of the coarse graph");
 	out.write(section,"cov_recovery", mrpt::utils::TEnumType<TCovarianceRecoveryPolicy>::value2name(cov_recovery) ,  /* text width */ 30, 30, "Covariance recovery policy");
 }
 
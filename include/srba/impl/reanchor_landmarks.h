@@ -0,0 +1,239 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#pragma once
+
+#include <algorithm>
+#include <limits>
+
+namespace srba {
+
+/** spanning_tree_distance (See header for docs) */
+template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
+topo_dist_t RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::spanning_tree_distance(const TKeyFrameID kf1, const TKeyFrameID kf2) const
+{
+	if (kf1==kf2) return 0;
+
+	// Since "all_edges" is symmetric, only the (i,j), i>j entries are stored:
+	typename rba_problem_state_t::TSpanningTree::all_edges_maps_t::const_iterator it_map = rba_state.spanning_tree.sym.all_edges.find( std::max(kf1,kf2) );
+	if (it_map==rba_state.spanning_tree.sym.all_edges.end())
+		return std::numeric_limits<topo_dist_t>::max();
+
+	typename std::map<TKeyFrameID, typename rba_problem_state_t::k2k_edge_vector_t >::const_iterator it_path = it_map->second.find( std::min(kf1,kf2) );
+	if (it_path==it_map->second.end())
+		return std::numeric_limits<topo_dist_t>::max();
+
+	return it_path->second.size();
+}
+
+/** find_best_landmark_base (See header for docs) */
+template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
+TKeyFrameID RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::find_best_landmark_base(const TLandmarkID lm_id, const std::vector<size_t> & obs_idxs) const
+{
+	const TKeyFrameID cur_base_id = rba_state.all_lms[lm_id].rfp->id_frame_base;
+
+	// Observer KFs, and how many observations each one has:
+	std::vector<TKeyFrameID> observers(obs_idxs.size());
+	for (size_t i=0;i<obs_idxs.size();i++)
+		observers[i] = rba_state.all_observations[obs_idxs[i]].obs.kf_id;
+	std::sort(observers.begin(),observers.end());
+
+	std::vector<std::pair<TKeyFrameID,size_t> > kf_counts;
+	for (size_t i=0;i<observers.size();i++)
+	{
+		if (kf_counts.empty() || kf_counts.back().first!=observers[i])
+			kf_counts.push_back( std::make_pair(observers[i],size_t(0)) );
+		kf_counts.back().second++;
+	}
+
+	TKeyFrameID best_id = SRBA_INVALID_KEYFRAMEID;
+	size_t best_linked = 0, best_chain_len = 0;
+
+	// The current base goes first, then the observers from the most recent one, so they win ties in this order:
+	for (size_t c=0;c<=kf_counts.size();c++)
+	{
+		const TKeyFrameID cand_id = (c==0) ? cur_base_id : kf_counts[kf_counts.size()-c].first;
+		if (c>0 && cand_id==cur_base_id)
+			continue;
+
+		size_t linked=0, chain_len=0;
+		for (size_t i=0;i<kf_counts.size();i++)
+		{
+			const topo_dist_t d = spanning_tree_distance(kf_counts[i].first, cand_id);
+			if (d==std::numeric_limits<topo_dist_t>::max())
+				continue;
+			linked    += kf_counts[i].second;
+			chain_len += kf_counts[i].second * d;
+		}
+
+		if (best_id==SRBA_INVALID_KEYFRAMEID || linked>best_linked || (linked==best_linked && chain_len<best_chain_len))
+		{
+			best_id        = cand_id;
+			best_linked    = linked;
+			best_chain_len = chain_len;
+		}
+	}
+	return best_id;
+}
+
+namespace internal
+{
+	/** Re-expresses the information matrix of a landmark in the frame of its new base KF: Inf' = R * Inf * R^T, with R the rotation
+	  * of \a old_base_wrt_new (the landmark position transforms as p' = R * p + t). Only applicable to point landmarks. */
+	template <bool IS_POINT_LANDMARK>
+	struct reanchor_lm_inf_matrix
+	{
+		template <class POSE,class MATRIX>
+		static void eval(MATRIX &inf_mat, const POSE &old_base_wrt_new) {
+			MRPT_UNUSED_PARAM(inf_mat); MRPT_UNUSED_PARAM(old_base_wrt_new);
+		}
+	};
+	template <>
+	struct reanchor_lm_inf_matrix<true>
+	{
+		template <class POSE,class MATRIX>
+		static void eval(MATRIX &inf_mat, const POSE &old_base_wrt_new) {
+			mrpt::math::CMatrixFixedNumeric<double,MATRIX::RowsAtCompileTime,MATRIX::ColsAtCompileTime> R;
+			old_base_wrt_new.getRotationMatrix(R);
+			inf_mat = R * inf_mat * R.transpose();
+		}
+	};
+} // end NS internal
+
+/** reanchor_landmark (See header for docs) */
+template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
+bool RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::reanchor_landmark(const TLandmarkID lm_id, const TKeyFrameID new_base_id)
+{
+	ASSERT_(lm_id<rba_state.all_lms.size() && rba_state.all_lms[lm_id].rfp!=NULL)
+	ASSERT_(new_base_id<rba_state.keyframes.size())
+
+	typename rba_problem_state_t::TLandmarkEntry & lm = rba_state.all_lms[lm_id];
+	TRelativeLandmarkPos & rfp = *lm.rfp;
+	const TKeyFrameID old_base_id = rfp.id_frame_base;
+
+	if (old_base_id==new_base_id)
+		return true; // Nothing to do
+
+	// Only landmarks with unknown positions, parameterized as points, can be re-expressed wrt another KF:
+	if (lm.has_known_pos || landmark_t::jacob_family!=jacob_point_landmark)
+		return false;
+
+	m_profiler.enter("reanchor_landmark");
+
+	// Pose of the old base KF as seen from the new one, accumulating the k2k edges along the path between them
+	// (as in TSpanningTree::update_numeric(), but the path may be longer than the spanning tree depth):
+	typename kf2kf_pose_traits_t::k2k_edge_vector_t path;
+	if (!rba_state.find_path_astar(new_base_id, old_base_id, parameters.srba.max_tree_depth, NULL, &path, &m_path_search_ws))
+	{
+		m_profiler.leave("reanchor_landmark");
+		return false;
+	}
+
+	pose_t old_base_wrt_new;
+	TKeyFrameID curKF = new_base_id;
+	for (size_t k=0;k<path.size();k++)
+	{
+		if (path[k]->to==curKF)  // Inverse poses means we should face all arcs by the "head" (arrow) side
+		{
+			old_base_wrt_new.composeFrom(old_base_wrt_new, path[k]->inv_pose);
+			curKF = path[k]->from;
+		}
+		else
+		{
+			old_base_wrt_new.composeFrom(old_base_wrt_new, -path[k]->inv_pose);
+			curKF = path[k]->to;
+		}
+	}
+	ASSERT_(curKF==old_base_id)
+
+	// Move the landmark, and rotate its information matrix (if recovered by the last optimization) accordingly:
+	landmark_t::composePosePoint(rfp.pos, old_base_wrt_new);
+	rfp.id_frame_base = new_base_id;
+
+	typename hessian_traits_t::landmarks2infmatrix_t::iterator it_inf = rba_state.unknown_lms_inf_matrices.find(lm_id);
+	if (it_inf!=rba_state.unknown_lms_inf_matrices.end())
+		internal::reanchor_lm_inf_matrix<landmark_t::jacob_family==jacob_point_landmark>::eval(it_inf->second, old_base_wrt_new);
+	lm.anchor_version++; // From now on, all the compact dh_dAp records of its observations are obsolete
+
+	// Remove all its observations from the linear system:
+	const std::vector<size_t> & obs_idxs = rba_state.lm_observations[lm_id];
+
+	typename rba_problem_state_t::TLinearSystem & ls = rba_state.lin_system;
+	const mrpt::utils::map_as_vector<size_t,size_t>::const_iterator it_idx = ls.dh_df.getColInverseRemappedIndices().find(lm_id);
+	ASSERT_(it_idx!=ls.dh_df.getColInverseRemappedIndices().end())
+	ls.dh_df.getCol(it_idx->second).clear();
+
+	// Obsolete dh_dAp records of columns not materialized now will be dropped whenever they are:
+	for (size_t i=0;i<ls.dh_dAp_materialized.size();i++)
+	{
+		const size_t edge_id = ls.dh_dAp_materialized[i];
+		typename TSparseBlocksJacobians_dh_dAp::col_t & col = ls.dh_dAp.getCol(edge_id);
+
+		bool any_erased = false;
+		for (size_t j=0;j<obs_idxs.size();j++)
+			if (col.erase(obs_idxs[j]))
+				any_erased = true;
+		if (!any_erased)
+			continue;
+
+		std::vector<typename rba_problem_state_t::TLazyJacobBlock_dh_dAp> & blocks = ls.dh_dAp_lazy[edge_id].blocks;
+		size_t n=0;
+		for (size_t j=0;j<blocks.size();j++)
+		{
+			if (is_obsolete_dh_dAp_record(blocks[j]))
+				continue;
+			if (n!=j) blocks[n] = blocks[j];
+			n++;
+		}
+		blocks.erase(blocks.begin()+n, blocks.end());
+	}
+	rba_state.unlinked_observations.erase(lm_id);
+
+	// And link them again, wrt the new base:
+	for (size_t j=0;j<obs_idxs.size();j++)
+		if (!link_observation(obs_idxs[j]))
+			rba_state.unlinked_observations[lm_id].push_back(obs_idxs[j]);
+
+	invalidate_transform_cache(); // Residuals & Jacobians evaluated so far for these observations are wrt the old base
+
+	m_profiler.leave("reanchor_landmark");
+	return true;
+}
+
+/** reanchor_pending_landmarks (See header for docs) */
+template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
+void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::reanchor_pending_landmarks()
+{
+	if (m_lms_pending_reanchor.empty())
+		return;
+
+	m_profiler.enter("reanchor_pending_landmarks");
+
+	std::sort(m_lms_pending_reanchor.begin(),m_lms_pending_reanchor.end());
+	m_lms_pending_reanchor.erase( std::unique(m_lms_pending_reanchor.begin(),m_lms_pending_reanchor.end()), m_lms_pending_reanchor.end() );
+
+	size_t nReanchored = 0;
+	for (size_t i=0;i<m_lms_pending_reanchor.size();i++)
+	{
+		const TLandmarkID lm_id = m_lms_pending_reanchor[i];
+		if (rba_state.unlinked_observations.find(lm_id)==rba_state.unlinked_observations.end())
+			continue; // All its observations are already in the linear system
+
+		const TKeyFrameID new_base_id = find_best_landmark_base(lm_id, rba_state.lm_observations[lm_id]);
+		if (new_base_id!=rba_state.all_lms[lm_id].rfp->id_frame_base && reanchor_landmark(lm_id, new_base_id))
+			nReanchored++;
+	}
+	m_lms_pending_reanchor.clear();
+
+	m_profiler.leave("reanchor_pending_landmarks");
+
+	VERBOSE_LEVEL(2) << "[reanchor_pending_landmarks] " << nReanchored << " landmarks re-anchored.\n";
+}
+
+} // end NS
@@ -11,20 +11,52 @@
 
 namespace srba {
 
+namespace internal
+{
+	/** Auxiliary template for evaluating residuals in reprojection_residuals(), with or without the fused evaluation of
+	  * dh_dx (only if the sensor model implements observe_error_and_jacob()) */
+	template <bool USE_FUSED>
+	struct observe_error_dispatcher {
+		template <class SENSOR_MODEL,class RESIDUAL,class OBS,class POSE,class LM,class FUSED_JACOB>
+		static inline void eval(RESIDUAL & delta, FUSED_JACOB * fused, const OBS & z_obs, const POSE & base_pose_wrt_sensor, const LM & lm_pos, const typename SENSOR_MODEL::TObservationParams & params) {
+			MRPT_UNUSED_PARAM(fused);
+			SENSOR_MODEL::observe_error(delta,z_obs,base_pose_wrt_sensor,lm_pos,params);
+		}
+	};
+	template <>
+	struct observe_error_dispatcher<true> {
+		template <class SENSOR_MODEL,class RESIDUAL,class OBS,class POSE,class LM,class FUSED_JACOB>
+		static inline void eval(RESIDUAL & delta, FUSED_JACOB * fused, const OBS & z_obs, const POSE & base_pose_wrt_sensor, const LM & lm_pos, const typename SENSOR_MODEL::TObservationParams & params) {
+			fused->valid = SENSOR_MODEL::observe_error_and_jacob(delta,fused->dh_dx,z_obs,base_pose_wrt_sensor,lm_pos,params);
+		}
+	};
+}
+
 /** reprojection_residuals */
 template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
 double RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::reprojection_residuals(
 	vector_residuals_t & residuals, // Out:
 	const std::vector<TObsUsed> & observations // In:
-	) const
+	)
 {
 	const size_t nObs = observations.size();
 	if (residuals.size()!=nObs) residuals.resize(nObs);
 
 	double total_sqr_err = 0;
 
+	typename RBA_OPTIONS::obs_noise_matrix_t::whitening_data_t whitening_data;
+	if (RBA_OPTIONS::obs_noise_matrix_t::PREWHITEN_JACOBIANS)
+		RBA_OPTIONS::obs_noise_matrix_t::get_whitening_data(this->parameters.obs_noise, whitening_data);
+
 	for (size_t i=0;i<nObs;i++)
 	{
+		// Observations rejected as outliers contribute nothing (neither error nor gradient):
+		if (rba_state.all_observations_is_outlier[ observations[i].obs_idx ])
+		{
+			residuals[i].setZero();
+			continue;
+		}
+
 		// Actually measured pixel coords: observations[i]->obs.px
 		const TKeyFrameID  obs_frame_id = observations[i].k2f->obs.kf_id; // Observed from here.
 		const TRelativeLandmarkPos *feat_rel_pos = observations[i].k2f->feat_rel_pos;
@@ -33,42 +65,58 @@ double RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::reprojection_res
 
 		const TKeyFrameID  base_id  = feat_rel_pos->id_frame_base;
 
-		pose_t const * base_pose_wrt_observer=NULL;
-
-		// This case can occur with feats with unknown rel.pos:
-		if (base_id==obs_frame_id)
+		// Relative pose of the base KF wrt the sensor, shared with all other observations (and Jacobians) with the same observer & base KFs:
+		const TRelTransformCacheEntry * tf = find_rel_transform(obs_frame_id,base_id);
+		if (!tf)
 		{
-			base_pose_wrt_observer = &aux_null_pose;
-		}
-		else
-		{
-			// num[SOURCE] |--> map[TARGET] = CPose3D of TARGET as seen from SOURCE
-			const typename TRelativePosesForEachTarget::const_iterator itPoseMap_for_base_id = rba_state.spanning_tree.num.find(obs_frame_id);
-			ASSERT_( itPoseMap_for_base_id != rba_state.spanning_tree.num.end() )
-
-			const typename frameid2pose_map_t::const_iterator itRelPose = itPoseMap_for_base_id->second.find(base_id);
-			ASSERT_( itRelPose != itPoseMap_for_base_id->second.end() )
-
-			base_pose_wrt_observer = &itRelPose->second.pose;
+			pose_t const * base_pose_wrt_observer=NULL;
+
+			// This case can occur with feats with unknown rel.pos:
+			if (base_id==obs_frame_id)
+			{
+				base_pose_wrt_observer = &aux_null_pose;
+			}
+			else
+			{
+				// num[SOURCE] |--> map[TARGET] = CPose3D of TARGET as seen from SOURCE
+				const typename TRelativePosesForEachTarget::const_iterator itPoseMap_for_base_id = rba_state.spanning_tree.num.find(obs_frame_id);
+				ASSERT_( itPoseMap_for_base_id != rba_state.spanning_tree.num.end() )
+
+				const typename frameid2pose_map_t::const_iterator itRelPose = itPoseMap_for_base_id->second.find(base_id);
+				ASSERT_( itRelPose != itPoseMap_for_base_id->second.end() )
+
+				base_pose_wrt_observer = &itRelPose->second.pose;
+			}
+			tf = set_rel_transform(obs_frame_id,base_id,*base_pose_wrt_observer);
 		}
-
-		// pose_robot2sensor(): pose wrt sensor = pose_wrt_robot (-) sensor_pose_on_the_robot
-		typename options::internal::resulting_pose_t<typename RBA_OPTIONS::sensor_pose_on_robot_t,REL_POSE_DIMS>::pose_t base_pose_wrt_sensor(mrpt::poses::UNINITIALIZED_POSE);
-		RBA_OPTIONS::sensor_pose_on_robot_t::pose_robot2sensor( *base_pose_wrt_observer, base_pose_wrt_sensor, this->parameters.sensor_pose );
+		const sensor_pose_t & base_pose_wrt_sensor = tf->base_pose_wrt_sensor;
 
 		const array_obs_t & real_obs = observations[i].k2f->obs.obs_arr;
 		residual_t &delta = residuals[i];
 
 		// Generate observation and compare to real obs:
-		sensor_model_t::observe_error(delta,real_obs, base_pose_wrt_sensor,feat_rel_pos->pos, this->parameters.sensor);
+		if (SENSOR_HAS_FUSED_OBS_JACOB && !internal::use_autodiff_jacob_dh_dx<sensor_model_t>::value)
+		{
+			// Also evaluate dh_dx in the same pass, to be reused by the Jacobians if this linearization point gets accepted:
+			typename rba_problem_state_t::TObsFusedJacobian & fused = rba_state.all_observations_fused_dh_dx[ observations[i].obs_idx ];
+			internal::observe_error_dispatcher<SENSOR_HAS_FUSED_OBS_JACOB>::template eval<sensor_model_t>(delta,&fused,real_obs, base_pose_wrt_sensor,feat_rel_pos->pos, this->parameters.sensor);
+			fused.epoch = m_transform_cache_epoch;
+		}
+		else
+			sensor_model_t::observe_error(delta,real_obs, base_pose_wrt_sensor,feat_rel_pos->pos, this->parameters.sensor);
+
+		// Pre-whitened residuals (if applicable): consistent with the whitened Jacobians, see recompute_all_Jacobians()
+		if (RBA_OPTIONS::obs_noise_matrix_t::PREWHITEN_JACOBIANS)
+			RBA_OPTIONS::obs_noise_matrix_t::whiten(delta, whitening_data, rba_state.all_observations_noise_data[ observations[i].obs_idx ] );
 
-		const double sum_2 = delta.squaredNorm();
-		if (this->parameters.srba.use_robust_kernel)
+		// Squared error weighted with the same \Lambda used in H and the gradient, so the LM gain ratio is consistent:
+		const double sum_2 = RBA_OPTIONS::obs_noise_matrix_t::eval_sqr_error(delta, this->parameters.obs_noise, rba_state.all_observations_noise_data[ observations[i].obs_idx ] );
+		if (robust_kernel_t::IS_ROBUST && this->parameters.srba.use_robust_kernel)
 		{
-			const double nrm = std::max(1e-11,std::sqrt(sum_2));
-			const double w = std::sqrt(huber_kernel(nrm,parameters.srba.kernel_param))/nrm;
-			delta *= w;
-			total_sqr_err += (w*w)*sum_2;
+			// Residuals are left unweighted: the IRLS weight is applied while building the gradient & Hessian.
+			double w;
+			total_sqr_err += robust_kernel_t::eval(sum_2,parameters.srba.kernel_param, w);
+			rba_state.all_observations_robust_weight[ observations[i].obs_idx ] = w;
 		}
 		else
 		{
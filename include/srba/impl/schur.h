@@ -11,28 +11,180 @@
 
 namespace srba {
 
+	/** Persistent cache of the lambda-independent parts of the Schur-complement terms of each landmark, kept by RbaEngine between successive
+	  *  optimizations. For each landmark "l" it holds the eigen-decomposition Hf_l = V*diag(d)*V^t and, for each k2k edge "i" with a non-zero HApf
+	  *  block, the product Hpi_l*V. Since inv(Hf_l+lambda*I) = V*diag(1/(d+lambda))*V^t, the terms Hpi_l*inv(Hf_l+lambda*I)*Hpj_l^t of the reduced
+	  *  system are then obtained for any lambda with one scaling and one small product each.
+	  *  Entries are reused as long as the Hessian blocks they were computed from did not change (checked by exact comparison of their values), as it
+	  *  usually happens in the part of the local window far from the newest keyframes.
+	  *  Entries not looked up during the last N usages (see new_usage(), release_unused()) are freed, so the cache only holds terms of the
+	  *  recent local windows instead of growing with the whole map.
+	  * \sa SchurComplement
+	  */
+	template <class HESS_f, class HESS_Apf>
+	class SchurLandmarkCache
+	{
+	public:
+		typedef Eigen::Matrix<double,HESS_f::matrix_t::RowsAtCompileTime,HESS_f::matrix_t::ColsAtCompileTime>     matrix_f_t;
+		typedef Eigen::Matrix<double,HESS_f::matrix_t::RowsAtCompileTime,1>                                        vector_f_t;
+		typedef Eigen::Matrix<double,HESS_Apf::matrix_t::RowsAtCompileTime,HESS_Apf::matrix_t::ColsAtCompileTime> matrix_Apf_t;
+
+		/** Cached data for one block of HApf */
+		struct TApBlock
+		{
+			TApBlock() : V_version(0), last_used(0) { }
+
+			typename HESS_Apf::matrix_t  Hpi;        //!< The HApf block these values were computed from
+			matrix_Apf_t                 Hpi_V;      //!< Hpi_l * V_l
+			size_t                       V_version;  //!< The TLandmark::V_version used to compute \a Hpi_V
+			size_t                       last_used;  //!< Value of the usage counter the last time this entry was looked up
+
+			MRPT_MAKE_ALIGNED_OPERATOR_NEW
+		};
+		typedef typename mrpt::aligned_containers<size_t,TApBlock>::map_t  ap_blocks_t;
+
+		/** Cached data for one landmark */
+		struct TLandmark
+		{
+			TLandmark() : V_version(0), last_used(0) { }
+
+			typename HESS_f::matrix_t  Hf;         //!< The Hf diagonal block these values were computed from
+			matrix_f_t                 V;          //!< Eigenvectors of Hf_l
+			vector_f_t                 d;          //!< Eigenvalues of Hf_l
+			size_t                     V_version;  //!< Incremented each time \a V changes
+			size_t                     last_used;  //!< Value of the usage counter the last time this entry was looked up
+			ap_blocks_t                ap_blocks;  //!< Indexed by k2k edge ID
+
+			MRPT_MAKE_ALIGNED_OPERATOR_NEW
+		};
+		typedef typename mrpt::aligned_containers<size_t,TLandmark>::map_t  landmarks_t;
+
+		SchurLandmarkCache() : num_reused(0), num_recomputed(0), m_usage_counter(0) { }
+
+		size_t num_reused;     //!< Stats: number of (Hf or HApf) blocks whose cached terms were reused, since the last clear()
+		size_t num_recomputed; //!< Stats: number of (Hf or HApf) blocks whose cached terms had to be (re)computed, since the last clear()
+
+		void clear()
+		{
+			m_lms.clear();
+			num_reused = num_recomputed = 0;
+			m_usage_counter = 0;
+		}
+
+		/** Must be called once before each new usage of the cache (e.g. each optimization), for the aging of entries in release_unused() */
+		void new_usage() { ++m_usage_counter; }
+
+		/** Frees the entries (of landmarks and of HApf blocks) not looked up in the last \a max_age usages (0: never free them) */
+		void release_unused(const size_t max_age)
+		{
+			if (!max_age)
+				return;
+			for (typename landmarks_t::iterator it=m_lms.begin();it!=m_lms.end();)
+			{
+				if (m_usage_counter - it->second.last_used >= max_age)
+				{
+					m_lms.erase(it++);
+					continue;
+				}
+				ap_blocks_t & blks = it->second.ap_blocks;
+				for (typename ap_blocks_t::iterator it_b=blks.begin();it_b!=blks.end();)
+				{
+					if (m_usage_counter - it_b->second.last_used >= max_age)
+							blks.erase(it_b++);
+					else	++it_b;
+				}
+				++it;
+			}
+		}
+
+		size_t size() const { return m_lms.size(); } //!< Number of landmarks with cached terms
+
+		/** Returns the up-to-date entry of landmark \a lm_id, whose Hf diagonal block is \a Hf, only recomputing its eigen-decomposition if \a Hf changed */
+		TLandmark & update_landmark(const size_t lm_id, const typename HESS_f::matrix_t & Hf)
+		{
+			typename landmarks_t::iterator it = m_lms.find(lm_id);
+			if (it!=m_lms.end() && it->second.Hf==Hf)
+			{
+				num_reused++;
+				it->second.last_used = m_usage_counter;
+				return it->second;
+			}
+			if (it==m_lms.end())
+				it = m_lms.insert(it, typename landmarks_t::value_type(lm_id,TLandmark()) );
+
+			TLandmark & lm = it->second;
+			lm.last_used = m_usage_counter;
+			lm.Hf = Hf;
+			const Eigen::SelfAdjointEigenSolver<matrix_f_t> eig( Hf );
+			lm.V = eig.eigenvectors();
+			lm.d = eig.eigenvalues();
+			lm.V_version++;
+			num_recomputed++;
+			return lm;
+		}
+
+		/** Returns the up-to-date entry of the block of k2k edge \a ap_id and landmark \a lm, whose HApf block is \a Hpi, only recomputing Hpi*V if needed */
+		TApBlock & update_ap_block(TLandmark & lm, const size_t ap_id, const typename HESS_Apf::matrix_t & Hpi)
+		{
+			typename ap_blocks_t::iterator it = lm.ap_blocks.find(ap_id);
+			if (it!=lm.ap_blocks.end() && it->second.V_version==lm.V_version && it->second.Hpi==Hpi)
+			{
+				num_reused++;
+				it->second.last_used = m_usage_counter;
+				return it->second;
+			}
+			if (it==lm.ap_blocks.end())
+				it = lm.ap_blocks.insert(it, typename ap_blocks_t::value_type(ap_id,TApBlock()) );
+
+			TApBlock & blk = it->second;
+			blk.last_used = m_usage_counter;
+			blk.Hpi = Hpi;
+			blk.Hpi_V.noalias() = Hpi * lm.V;
+			blk.V_version = lm.V_version;
+			num_recomputed++;
+			return blk;
+		}
+
+	private:
+		landmarks_t  m_lms; //!< Indexed by landmark ID
+		size_t       m_usage_counter; //!< Incremented in new_usage()
+	};
+
 	/** A generic symbolic and numeric Schur-complement handler for builing reduced systems of equations.
+	  *  The lambda-independent terms of each landmark are kept in a SchurLandmarkCache, which may be provided by the user to reuse them between
+	  *  different instances of this class (i.e. different optimizations).
 	  */
 	template <class HESS_Ap, class HESS_f, class HESS_Apf>
 	class SchurComplement
 	{
 	public:
 
+		typedef SchurLandmarkCache<HESS_f,HESS_Apf> landmark_cache_t;
+
 		/** Constructor: builds the symbolic representations
 		  *  Note: HApf must be in row-compressed form; HAp & Hf in column-compressed form.
 		  * \param[in] _minus_grad_f Can be NULL if there're no observations of landmarks with unknown positions (may still be of LMs with known ones).
+		  * \param[in] _cache If not NULL, a persistent cache of landmark terms, to be reused between instances. Otherwise, one owned by this object is used.
+		  * \param[in] _Ap_ids, _f_ids Required if \a _cache is provided: the k2k edge ID of each Ap unknown and the landmark ID of each feature unknown, the keys in the cache.
 		  */
-		SchurComplement(HESS_Ap  &_HAp, HESS_f & _Hf, HESS_Apf & _HApf, double * _minus_grad_Ap, double * _minus_grad_f)
+		SchurComplement(HESS_Ap  &_HAp, HESS_f & _Hf, HESS_Apf & _HApf, double * _minus_grad_Ap, double * _minus_grad_f,
+			landmark_cache_t * _cache = NULL, const std::vector<size_t> * _Ap_ids = NULL, const std::vector<size_t> * _f_ids = NULL)
 		: HAp(_HAp), Hf(_Hf), HApf(_HApf),
 		  minus_grad_Ap(_minus_grad_Ap),
 		  minus_grad_f(_minus_grad_f),
 		  // Problem dims:
 		  nUnknowns_Ap( HAp.getColCount() ),
 		  nUnknowns_f( Hf.getColCount() ),
-		  nHf_invertible_blocks(0)
+		  nHf_invertible_blocks(0),
+		  m_cache( _cache ? _cache : &m_own_cache ),
+		  m_Ap_ids( _cache ? _Ap_ids : NULL ),
+		  m_f_ids( _cache ? _f_ids : NULL ),
+		  m_cache_needs_refresh(true)
 		{
 			if (!nUnknowns_f || !nUnknowns_Ap) return;
 
+			ASSERT_(!_cache || (_Ap_ids && _Ap_ids->size()==nUnknowns_Ap && _f_ids && _f_ids->size()==nUnknowns_f))
+
 			// 0) Make copy of the original numerical values of HAp:
 			// -----------------------------------------------------------------
 			HAp_original.copyNumericalValuesFrom( HAp );
@@ -42,10 +194,18 @@ namespace srba {
 			m_Hf_blocks_info.resize(nUnknowns_f);
 			for (size_t i=0;i<nUnknowns_f;i++)
 			{
-				const typename HESS_f::col_t & col_i = Hf.getCol(i);
-				ASSERT_(!col_i.empty() && col_i.rbegin()->first==i)
+				m_Hf_blocks_info[i].sym_Hf_diag_blocks = &Hf.getDiagonalBlock(i);
+			}
 
-				m_Hf_blocks_info[i].sym_Hf_diag_blocks = &col_i.rbegin()->second.num;
+			// 1b) List of all the non-zero blocks in HApf, contiguous by rows:
+			// -----------------------------------------------------------------
+			m_HApf_row_first_block.resize(nUnknowns_Ap);
+			for (size_t i=0;i<nUnknowns_Ap;i++)
+			{
+				m_HApf_row_first_block[i] = m_HApf_blocks_info.size();
+				const typename HESS_Apf::col_t & row_i = HApf.getCol(i);
+				for (typename HESS_Apf::col_t::const_iterator it=row_i.begin();it!=row_i.end();++it)
+					m_HApf_blocks_info.push_back( TInfoPerHApfBlock(&it->second.num, i, it->first) );
 			}
 
 			// 2) Build instructions to reduce H_Ap and grad_Ap
@@ -83,11 +243,13 @@ namespace srba {
 					typename HESS_Apf::col_t::const_iterator it_j = row_j.begin();
 					const typename HESS_Apf::col_t::const_iterator it_i_end = row_i.end();
 					const typename HESS_Apf::col_t::const_iterator it_j_end = row_j.end();
+					// And their corresponding entries in m_HApf_blocks_info:
+					size_t blk_i = m_HApf_row_first_block[i], blk_j = m_HApf_row_first_block[j];
 
 					while (it_i!=it_i_end && it_j!=it_j_end)
 					{
-						if ( it_i->first < it_j->first ) ++it_i;
-						else if ( it_j->first < it_i->first ) ++it_j;
+						if ( it_i->first < it_j->first ) { ++it_i; ++blk_i; }
+						else if ( it_j->first < it_i->first ) { ++it_j; ++blk_j; }
 						else
 						{
 							// match between: it_i->first == it_j->first
@@ -101,7 +263,7 @@ namespace srba {
 							ASSERT_(idx_feat<nUnknowns_f)
 
 							// Gradient (only if we're at i==j)
-							typename HESS_Apf::matrix_t *out_temporary_result = NULL;
+							matrix_Apf_t *out_temporary_result = NULL;
 							if (grad_entries)
 							{
 								grad_entries->lst_terms_to_subtract.resize( grad_entries->lst_terms_to_subtract.size()+1 );
@@ -115,13 +277,14 @@ namespace srba {
 							std::cout << "SymSchur.HAp("<<i<<","<<j<< "): HApf_" << it_i->first << " * HApf_" << it_j->first  << std::endl;
 #endif
 							sym_ij.lst_terms_to_add.push_back( typename THApSymbolicEntry::TEntry(
-								&it_j->second.num, //&it_i->second.num,
+								&m_HApf_blocks_info[blk_j], //&it_i->second.num,
 								&m_Hf_blocks_info[idx_feat],
-								&it_i->second.num, //&it_j->second.num,
+								&m_HApf_blocks_info[blk_i], //&it_j->second.num,
 								out_temporary_result ) );
 
 							// Move:
 							++it_i; ++it_j;
+							++blk_i; ++blk_j;
 						}
 					} // end while (find intersect)
 
@@ -165,6 +328,7 @@ namespace srba {
 		void realize_HAp_changed()
 		{
 			HAp_original.copyNumericalValuesFrom( HAp );
+			m_cache_needs_refresh = true; // Hf & HApf have also changed
 		}
 
 		/** After calling numeric_build_reduced_system() one can get the stats on how many features are actually estimable */
@@ -187,29 +351,42 @@ namespace srba {
 			// --------------------------------------------------------------------------------
 			HAp.copyNumericalValuesFrom( HAp_original );
 
-			// 1) Invert diagonal blocks in Hf:
+			// 0b) Update the lambda-independent terms, only for those Hf & HApf blocks which changed
+			//     since they were computed (possibly in a previous optimization, if using a persistent cache):
+			// --------------------------------------------------------------------------------
+			if (m_cache_needs_refresh)
+			{
+				for (size_t i=0;i<nUnknowns_f;i++)
+					m_Hf_blocks_info[i].cached = &m_cache->update_landmark( m_f_ids ? (*m_f_ids)[i] : i, *m_Hf_blocks_info[i].sym_Hf_diag_blocks );
+
+				for (typename std::deque<TInfoPerHApfBlock>::iterator it=m_HApf_blocks_info.begin();it!=m_HApf_blocks_info.end();++it)
+					it->cached = &m_cache->update_ap_block( *m_Hf_blocks_info[it->feat_idx].cached, m_Ap_ids ? (*m_Ap_ids)[it->Ap_idx] : it->Ap_idx, *it->sym_HApf_block );
+
+				m_cache_needs_refresh = false;
+			}
+
+			// 1) Invert diagonal blocks in Hf, from their eigen-decomposition: inv(Hf+lambda*I) = V*diag(1/(d+lambda))*V^t
 			// ---------------------------------
 			nHf_invertible_blocks=0;
 			for (size_t i=0;i<nUnknowns_f;i++)
 			{
-				// LU decomposition is rank-revealing (not like LLt)
-				typename HESS_f::matrix_t Hfi = *m_Hf_blocks_info[i].sym_Hf_diag_blocks;
-				for (int k=0;k<Hfi.cols();k++)
-					Hfi.coeffRef(k,k)+=lambda;
+				TInfoPerHfBlock & info = m_Hf_blocks_info[i];
+				const typename landmark_cache_t::TLandmark & lm = *info.cached;
 
-				const Eigen::FullPivLU<typename HESS_f::matrix_t> lu( Hfi );
+				const typename landmark_cache_t::vector_f_t d_lambda = lm.d.array() + lambda;
 
-				// Badly conditioned matrix?
-				if (true== (m_Hf_blocks_info[i].num_Hf_diag_blocks_invertible = lu.isInvertible() ))
+				// Badly conditioned matrix? (Same rank threshold than Eigen::FullPivLU)
+				if (true== (info.num_Hf_diag_blocks_invertible = (d_lambda.minCoeff() > std::abs(d_lambda.maxCoeff()) * Eigen::NumTraits<double>::epsilon() * d_lambda.size()) ))
 				{
 					nHf_invertible_blocks++;
-					m_Hf_blocks_info[i].num_Hf_diag_blocks_inverses = lu.inverse();
+					info.inv_d_lambda = d_lambda.cwiseInverse();
+					info.num_Hf_diag_blocks_inverses.noalias() = lm.V * info.inv_d_lambda.asDiagonal() * lm.V.transpose();
 				}
 			}
 
 			// 2) H_Ap of the reduced system:
 			// ---------------------------------
-			typename HESS_Apf::matrix_t aux_Hpi_lk_times_inv_Hf_lk;
+			matrix_Apf_t aux_Hpi_V_times_inv_D;
 			for (typename std::deque<THApSymbolicEntry>::const_iterator it=m_sym_HAp_reduce.begin();it!=m_sym_HAp_reduce.end();++it)
 			{
 				const THApSymbolicEntry &sym_entry = *it;
@@ -225,19 +402,14 @@ namespace srba {
 
 					if (entry.inv_Hf_lk->num_Hf_diag_blocks_invertible)
 					{
-						//cout << "Hfinv:\n" << entry.inv_Hf_lk->num_Hf_diag_blocks_inverses  << endl;
-						// \bar{Hp} -=  Hpi_lk * inv(Hf_lk) * Hpj_lk^t
-
-						// Store this term for reuse with the gradient update, or use temporary local storage:
-						typename HESS_Apf::matrix_t * Hpi_lk_times_inv_Hf_lk =
-							entry.out_Hpi_lk_times_inv_Hf_lk!=NULL
-							?
-							entry.out_Hpi_lk_times_inv_Hf_lk : &aux_Hpi_lk_times_inv_Hf_lk;
+						// \bar{Hp} -=  Hpi_lk * inv(Hf_lk) * Hpj_lk^t = (Hpi_lk*V) * diag(1/(d+lambda)) * (Hpj_lk*V)^t
+						aux_Hpi_V_times_inv_D.noalias() = entry.Hpi_lk->cached->Hpi_V * entry.inv_Hf_lk->inv_d_lambda.asDiagonal();
 
-						Hpi_lk_times_inv_Hf_lk->noalias() = (*entry.Hpi_lk) * entry.inv_Hf_lk->num_Hf_diag_blocks_inverses;
+						HAp_ij.noalias() -= aux_Hpi_V_times_inv_D * entry.Hpj_lk->cached->Hpi_V.transpose();
 
-						//std::cout << "product #" << i << ":\nHpi_lk:\n" << (*entry.Hpi_lk) << "\nHfi^-1:\n" << entry.inv_Hf_lk->num_Hf_diag_blocks_inverses << "\nHpj_lk^t:\n" << entry.Hpj_lk->transpose() << "\n\n";
-						HAp_ij.noalias() -= (*Hpi_lk_times_inv_Hf_lk) * (*entry.Hpj_lk).transpose();
+						// Store this term for reuse with the gradient update:
+						if (entry.out_Hpi_lk_times_inv_Hf_lk!=NULL)
+							entry.out_Hpi_lk_times_inv_Hf_lk->noalias() = aux_Hpi_V_times_inv_D * entry.inv_Hf_lk->cached->V.transpose();
 					}
 				}
 				//std::cout << "after:\n" << HAp_ij<< std::endl;
@@ -328,15 +500,24 @@ namespace srba {
 		// -----------------------------------------
 		typedef typename Eigen::Map<Eigen::Matrix<double,HESS_Ap::matrix_t::RowsAtCompileTime,1> > vector_Ap_t;
 		typedef typename Eigen::Map<Eigen::Matrix<double,HESS_f::matrix_t::RowsAtCompileTime,1> > vector_f_t;
+		typedef typename landmark_cache_t::matrix_f_t    matrix_f_t;
+		typedef typename landmark_cache_t::matrix_Apf_t  matrix_Apf_t;
 
+		landmark_cache_t            m_own_cache; //!< Only used if no external cache is provided
+		landmark_cache_t          * m_cache;
+		const std::vector<size_t> * m_Ap_ids;    //!< Cache keys of each Ap unknown (NULL: their indices)
+		const std::vector<size_t> * m_f_ids;     //!< Cache keys of each feature unknown (NULL: their indices)
+		bool                        m_cache_needs_refresh; //!< Whether Hf & HApf changed since the cached terms were last looked up
 
 		struct TInfoPerHfBlock
 		{
 			const typename HESS_f::matrix_t * sym_Hf_diag_blocks;
-			typename HESS_f::matrix_t         num_Hf_diag_blocks_inverses;
+			const typename landmark_cache_t::TLandmark * cached; //!< Eigen-decomposition of the block
+			typename landmark_cache_t::vector_f_t inv_d_lambda;  //!< 1/(d+lambda), for the eigenvalues d
+			matrix_f_t                        num_Hf_diag_blocks_inverses;
 			bool                              num_Hf_diag_blocks_invertible; //!< Whether \a num_Hf_diag_blocks_inverses could be generated
 
-			TInfoPerHfBlock() : sym_Hf_diag_blocks(NULL), num_Hf_diag_blocks_invertible(false) { }
+			TInfoPerHfBlock() : sym_Hf_diag_blocks(NULL), cached(NULL), num_Hf_diag_blocks_invertible(false) { }
 
 			MRPT_MAKE_ALIGNED_OPERATOR_NEW
 		};
@@ -345,16 +526,30 @@ namespace srba {
 
 		TInfoPerHfBlock_vector_t  m_Hf_blocks_info;
 
+		struct TInfoPerHApfBlock
+		{
+			TInfoPerHApfBlock(const typename HESS_Apf::matrix_t * _sym_HApf_block, const size_t _Ap_idx, const size_t _feat_idx) :
+				sym_HApf_block(_sym_HApf_block), Ap_idx(_Ap_idx), feat_idx(_feat_idx), cached(NULL)
+			{ }
+
+			const typename HESS_Apf::matrix_t * sym_HApf_block;
+			size_t Ap_idx, feat_idx;
+			const typename landmark_cache_t::TApBlock * cached; //!< Hpi_l * V_l
+		};
+
+		std::deque<TInfoPerHApfBlock>  m_HApf_blocks_info;     //!< All non-zero blocks in HApf, contiguous by rows
+		std::vector<size_t>            m_HApf_row_first_block; //!< Index in \a m_HApf_blocks_info of the first block of each row of HApf
+
 		/** Info for each block in HAp */
 		struct THApSymbolicEntry
 		{
 			struct TEntry
 			{
 				TEntry(
-					const typename HESS_Apf::matrix_t * _Hpi_lk,
+					const TInfoPerHApfBlock           * _Hpi_lk,
 					const TInfoPerHfBlock             * _inv_Hf_lk,
-					const typename HESS_Apf::matrix_t * _Hpj_lk,
-					typename HESS_Apf::matrix_t       * _out_Hpi_lk_times_inv_Hf_lk
+					const TInfoPerHApfBlock           * _Hpj_lk,
+					matrix_Apf_t                      * _out_Hpi_lk_times_inv_Hf_lk
 					)
 					:
 						Hpi_lk(_Hpi_lk),
@@ -364,10 +559,10 @@ namespace srba {
 				{
 				}
 
-				const typename HESS_Apf::matrix_t * Hpi_lk;
+				const TInfoPerHApfBlock           * Hpi_lk;
 				const TInfoPerHfBlock             * inv_Hf_lk;
-				const typename HESS_Apf::matrix_t * Hpj_lk;
-				typename HESS_Apf::matrix_t       * out_Hpi_lk_times_inv_Hf_lk;  //!< If NULL=use local storage.
+				const TInfoPerHApfBlock           * Hpj_lk;
+				matrix_Apf_t                      * out_Hpi_lk_times_inv_Hf_lk;  //!< If NULL=use local storage.
 			};
 
 			typename HESS_Ap::matrix_t * HAp_ij;
@@ -389,7 +584,7 @@ namespace srba {
 			{
 				size_t feat_idx;
 				// Used as a temporary container for the product, but also because this term reappears in the gradient update:
-				typename HESS_Apf::matrix_t         Hpi_lk_times_inv_Hf_lk;
+				matrix_Apf_t                        Hpi_lk_times_inv_Hf_lk;
 
 				MRPT_MAKE_ALIGNED_OPERATOR_NEW
 			};
@@ -0,0 +1,244 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#pragma once
+
+#include <queue>
+#include <functional>
+
+namespace srba {
+
+//  Bidirectional breadth-first search (BFS) for "trg_node"
+//  Return: true: found
+template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
+bool TRBA_Problem_state<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::find_path_bfs(
+	const TKeyFrameID           src_node,
+	const TKeyFrameID           trg_node,
+	std::vector<TKeyFrameID>  * out_path_IDs,
+	typename kf2kf_pose_traits<KF2KF_POSE_TYPE>::k2k_edge_vector_t * out_path_edges,
+	TPathSearchWorkspace      * aux_ws ) const
+{
+	if (out_path_IDs) out_path_IDs->clear();
+	if (out_path_edges) out_path_edges->clear();
+	if (src_node==trg_node) return true; // No need to do any search...
+
+	ASSERTDEB_(src_node < keyframes.size() && trg_node < keyframes.size())
+
+	TPathSearchWorkspace local_ws; // Only used if the caller gave no working space, so concurrent searches don't share any state
+	TPathSearchWorkspace & ws = aux_ws ? *aux_ws : local_ws;
+	ws.new_search(keyframes.size());
+	const unsigned int gen = ws.generation;
+
+	// Side 0 grows from the source, side 1 from the target:
+	const TKeyFrameID roots[2] = { src_node, trg_node };
+	size_t queue_head[2] = { 0,0 };
+	for (int s=0;s<2;s++)
+	{
+		ws.stamp[s][roots[s]] = gen;
+		ws.dist[s][roots[s]] = 0;
+		ws.queue[s].push_back(roots[s]);
+	}
+
+	// Expand one complete BFS level at a time, always from the side with the smallest frontier.
+	// The first level which reaches any KF already visited from the other side gives the shortest distance
+	// (the minimum among all such KFs found while expanding that level).
+	topo_dist_t best_dist = std::numeric_limits<topo_dist_t>::max();
+	TKeyFrameID meet_kf = SRBA_INVALID_KEYFRAMEID;
+
+	while (queue_head[0]<ws.queue[0].size() && queue_head[1]<ws.queue[1].size())
+	{
+		const int s = (ws.queue[0].size()-queue_head[0] <= ws.queue[1].size()-queue_head[1]) ? 0:1;
+		const int o = 1-s;
+		const topo_dist_t level = ws.dist[s][ ws.queue[s][queue_head[s]] ];
+
+		while (queue_head[s]<ws.queue[s].size() && ws.dist[s][ ws.queue[s][queue_head[s]] ]==level)
+		{
+			const TKeyFrameID next_kf = ws.queue[s][queue_head[s]++];
+
+			// Get all connections of this node:
+			const keyframe_info & kfi = keyframes[next_kf];
+			for (size_t i=0;i<kfi.adjacent_k2k_edges.size();i++)
+			{
+				const k2k_edge_t* ed = kfi.adjacent_k2k_edges[i];
+				const TKeyFrameID new_kf = getTheOtherFromPair2(next_kf, *ed);
+				if (ws.stamp[s][new_kf]==gen)
+					continue; // Already visited from this side
+
+				ws.stamp[s][new_kf] = gen;
+				ws.dist[s][new_kf] = level+1;
+				ws.prev[s][new_kf] = next_kf;
+				ws.prev_edge[s][new_kf] = ed;
+				ws.queue[s].push_back(new_kf);
+
+				if (ws.stamp[o][new_kf]==gen && level+1+ws.dist[o][new_kf]<best_dist)
+				{
+					best_dist = level+1+ws.dist[o][new_kf];
+					meet_kf = new_kf;
+				}
+			}
+		}
+
+		if (meet_kf!=SRBA_INVALID_KEYFRAMEID)
+			break;
+	}
+
+	if (meet_kf==SRBA_INVALID_KEYFRAMEID)
+		return false; // No path found.
+
+	// Path found: go from the meeting KF back to the source, then forward to the target:
+	if (out_path_IDs) out_path_IDs->resize(best_dist);
+	if (out_path_edges) out_path_edges->resize(best_dist);
+
+	topo_dist_t pos = ws.dist[0][meet_kf];
+	for (TKeyFrameID path_node = meet_kf; path_node!=src_node; path_node = ws.prev[0][path_node])
+	{
+		ASSERT_(pos>0)
+		--pos;
+		if (out_path_IDs) (*out_path_IDs)[pos] = path_node;
+		if (out_path_edges) (*out_path_edges)[pos] = const_cast<k2k_edge_t*>(ws.prev_edge[0][path_node]);
+	}
+
+	pos = ws.dist[0][meet_kf];
+	for (TKeyFrameID path_node = meet_kf; path_node!=trg_node; pos++)
+	{
+		ASSERT_(pos<best_dist)
+		if (out_path_edges) (*out_path_edges)[pos] = const_cast<k2k_edge_t*>(ws.prev_edge[1][path_node]);
+		path_node = ws.prev[1][path_node];
+		if (out_path_IDs) (*out_path_IDs)[pos] = path_node;
+	}
+
+	return true;
+}
+
+//  A* search for "trg_node", using the symbolic spanning trees as heuristic
+//  Return: true: found
+template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
+bool TRBA_Problem_state<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::find_path_astar(
+	const TKeyFrameID           src_node,
+	const TKeyFrameID           trg_node,
+	const topo_dist_t           max_depth,
+	std::vector<TKeyFrameID>  * out_path_IDs,
+	typename kf2kf_pose_traits<KF2KF_POSE_TYPE>::k2k_edge_vector_t * out_path_edges,
+	TPathSearchWorkspace      * aux_ws ) const
+{
+	if (out_path_IDs) out_path_IDs->clear();
+	if (out_path_edges) out_path_edges->clear();
+	if (src_node==trg_node) return true; // No need to do any search...
+
+	ASSERTDEB_(src_node < keyframes.size() && trg_node < keyframes.size())
+
+	TPathSearchWorkspace local_ws; // Only used if the caller gave no working space, so concurrent searches don't share any state
+	TPathSearchWorkspace & ws = aux_ws ? *aux_ws : local_ws;
+	ws.new_search(keyframes.size());
+	const unsigned int gen = ws.generation;
+
+	std::vector<unsigned int>      & stamp     = ws.stamp[0];
+	std::vector<topo_dist_t>       & dist      = ws.dist[0];
+	std::vector<TKeyFrameID>       & prev      = ws.prev[0];
+	std::vector<const k2k_edge_t*> & prev_edge = ws.prev_edge[0];
+	std::vector<topo_dist_t>       & heur      = ws.heuristic;
+
+	// Heuristic: exact distance if "trg_node" is in the spanning tree of the KF, otherwise it's at least max_depth+1.
+	// A value of 0 means unknown (the KF has no spanning tree yet), which keeps the heuristic admissible.
+	const topo_dist_t HEUR_FAR = max_depth+1;
+	typename TSpanningTree::next_edge_maps_t::const_iterator it_st_trg = spanning_tree.sym.next_edge.find(trg_node);
+
+	typedef std::pair<topo_dist_t,TKeyFrameID> open_entry_t; // (f=g+h, KF)
+	std::priority_queue<open_entry_t, std::vector<open_entry_t>, std::greater<open_entry_t> > open;
+
+	stamp[src_node] = gen;
+	dist[src_node] = 0;
+	{
+		// Distances are symmetric, so look up the source in the tree of the target:
+		std::map<TKeyFrameID,TSpanTreeEntry>::const_iterator it;
+		heur[src_node] = (it_st_trg==spanning_tree.sym.next_edge.end()) ? 0 :
+			(it=it_st_trg->second.find(src_node))!=it_st_trg->second.end() ? it->second.distance : HEUR_FAR;
+	}
+	open.push( open_entry_t(heur[src_node],src_node) );
+
+	while (!open.empty())
+	{
+		const open_entry_t top = open.top();
+		open.pop();
+		const TKeyFrameID cur_kf = top.second;
+		if (top.first!=dist[cur_kf]+heur[cur_kf])
+			continue; // Outdated entry: this KF was reached later through a shorter path
+
+		// Is the remaining path exactly known from the spanning tree?
+		const bool exact_heur = (cur_kf==trg_node) || (heur[cur_kf]>0 && heur[cur_kf]<HEUR_FAR);
+		if (exact_heur)
+		{
+			const topo_dist_t total_dist = dist[cur_kf] + heur[cur_kf];
+			if (out_path_IDs) out_path_IDs->resize(total_dist);
+			if (out_path_edges) out_path_edges->resize(total_dist);
+
+			// Go back from "cur_kf" to the source:
+			topo_dist_t pos = dist[cur_kf];
+			for (TKeyFrameID path_node = cur_kf; path_node!=src_node; path_node = prev[path_node])
+			{
+				ASSERT_(pos>0)
+				--pos;
+				if (out_path_IDs) (*out_path_IDs)[pos] = path_node;
+				if (out_path_edges) (*out_path_edges)[pos] = const_cast<k2k_edge_t*>(prev_edge[path_node]);
+			}
+
+			// And follow the spanning trees from "cur_kf" to the target:
+			pos = dist[cur_kf];
+			for (TKeyFrameID path_node = cur_kf; path_node!=trg_node; pos++)
+			{
+				ASSERT_(pos<total_dist)
+				typename TSpanningTree::next_edge_maps_t::const_iterator it_st = spanning_tree.sym.next_edge.find(path_node);
+				ASSERT_(it_st!=spanning_tree.sym.next_edge.end())
+				std::map<TKeyFrameID,TSpanTreeEntry>::const_iterator it_next = it_st->second.find(trg_node);
+				ASSERT_(it_next!=it_st->second.end())
+				const TKeyFrameID next_kf = it_next->second.next;
+
+				const k2k_edge_t* ed = NULL;
+				const keyframe_info & kfi = keyframes[path_node];
+				for (size_t i=0;!ed && i<kfi.adjacent_k2k_edges.size();i++)
+					if (getTheOtherFromPair2(path_node, *kfi.adjacent_k2k_edges[i])==next_kf)
+						ed = kfi.adjacent_k2k_edges[i];
+				ASSERT_(ed!=NULL)
+
+				if (out_path_IDs) (*out_path_IDs)[pos] = next_kf;
+				if (out_path_edges) (*out_path_edges)[pos] = const_cast<k2k_edge_t*>(ed);
+				path_node = next_kf;
+			}
+			return true; // End of search
+		}
+
+		// Get all connections of this node:
+		const topo_dist_t new_dist = dist[cur_kf]+1;
+		const keyframe_info & kfi = keyframes[cur_kf];
+		for (size_t i=0;i<kfi.adjacent_k2k_edges.size();i++)
+		{
+			const k2k_edge_t* ed = kfi.adjacent_k2k_edges[i];
+			const TKeyFrameID new_kf = getTheOtherFromPair2(cur_kf, *ed);
+
+			if (stamp[new_kf]!=gen)
+			{
+				stamp[new_kf] = gen;
+				std::map<TKeyFrameID,TSpanTreeEntry>::const_iterator it;
+				heur[new_kf] = (it_st_trg==spanning_tree.sym.next_edge.end()) ? 0 :
+					(it=it_st_trg->second.find(new_kf))!=it_st_trg->second.end() ? it->second.distance : HEUR_FAR;
+				if (new_kf==trg_node) heur[new_kf] = 0;
+			}
+			else if (dist[new_kf]<=new_dist)
+				continue; // Already reached through a path as short as this one
+
+			dist[new_kf] = new_dist;
+			prev[new_kf] = cur_kf;
+			prev_edge[new_kf] = ed;
+			open.push( open_entry_t(new_dist+heur[new_kf],new_kf) );
+		}
+	}
+	return false; // No path found.
+}
+
+} // end NS
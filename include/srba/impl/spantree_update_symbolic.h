@@ -185,7 +185,7 @@ cout << "ST: New path ST["<<s<<"]["<<r<<"].N ="<<(ste_s2ik ? ste_s2ik->next : ne
 		// find_path_bfs
 		typename kf2kf_pose_traits<KF2KF_POSE_TYPE>::k2k_edge_vector_t & path = sym.all_edges[from][to];  // O(1) in map_as_vector
 		path.clear();
-		bool path_found = m_parent->find_path_bfs(from,to, NULL, &path);
+		bool path_found = m_parent->find_path_bfs(from,to, NULL, &path, &this->path_search_ws);
 		ASSERT_(path_found)
 	} // end for each "kfs_with_modified_next_edge"
 
@@ -221,10 +221,10 @@ struct TBFSEntry
 	topo_dist_t dist;
 };
 
-//  Breadth-first search (BFS) for "trg_node"
+//  Unidirectional breadth-first search (BFS) for "trg_node"
 //  Return: true: found
 template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
-bool TRBA_Problem_state<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::find_path_bfs(
+bool TRBA_Problem_state<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::find_path_bfs_unidirectional(
 	const TKeyFrameID           cur_node,
 	const TKeyFrameID           trg_node,
 	std::vector<TKeyFrameID>  * out_path_IDs,
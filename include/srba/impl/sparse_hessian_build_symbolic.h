@@ -9,173 +9,224 @@
 
 #pragma once
 
-namespace srba {
+#include <algorithm>
 
+namespace srba {
 
-/** Rebuild the Hessian symbolic information from the given Jacobians
-  * Example of the expected template types:
-  *  - HESS_Apf:  MatrixBlockSparseCols<double,6,3,THessianSymbolicInfo<double,2,6,3>, false >
-  *  - JACOB_COLUMN_dh_dAp: TSparseBlocksJacobians_dh_dAp::col_t = MatrixBlockSparseCols<double,2,6,TJacobianSymbolicInfo_dh_dAp, false>::col_t
-  */
-template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
-template <class HESS_Ap, class HESS_f,class HESS_Apf, class JACOB_COLUMN_dh_dAp,class JACOB_COLUMN_dh_df>
-void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::sparse_hessian_build_symbolic(
-	HESS_Ap & HAp,
-	HESS_f & Hf,
-	HESS_Apf & HApf,
-	const std::vector<JACOB_COLUMN_dh_dAp*> & dh_dAp,
-	const std::vector<JACOB_COLUMN_dh_df*>  & dh_df)
+namespace internal
 {
-	typedef typename HESS_Ap::symbolic_t::THessianSymbolicInfoEntry  hess_Ap_sym_entry_t;   // These are concrete instances of THessianSymbolicInfo<...>::THessianSymbolicInfoEntry
-	typedef typename HESS_f::symbolic_t::THessianSymbolicInfoEntry   hess_f_sym_entry_t;
-	typedef typename HESS_Apf::symbolic_t::THessianSymbolicInfoEntry hess_Apf_sym_entry_t;
-
-	const size_t nUnknowns_k2k = dh_dAp.size();
-	const size_t nUnknowns_k2f = dh_df.size();
-
-	// --------------------------------------------------------------------
-	//  (1) HAp = J_Ap^t * J_Ap
-	// --------------------------------------------------------------------
-	// Only upper-triangular half of U (what is used by Cholesky):
-	HAp.setColCount (nUnknowns_k2k);
-	for (size_t i=0;i<nUnknowns_k2k;i++)
+	/** One nonzero Jacobian block, indexed by (observation, unknown). Used to transpose the column-wise
+	  * Jacobians into a per-observation list while building the Hessian symbolic structure. */
+	template <class JACOB_ENTRY>
+	struct TObsJacobEntry
 	{
-		const JACOB_COLUMN_dh_dAp & col_i = *dh_dAp[i];
-		ASSERT_(!col_i.empty()) // I guess this shouldn't happen...
+		size_t              obs_idx;
+		size_t              unk_idx;
+		const JACOB_ENTRY * jacob;
 
-		// j=i
-		// -----
-		{
-			typename HESS_Ap::symbolic_t & Hii_sym = HAp.getCol(i)[i].sym;
+		TObsJacobEntry(const size_t obs_idx_, const size_t unk_idx_, const JACOB_ENTRY * jacob_) : obs_idx(obs_idx_),unk_idx(unk_idx_),jacob(jacob_) {}
 
-			for (typename JACOB_COLUMN_dh_dAp::const_iterator it=col_i.begin();it!=col_i.end();++it)
-			{
-				const size_t obs_idx = it->first;
-
-				Hii_sym.lst_jacob_blocks.push_back(
-					hess_Ap_sym_entry_t(
-						&it->second.num, &it->second.num, // J1, J2,
-						it->second.sym.is_valid,it->second.sym.is_valid, // J1_valid, J2_valid,
-						obs_idx
-						) );
-			}
+		inline bool operator <(const TObsJacobEntry &o) const {
+			return obs_idx<o.obs_idx || (obs_idx==o.obs_idx && unk_idx<o.unk_idx);
 		}
+	};
 
-		// j=[i+1, nUnknowns-1]
-		// -------------------
-		for (size_t j=i+1;j<nUnknowns_k2k;j++)
+	/** Collects all the blocks of a list of Jacobian columns, sorted by (observation index, unknown index). */
+	template <class JACOB_COLUMN>
+	void collect_jacob_blocks_by_observation(
+		const std::vector<JACOB_COLUMN*> & cols,
+		std::vector< TObsJacobEntry<typename JACOB_COLUMN::mapped_type> > & out)
+	{
+		size_t nBlocks = 0;
+		for (size_t i=0;i<cols.size();i++)
 		{
-			const JACOB_COLUMN_dh_dAp & col_j = *dh_dAp[j];
-			ASSERTMSG_(!col_j.empty(),mrpt::format("col_j,i=%u,j=%u empty (nUnknowns_k2k=%u)!",static_cast<unsigned int>(i),static_cast<unsigned int>(j),static_cast<unsigned int>(nUnknowns_k2k))) // I guess this shouldn't happen...
+			ASSERTMSG_(!cols[i]->empty(),mrpt::format("Jacobian column %u is empty!",static_cast<unsigned int>(i))) // I guess this shouldn't happen...
+			nBlocks+=cols[i]->size();
+		}
 
-			// code below based on "std::set_intersection"
-			typename JACOB_COLUMN_dh_dAp::const_iterator it_i = col_i.begin();
-			typename JACOB_COLUMN_dh_dAp::const_iterator it_j = col_j.begin();
-			const typename JACOB_COLUMN_dh_dAp::const_iterator it_i_end = col_i.end();
-			const typename JACOB_COLUMN_dh_dAp::const_iterator it_j_end = col_j.end();
+		out.clear();
+		out.reserve(nBlocks);
+		for (size_t i=0;i<cols.size();i++)
+			for (typename JACOB_COLUMN::const_iterator it=cols[i]->begin();it!=cols[i]->end();++it)
+				out.push_back( TObsJacobEntry<typename JACOB_COLUMN::mapped_type>(it->first,i,&it->second) );
 
-			// Don't create the entry in the sparse Hessian until we're sure it's nonzero:
-			typename HESS_Ap::symbolic_t Hij_sym;
+		std::sort(out.begin(),out.end());
+	}
 
-			while (it_i!=it_i_end && it_j!=it_j_end)
-			{
-				if ( it_i->first < it_j->first ) ++it_i;
-				else if ( it_j->first < it_i->first ) ++it_j;
-				else
-				{
-					// match between: it_i->first == it_j->first
-					const size_t obs_idx = it_i->first;
+	/** Returns one past the last entry in [first,end) with the same observation index as \a first */
+	template <class ENTRY>
+	inline size_t find_end_of_observation(const std::vector<ENTRY> & v, const size_t first)
+	{
+		size_t last = first+1;
+		while (last<v.size() && v[last].obs_idx==v[first].obs_idx)
+			++last;
+		return last;
+	}
+
+	/** Collects the terms of a sparse Hessian in the order they are generated (by observation), then groups them by Hessian
+	  * block into its flat THessianSymbolicCSR in finish(). */
+	template <class HESS>
+	class HessianSymbolicCSRBuilder
+	{
+	public:
+		typedef typename HESS::symbolic_t::THessianSymbolicInfoEntry term_t;
+		typedef typename HESS::TEntry                                 hess_entry_t;
 
-					Hij_sym.lst_jacob_blocks.push_back( //std::make_pair(&it_i->second.num, &it_j->second.num) );
-						hess_Ap_sym_entry_t(
-							&it_i->second.num, &it_j->second.num, // J1, J2,
-							it_i->second.sym.is_valid,it_j->second.sym.is_valid, // J1_valid, J2_valid,
-							obs_idx
-							) );
+		HessianSymbolicCSRBuilder(HESS & H) : m_H(H) { m_H.symbolic_csr.clear(); }
 
-					// Move:
-					++it_i; ++it_j;
-				}
+		/** Appends a term to the Hessian block \a blk */
+		inline void add(hess_entry_t & blk, const term_t & t)
+		{
+			if (!blk.sym.num_jacob_blocks++)
+			{
+				blk.sym.first_jacob_block = m_new_blocks.size(); // Temporary block index, until finish()
+				m_new_blocks.push_back(&blk);
 			}
+			m_terms.push_back( std::make_pair(blk.sym.first_jacob_block, t) );
+		}
 
-			// If it was nonzero, move (swap) to its actual place, created with the [] operator in the std::map<>:
-			if (!Hij_sym.lst_jacob_blocks.empty())
-				Hij_sym.lst_jacob_blocks.swap( HAp.getCol(j)[i].sym.lst_jacob_blocks );  // Caution!! Look: at (j,i), in that order, OK?
+		/** Numbers the blocks in their storage order and moves all the terms into the flat array */
+		void finish()
+		{
+			THessianSymbolicCSR<typename HESS::symbolic_t,hess_entry_t> & csr = m_H.symbolic_csr;
+
+			// Final block indices:
+			std::vector<size_t> tmp2final(m_new_blocks.size());
+			csr.blocks.reserve(m_new_blocks.size());
+			for (size_t c=0;c<m_H.getColCount();c++)
+				for (typename HESS::col_t::iterator it=m_H.getCol(c).begin();it!=m_H.getCol(c).end();++it)
+					if (it->second.sym.num_jacob_blocks)
+					{
+						tmp2final[it->second.sym.first_jacob_block] = csr.blocks.size();
+						csr.blocks.push_back(&it->second);
+					}
+			ASSERT_EQUAL_(csr.blocks.size(),m_new_blocks.size())
+
+			csr.offsets.resize(csr.blocks.size()+1);
+			csr.offsets[0] = 0;
+			for (size_t b=0;b<csr.blocks.size();b++)
+			{
+				csr.offsets[b+1] = csr.offsets[b] + csr.blocks[b]->sym.num_jacob_blocks;
+				csr.blocks[b]->sym.first_jacob_block = csr.offsets[b];
+			}
 
-		} // end for j
-	} // end for i
+			// Stable counting sort by block, so the terms of each block remain in increasing order of observation index:
+			std::vector<size_t> cursor(csr.offsets.begin(), csr.offsets.end()-1);
+			csr.entries.resize(m_terms.size());
+			for (size_t k=0;k<m_terms.size();k++)
+				csr.entries[ cursor[ tmp2final[m_terms[k].first] ]++ ] = m_terms[k].second;
 
-	// --------------------------------------------------------------------
-	//  (2) Hf = J_f^t * J_f
-	// --------------------------------------------------------------------
-	// Only upper-triangular half of U (what is used by Cholesky):
-	Hf.setColCount (nUnknowns_k2f);
-	for (size_t i=0;i<nUnknowns_k2f;i++)
+			m_terms.clear();
+			m_new_blocks.clear();
+		}
+
+	private:
+		HESS & m_H;
+		std::vector<std::pair<size_t,term_t> > m_terms;      //!< (temporary block index, term)
+		std::vector<hess_entry_t*>              m_new_blocks; //!< Indexed by temporary block index
+	};
+
+	/** Emits the upper triangle (including the diagonal) of J^t*J for the set of Jacobian blocks of each observation. */
+	template <class HESS, class ENTRY>
+	void sparse_hessian_build_symbolic_square(HESS & H, const std::vector<ENTRY> & blocks, const size_t nUnknowns)
 	{
-		const JACOB_COLUMN_dh_df & col_i = *dh_df[i];
-		ASSERT_(!col_i.empty()) // I guess this shouldn't happen...
+		typedef typename HESS::symbolic_t::THessianSymbolicInfoEntry hess_sym_entry_t;
 
-		// j=i
-		// -----
+		H.setColCount(nUnknowns);
+		HessianSymbolicCSRBuilder<HESS> builder(H);
+		for (size_t first=0;first<blocks.size(); )
 		{
-			typename HESS_f::symbolic_t & Hii_sym = Hf.getCol(i)[i].sym;
+			const size_t last = find_end_of_observation(blocks,first);
+			const size_t obs_idx = blocks[first].obs_idx;
 
-			for (typename JACOB_COLUMN_dh_df::const_iterator it=col_i.begin();it!=col_i.end();++it)
+			for (size_t a=first;a<last;a++)
 			{
-				const size_t obs_idx = it->first;
-
-				Hii_sym.lst_jacob_blocks.push_back( //std::make_pair(&it->second.num, &it->second.num) );
-					hess_f_sym_entry_t(
-						&it->second.num, &it->second.num, // J1, J2,
-						it->second.sym.is_valid,it->second.sym.is_valid, // J1_valid, J2_valid,
-						obs_idx
-						) );
+				const ENTRY & Ja = blocks[a];
+				for (size_t b=a;b<last;b++)
+				{
+					const ENTRY & Jb = blocks[b];
+					// Only upper-triangular half: at (j,i) with i<=j, as stored by columns:
+					builder.add( H.getCol(Jb.unk_idx)[Ja.unk_idx],
+						hess_sym_entry_t(
+							&Ja.jacob->num, &Jb.jacob->num, // J1, J2,
+							Ja.jacob->sym.is_valid,Jb.jacob->sym.is_valid, // J1_valid, J2_valid,
+							obs_idx
+							) );
+				}
 			}
+			first = last;
 		}
+		builder.finish();
+	}
 
-		// j=[i+1, nUnknowns-1]
-		// -------------------
-		for (size_t j=i+1;j<nUnknowns_k2f;j++)
+	/** \overload For block-diagonal Hessians: each observation must involve one single unknown. */
+	template <typename Scalar, int N, class INFO, class ENTRY>
+	void sparse_hessian_build_symbolic_square(BlockDiagonalMatrix<Scalar,N,INFO> & H, const std::vector<ENTRY> & blocks, const size_t nUnknowns)
+	{
+		typedef typename INFO::THessianSymbolicInfoEntry hess_sym_entry_t;
+
+		H.setColCount(nUnknowns);
+		HessianSymbolicCSRBuilder<BlockDiagonalMatrix<Scalar,N,INFO> > builder(H);
+		for (size_t k=0;k<blocks.size();k++)
 		{
-			const JACOB_COLUMN_dh_df & col_j = *dh_df[j];
-			ASSERT_(!col_j.empty()) // I guess this shouldn't happen...
+			const ENTRY & J = blocks[k];
+			ASSERTMSG_(k+1==blocks.size() || blocks[k+1].obs_idx!=J.obs_idx, "Block-diagonal Hessian but an observation involves several unknowns!")
+
+			builder.add( H.getCol(J.unk_idx).diag.second,
+				hess_sym_entry_t(
+					&J.jacob->num, &J.jacob->num, // J1, J2,
+					J.jacob->sym.is_valid,J.jacob->sym.is_valid, // J1_valid, J2_valid,
+					J.obs_idx
+					) );
+		}
+		builder.finish();
+	}
 
-			// code below based on "std::set_intersection"
-			typename JACOB_COLUMN_dh_df::const_iterator it_i = col_i.begin();
-			typename JACOB_COLUMN_dh_df::const_iterator it_j = col_j.begin();
-			const typename JACOB_COLUMN_dh_df::const_iterator it_i_end = col_i.end();
-			const typename JACOB_COLUMN_dh_df::const_iterator it_j_end = col_j.end();
+} // end NS internal
 
-			// Don't create the entry in the sparse Hessian until we're sure it's nonzero:
-			typename HESS_f::symbolic_t Hij_sym;
+/** Rebuild the Hessian symbolic information from the given Jacobians
+  * Example of the expected template types:
+  *  - HESS_Apf:  MatrixBlockSparseCols<double,6,3,THessianSymbolicInfo<double,2,6,3>, false >
+  *  - JACOB_COLUMN_dh_dAp: TSparseBlocksJacobians_dh_dAp::col_t = SparseBlockJacobian<double,2,6,TJacobianSymbolicInfo_dh_dAp, false>::col_t
+  *
+  * The Jacobian blocks are first regrouped by observation, then each observation emits the Hessian entries for all the pairs
+  * of unknowns it involves. The cost is thus proportional to the number of nonzero Hessian blocks instead of the
+  * square of the number of unknowns, and the result is identical to intersecting each pair of Jacobian columns.
+  * The terms of all the blocks of each Hessian are stored in its flat \a symbolic_csr structure (see THessianSymbolicCSR).
+  */
+template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
+template <class HESS_Ap, class HESS_f,class HESS_Apf, class JACOB_COLUMN_dh_dAp,class JACOB_COLUMN_dh_df>
+void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::sparse_hessian_build_symbolic(
+	HESS_Ap & HAp,
+	HESS_f & Hf,
+	HESS_Apf & HApf,
+	const std::vector<JACOB_COLUMN_dh_dAp*> & dh_dAp,
+	const std::vector<JACOB_COLUMN_dh_df*>  & dh_df)
+{
+	typedef typename HESS_Apf::symbolic_t::THessianSymbolicInfoEntry hess_Apf_sym_entry_t;
+	typedef internal::TObsJacobEntry<typename JACOB_COLUMN_dh_dAp::mapped_type> obs_Ap_entry_t;
+	typedef internal::TObsJacobEntry<typename JACOB_COLUMN_dh_df::mapped_type>  obs_f_entry_t;
 
-			while (it_i!=it_i_end && it_j!=it_j_end)
-			{
-				if ( it_i->first < it_j->first ) ++it_i;
-				else if ( it_j->first < it_i->first ) ++it_j;
-				else
-				{
-					// match between: it_i->first == it_j->first
-					const size_t obs_idx = it_i->first;
+	const size_t nUnknowns_k2k = dh_dAp.size();
+	const size_t nUnknowns_k2f = dh_df.size();
 
-					Hij_sym.lst_jacob_blocks.push_back( //std::make_pair(&it_i->second.num, &it_j->second.num) );
-						hess_f_sym_entry_t(
-							&it_i->second.num, &it_j->second.num, // J1, J2,
-							it_i->second.sym.is_valid,it_j->second.sym.is_valid, // J1_valid, J2_valid,
-							obs_idx
-							) );
+	// Transpose the Jacobians: list of blocks sorted by observation index:
+	std::vector<obs_Ap_entry_t> blocks_Ap;
+	std::vector<obs_f_entry_t>  blocks_f;
+	internal::collect_jacob_blocks_by_observation(dh_dAp, blocks_Ap);
+	internal::collect_jacob_blocks_by_observation(dh_df, blocks_f);
 
-					// Move:
-					++it_i; ++it_j;
-				}
-			}
-
-			// If it was nonzero, move (swap) to its actual place, created with the [] operator in the std::map<>:
-			if (!Hij_sym.lst_jacob_blocks.empty())
-				Hij_sym.lst_jacob_blocks.swap( Hf.getCol(j)[i].sym.lst_jacob_blocks );  // Caution!! Look: at (j,i), in that order, OK?
+	// --------------------------------------------------------------------
+	//  (1) HAp = J_Ap^t * J_Ap
+	// --------------------------------------------------------------------
+	// Only upper-triangular half of U (what is used by Cholesky):
+	internal::sparse_hessian_build_symbolic_square(HAp,blocks_Ap,nUnknowns_k2k);
 
-		} // end for j
-	} // end for i
+	// --------------------------------------------------------------------
+	//  (2) Hf = J_f^t * J_f
+	// --------------------------------------------------------------------
+	// Only upper-triangular half of U (what is used by Cholesky):
+	internal::sparse_hessian_build_symbolic_square(Hf,blocks_f,nUnknowns_k2f);
 
 	// --------------------------------------------------------------------
 	//  (3) HApf = J_Ap^t * J_f
@@ -183,57 +234,36 @@ void RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::sparse_hessian_bui
 	// The entire rectangular matrix (it's NOT symetric!)
 
 	// *NOTE* HApf will be stored indices by rows instead of columns!!
-
-	//HApf.setColCount(nUnknowns_k2f);
 	HApf.setColCount(nUnknowns_k2k);  // # of ROWS
-	for (size_t i=0;i<nUnknowns_k2k;i++)  // i:row = [0,nUnknowns_k2k-1]
-	{
-		const JACOB_COLUMN_dh_dAp & col_i = *dh_dAp[i];
-		ASSERT_(!col_i.empty()) // I guess this shouldn't happen...
+	internal::HessianSymbolicCSRBuilder<HESS_Apf> builder_Apf(HApf);
 
-		// j:col = [0,nUnknowns_k2f-1]
-		for (size_t j=0;j<nUnknowns_k2f;j++)
-		{
-			const JACOB_COLUMN_dh_df & col_j = *dh_df[j];
-			ASSERT_(!col_j.empty()) // I guess this shouldn't happen...
-
-			// code below based on "std::set_intersection"
-			typename JACOB_COLUMN_dh_dAp::const_iterator it_i = col_i.begin();
-			typename JACOB_COLUMN_dh_df::const_iterator it_j = col_j.begin();
-			const typename JACOB_COLUMN_dh_dAp::const_iterator it_i_end = col_i.end();
-			const typename JACOB_COLUMN_dh_df::const_iterator it_j_end = col_j.end();
+	// Merge both lists (both sorted by observation index):
+	size_t idx_f = 0;
+	for (size_t first=0;first<blocks_Ap.size(); )
+	{
+		const size_t last = internal::find_end_of_observation(blocks_Ap,first);
+		const size_t obs_idx = blocks_Ap[first].obs_idx;
 
-			// Don't create the entry in the sparse Hessian until we're sure it's nonzero:
-			typename HESS_Apf::symbolic_t Hij_sym;
+		while (idx_f<blocks_f.size() && blocks_f[idx_f].obs_idx<obs_idx)
+			++idx_f;
 
-			while (it_i!=it_i_end && it_j!=it_j_end)
+		for (size_t b=idx_f; b<blocks_f.size() && blocks_f[b].obs_idx==obs_idx; b++)
+		{
+			const obs_f_entry_t & Jb = blocks_f[b];
+			for (size_t a=first;a<last;a++)
 			{
-				if ( it_i->first < it_j->first ) ++it_i;
-				else if ( it_j->first < it_i->first ) ++it_j;
-				else
-				{
-					// match between: it_i->first == it_j->first
-					const size_t obs_idx = it_i->first;
-
-					Hij_sym.lst_jacob_blocks.push_back(
-						hess_Apf_sym_entry_t(
-							&it_i->second.num, &it_j->second.num, // J1, J2,
-							it_i->second.sym.is_valid,it_j->second.sym.is_valid, // J1_valid, J2_valid,
-							obs_idx
-							) );
-
-					// Move:
-					++it_i; ++it_j;
-				}
+				const obs_Ap_entry_t & Ja = blocks_Ap[a];
+				builder_Apf.add( HApf.getCol(Ja.unk_idx)[Jb.unk_idx], // (i,j) because it's stored indices by rows instead of columns!
+					hess_Apf_sym_entry_t(
+						&Ja.jacob->num, &Jb.jacob->num, // J1, J2,
+						Ja.jacob->sym.is_valid,Jb.jacob->sym.is_valid, // J1_valid, J2_valid,
+						obs_idx
+						) );
 			}
-
-			// If it was nonzero, move (swap) to its actual place, created with the [] operator in the std::map<>:
-			if (!Hij_sym.lst_jacob_blocks.empty())
-				Hij_sym.lst_jacob_blocks.swap( HApf.getCol(i)[j].sym.lst_jacob_blocks ); // (i,j) because it's stored indices by rows instead of columns!
-
-		} // end for j
-	} // end for i
-
+		}
+		first = last;
+	}
+	builder_Apf.finish();
 }
 
 } // end NS
@@ -12,50 +12,81 @@
 
 namespace srba {
 
-/** Rebuild the Hessian symbolic information from the internal pointers to blocks of Jacobians.
+/** Rebuild the Hessian numeric information from the internal pointers to blocks of Jacobians, in its flat symbolic structure (\a H.symbolic_csr).
 	*  Only the upper triangle is filled-in (all what is needed for Cholesky) for square Hessians, in whole for rectangular ones (it depends on the symbolic decomposition, done elsewhere).
 	* \tparam SPARSEBLOCKHESSIAN can be: TSparseBlocksHessian_6x6, TSparseBlocksHessian_3x3 or TSparseBlocksHessian_6x3
+	* \param[in] obs_to_relinearize If provided, only Hessian blocks with at least one observation marked with a non-zero in this vector (indexed by global observation index) are updated.
+	* \param[out] out_num_skipped_blocks If provided, the number of Hessian blocks skipped due to \a obs_to_relinearize will be added to it.
 	* \return The number of Jacobian multiplications skipped due to its observation being marked as "invalid"
 	*/
 template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
 template <class SPARSEBLOCKHESSIAN>
-size_t RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::sparse_hessian_update_numeric( SPARSEBLOCKHESSIAN & H ) const
+size_t RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::sparse_hessian_update_numeric( SPARSEBLOCKHESSIAN & H, const std::vector<char> * obs_to_relinearize, size_t * out_num_skipped_blocks ) const
 {
-	size_t nInvalid = 0;
-	const size_t nUnknowns = H.getColCount();
-	for (size_t i=0;i<nUnknowns;i++)
+	// Aux. type for IRLS-weighted Jacobians (only used with robust kernels):
+	typedef Eigen::Matrix<double,SPARSEBLOCKHESSIAN::symbolic_t::matrix1_t::RowsAtCompileTime,SPARSEBLOCKHESSIAN::symbolic_t::matrix1_t::ColsAtCompileTime> weighted_J1_t;
+	const bool use_robust_weights = robust_kernel_t::IS_ROBUST && this->parameters.srba.use_robust_kernel;
+
+	typedef typename SPARSEBLOCKHESSIAN::symbolic_t::THessianSymbolicInfoEntry hess_sym_entry_t;
+
+	// Single streaming pass over the flat symbolic structure. Blocks are independent, so they are split among threads:
+	const THessianSymbolicCSR<typename SPARSEBLOCKHESSIAN::symbolic_t,typename SPARSEBLOCKHESSIAN::TEntry> & csr = H.symbolic_csr;
+	const int nBlocks = static_cast<int>(csr.getBlockCount());
+
+	size_t nInvalid = 0, nSkipped = 0;
+#if defined(_OPENMP)
+	#pragma omp parallel for schedule(dynamic,64) reduction(+:nInvalid,nSkipped) if(nBlocks>=1024)
+#endif
+	for (int b=0;b<nBlocks;b++)
 	{
-		typename SPARSEBLOCKHESSIAN::col_t & col = H.getCol(i);
+		const hess_sym_entry_t * const terms_begin = &csr.entries[0] + csr.offsets[b];
+		const hess_sym_entry_t * const terms_end   = &csr.entries[0] + csr.offsets[b+1];
 
-		for (typename SPARSEBLOCKHESSIAN::col_t::iterator it=col.begin();it!=col.end();++it)
+		// Lazy relinearization: only re-evaluate if some of the Jacobians involved has changed:
+		if (obs_to_relinearize)
 		{
-			typename SPARSEBLOCKHESSIAN::TEntry & entry = it->second;
+			bool any_changed = false;
+			for (const hess_sym_entry_t * itJ = terms_begin; itJ!=terms_end && !any_changed; ++itJ)
+				any_changed = (*obs_to_relinearize)[itJ->obs_idx]!=0;
+			if (!any_changed)
+			{
+				++nSkipped;
+				continue;
+			}
+		}
 
-			// Compute: Hij = \Sum_k  J_{ki}^t * \Lambda_k *  J_{kj}
+		// Compute: Hij = \Sum_k  J_{ki}^t * \Lambda_k *  J_{kj}
 
-			typename SPARSEBLOCKHESSIAN::matrix_t Hij;
-			Hij.setZero();
-			//const size_t nJacobs = entry.sym.lst_jacob_blocks.size();
-			//for (size_t k=0;k<nJacobs;k++)
-			const typename SPARSEBLOCKHESSIAN::symbolic_t::list_jacob_blocks_t::const_iterator itJ_end = entry.sym.lst_jacob_blocks.end();
-			for (typename SPARSEBLOCKHESSIAN::symbolic_t::list_jacob_blocks_t::const_iterator itJ = entry.sym.lst_jacob_blocks.begin(); itJ!=itJ_end; ++itJ)
-			{
-				const typename SPARSEBLOCKHESSIAN::symbolic_t::THessianSymbolicInfoEntry & sym_k = *itJ;
+		typename SPARSEBLOCKHESSIAN::matrix_t Hij;
+		Hij.setZero();
+		for (const hess_sym_entry_t * itJ = terms_begin; itJ!=terms_end; ++itJ)
+		{
+			const hess_sym_entry_t & sym_k = *itJ;
 
-				if (*sym_k.J1_valid && *sym_k.J2_valid)
-				{
-					// Accumulate Hessian sub-blocks:
-					RBA_OPTIONS::obs_noise_matrix_t::template accum_JtJ(Hij, *sym_k.J1, *sym_k.J2, sym_k.obs_idx, this->parameters.obs_noise );
+			if (*sym_k.J1_valid && *sym_k.J2_valid)
+			{
+				// Accumulate Hessian sub-blocks:
+				if (use_robust_weights)
+				{	// IRLS: Hij += w_k * J1^t * \Lambda * J2
+					const double w = rba_state.all_observations_robust_weight[sym_k.obs_idx];
+					if (w!=0) // (Skip observations totally discarded by the kernel)
+					{
+						const weighted_J1_t wJ1 = (*sym_k.J1) * w;
+						RBA_OPTIONS::obs_noise_matrix_t::template accum_JtJ(Hij, wJ1, *sym_k.J2, sym_k.obs_idx, this->parameters.obs_noise, rba_state.all_observations_noise_data[sym_k.obs_idx] );
+					}
 				}
-				else nInvalid++;
+				else
+					RBA_OPTIONS::obs_noise_matrix_t::template accum_JtJ(Hij, *sym_k.J1, *sym_k.J2, sym_k.obs_idx, this->parameters.obs_noise, rba_state.all_observations_noise_data[sym_k.obs_idx] );
 			}
+			else nInvalid++;
+		}
 
-			// Do scaling (if applicable):
-			RBA_OPTIONS::obs_noise_matrix_t::template scale_H(Hij, this->parameters.obs_noise );
+		// Do scaling (if applicable):
+		RBA_OPTIONS::obs_noise_matrix_t::template scale_H(Hij, this->parameters.obs_noise );
 
-			entry.num = Hij;
-		}
+		csr.blocks[b]->num = Hij;
 	}
+	if (out_num_skipped_blocks) (*out_num_skipped_blocks) += nSkipped;
 	return nInvalid;
 } // end of sparse_hessian_update_numeric
 
@@ -0,0 +1,52 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#pragma once
+
+namespace srba {
+
+/** set_rel_transform (See header for docs) */
+template <class KF2KF_POSE_TYPE,class LM_TYPE,class OBS_TYPE,class RBA_OPTIONS>
+typename RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::TRelTransformCacheEntry *
+RbaEngine<KF2KF_POSE_TYPE,LM_TYPE,OBS_TYPE,RBA_OPTIONS>::set_rel_transform(
+	const TKeyFrameID observer_id,
+	const TKeyFrameID base_id,
+	const pose_t & base_pose_wrt_observer) const
+{
+	if (observer_id>=m_transform_cache.size())
+		m_transform_cache.resize(observer_id+1);
+
+	TRelTransformCacheSlot & slot = m_transform_cache[observer_id];
+	if (slot.epoch!=m_transform_cache_epoch)
+	{	// Entries from a former linearization: drop them, but keep their memory
+		slot.entries.clear();
+		slot.epoch = m_transform_cache_epoch;
+	}
+
+	TRelTransformCacheEntry * pe = NULL;
+	for (size_t i=0;i<slot.entries.size() && !pe;i++)
+		if (slot.entries[i].base_id==base_id)
+			pe = &slot.entries[i];
+	if (!pe)
+	{
+		slot.entries.push_back( TRelTransformCacheEntry() );
+		pe = &slot.entries.back();
+		pe->base_id = base_id;
+	}
+	TRelTransformCacheEntry & e = *pe;
+
+	e.base_pose_wrt_observer = base_pose_wrt_observer;
+	// pose_robot2sensor(): pose wrt sensor = pose_wrt_robot (-) sensor_pose_on_the_robot
+	RBA_OPTIONS::sensor_pose_on_robot_t::pose_robot2sensor( e.base_pose_wrt_observer, e.base_pose_wrt_sensor, this->parameters.sensor_pose );
+	e.R_valid = false;
+
+	return &e;
+}
+
+} // End of namespaces
@@ -11,7 +11,11 @@
 
 #include <mrpt/poses/CPose3D.h>
 #include <mrpt/poses/CPose2D.h>
+#include <mrpt/poses/CPose3DQuat.h>
 #include <mrpt/poses/SE_traits.h>
+#include <mrpt/graphs/CNetworkOfPoses.h>
+#include <iostream>
+#include <limits>
 
 namespace srba {
 namespace kf2kf_poses
@@ -28,6 +32,131 @@ namespace kf2kf_poses
 		static const size_t REL_POSE_DIMS = 6;  //!< Each relative pose is parameterized as a CPose3D()
 		typedef mrpt::poses::CPose3D       pose_t;  //!< The pose class
 		typedef mrpt::poses::SE_traits<3>  se_traits_t;  //!< The SE(3) traits struct (for Lie algebra log/exp maps, etc.)
+		typedef mrpt::graphs::CNetworkOfPoses3D global_graph_t; //!< Pose graph type for global optimizations
+	};
+
+	/** A lean SE(3) pose: a 3x3 rotation matrix plus a translation, without the yaw/pitch/roll angles, the lazy
+	  * update flags and the virtual table of mrpt::poses::CPose3D. Provides the subset of the CPose3D interface
+	  * used by SRBA, with composition and inversion written as small fixed-size Eigen products.
+	  * Implicitly convertible from/to mrpt::poses::CPose3D.
+	  * \sa SE3_fast */
+	class TPose3DRotMat
+	{
+	public:
+		enum { rotation_dimensions = 3 };
+
+		mrpt::math::CMatrixDouble33  m_ROT;    //!< The 3x3 rotation matrix
+		mrpt::math::CArrayDouble<3>  m_coords; //!< The translation vector [x,y,z]
+
+		/** Default ctor: the identity transformation */
+		inline TPose3DRotMat() : m_ROT(mrpt::math::UNINITIALIZED_MATRIX) { m_ROT.setIdentity(); m_coords.setZero(); }
+		/** Fast ctor: leaves the pose uninitialized */
+		inline TPose3DRotMat(mrpt::poses::TConstructorFlags_Poses) : m_ROT(mrpt::math::UNINITIALIZED_MATRIX) { }
+		/** Implicit conversion from a CPose3D */
+		inline TPose3DRotMat(const mrpt::poses::CPose3D &p) : m_ROT(p.getRotationMatrix()) { m_coords[0]=p.x(); m_coords[1]=p.y(); m_coords[2]=p.z(); }
+		explicit TPose3DRotMat(const mrpt::poses::CPose2D &p) { *this = TPose3DRotMat(mrpt::poses::CPose3D(p)); }
+		explicit TPose3DRotMat(const mrpt::poses::CPose3DQuat &p) { *this = TPose3DRotMat(mrpt::poses::CPose3D(p)); }
+
+		/** Implicit conversion to a CPose3D (its yaw/pitch/roll are only computed if requested) */
+		inline operator mrpt::poses::CPose3D() const { return mrpt::poses::CPose3D(m_ROT,m_coords); }
+		inline mrpt::poses::CPose3D asCPose3D() const { return mrpt::poses::CPose3D(m_ROT,m_coords); }
+
+		inline double x() const { return m_coords[0]; }
+		inline double y() const { return m_coords[1]; }
+		inline double z() const { return m_coords[2]; }
+		inline void x(const double v) { m_coords[0]=v; }
+		inline void y(const double v) { m_coords[1]=v; }
+		inline void z(const double v) { m_coords[2]=v; }
+
+		inline const mrpt::math::CMatrixDouble33 & getRotationMatrix() const { return m_ROT; }
+		inline void getRotationMatrix(mrpt::math::CMatrixDouble33 &R) const { R = m_ROT; }
+		inline void setRotationMatrix(const mrpt::math::CMatrixDouble33 &R) { m_ROT = R; }
+
+		inline void getHomogeneousMatrix(mrpt::math::CMatrixDouble44 &HM) const
+		{
+			HM.block<3,3>(0,0) = m_ROT;
+			for (int i=0;i<3;i++) HM(i,3)=m_coords[i];
+			HM(3,0)=HM(3,1)=HM(3,2)=0.; HM(3,3)=1.;
+		}
+		inline mrpt::math::CMatrixDouble44 getHomogeneousMatrixVal() const { mrpt::math::CMatrixDouble44 HM(mrpt::math::UNINITIALIZED_MATRIX); getHomogeneousMatrix(HM); return HM; }
+
+		/** this = A (+) B. Safe to call with "this" being A and/or B. */
+		inline void composeFrom(const TPose3DRotMat &A, const TPose3DRotMat &B)
+		{
+			const Eigen::Matrix<double,3,1> t = A.m_ROT*B.m_coords + A.m_coords;
+			const Eigen::Matrix<double,3,3> R = A.m_ROT*B.m_ROT;
+			m_ROT = R; m_coords = t;
+		}
+		/** this = A (-) B, i.e. A as seen from B. Safe to call with "this" being A and/or B. */
+		inline void inverseComposeFrom(const TPose3DRotMat &A, const TPose3DRotMat &B)
+		{
+			const Eigen::Matrix<double,3,1> t = B.m_ROT.transpose()*(A.m_coords - B.m_coords);
+			const Eigen::Matrix<double,3,3> R = B.m_ROT.transpose()*A.m_ROT;
+			m_ROT = R; m_coords = t;
+		}
+		/** Inverts this transformation, in place. */
+		inline void inverse()
+		{
+			m_ROT.transposeInPlace();
+			const Eigen::Matrix<double,3,1> t = -(m_ROT*m_coords);
+			m_coords = t;
+		}
+
+		inline TPose3DRotMat operator +(const TPose3DRotMat &b) const { TPose3DRotMat r(mrpt::poses::UNINITIALIZED_POSE); r.composeFrom(*this,b); return r; }
+		inline TPose3DRotMat operator -(const TPose3DRotMat &b) const { TPose3DRotMat r(mrpt::poses::UNINITIALIZED_POSE); r.inverseComposeFrom(*this,b); return r; }
+		/** Unary "-": the inverse transformation */
+		inline TPose3DRotMat operator -() const
+		{
+			TPose3DRotMat r(mrpt::poses::UNINITIALIZED_POSE);
+			r.m_ROT = m_ROT.transpose();
+			r.m_coords = -(r.m_ROT*m_coords);
+			return r;
+		}
+
+		/** (gx,gy,gz) = this (+) (lx,ly,lz). Input and output may be the same variables. */
+		inline void composePoint(const double lx,const double ly,const double lz, double &gx, double &gy, double &gz) const
+		{
+			const double rx = m_ROT.coeff(0,0)*lx + m_ROT.coeff(0,1)*ly + m_ROT.coeff(0,2)*lz + m_coords[0];
+			const double ry = m_ROT.coeff(1,0)*lx + m_ROT.coeff(1,1)*ly + m_ROT.coeff(1,2)*lz + m_coords[1];
+			const double rz = m_ROT.coeff(2,0)*lx + m_ROT.coeff(2,1)*ly + m_ROT.coeff(2,2)*lz + m_coords[2];
+			gx=rx; gy=ry; gz=rz;
+		}
+		inline void composePoint(const mrpt::math::TPoint3D &l, mrpt::math::TPoint3D &g) const { composePoint(l.x,l.y,l.z, g.x,g.y,g.z); }
+		/** (lx,ly,lz) = (gx,gy,gz) (-) this. Input and output may be the same variables. */
+		inline void inverseComposePoint(const double gx,const double gy,const double gz, double &lx, double &ly, double &lz) const
+		{
+			const double dx = gx-m_coords[0], dy = gy-m_coords[1], dz = gz-m_coords[2];
+			lx = m_ROT.coeff(0,0)*dx + m_ROT.coeff(1,0)*dy + m_ROT.coeff(2,0)*dz;
+			ly = m_ROT.coeff(0,1)*dx + m_ROT.coeff(1,1)*dy + m_ROT.coeff(2,1)*dz;
+			lz = m_ROT.coeff(0,2)*dx + m_ROT.coeff(1,2)*dy + m_ROT.coeff(2,2)*dz;
+		}
+		inline void inverseComposePoint(const mrpt::math::TPoint3D &g, mrpt::math::TPoint3D &l) const { inverseComposePoint(g.x,g.y,g.z, l.x,l.y,l.z); }
+
+		inline void setToNaN() { m_ROT.fill(std::numeric_limits<double>::quiet_NaN()); m_coords.fill(std::numeric_limits<double>::quiet_NaN()); }
+	};
+
+	inline std::ostream & operator <<(std::ostream &o, const TPose3DRotMat &p) { return o << p.asCPose3D(); }
+
+	/** SE(3) relative poses stored as a TPose3DRotMat instead of a CPose3D: same parameterization, Jacobians and manifold
+	  * updates than SE3, with cheaper compositions and inversions in the spanning-tree updates. */
+	struct SE3_fast
+	{
+		static const size_t REL_POSE_DIMS = 6;  //!< Each relative pose is parameterized as a TPose3DRotMat
+		typedef TPose3DRotMat  pose_t;  //!< The pose class
+		typedef mrpt::graphs::CNetworkOfPoses3D global_graph_t; //!< Pose graph type for global optimizations (TPose3DRotMat converts to CPose3D)
+
+		/** The SE(3) traits struct, with the pseudo-exponential map generating TPose3DRotMat poses */
+		struct se_traits_t : public mrpt::poses::SE_traits<3>
+		{
+			using mrpt::poses::SE_traits<3>::pseudo_exp;
+			/** Same map than SE_traits<3>::pseudo_exp(), so it remains consistent with the SE3 Jacobians */
+			static inline void pseudo_exp(const array_t &x, TPose3DRotMat &P)
+			{
+				mrpt::poses::CPose3D p(mrpt::poses::UNINITIALIZED_POSE);
+				mrpt::poses::SE_traits<3>::pseudo_exp(x,p);
+				P = TPose3DRotMat(p);
+			}
+		};
 	};
 
 	struct SE2
@@ -35,6 +164,7 @@ namespace kf2kf_poses
 		static const size_t REL_POSE_DIMS = 3;  //!< Each relative pose is parameterized as a CPose3D()
 		typedef mrpt::poses::CPose2D   pose_t;  //!< The pose class
 		typedef mrpt::poses::SE_traits<2>  se_traits_t;  //!< The SE(2) traits struct (for Lie algebra log/exp maps, etc.)
+		typedef mrpt::graphs::CNetworkOfPoses2D global_graph_t; //!< Pose graph type for global optimizations
 	};
 
 	/** @} */
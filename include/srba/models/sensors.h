@@ -12,6 +12,23 @@
 #include <mrpt/poses/CPose3DQuat.h>
 
 namespace srba {
+	namespace internal
+	{
+		/** out_obs_err = z_obs - h(xji_l), for a landmark xji_l already relative to the sensor. Shared by observe_error() and
+		  * observe_error_and_jacob() of all sensor models with eval_observation<>(), so both evaluate the very same h(x'). */
+		template <class SENSOR_MODEL>
+		inline void observe_error_local(
+			typename observation_traits<typename SENSOR_MODEL::OBS_T>::array_obs_t       & out_obs_err,
+			const typename observation_traits<typename SENSOR_MODEL::OBS_T>::array_obs_t & z_obs,
+			const typename SENSOR_MODEL::array_landmark_t                               & xji_l,
+			const typename SENSOR_MODEL::TObservationParams                             & params)
+		{
+			typename observation_traits<typename SENSOR_MODEL::OBS_T>::array_obs_t  pred_obs;  // prediction
+			SENSOR_MODEL::template eval_observation<double>(&pred_obs[0],&xji_l[0],params);
+			out_obs_err = z_obs - pred_obs;
+		}
+	}
+
 	/** \defgroup mrpt_srba_models Sensor models: one for each combination of {landmark_parameterization,observation_type}
 	  * \ingroup mrpt_srba_grp */
 
@@ -54,15 +71,20 @@ namespace srba {
 			const landmark_traits<LANDMARK_T>::array_landmark_t & lm_pos,
 			const OBS_T::TObservationParams                     & params)
 		{
-			double x,y,z; // wrt cam (local coords)
-			base_pose_wrt_observer.composePoint(lm_pos[0],lm_pos[1],lm_pos[2], x,y,z);
-			ASSERT_(z!=0)
+			array_landmark_t l; // wrt cam (local coords)
+			base_pose_wrt_observer.composePoint(lm_pos[0],lm_pos[1],lm_pos[2], l[0],l[1],l[2]);
+			ASSERT_(l[2]!=0)
+			internal::observe_error_local<sensor_model>(out_obs_err,z_obs,l,params);
+		}
 
+		/** Observation model h(x') for a landmark at x'=xji_l, relative to the sensor (see sensor_model). Also used by observe_error(). */
+		template <typename T>
+		static bool eval_observation(T h[OBS_DIMS], const T xji_l[LM_DIMS], const TObservationParams & params)
+		{
 			// Pinhole model:
-			observation_traits<OBS_T>::array_obs_t  pred_obs;  // prediction
-			pred_obs[0] = params.camera_calib.cx() + params.camera_calib.fx() * x/z;
-			pred_obs[1] = params.camera_calib.cy() + params.camera_calib.fy() * y/z;
-			out_obs_err = z_obs - pred_obs;
+			h[0] = params.camera_calib.cx() + params.camera_calib.fx() * xji_l[0]/xji_l[2];
+			h[1] = params.camera_calib.cy() + params.camera_calib.fy() * xji_l[1]/xji_l[2];
+			return xji_l[2]>0; // Ill-defined if the point is behind us
 		}
 
 		/** Evaluates the partial Jacobian dh_dx:
@@ -109,6 +131,23 @@ namespace srba {
 			return true;
 		}
 
+		/** Fused observe_error() + eval_jacob_dh_dx() (see sensor_model) */
+		template <class POSE_T>
+		static bool observe_error_and_jacob(
+			observation_traits<OBS_T>::array_obs_t              & out_obs_err, 
+			TJacobian_dh_dx                                     & dh_dx,
+			const observation_traits<OBS_T>::array_obs_t        & z_obs, 
+			const POSE_T                                        & base_pose_wrt_observer,
+			const landmark_traits<LANDMARK_T>::array_landmark_t & lm_pos,
+			const OBS_T::TObservationParams                     & params)
+		{
+			array_landmark_t l; // wrt cam (local coords)
+			base_pose_wrt_observer.composePoint(lm_pos[0],lm_pos[1],lm_pos[2], l[0],l[1],l[2]);
+			ASSERT_(l[2]!=0)
+			internal::observe_error_local<sensor_model>(out_obs_err,z_obs,l,params);
+			return eval_jacob_dh_dx(dh_dx,l,params);
+		}
+
 		/** Inverse observation model for first-seen landmarks. Needed to avoid having landmarks at (0,0,0) which 
 		  *  leads to undefined Jacobians. This is invoked only when both "unknown_relative_position_init_val" and "is_fixed" are "false" 
 		  *  in an observation. 
@@ -179,35 +218,35 @@ namespace srba {
 			const landmark_traits<LANDMARK_T>::array_landmark_t & lm_pos,
 			const OBS_T::TObservationParams                     & params)
 		{
-			double lx,ly,lz; // wrt cam (local coords)
-			base_pose_wrt_observer.composePoint(lm_pos[0],lm_pos[1],lm_pos[2], lx,ly,lz);
-			ASSERT_(lz!=0)
+			array_landmark_t l; // wrt cam (local coords)
+			base_pose_wrt_observer.composePoint(lm_pos[0],lm_pos[1],lm_pos[2], l[0],l[1],l[2]);
+			ASSERT_(l[2]!=0)
+			internal::observe_error_local<sensor_model>(out_obs_err,z_obs,l,params);
+		}
 
-			observation_traits<OBS_T>::array_obs_t  pred_obs;  // prediction
+		/** Observation model h(x') for a landmark at x'=xji_l, relative to the sensor (see sensor_model). Also used by observe_error(). */
+		template <typename T>
+		static bool eval_observation(T h[OBS_DIMS], const T xji_l[LM_DIMS], const TObservationParams & params)
+		{
 			// Pinhole model: Left camera.
 			const mrpt::utils::TCamera &lc = params.camera_calib.leftCamera;
-			pred_obs[0] = lc.cx() + lc.fx() * lx/lz;
-			pred_obs[1] = lc.cy() + lc.fy() * ly/lz;
+			h[0] = lc.cx() + lc.fx() * xji_l[0]/xji_l[2];
+			h[1] = lc.cy() + lc.fy() * xji_l[1]/xji_l[2];
 
-			// Project point relative to right-camera:
+			// Project point relative to right-camera: xji_l_right = R2L (+) xji_l
 			const mrpt::poses::CPose3DQuat R2L = -params.camera_calib.rightCameraPose; // R2L = (-) Left-to-right_camera_pose
-			
-			// base_wrt_right_cam = ( (-)L2R ) (+) L2Base
-			//mrpt::poses::CPose3DQuat base_wrt_right_cam(mrpt::poses::UNINITIALIZED_POSE);
-			//base_wrt_right_cam.composeFrom(R2L,mrpt::poses::CPose3DQuat(base_pose_wrt_observer));
-			
-			double rx,ry,rz; // wrt cam (local coords)
-			//base_wrt_right_cam.composePoint(lx,ly,lz, rx,ry,rz);
-
-			// xji_l_right = R2L (+) Xji_l
-			R2L.composePoint(lx,ly,lz, rx,ry,rz);
-			ASSERT_(rz!=0)
+			mrpt::math::CMatrixDouble33 R;
+			R2L.getRotationMatrix(R);
+			const double t[3] = { R2L.x(), R2L.y(), R2L.z() };
+			T xr[3];
+			for (int i=0;i<3;i++)
+				xr[i] = R(i,0)*xji_l[0] + R(i,1)*xji_l[1] + R(i,2)*xji_l[2] + t[i];
 
 			// Pinhole model: Right camera.
 			const mrpt::utils::TCamera &rc = params.camera_calib.rightCamera;
-			pred_obs[2] = rc.cx() + rc.fx() * rx/rz;
-			pred_obs[3] = rc.cy() + rc.fy() * ry/rz;
-			out_obs_err = z_obs - pred_obs;
+			h[2] = rc.cx() + rc.fx() * xr[0]/xr[2];
+			h[3] = rc.cy() + rc.fy() * xr[1]/xr[2];
+			return xji_l[2]>0 && xr[2]>0; // Ill-defined if the point is behind any of the cameras
 		}
 
 		/** Evaluates the partial Jacobian dh_dx:
@@ -353,14 +392,18 @@ namespace srba {
 			const landmark_traits<LANDMARK_T>::array_landmark_t & lm_pos,
 			const OBS_T::TObservationParams                     & params)
 		{
-			MRPT_UNUSED_PARAM(params);
-			double x,y,z; // wrt cam (local coords)
-			base_pose_wrt_observer.composePoint(lm_pos[0],lm_pos[1],lm_pos[2], x,y,z);
+			array_landmark_t l; // wrt cam (local coords)
+			base_pose_wrt_observer.composePoint(lm_pos[0],lm_pos[1],lm_pos[2], l[0],l[1],l[2]);
+			internal::observe_error_local<sensor_model>(out_obs_err,z_obs,l,params);
+		}
 
-			observation_traits<OBS_T>::array_obs_t  pred_obs;  // prediction
-			// Observations are simply the "local coords":
-			pred_obs[0] = x; pred_obs[1] = y; pred_obs[2] = z;
-			out_obs_err = z_obs - pred_obs;
+		/** Observation model h(x') for a landmark at x'=xji_l, relative to the sensor (see sensor_model). Also used by observe_error(). */
+		template <typename T>
+		static bool eval_observation(T h[OBS_DIMS], const T xji_l[LM_DIMS], const TObservationParams & params)
+		{
+			MRPT_UNUSED_PARAM(params);
+			h[0] = xji_l[0]; h[1] = xji_l[1]; h[2] = xji_l[2];
+			return true;
 		}
 
 		/** Evaluates the partial Jacobian dh_dx:
@@ -392,6 +435,22 @@ namespace srba {
 			return true;
 		}
 
+		/** Fused observe_error() + eval_jacob_dh_dx() (see sensor_model) */
+		template <class POSE_T>
+		static bool observe_error_and_jacob(
+			observation_traits<OBS_T>::array_obs_t              & out_obs_err, 
+			TJacobian_dh_dx                                     & dh_dx,
+			const observation_traits<OBS_T>::array_obs_t        & z_obs, 
+			const POSE_T                                        & base_pose_wrt_observer,
+			const landmark_traits<LANDMARK_T>::array_landmark_t & lm_pos,
+			const OBS_T::TObservationParams                     & params)
+		{
+			array_landmark_t l; // wrt cam (local coords)
+			base_pose_wrt_observer.composePoint(lm_pos[0],lm_pos[1],lm_pos[2], l[0],l[1],l[2]);
+			internal::observe_error_local<sensor_model>(out_obs_err,z_obs,l,params);
+			return eval_jacob_dh_dx(dh_dx,l,params);
+		}
+
 		/** Inverse observation model for first-seen landmarks. Needed to avoid having landmarks at (0,0,0) which 
 		  *  leads to undefined Jacobians. This is invoked only when both "unknown_relative_position_init_val" and "is_fixed" are "false" 
 		  *  in an observation. 
@@ -451,13 +510,18 @@ namespace srba {
 			const landmark_traits<LANDMARK_T>::array_landmark_t & lm_pos,
 			const OBS_T::TObservationParams                     & params)
 		{
-			double x,y; // wrt cam (local coords)
-			base_pose_wrt_observer.composePoint(lm_pos[0],lm_pos[1], x,y);
+			array_landmark_t l; // wrt cam (local coords)
+			base_pose_wrt_observer.composePoint(lm_pos[0],lm_pos[1], l[0],l[1]);
+			internal::observe_error_local<sensor_model>(out_obs_err,z_obs,l,params);
+		}
 
-			observation_traits<OBS_T>::array_obs_t  pred_obs;  // prediction
-			// Observations are simply the "local coords":
-			pred_obs[0] = x; pred_obs[1] = y;
-			out_obs_err = z_obs - pred_obs;
+		/** Observation model h(x') for a landmark at x'=xji_l, relative to the sensor (see sensor_model). Also used by observe_error(). */
+		template <typename T>
+		static bool eval_observation(T h[OBS_DIMS], const T xji_l[LM_DIMS], const TObservationParams & params)
+		{
+			MRPT_UNUSED_PARAM(params);
+			h[0] = xji_l[0]; h[1] = xji_l[1];
+			return true;
 		}
 
 		/** Evaluates the partial Jacobian dh_dx:
@@ -489,6 +553,22 @@ namespace srba {
 			return true;
 		}
 
+		/** Fused observe_error() + eval_jacob_dh_dx() (see sensor_model) */
+		template <class POSE_T>
+		static bool observe_error_and_jacob(
+			observation_traits<OBS_T>::array_obs_t              & out_obs_err, 
+			TJacobian_dh_dx                                     & dh_dx,
+			const observation_traits<OBS_T>::array_obs_t        & z_obs, 
+			const POSE_T                                        & base_pose_wrt_observer,
+			const landmark_traits<LANDMARK_T>::array_landmark_t & lm_pos,
+			const OBS_T::TObservationParams                     & params)
+		{
+			array_landmark_t l; // wrt cam (local coords)
+			base_pose_wrt_observer.composePoint(lm_pos[0],lm_pos[1], l[0],l[1]);
+			internal::observe_error_local<sensor_model>(out_obs_err,z_obs,l,params);
+			return eval_jacob_dh_dx(dh_dx,l,params);
+		}
+
 		/** Inverse observation model for first-seen landmarks. Needed to avoid having landmarks at (0,0,0) which 
 		  *  leads to undefined Jacobians. This is invoked only when both "unknown_relative_position_init_val" and "is_fixed" are "false" 
 		  *  in an observation. 
@@ -547,21 +627,23 @@ namespace srba {
 			const landmark_traits<LANDMARK_T>::array_landmark_t & lm_pos,
 			const OBS_T::TObservationParams                     & params)
 		{
-			mrpt::math::TPoint3D  l; // wrt sensor (local coords)
-			base_pose_wrt_observer.composePoint(lm_pos[0],lm_pos[1],lm_pos[2], l.x,l.y,l.z);
-			
-			static const mrpt::poses::CPose3D origin;
-			double range,yaw,pitch;
-			origin.sphericalCoordinates(
-				l,  // In: point
-				range,yaw,pitch // Out: spherical coords							
-				);
+			array_landmark_t l; // wrt sensor (local coords)
+			base_pose_wrt_observer.composePoint(lm_pos[0],lm_pos[1],lm_pos[2], l[0],l[1],l[2]);
+			internal::observe_error_local<sensor_model>(out_obs_err,z_obs,l,params);
+		}
 
-			observation_traits<OBS_T>::array_obs_t  pred_obs;  // prediction
-			pred_obs[0] = range;
-			pred_obs[1] = yaw;
-			pred_obs[2] = pitch;
-			out_obs_err = z_obs - pred_obs;
+		/** Observation model h(x') for a landmark at x'=xji_l, relative to the sensor (see sensor_model). Also used by observe_error(). */
+		template <typename T>
+		static bool eval_observation(T h[OBS_DIMS], const T xji_l[LM_DIMS], const TObservationParams & params)
+		{
+			MRPT_UNUSED_PARAM(params);
+			using std::sqrt; using std::atan2;
+			const T rho2 = xji_l[0]*xji_l[0] + xji_l[1]*xji_l[1];
+			// Same convention than mrpt::poses::CPose3D::sphericalCoordinates():
+			h[0] = sqrt(rho2 + xji_l[2]*xji_l[2]); // range
+			h[1] = atan2(xji_l[1],xji_l[0]);       // yaw
+			h[2] = -atan2(xji_l[2],sqrt(rho2));    // pitch
+			return rho2!=0; // Bearing not differentiable along the Z axis
 		}
 
 		/** Evaluates the partial Jacobian dh_dx:
@@ -603,6 +685,22 @@ namespace srba {
 			return true;
 		}
 
+		/** Fused observe_error() + eval_jacob_dh_dx() (see sensor_model) */
+		template <class POSE_T>
+		static bool observe_error_and_jacob(
+			observation_traits<OBS_T>::array_obs_t              & out_obs_err, 
+			TJacobian_dh_dx                                     & dh_dx,
+			const observation_traits<OBS_T>::array_obs_t        & z_obs, 
+			const POSE_T                                        & base_pose_wrt_observer,
+			const landmark_traits<LANDMARK_T>::array_landmark_t & lm_pos,
+			const OBS_T::TObservationParams                     & params)
+		{
+			array_landmark_t l; // wrt sensor (local coords)
+			base_pose_wrt_observer.composePoint(lm_pos[0],lm_pos[1],lm_pos[2], l[0],l[1],l[2]);
+			internal::observe_error_local<sensor_model>(out_obs_err,z_obs,l,params);
+			return eval_jacob_dh_dx(dh_dx,l,params);
+		}
+
 		/** Inverse observation model for first-seen landmarks. Needed to avoid having landmarks at (0,0,0) which 
 		  *  leads to undefined Jacobians. This is invoked only when both "unknown_relative_position_init_val" and "is_fixed" are "false" 
 		  *  in an observation. 
@@ -665,17 +763,21 @@ namespace srba {
 			const landmark_traits<LANDMARK_T>::array_landmark_t & lm_pos,
 			const OBS_T::TObservationParams                     & params)
 		{
-			MRPT_UNUSED_PARAM(params);
-			mrpt::math::TPoint2D  l; // wrt sensor (local coords)
-			base_pose_wrt_observer.composePoint(lm_pos[0],lm_pos[1], l.x,l.y);
-			
-			const double range = hypot(l.x,l.y);
-			const double yaw   = atan2(l.y,l.x);
+			array_landmark_t l; // wrt sensor (local coords)
+			base_pose_wrt_observer.composePoint(lm_pos[0],lm_pos[1], l[0],l[1]);
+			internal::observe_error_local<sensor_model>(out_obs_err,z_obs,l,params);
+		}
 
-			observation_traits<OBS_T>::array_obs_t  pred_obs;  // prediction
-			pred_obs[0] = range;
-			pred_obs[1] = yaw;
-			out_obs_err = z_obs - pred_obs;
+		/** Observation model h(x') for a landmark at x'=xji_l, relative to the sensor (see sensor_model). Also used by observe_error(). */
+		template <typename T>
+		static bool eval_observation(T h[OBS_DIMS], const T xji_l[LM_DIMS], const TObservationParams & params)
+		{
+			MRPT_UNUSED_PARAM(params);
+			using std::sqrt; using std::atan2;
+			const T r2 = xji_l[0]*xji_l[0] + xji_l[1]*xji_l[1];
+			h[0] = sqrt(r2);                   // range
+			h[1] = atan2(xji_l[1],xji_l[0]);   // yaw
+			return r2!=0; // Bearing not differentiable at the origin
 		}
 
 		/** Evaluates the partial Jacobian dh_dx:
@@ -714,6 +816,22 @@ namespace srba {
 			return true;
 		}
 
+		/** Fused observe_error() + eval_jacob_dh_dx() (see sensor_model) */
+		template <class POSE_T>
+		static bool observe_error_and_jacob(
+			observation_traits<OBS_T>::array_obs_t              & out_obs_err, 
+			TJacobian_dh_dx                                     & dh_dx,
+			const observation_traits<OBS_T>::array_obs_t        & z_obs, 
+			const POSE_T                                        & base_pose_wrt_observer,
+			const landmark_traits<LANDMARK_T>::array_landmark_t & lm_pos,
+			const OBS_T::TObservationParams                     & params)
+		{
+			array_landmark_t l; // wrt sensor (local coords)
+			base_pose_wrt_observer.composePoint(lm_pos[0],lm_pos[1], l[0],l[1]);
+			internal::observe_error_local<sensor_model>(out_obs_err,z_obs,l,params);
+			return eval_jacob_dh_dx(dh_dx,l,params);
+		}
+
 		/** Inverse observation model for first-seen landmarks. Needed to avoid having landmarks at (0,0,0) which 
 		  *  leads to undefined Jacobians. This is invoked only when both "unknown_relative_position_init_val" and "is_fixed" are "false" 
 		  *  in an observation. 
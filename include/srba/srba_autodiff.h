@@ -0,0 +1,138 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#pragma once
+
+#include <cmath>
+#include <Eigen/Dense>
+
+namespace srba {
+namespace autodiff
+{
+	/** \defgroup mrpt_srba_autodiff Forward-mode automatic differentiation of sensor models
+		* Exact Jacobians dh_dx for sensor models which do not (yet) implement an analytic \a eval_jacob_dh_dx(), e.g. while
+		* prototyping a new sensor_model<>. The sensor model must provide the observation function h(x'), templated on the scalar type:
+		* \code
+		*   template <typename T>
+		*   static bool eval_observation(T h[OBS_DIMS], const T xji_l[LM_DIMS], const TObservationParams & params);
+		* \endcode
+		* which must return false if dh_dx is ill-defined at xji_l (e.g. point behind a camera).
+		* Use "using std::sqrt;" (etc.) plus unqualified calls to math functions within it, so the overloads for dual<> are found.
+		*
+		* Then, either implement eval_jacob_dh_dx() by calling autodiff::eval_jacob_dh_dx<>(), or define SRBA_USE_AUTODIFF_JACOBIANS=1
+		* before including SRBA to use automatic differentiation for all sensor models (much faster and more accurate than SRBA_USE_NUMERIC_JACOBIANS).
+		* Sensor models without eval_observation<T>() (the relative pose models, whose dh_dx is just the identity) keep using their
+		* analytic eval_jacob_dh_dx() in that case (see internal::has_eval_observation).
+		* \ingroup mrpt_srba_grp */
+
+	/** A dual number with a fixed number N of infinitesimal parts: a + \sum_i v_i \epsilon_i.
+	  * \ingroup mrpt_srba_autodiff */
+	template <size_t N>
+	struct dual
+	{
+		typedef Eigen::Matrix<double,N,1,Eigen::DontAlign> deriv_t;
+
+		double  a; //!< Value
+		deriv_t v; //!< Partial derivatives wrt each of the N independent variables
+
+		inline dual() { }
+		/** Constant (implicit conversion from double) */
+		inline dual(const double val) : a(val) { v.setZero(); }
+		/** The k'th independent variable, with value "val" */
+		inline dual(const double val, const size_t k) : a(val) { v.setZero(); v[k]=1.0; }
+		inline dual(const double val, const deriv_t &deriv) : a(val), v(deriv) { }
+
+		inline dual & operator +=(const dual &o) { a+=o.a; v+=o.v; return *this; }
+		inline dual & operator -=(const dual &o) { a-=o.a; v-=o.v; return *this; }
+		inline dual & operator *=(const dual &o) { v = v*o.a + o.v*a; a*=o.a; return *this; }
+		inline dual & operator /=(const dual &o) { const double inv = 1.0/o.a; v = (v - o.v*(a*inv))*inv; a*=inv; return *this; }
+	};
+
+	template <size_t N> inline dual<N> operator -(const dual<N> &f) { return dual<N>(-f.a,-f.v); }
+	template <size_t N> inline dual<N> operator +(const dual<N> &f) { return f; }
+
+	template <size_t N> inline dual<N> operator +(const dual<N> &f, const dual<N> &g) { return dual<N>(f.a+g.a, f.v+g.v); }
+	template <size_t N> inline dual<N> operator +(const dual<N> &f, const double s)   { return dual<N>(f.a+s, f.v); }
+	template <size_t N> inline dual<N> operator +(const double s, const dual<N> &f)   { return dual<N>(f.a+s, f.v); }
+
+	template <size_t N> inline dual<N> operator -(const dual<N> &f, const dual<N> &g) { return dual<N>(f.a-g.a, f.v-g.v); }
+	template <size_t N> inline dual<N> operator -(const dual<N> &f, const double s)   { return dual<N>(f.a-s, f.v); }
+	template <size_t N> inline dual<N> operator -(const double s, const dual<N> &f)   { return dual<N>(s-f.a, -f.v); }
+
+	template <size_t N> inline dual<N> operator *(const dual<N> &f, const dual<N> &g) { return dual<N>(f.a*g.a, f.v*g.a + g.v*f.a); }
+	template <size_t N> inline dual<N> operator *(const dual<N> &f, const double s)   { return dual<N>(f.a*s, f.v*s); }
+	template <size_t N> inline dual<N> operator *(const double s, const dual<N> &f)   { return dual<N>(f.a*s, f.v*s); }
+
+	template <size_t N> inline dual<N> operator /(const dual<N> &f, const dual<N> &g) { const double inv = 1.0/g.a; const double q = f.a*inv; return dual<N>(q, (f.v - g.v*q)*inv); }
+	template <size_t N> inline dual<N> operator /(const dual<N> &f, const double s)   { const double inv = 1.0/s; return dual<N>(f.a*inv, f.v*inv); }
+	template <size_t N> inline dual<N> operator /(const double s, const dual<N> &f)   { const double inv = 1.0/f.a; const double q = s*inv; return dual<N>(q, f.v*(-q*inv)); }
+
+	// Comparisons only look at the value part:
+	template <size_t N> inline bool operator < (const dual<N> &f, const dual<N> &g) { return f.a< g.a; }
+	template <size_t N> inline bool operator <=(const dual<N> &f, const dual<N> &g) { return f.a<=g.a; }
+	template <size_t N> inline bool operator > (const dual<N> &f, const dual<N> &g) { return f.a> g.a; }
+	template <size_t N> inline bool operator >=(const dual<N> &f, const dual<N> &g) { return f.a>=g.a; }
+	template <size_t N> inline bool operator ==(const dual<N> &f, const dual<N> &g) { return f.a==g.a; }
+	template <size_t N> inline bool operator !=(const dual<N> &f, const dual<N> &g) { return f.a!=g.a; }
+	template <size_t N> inline bool operator < (const dual<N> &f, const double s) { return f.a< s; }
+	template <size_t N> inline bool operator <=(const dual<N> &f, const double s) { return f.a<=s; }
+	template <size_t N> inline bool operator > (const dual<N> &f, const double s) { return f.a> s; }
+	template <size_t N> inline bool operator >=(const dual<N> &f, const double s) { return f.a>=s; }
+	template <size_t N> inline bool operator ==(const dual<N> &f, const double s) { return f.a==s; }
+	template <size_t N> inline bool operator !=(const dual<N> &f, const double s) { return f.a!=s; }
+
+	// Elementary functions (chain rule on the infinitesimal part):
+	template <size_t N> inline dual<N> sqrt(const dual<N> &f) { const double s = std::sqrt(f.a); return dual<N>(s, f.v*(0.5/s)); }
+	template <size_t N> inline dual<N> exp (const dual<N> &f) { const double e = std::exp(f.a);  return dual<N>(e, f.v*e); }
+	template <size_t N> inline dual<N> log (const dual<N> &f) { return dual<N>(std::log(f.a), f.v*(1.0/f.a)); }
+	template <size_t N> inline dual<N> sin (const dual<N> &f) { return dual<N>(std::sin(f.a), f.v*std::cos(f.a)); }
+	template <size_t N> inline dual<N> cos (const dual<N> &f) { return dual<N>(std::cos(f.a), f.v*(-std::sin(f.a))); }
+	template <size_t N> inline dual<N> tan (const dual<N> &f) { const double t = std::tan(f.a); return dual<N>(t, f.v*(1.0+t*t)); }
+	template <size_t N> inline dual<N> asin(const dual<N> &f) { return dual<N>(std::asin(f.a), f.v*(1.0/std::sqrt(1.0-f.a*f.a))); }
+	template <size_t N> inline dual<N> acos(const dual<N> &f) { return dual<N>(std::acos(f.a), f.v*(-1.0/std::sqrt(1.0-f.a*f.a))); }
+	template <size_t N> inline dual<N> atan(const dual<N> &f) { return dual<N>(std::atan(f.a), f.v*(1.0/(1.0+f.a*f.a))); }
+	template <size_t N> inline dual<N> abs (const dual<N> &f) { return f.a<0 ? -f : f; }
+	template <size_t N> inline dual<N> fabs(const dual<N> &f) { return f.a<0 ? -f : f; }
+	template <size_t N> inline dual<N> atan2(const dual<N> &y, const dual<N> &x)
+	{
+		const double den = 1.0/(x.a*x.a+y.a*y.a);
+		return dual<N>(std::atan2(y.a,x.a), (y.v*x.a - x.v*y.a)*den);
+	}
+	template <size_t N> inline dual<N> hypot(const dual<N> &x, const dual<N> &y)
+	{
+		const double h = std::sqrt(x.a*x.a+y.a*y.a);
+		return dual<N>(h, (x.v*x.a + y.v*y.a)*(1.0/h));
+	}
+
+	/** Evaluates the Jacobian dh_dx of a sensor model at xji_l by forward-mode automatic differentiation of its
+	  * templated \a eval_observation<T>() (see \ref mrpt_srba_autodiff). Returns false if the observation is ill-defined.
+	  * \ingroup mrpt_srba_autodiff */
+	template <class SENSOR_MODEL>
+	bool eval_jacob_dh_dx(
+		typename SENSOR_MODEL::TJacobian_dh_dx          & dh_dx,
+		const typename SENSOR_MODEL::array_landmark_t   & xji_l,
+		const typename SENSOR_MODEL::TObservationParams & sensor_params)
+	{
+		static const size_t OBS_DIMS = SENSOR_MODEL::OBS_DIMS;
+		static const size_t LM_DIMS  = SENSOR_MODEL::LM_DIMS;
+		typedef dual<LM_DIMS> dual_t;
+
+		dual_t x[LM_DIMS], h[OBS_DIMS];
+		for (size_t i=0;i<LM_DIMS;i++)
+			x[i] = dual_t(xji_l[i],i);
+
+		if (!SENSOR_MODEL::template eval_observation<dual_t>(h,x,sensor_params))
+			return false;
+
+		for (size_t i=0;i<OBS_DIMS;i++)
+			dh_dx.row(i) = h[i].v.transpose();
+		return true;
+	}
+
+} } // End of namespaces
@@ -9,7 +9,10 @@
 
 #pragma once
 
-/** \defgroup mrpt_srba_ecps Edge creation policies */
+/** \defgroup mrpt_srba_ecps Edge creation policies
+  * Besides `eval()`, each policy must provide `get_center_kf_for_kf()`, which defines the areas used by the coarse layer of the
+  * optimization (see RbaEngine::get_coarse_graph()). */
 
 #include "ecps/local_areas_fixed_size.h"
+#include "ecps/local_areas_adaptive.h"
 #include "ecps/classic_linear_rba.h"
@@ -15,3 +15,4 @@
 #include "srba_options_noise.h"
 #include "srba_options_sensor_pose.h"
 #include "srba_options_solver.h"
+#include "srba_options_robust_kernel.h"
@@ -24,6 +24,8 @@ namespace options
 		  * \ingroup mrpt_srba_options_noise */
 		struct observation_noise_identity
 		{
+			static const bool PREWHITEN_JACOBIANS = false; //!< Never needed here: \Lambda is a scalar, applied once in scale_H()
+
 			/** Observation noise parameters to be filled by the user in srba.parameters.obs_noise */
 			struct parameters_t
 			{
@@ -40,11 +42,53 @@ namespace options
 				// None: all obs. have the same value="std_noise_observations" 
 			};
 
+			/** Data needed by whiten(), computed once from the parameters by get_whitening_data() */
+			struct whitening_data_t
+			{
+				// None
+			};
+
+			/** Fills in the data needed by whiten(). Must be called before (possibly parallel) loops over observations, not inside them. */
+			inline static void get_whitening_data(const parameters_t & obs_noise_params, whitening_data_t & wd)
+			{
+				MRPT_UNUSED_PARAM(obs_noise_params); MRPT_UNUSED_PARAM(wd);
+			}
+
+			/** Pre-whitening of one Jacobian block or residual (only called if PREWHITEN_JACOBIANS=true) */
+			template <class MATRIX>
+			inline static void whiten(MATRIX & M, const whitening_data_t & wd, const noise_data_per_obs_t & noise_data)
+			{
+				MRPT_UNUSED_PARAM(M); MRPT_UNUSED_PARAM(wd); MRPT_UNUSED_PARAM(noise_data);
+			}
+
+			/** Initializes the per-observation data from the information matrix given by the user in new_kf_observation_t::obs_information (ignored here) */
+			template <class MATRIX>
+			inline static void init_noise_data_per_obs(noise_data_per_obs_t & noise_data, const MATRIX & obs_information)
+			{
+				MRPT_UNUSED_PARAM(noise_data); MRPT_UNUSED_PARAM(obs_information);
+			}
+
+			/** Returns the squared Mahalanobis distance of one residual (used for chi-square outlier gating) */
+			template <class VECTOR_R>
+			inline static double eval_sqr_mahalanobis(const VECTOR_R &r, const parameters_t & obs_noise_params, const noise_data_per_obs_t & noise_data)
+			{
+				MRPT_UNUSED_PARAM(noise_data);
+				return r.squaredNorm()/mrpt::utils::square(obs_noise_params.std_noise_observations);
+			}
+
+			/** Returns the squared error of one residual, weighted consistently with H and the gradient (the total of which is minimized) */
+			template <class VECTOR_R>
+			inline static double eval_sqr_error(const VECTOR_R &r, const parameters_t & obs_noise_params, const noise_data_per_obs_t & noise_data)
+			{
+				MRPT_UNUSED_PARAM(obs_noise_params); MRPT_UNUSED_PARAM(noise_data);
+				return r.squaredNorm(); // The constant factor 1/sigma only scales H and the gradient
+			}
+
 			/** Must execute H+= J1^t * \Lambda * J2 */
 			template <class MATRIX_H,class MATRIX_J1,class MATRIX_J2>
-			inline static void accum_JtJ(MATRIX_H & H, const MATRIX_J1 & J1, const MATRIX_J2 &J2, const size_t obs_idx, const parameters_t & obs_noise_params) 
+			inline static void accum_JtJ(MATRIX_H & H, const MATRIX_J1 & J1, const MATRIX_J2 &J2, const size_t obs_idx, const parameters_t & obs_noise_params, const noise_data_per_obs_t & noise_data) 
 			{
-				MRPT_UNUSED_PARAM(obs_idx); MRPT_UNUSED_PARAM(obs_noise_params);
+				MRPT_UNUSED_PARAM(obs_idx); MRPT_UNUSED_PARAM(obs_noise_params); MRPT_UNUSED_PARAM(noise_data);
 				H.noalias() += J1.transpose() * J2;  // The constant scale factor 1/sigma will be applied in the end (below)
 			}
 			/** Do scaling, if applicable, to H after end of all calls to accum_JtJ()  */
@@ -57,9 +101,9 @@ namespace options
 
 			/** Must execute grad+= J^t * \Lambda * r */
 			template <class VECTOR_GRAD,class MATRIX_J,class VECTOR_R>
-			inline static void accum_Jtr(VECTOR_GRAD & g, const MATRIX_J & J, const VECTOR_R &r, const size_t obs_idx, const parameters_t & obs_noise_params) 
+			inline static void accum_Jtr(VECTOR_GRAD & g, const MATRIX_J & J, const VECTOR_R &r, const size_t obs_idx, const parameters_t & obs_noise_params, const noise_data_per_obs_t & noise_data) 
 			{
-				MRPT_UNUSED_PARAM(obs_idx); MRPT_UNUSED_PARAM(obs_noise_params);
+				MRPT_UNUSED_PARAM(obs_idx); MRPT_UNUSED_PARAM(obs_noise_params); MRPT_UNUSED_PARAM(noise_data);
 				g.noalias() += J.transpose() * r;  // The constant scale factor 1/sigma will be applied in the end (below)
 			}
 			/** Do scaling, if applicable, to GRAD after end of all calls to accum_Jtr()  */
@@ -74,11 +118,14 @@ namespace options
 
 		/** Usage: A possible type for RBA_OPTIONS::obs_noise_matrix_t.
 		  * Meaning: The sensor noise matrix is an arbitrary matrix and the same for all observations. 
+		  * \tparam PREWHITEN If true, Jacobians and residuals are multiplied by the Cholesky factor of \Lambda once, right after
+		  *  being evaluated, so Hessian blocks are plain J1^t * J2 products instead of J1^t * \Lambda * J2.
 		  * \ingroup mrpt_srba_options_noise */
-		template <class obs_t>
+		template <class obs_t, bool PREWHITEN = false>
 		struct observation_noise_constant_matrix
 		{
 			static const size_t OBS_DIMS = obs_t::OBS_DIMS;  //!< The dimension of one observation
+			static const bool PREWHITEN_JACOBIANS = PREWHITEN;
 
 			typedef Eigen::Matrix<double,OBS_DIMS,OBS_DIMS>  obs_noise_matrix_t; //!< Type for symetric, positive-definite noise matrices.
 
@@ -98,13 +145,61 @@ namespace options
 				// None: all obs. have the same value
 			};
 
+			/** Data needed by whiten(), computed once from the parameters by get_whitening_data() */
+			struct whitening_data_t
+			{
+				obs_noise_matrix_t  sqrt_lambda; //!< Upper Cholesky factor U of \a lambda (\Lambda = U^t * U)
+
+				MRPT_MAKE_ALIGNED_OPERATOR_NEW
+			};
+
+			/** Fills in the data needed by whiten(). Must be called before (possibly parallel) loops over observations, not inside them. */
+			inline static void get_whitening_data(const parameters_t & obs_noise_params, whitening_data_t & wd)
+			{
+				wd.sqrt_lambda = obs_noise_params.lambda.llt().matrixU();
+			}
+
+			/** Pre-whitening of one Jacobian block or residual: M = U * M (only called if PREWHITEN_JACOBIANS=true) */
+			template <class MATRIX>
+			inline static void whiten(MATRIX & M, const whitening_data_t & wd, const noise_data_per_obs_t & noise_data)
+			{
+				MRPT_UNUSED_PARAM(noise_data);
+				M = wd.sqrt_lambda * M;
+			}
+
+			/** Initializes the per-observation data from the information matrix given by the user in new_kf_observation_t::obs_information (ignored here) */
+			template <class MATRIX>
+			inline static void init_noise_data_per_obs(noise_data_per_obs_t & noise_data, const MATRIX & obs_information)
+			{
+				MRPT_UNUSED_PARAM(noise_data); MRPT_UNUSED_PARAM(obs_information);
+			}
+
+			/** Returns the squared Mahalanobis distance of one residual (used for chi-square outlier gating) */
+			template <class VECTOR_R>
+			inline static double eval_sqr_mahalanobis(const VECTOR_R &r, const parameters_t & obs_noise_params, const noise_data_per_obs_t & noise_data)
+			{
+				MRPT_UNUSED_PARAM(noise_data);
+				if (PREWHITEN_JACOBIANS)
+				     return r.squaredNorm(); // Already whitened
+				else return r.dot(obs_noise_params.lambda * r);
+			}
+
+			/** Returns the squared error of one residual, weighted consistently with H and the gradient (the total of which is minimized) */
+			template <class VECTOR_R>
+			inline static double eval_sqr_error(const VECTOR_R &r, const parameters_t & obs_noise_params, const noise_data_per_obs_t & noise_data)
+			{
+				return eval_sqr_mahalanobis(r,obs_noise_params,noise_data);
+			}
+
 			/** Must execute H+= J1^t * \Lambda * J2 */
 			template <class MATRIX_H,class MATRIX_J1,class MATRIX_J2>
 			inline static void accum_JtJ(MATRIX_H & H, const MATRIX_J1 & J1, const MATRIX_J2 &J2,
-				const size_t obs_idx, const parameters_t & obs_noise_params) 
+				const size_t obs_idx, const parameters_t & obs_noise_params, const noise_data_per_obs_t & noise_data) 
 			{
-				MRPT_UNUSED_PARAM(obs_idx);
-				H.noalias() += J1.transpose() * obs_noise_params.lambda * J2;
+				MRPT_UNUSED_PARAM(obs_idx); MRPT_UNUSED_PARAM(noise_data);
+				if (PREWHITEN_JACOBIANS)
+						H.noalias() += J1.transpose() * J2; // \Lambda already in J1,J2
+				else	H.noalias() += J1.transpose() * obs_noise_params.lambda * J2;
 			}
 
 			/** Do scaling, if applicable, to H after end of all calls to accum_JtJ()  */
@@ -118,10 +213,12 @@ namespace options
 			/** Must execute grad+= J^t * \Lambda * r */
 			template <class VECTOR_GRAD,class MATRIX_J,class VECTOR_R>
 			inline static void accum_Jtr(VECTOR_GRAD & g, const MATRIX_J & J, const VECTOR_R &r,
-				const size_t obs_idx, const parameters_t & obs_noise_params) 
+				const size_t obs_idx, const parameters_t & obs_noise_params, const noise_data_per_obs_t & noise_data) 
 			{
-				MRPT_UNUSED_PARAM(obs_idx);
-				g.noalias() += J.transpose() * obs_noise_params.lambda * r;
+				MRPT_UNUSED_PARAM(obs_idx); MRPT_UNUSED_PARAM(noise_data);
+				if (PREWHITEN_JACOBIANS)
+						g.noalias() += J.transpose() * r; // \Lambda already in J,r
+				else	g.noalias() += J.transpose() * obs_noise_params.lambda * r;
 			}
 			/** Do scaling, if applicable, to GRAD after end of all calls to accum_Jtr()  */
 			template <class VECTOR_GRAD>
@@ -132,4 +229,119 @@ namespace options
 
 		};  // end of "observation_noise_constant_matrix"
 
+		/** Usage: A possible type for RBA_OPTIONS::obs_noise_matrix_t.
+		  * Meaning: Each observation has its own, arbitrary information matrix (e.g. depth-dependent noise in stereo),
+		  *  given by the user in new_kf_observation_t::obs_information (Default: identity) and stored along the
+		  *  rest of per-observation data in TRBA_Problem_state::all_observations_noise_data.
+		  * \tparam PREWHITEN See observation_noise_constant_matrix. The Cholesky factor of each observation is computed only once, when it's inserted.
+		  * \ingroup mrpt_srba_options_noise */
+		template <class obs_t, bool PREWHITEN = false>
+		struct observation_noise_per_observation
+		{
+			static const size_t OBS_DIMS = obs_t::OBS_DIMS;  //!< The dimension of one observation
+			static const bool PREWHITEN_JACOBIANS = PREWHITEN;
+
+			typedef Eigen::Matrix<double,OBS_DIMS,OBS_DIMS>  obs_noise_matrix_t; //!< Type for symetric, positive-definite noise matrices.
+
+			/** Observation noise parameters to be filled by the user in srba.parameters.obs_noise */
+			struct parameters_t
+			{
+				// None: all the information is given per observation.
+			};
+
+			/** Internal struct for data that must be stored for each observation  */
+			struct noise_data_per_obs_t
+			{
+				obs_noise_matrix_t  lambda; //!< The information matrix (inverse of covariance) of this observation (\Lambda in common SLAM notation)
+				obs_noise_matrix_t  sqrt_lambda; //!< Upper Cholesky factor U of \a lambda (\Lambda = U^t * U). Only filled in if PREWHITEN_JACOBIANS=true
+
+				noise_data_per_obs_t() : lambda( obs_noise_matrix_t::Identity() ), sqrt_lambda( obs_noise_matrix_t::Identity() ) { }
+
+				MRPT_MAKE_ALIGNED_OPERATOR_NEW
+			};
+
+			/** Initializes the per-observation data from the information matrix given by the user in new_kf_observation_t::obs_information */
+			template <class MATRIX>
+			inline static void init_noise_data_per_obs(noise_data_per_obs_t & noise_data, const MATRIX & obs_information)
+			{
+				noise_data.lambda = obs_information;
+				if (PREWHITEN_JACOBIANS)
+					noise_data.sqrt_lambda = noise_data.lambda.llt().matrixU();
+			}
+
+			/** Data needed by whiten(), computed once from the parameters by get_whitening_data() */
+			struct whitening_data_t
+			{
+				// None: the Cholesky factors are stored per observation
+			};
+
+			/** Fills in the data needed by whiten(). Must be called before (possibly parallel) loops over observations, not inside them. */
+			inline static void get_whitening_data(const parameters_t & obs_noise_params, whitening_data_t & wd)
+			{
+				MRPT_UNUSED_PARAM(obs_noise_params); MRPT_UNUSED_PARAM(wd);
+			}
+
+			/** Pre-whitening of one Jacobian block or residual: M = U * M (only called if PREWHITEN_JACOBIANS=true) */
+			template <class MATRIX>
+			inline static void whiten(MATRIX & M, const whitening_data_t & wd, const noise_data_per_obs_t & noise_data)
+			{
+				MRPT_UNUSED_PARAM(wd);
+				M = noise_data.sqrt_lambda * M;
+			}
+
+			/** Returns the squared Mahalanobis distance of one residual (used for chi-square outlier gating) */
+			template <class VECTOR_R>
+			inline static double eval_sqr_mahalanobis(const VECTOR_R &r, const parameters_t & obs_noise_params, const noise_data_per_obs_t & noise_data)
+			{
+				MRPT_UNUSED_PARAM(obs_noise_params);
+				if (PREWHITEN_JACOBIANS)
+				     return r.squaredNorm(); // Already whitened
+				else return r.dot(noise_data.lambda * r);
+			}
+
+			/** Returns the squared error of one residual, weighted consistently with H and the gradient (the total of which is minimized) */
+			template <class VECTOR_R>
+			inline static double eval_sqr_error(const VECTOR_R &r, const parameters_t & obs_noise_params, const noise_data_per_obs_t & noise_data)
+			{
+				return eval_sqr_mahalanobis(r,obs_noise_params,noise_data);
+			}
+
+			/** Must execute H+= J1^t * \Lambda * J2 */
+			template <class MATRIX_H,class MATRIX_J1,class MATRIX_J2>
+			inline static void accum_JtJ(MATRIX_H & H, const MATRIX_J1 & J1, const MATRIX_J2 &J2,
+				const size_t obs_idx, const parameters_t & obs_noise_params, const noise_data_per_obs_t & noise_data) 
+			{
+				MRPT_UNUSED_PARAM(obs_idx); MRPT_UNUSED_PARAM(obs_noise_params);
+				if (PREWHITEN_JACOBIANS)
+						H.noalias() += J1.transpose() * J2; // \Lambda already in J1,J2
+				else	H.noalias() += J1.transpose() * noise_data.lambda * J2;
+			}
+
+			/** Do scaling, if applicable, to H after end of all calls to accum_JtJ()  */
+			template <class MATRIX_H>
+			inline static void scale_H(MATRIX_H & H, const parameters_t & obs_noise_params) 
+			{  // Nothing else to do.
+				MRPT_UNUSED_PARAM(H);
+				MRPT_UNUSED_PARAM(obs_noise_params);
+			}
+
+			/** Must execute grad+= J^t * \Lambda * r */
+			template <class VECTOR_GRAD,class MATRIX_J,class VECTOR_R>
+			inline static void accum_Jtr(VECTOR_GRAD & g, const MATRIX_J & J, const VECTOR_R &r,
+				const size_t obs_idx, const parameters_t & obs_noise_params, const noise_data_per_obs_t & noise_data) 
+			{
+				MRPT_UNUSED_PARAM(obs_idx); MRPT_UNUSED_PARAM(obs_noise_params);
+				if (PREWHITEN_JACOBIANS)
+						g.noalias() += J.transpose() * r; // \Lambda already in J,r
+				else	g.noalias() += J.transpose() * noise_data.lambda * r;
+			}
+			/** Do scaling, if applicable, to GRAD after end of all calls to accum_Jtr()  */
+			template <class VECTOR_GRAD>
+			inline static void scale_Jtr(VECTOR_GRAD & g, const parameters_t & obs_noise_params) 
+			{  // Nothing else to do.
+				MRPT_UNUSED_PARAM(g); MRPT_UNUSED_PARAM(obs_noise_params);
+			}
+
+		};  // end of "observation_noise_per_observation"
+
 } } // End of namespaces
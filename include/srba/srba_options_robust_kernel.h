@@ -0,0 +1,142 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#pragma once
+
+#include <cmath>
+
+namespace srba {
+namespace options
+{
+	/** \defgroup mrpt_srba_options_robust_kernel Types for RBA_OPTIONS::robust_kernel_t
+		* All kernels are written as a function \rho(s) of the squared error s=|r|^2, with \rho(s) ~ s for small s.
+		* Each one must provide:
+		*  - IS_ROBUST: If false, all the kernel-related code is removed at compile time.
+		*  - eval(s,k,w): Returns \rho(s) and sets the IRLS weight w=\rho'(s), to be applied to J^t*r and J^t*J.
+		*
+		* The kernel parameter "k" is taken from RbaEngine::parameters.srba.kernel_param, and the kernel is only applied when
+		* RbaEngine::parameters.srba.use_robust_kernel is true.
+		* \ingroup mrpt_srba_options */
+
+		/** Usage: A possible type for RBA_OPTIONS::robust_kernel_t.
+		  * Meaning: Plain least-squares, no robust kernel at all (zero runtime cost).
+		  * \ingroup mrpt_srba_options_robust_kernel */
+		struct robust_kernel_none
+		{
+			static const bool IS_ROBUST = false;
+
+			static inline double eval(const double s, const double k, double &w)
+			{
+				MRPT_UNUSED_PARAM(k);
+				w = 1.0;
+				return s;
+			}
+		};
+
+		/** Usage: A possible type for RBA_OPTIONS::robust_kernel_t.
+		  * Meaning: Pseudo-Huber kernel: \rho(s)= 2k^2 ( sqrt(1+s/k^2) - 1 ). (This is the default)
+		  * \ingroup mrpt_srba_options_robust_kernel */
+		struct robust_kernel_pseudo_huber
+		{
+			static const bool IS_ROBUST = true;
+
+			static inline double eval(const double s, const double k, double &w)
+			{
+				const double k2 = k*k;
+				const double aux = std::sqrt(1.0+s/k2);
+				w = 1.0/aux;
+				return 2*k2*(aux-1.0);
+			}
+		};
+
+		/** Usage: A possible type for RBA_OPTIONS::robust_kernel_t.
+		  * Meaning: Huber kernel: \rho(s)= s if s<=k^2, 2k sqrt(s) - k^2 otherwise.
+		  * \ingroup mrpt_srba_options_robust_kernel */
+		struct robust_kernel_huber
+		{
+			static const bool IS_ROBUST = true;
+
+			static inline double eval(const double s, const double k, double &w)
+			{
+				if (s<=k*k)
+				{
+					w = 1.0;
+					return s;
+				}
+				const double nrm = std::sqrt(s);
+				w = k/nrm;
+				return 2*k*nrm - k*k;
+			}
+		};
+
+		/** Usage: A possible type for RBA_OPTIONS::robust_kernel_t.
+		  * Meaning: Cauchy kernel: \rho(s)= k^2 log(1+s/k^2).
+		  * \ingroup mrpt_srba_options_robust_kernel */
+		struct robust_kernel_cauchy
+		{
+			static const bool IS_ROBUST = true;
+
+			static inline double eval(const double s, const double k, double &w)
+			{
+				const double k2 = k*k;
+				w = 1.0/(1.0+s/k2);
+				return k2*std::log(1.0+s/k2);
+			}
+		};
+
+		/** Usage: A possible type for RBA_OPTIONS::robust_kernel_t.
+		  * Meaning: Tukey biweight kernel: \rho(s)= k^2/3 (1-(1-s/k^2)^3) if s<=k^2, k^2/3 otherwise.
+		  *  Observations beyond "k" get a null weight, i.e. they are completely ignored.
+		  * \ingroup mrpt_srba_options_robust_kernel */
+		struct robust_kernel_tukey
+		{
+			static const bool IS_ROBUST = true;
+
+			static inline double eval(const double s, const double k, double &w)
+			{
+				const double k2 = k*k;
+				if (s>=k2)
+				{
+					w = 0.0;
+					return k2/3.0;
+				}
+				const double aux = 1.0-s/k2;
+				w = aux*aux;
+				return k2/3.0*(1.0-aux*aux*aux);
+			}
+		};
+
+		/** Usage: A possible type for RBA_OPTIONS::robust_kernel_t.
+		  * Meaning: Geman-McClure kernel: \rho(s)= s k^2/(k^2+s).
+		  * \ingroup mrpt_srba_options_robust_kernel */
+		struct robust_kernel_geman_mcclure
+		{
+			static const bool IS_ROBUST = true;
+
+			static inline double eval(const double s, const double k, double &w)
+			{
+				const double k2 = k*k;
+				const double aux = k2/(k2+s);
+				w = aux*aux;
+				return s*aux;
+			}
+		};
+
+		namespace internal
+		{
+			/** Evaluates to RBA_OPTIONS::robust_kernel_t if defined, or to robust_kernel_pseudo_huber otherwise (the only kernel
+			  * available in older versions), so user-defined RBA_OPTIONS structs which don't inherit from RBA_OPTIONS_DEFAULT keep compiling. */
+			template <class RBA_OPTIONS, class ENABLE = void>
+			struct robust_kernel { typedef robust_kernel_pseudo_huber type; };
+
+			template <class RBA_OPTIONS>
+			struct robust_kernel<RBA_OPTIONS, typename srba::internal::void_if_type<typename RBA_OPTIONS::robust_kernel_t>::type> { typedef typename RBA_OPTIONS::robust_kernel_t type; };
+		}
+
+} } // End of namespaces
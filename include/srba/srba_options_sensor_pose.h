@@ -45,9 +45,9 @@ namespace options
 
 			/** Converts a pose relative to the robot coordinate frame (P) into a pose relative to
 			 * the sensor (RES = P \ominus POSE_IN_ROBOT ) */
-			template <class KF_POSE>
+			template <class KF_POSE,class SENSOR_POSE>
 			static inline void pose_robot2sensor(const KF_POSE & pose_wrt_robot,
-				KF_POSE & pose_wrt_sensor, const parameters_t &p) {
+				SENSOR_POSE & pose_wrt_sensor, const parameters_t &p) {
 				MRPT_UNUSED_PARAM(p);
 				pose_wrt_sensor = pose_wrt_robot;
 			}
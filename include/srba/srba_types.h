@@ -14,7 +14,15 @@
 #include <mrpt/math/CArrayNumeric.h>
 #include <mrpt/utils/TEnumType.h>
 #include <mrpt/system/memory.h> // for MRPT_MAKE_ALIGNED_OPERATOR_NEW
+#include "landmark_jacob_families.h"
 #include <set>
+#include <map>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <iterator> // std::reverse_iterator
+#include <limits>
+#include <string>
 
 namespace srba
 {
@@ -38,6 +46,18 @@ namespace srba
 	    @{ */
 
 	/** Generic declaration, of which specializations are defined for each combination of LM+OBS type.
+	  * Each specialization must implement observe_error(), eval_jacob_dh_dx() and inverse_sensor_model(), plus, optionally:
+	  *  - eval_observation<T>(): The observation model h(x') for a landmark x' relative to the sensor, templated on the scalar type so
+	  *    dh_dx can be obtained by automatic differentiation (see \ref mrpt_srba_autodiff). It always evaluates h(x'), and returns false if
+	  *    dh_dx is ill-defined at x' (e.g. a point behind a camera).
+	  *  - observe_error_and_jacob<POSE_T>(): The fused evaluation of observe_error() and eval_jacob_dh_dx(), sharing the transformation of the
+	  *    landmark into the sensor frame. If present (see internal::has_observe_error_and_jacob), dh_dx is obtained while evaluating the
+	  *    residuals and reused by the Jacobians at the same linearization point. It must output the same error than observe_error(), and the
+	  *    same dh_dx and return value than eval_jacob_dh_dx() evaluated at the transformed landmark:
+	  * \code
+	  *  template <class POSE_T>
+	  *  static bool observe_error_and_jacob(array_obs_t & out_obs_err, TJacobian_dh_dx & dh_dx, const array_obs_t & z_obs, const POSE_T & base_pose_wrt_observer, const array_landmark_t & lm_pos, const TObservationParams & params);
+	  * \endcode
 	  * \sa Implementations are in srba/models/sensors.h
 	  */
 	template <class landmark_t,class obs_t>
@@ -128,9 +148,10 @@ namespace srba
 		{
 			bool                 has_known_pos; //!< true: This landmark has a fixed (known) relative position. false: The relative pos of this landmark is an unknown of the problem.
 			TRelativeLandmarkPos *rfp;           //!< Pointers to elements in \a unknown_lms and \a known_lms.
+			unsigned int         anchor_version; //!< Incremented each time the landmark is moved to another base KF (see RbaEngine::reanchor_landmark())
 
-			TLandmarkEntry() : has_known_pos(true), rfp(NULL) {}
-			TLandmarkEntry(bool has_known_pos_, TRelativeLandmarkPos *rfp_) : has_known_pos(has_known_pos_), rfp(rfp_)
+			TLandmarkEntry() : has_known_pos(true), rfp(NULL), anchor_version(0) {}
+			TLandmarkEntry(bool has_known_pos_, TRelativeLandmarkPos *rfp_) : has_known_pos(has_known_pos_), rfp(rfp_), anchor_version(0)
 			{}
 		};
 
@@ -180,6 +201,70 @@ namespace srba
 		return p.from==one ? p.to: p.from;
 	}
 
+	/** A dense array of values indexed by IDs (of KFs, landmarks, edges,...), where each entry is lazily reset to a default value the first time
+	  *  it is accessed after reset(). Entries are tagged with a generation counter, so reset() is O(1) and, once the array has grown to its
+	  *  final size, there are no memory allocations at all. Used as reusable working space in graph traversals, e.g. RbaEngine::bfs_visitor()
+	  */
+	template <typename T>
+	class stamped_array_t
+	{
+	public:
+		stamped_array_t(const T &default_val = T()) : m_generation(1), m_default(default_val) { }
+
+		/** Logically resets all entries to their default value. Amortized O(1) */
+		void reset()
+		{
+			if (++m_generation==0)
+			{	// Wrap around: really reset all stamps (once every 2^32 calls)
+				std::fill(m_stamps.begin(),m_stamps.end(),0u);
+				m_generation = 1;
+			}
+		}
+
+		/** Returns true if the entry has been accessed since the last reset() */
+		inline bool is_set(const size_t idx) const { return idx<m_stamps.size() && m_stamps[idx]==m_generation; }
+
+		/** Marks the entry as accessed, like std::set<>::insert(), returning true if it was not since the last reset() */
+		inline bool insert(const size_t idx)
+		{
+			if (is_set(idx)) return false;
+			(*this)[idx];
+			return true;
+		}
+
+		/** Read/write access to an entry, which is first reset to the default value if not accessed since the last reset() */
+		inline T & operator[](const size_t idx)
+		{
+			if (idx>=m_stamps.size())
+				grow(idx+1);
+			if (m_stamps[idx]!=m_generation)
+			{
+				m_stamps[idx] = m_generation;
+				m_values[idx] = m_default;
+			}
+			return m_values[idx];
+		}
+
+		/** Read-only access to an entry: its default value if not accessed since the last reset() */
+		inline T get(const size_t idx) const { return is_set(idx) ? m_values[idx] : m_default; }
+
+		/** Preallocates memory for IDs in the range [0,n-1] */
+		void reserve(const size_t n) { if (n>m_stamps.size()) grow(n); }
+
+	private:
+		std::vector<unsigned int> m_stamps;
+		std::vector<T>            m_values;
+		unsigned int              m_generation;
+		T                         m_default;
+
+		void grow(const size_t min_size)
+		{
+			const size_t new_size = std::max(min_size, 2*m_stamps.size());
+			m_stamps.resize(new_size, 0u);
+			m_values.resize(new_size, m_default);
+		}
+	};
+
 	/** Used in TNewKeyFrameInfo */
 	struct TNewEdgeInfo
 	{
@@ -299,7 +384,36 @@ namespace srba
 
 		typedef std::vector<THessianSymbolicInfoEntry> list_jacob_blocks_t;
 
-		list_jacob_blocks_t lst_jacob_blocks; //!< The list of Jacobian blocks itself
+		/** The list of Jacobian blocks itself is stored in the flat array of the whole Hessian (see THessianSymbolicCSR), at
+		  * indices [first_jacob_block, first_jacob_block+num_jacob_blocks-1] */
+		size_t first_jacob_block;
+		size_t num_jacob_blocks;
+
+		THessianSymbolicInfo() : first_jacob_block(0), num_jacob_blocks(0) { }
+	};
+
+	/** The symbolic structure of a whole sparse Hessian, in a CSR-like flat form: the "J1^t * \Lambda * J2" terms of all the
+	  * Hessian blocks are stored contiguously in \a entries, grouped by block (and within each block, in increasing order of
+	  * observation index), and the terms of the b'th block are entries[offsets[b] ... offsets[b+1]-1].
+	  * Blocks are numbered in their storage order (by columns, then by rows). Built by RbaEngine::sparse_hessian_build_symbolic().
+	  * \tparam INFO A THessianSymbolicInfo<>
+	  * \tparam HESS_ENTRY The type of the Hessian block entries (with members "num" and "sym")
+	  */
+	template <class INFO, class HESS_ENTRY>
+	struct THessianSymbolicCSR
+	{
+		typedef typename INFO::THessianSymbolicInfoEntry entry_t;
+
+		typename INFO::list_jacob_blocks_t entries; //!< All the terms, grouped by block
+		std::vector<size_t>                offsets; //!< Size: number of blocks + 1
+		std::vector<HESS_ENTRY*>           blocks;  //!< The Hessian block each group of terms belongs to (pointers into the owner sparse matrix)
+
+		inline size_t getBlockCount() const { return blocks.size(); }
+
+		/** The terms of one Hessian block, given its symbolic info (with \a num_jacob_blocks elements) */
+		inline const entry_t * getBlockTerms(const INFO &sym) const { return entries.empty() ? NULL : &entries[sym.first_jacob_block]; }
+
+		void clear() { entries.clear(); offsets.clear(); blocks.clear(); }
 	};
 
 
@@ -379,8 +493,435 @@ namespace srba
 				nNonZeroBlocks+=lstColumns[j]->size();
 		}
 
+		/** Flat symbolic structure, with pointers to the blocks of this matrix (only for sparse Hessians) */
+		THessianSymbolicCSR<INFO,typename base_t::TEntry> symbolic_csr;
+
+		/** Returns the diagonal block (i,i) of a square matrix stored in upper-triangular form, i.e. the last entry of the i'th column. */
+		const typename base_t::matrix_t & getDiagonalBlock(const size_t i) const
+		{
+			const typename base_t::col_t & col_i = base_t::getCol(i);
+			ASSERT_(!col_i.empty() && col_i.rbegin()->first==i)
+			return col_i.rbegin()->second.num;
+		}
+
 	}; // end SparseBlockMatrix()
 
+	/** A block-diagonal square matrix of NxN blocks, each one with its associated information, stored in a flat aligned array.
+	  * It replaces SparseBlockMatrix<> for the landmarks Hessian Hf when no observation involves two landmarks, which
+	  * makes Hf strictly block-diagonal (see hessian_traits). The columns (col_t) mimic the interface of the std::map<> columns
+	  * of SparseBlockMatrix<>, with the diagonal block as their only entry, so generic code iterating over the columns keeps working.
+	  */
+	template <typename Scalar, int N, typename INFO>
+	struct BlockDiagonalMatrix
+	{
+		typedef Eigen::Matrix<Scalar,N,N> matrix_t;
+		typedef INFO symbolic_t;
+
+		struct TEntry
+		{
+			matrix_t   num;
+			symbolic_t sym;
+
+			MRPT_MAKE_ALIGNED_OPERATOR_NEW
+		};
+
+		/** One column, holding its diagonal block as the only entry (with the interface of a std::map<size_t,TEntry>). */
+		struct col_t
+		{
+			typedef std::pair<size_t,TEntry>              value_type;
+			typedef value_type *                          iterator;
+			typedef const value_type *                    const_iterator;
+			typedef std::reverse_iterator<iterator>       reverse_iterator;
+			typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+			value_type diag; //!< (column index, diagonal block)
+
+			inline iterator               begin()        { return &diag; }
+			inline const_iterator         begin()  const { return &diag; }
+			inline iterator               end()          { return &diag+1; }
+			inline const_iterator         end()    const { return &diag+1; }
+			inline reverse_iterator       rbegin()       { return reverse_iterator(end()); }
+			inline const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+			inline reverse_iterator       rend()         { return reverse_iterator(begin()); }
+			inline const_reverse_iterator rend()   const { return const_reverse_iterator(begin()); }
+			inline size_t size()  const { return 1; }
+			inline bool   empty() const { return false; }
+			inline iterator       find(const size_t row)       { return row==diag.first ? begin() : end(); }
+			inline const_iterator find(const size_t row) const { return row==diag.first ? begin() : end(); }
+			/** Only the diagonal block can be accessed, i.e. \a row must be the index of this column */
+			inline TEntry & operator[](const size_t row) { ASSERT_(row==diag.first) return diag.second; }
+
+			MRPT_MAKE_ALIGNED_OPERATOR_NEW
+		};
+
+		/** Flat symbolic structure, with pointers to the blocks of this matrix */
+		THessianSymbolicCSR<INFO,TEntry> symbolic_csr;
+
+		inline size_t getColCount() const { return m_cols.size(); }
+
+		/** Changes the number of columns (=rows) keeping the existing ones. */
+		void setColCount(const size_t nCols)
+		{
+			m_cols.resize(nCols);
+			for (size_t i=0;i<nCols;i++)
+				m_cols[i].diag.first = i;
+		}
+
+		inline col_t       & getCol(const size_t idx)       { return m_cols[idx]; }
+		inline const col_t & getCol(const size_t idx) const { return m_cols[idx]; }
+
+		inline matrix_t       & getDiagonalBlock(const size_t i)       { return m_cols[i].diag.second.num; }
+		inline const matrix_t & getDiagonalBlock(const size_t i) const { return m_cols[i].diag.second.num; }
+
+		inline void clear() { m_cols.clear(); symbolic_csr.clear(); }
+
+		/** See SparseBlockMatrix::getSparsityStats() */
+		void getSparsityStats(size_t &nMaxBlocks, size_t &nNonZeroBlocks) const {
+			nMaxBlocks = m_cols.size()*m_cols.size();
+			nNonZeroBlocks = m_cols.size();
+		}
+
+		/** Builds a dense representation of the matrix (the \a force_symmetry flag is ignored, since it's always symmetric if its blocks are). */
+		void getAsDense(mrpt::math::CMatrixDouble &D, const bool force_symmetry=false) const
+		{
+			MRPT_UNUSED_PARAM(force_symmetry);
+			D.setZero(N*m_cols.size(),N*m_cols.size());
+			for (size_t i=0;i<m_cols.size();i++)
+				D.block(N*i,N*i,N,N) = m_cols[i].diag.second.num;
+		}
+
+	private:
+		typename mrpt::aligned_containers<col_t>::vector_t m_cols;
+	}; // end BlockDiagonalMatrix()
+
+	/** A column of a SparseBlockJacobian<>: its nonzero blocks, indexed by row (observation index), in a contiguous vector sorted by row.
+	  * It offers the subset of the std::map<size_t,TEntry> interface used for Jacobians. Appending rows in increasing order (the usual case,
+	  * since new observations get ever increasing indices) is amortized O(1), and iterating is a linear scan over memory.
+	  * Erased entries are left as "tombstones" which iterators skip, and the storage is compacted when they outnumber the live entries.
+	  * \note Inserting or erasing entries may invalidate iterators, pointers and references to other entries of the same column.
+	  */
+	template <class TENTRY>
+	class SparseBlockColumn
+	{
+	public:
+		typedef TENTRY mapped_type;
+
+		struct value_type
+		{
+			size_t      first;  //!< Row index
+			mapped_type second; //!< The block
+			bool        erased; //!< Tombstone mark: skipped by iterators
+
+			value_type() : first(0), second(), erased(false) { }
+			value_type(const size_t row, const mapped_type &e) : first(row), second(e), erased(false) { }
+
+			MRPT_MAKE_ALIGNED_OPERATOR_NEW
+		};
+
+		/** Forward iterator over the live (non-erased) entries */
+		template <class V>
+		class iterator_base
+		{
+		public:
+			typedef std::forward_iterator_tag iterator_category;
+			typedef V                         value_type;
+			typedef std::ptrdiff_t            difference_type;
+			typedef V *                       pointer;
+			typedef V &                       reference;
+
+			iterator_base() : m_p(NULL), m_end(NULL) { }
+			iterator_base(V * p, V * end) : m_p(p), m_end(end) { skip_erased(); }
+			/** Conversion from non-const to const iterators */
+			template <class V2> iterator_base(const iterator_base<V2> &o) : m_p(o.ptr()), m_end(o.end_ptr()) { }
+
+			inline V & operator *() const { return *m_p; }
+			inline V * operator->() const { return m_p; }
+			inline iterator_base & operator++() { ++m_p; skip_erased(); return *this; }
+			inline iterator_base   operator++(int) { iterator_base tmp(*this); ++(*this); return tmp; }
+			template <class V2> inline bool operator==(const iterator_base<V2> &o) const { return m_p==o.ptr(); }
+			template <class V2> inline bool operator!=(const iterator_base<V2> &o) const { return m_p!=o.ptr(); }
+
+			inline V * ptr() const { return m_p; }
+			inline V * end_ptr() const { return m_end; }
+
+		private:
+			inline void skip_erased() { while (m_p!=m_end && m_p->erased) ++m_p; }
+			V * m_p, * m_end;
+		};
+
+		typedef iterator_base<value_type>       iterator;
+		typedef iterator_base<const value_type> const_iterator;
+
+		SparseBlockColumn() : m_num_erased(0) { }
+
+		inline iterator       begin()       { return iterator(data_begin(),data_end()); }
+		inline const_iterator begin() const { return const_iterator(data_begin(),data_end()); }
+		inline iterator       end()         { return iterator(data_end(),data_end()); }
+		inline const_iterator end()   const { return const_iterator(data_end(),data_end()); }
+
+		/** Number of live (non-erased) entries */
+		inline size_t size()  const { return m_entries.size()-m_num_erased; }
+		inline bool   empty() const { return size()==0; }
+		/** Number of tombstones waiting for the next compact() */
+		inline size_t num_erased() const { return m_num_erased; }
+
+		inline void reserve(const size_t n) { m_entries.reserve(n); }
+		inline void clear() { m_entries.clear(); m_num_erased=0; }
+		/** Like clear(), but also returns the allocated storage to the heap */
+		inline void clear_and_free() { typename mrpt::aligned_containers<value_type>::vector_t().swap(m_entries); m_num_erased=0; }
+
+		/** Binary search for a live entry, or end() if not found */
+		iterator find(const size_t row) {
+			const size_t i = lower_bound_idx(row);
+			return (i<m_entries.size() && m_entries[i].first==row && !m_entries[i].erased) ? iterator(&m_entries[i],data_end()) : end();
+		}
+		const_iterator find(const size_t row) const {
+			const size_t i = lower_bound_idx(row);
+			return (i<m_entries.size() && m_entries[i].first==row && !m_entries[i].erased) ? const_iterator(&m_entries[i],data_end()) : end();
+		}
+
+		/** Returns the entry at \a row, creating an empty one if it didn't exist. Amortized O(1) if \a row is larger than all existing rows. */
+		mapped_type & operator[](const size_t row)
+		{
+			if (m_entries.empty() || m_entries.back().first<row)
+			{
+				m_entries.push_back( value_type(row,mapped_type()) );
+				return m_entries.back().second;
+			}
+			const size_t i = lower_bound_idx(row);
+			if (i<m_entries.size() && m_entries[i].first==row)
+			{
+				value_type & e = m_entries[i];
+				if (e.erased) { // Revive a tombstone:
+					e.second = mapped_type();
+					e.erased = false;
+					--m_num_erased;
+				}
+				return e.second;
+			}
+			return m_entries.insert(m_entries.begin()+i, value_type(row,mapped_type()) )->second;
+		}
+
+		/** Marks the entry at \a row as erased (O(log N)), compacting the storage if tombstones outnumber live entries.
+		  * \return false if there was no such entry */
+		bool erase(const size_t row)
+		{
+			const size_t i = lower_bound_idx(row);
+			if (i>=m_entries.size() || m_entries[i].first!=row || m_entries[i].erased)
+				return false;
+			m_entries[i].erased = true;
+			m_entries[i].second = mapped_type(); // Release any memory held by the symbolic info
+			++m_num_erased;
+			if (m_num_erased>size())
+				compact();
+			return true;
+		}
+
+		/** Physically removes all the tombstones */
+		void compact()
+		{
+			if (!m_num_erased) return;
+			size_t n=0;
+			for (size_t i=0;i<m_entries.size();i++)
+			{
+				if (m_entries[i].erased) continue;
+				if (n!=i) m_entries[n] = m_entries[i];
+				++n;
+			}
+			m_entries.resize(n);
+			m_num_erased = 0;
+		}
+
+	private:
+		typename mrpt::aligned_containers<value_type>::vector_t m_entries; //!< Sorted by row, including tombstones
+		size_t m_num_erased;
+
+		inline value_type       * data_begin()       { return m_entries.empty() ? NULL : &m_entries[0]; }
+		inline const value_type * data_begin() const { return m_entries.empty() ? NULL : &m_entries[0]; }
+		inline value_type       * data_end()         { return data_begin()+m_entries.size(); }
+		inline const value_type * data_end()   const { return data_begin()+m_entries.size(); }
+
+		size_t lower_bound_idx(const size_t row) const
+		{
+			size_t lo=0, hi=m_entries.size();
+			while (lo<hi)
+			{
+				const size_t mid = (lo+hi)/2;
+				if (m_entries[mid].first<row) lo=mid+1;
+				else hi=mid;
+			}
+			return lo;
+		}
+	}; // end SparseBlockColumn
+
+	/** Column-indexed storage of the sparse Jacobians dh_dAp and dh_df, with the interface of mrpt::math::MatrixBlockSparseCols<> but with
+	  * columns stored as contiguous sorted vectors of aligned blocks (see SparseBlockColumn) instead of std::map<>'s with one heap node per block.
+	  * \tparam HAS_REMAP If true, each column is associated to an arbitrary user index (e.g. the landmark ID) given in appendCol().
+	  */
+	template <typename Scalar, int NROWS, int NCOLS, typename INFO, bool HAS_REMAP>
+	struct SparseBlockJacobian
+	{
+		typedef Eigen::Matrix<Scalar,NROWS,NCOLS> matrix_t;
+		typedef INFO symbolic_t;
+
+		struct TEntry
+		{
+			matrix_t   num;
+			symbolic_t sym;
+
+			MRPT_MAKE_ALIGNED_OPERATOR_NEW
+		};
+
+		typedef SparseBlockColumn<TEntry> col_t;
+
+		inline size_t getColCount() const { return m_cols.size(); }
+		inline void   setColCount(const size_t nCols) { m_cols.resize(nCols); }
+
+		inline col_t       & getCol(const size_t idx)       { return m_cols[idx]; }
+		inline const col_t & getCol(const size_t idx) const { return m_cols[idx]; }
+
+		/** Appends an empty column, associated to the index \a remapIndex if HAS_REMAP=true. Pointers to existing columns remain valid. */
+		col_t & appendCol(const size_t remapIndex)
+		{
+			const size_t idx = m_cols.size();
+			if (HAS_REMAP)
+			{
+				m_col_remapped_indices.push_back(remapIndex);
+				m_col_inverse_remapped_indices[remapIndex] = idx;
+			}
+			m_cols.push_back(col_t());
+			return m_cols.back();
+		}
+
+		/** Map: remap index -> column index (only if HAS_REMAP=true) */
+		inline const mrpt::utils::map_as_vector<size_t,size_t> & getColInverseRemappedIndices() const { ASSERTDEB_(HAS_REMAP) return m_col_inverse_remapped_indices; }
+		/** Column index -> remap index (only if HAS_REMAP=true) */
+		inline const std::vector<size_t> & getColRemappedIndices() const { ASSERTDEB_(HAS_REMAP) return m_col_remapped_indices; }
+
+		void clearAll()
+		{
+			m_cols.clear();
+			m_col_remapped_indices.clear();
+			m_col_inverse_remapped_indices.clear();
+		}
+
+		/** Compacts the tombstones left by erased blocks in all columns */
+		void compact()
+		{
+			for (size_t i=0;i<m_cols.size();i++)
+				m_cols[i].compact();
+		}
+
+		/** See SparseBlockMatrix::findRowSpan() */
+		static size_t findRowSpan(const std::vector<col_t*> &lstColumns, size_t *row_min_idx=NULL, size_t *row_max_idx=NULL)
+		{
+			size_t row_min=std::numeric_limits<size_t>::max();
+			size_t row_max=0;
+			for (size_t i=0;i<lstColumns.size();++i)
+				for (typename col_t::const_iterator itRow=lstColumns[i]->begin();itRow!=lstColumns[i]->end();++itRow) {
+					mrpt::utils::keep_max(row_max, itRow->first);
+					mrpt::utils::keep_min(row_min, itRow->first);
+				}
+			if (row_min==std::numeric_limits<size_t>::max())
+				row_min=0;
+			if (row_min_idx) *row_min_idx = row_min;
+			if (row_max_idx) *row_max_idx = row_max;
+			return (row_max-row_min)+1;
+		}
+
+		/** See SparseBlockMatrix::getSparsityStats() */
+		static void getSparsityStats(const std::vector<col_t*> &lstColumns, size_t &nMaxBlocks, size_t &nNonZeroBlocks  )
+		{
+			const size_t nCols = lstColumns.size();
+			const size_t nRows = findRowSpan(lstColumns);
+			nMaxBlocks = nCols * nRows;
+			nNonZeroBlocks = 0;
+			for (size_t j=0;j<nCols;j++)
+				nNonZeroBlocks+=lstColumns[j]->size();
+		}
+
+		/** Builds a dense representation of the matrix, with as many block rows as the largest row index plus one. */
+		void getAsDense(mrpt::math::CMatrixDouble &D) const
+		{
+			size_t nRows=0;
+			for (size_t j=0;j<m_cols.size();j++)
+				for (typename col_t::const_iterator it=m_cols[j].begin();it!=m_cols[j].end();++it)
+					mrpt::utils::keep_max(nRows, it->first+1);
+			D.setZero(NROWS*nRows, NCOLS*m_cols.size());
+			for (size_t j=0;j<m_cols.size();j++)
+				for (typename col_t::const_iterator it=m_cols[j].begin();it!=m_cols[j].end();++it)
+					D.block(NROWS*it->first,NCOLS*j,NROWS,NCOLS) = it->second.num;
+		}
+
+		/** A matrix with one element per block, 1 for nonzero blocks, 0 otherwise. */
+		void getBinaryBlocksRepresentation(mrpt::math::CMatrixDouble &out) const
+		{
+			size_t nRows=0;
+			for (size_t j=0;j<m_cols.size();j++)
+				for (typename col_t::const_iterator it=m_cols[j].begin();it!=m_cols[j].end();++it)
+					mrpt::utils::keep_max(nRows, it->first+1);
+			out.setZero(nRows, m_cols.size());
+			for (size_t j=0;j<m_cols.size();j++)
+				for (typename col_t::const_iterator it=m_cols[j].begin();it!=m_cols[j].end();++it)
+					out(it->first,j) = 1;
+		}
+
+		void saveToTextFileAsDense(const std::string &filename) const
+		{
+			mrpt::math::CMatrixDouble D;
+			getAsDense(D);
+			D.saveToTextFile(filename);
+		}
+
+	private:
+		typename mrpt::aligned_containers<col_t>::deque_t m_cols; //!< A deque, so pointers to columns are not invalidated by appendCol()
+		std::vector<size_t>                             m_col_remapped_indices;
+		mrpt::utils::map_as_vector<size_t,size_t>       m_col_inverse_remapped_indices;
+	}; // end SparseBlockJacobian
+
+
+	namespace internal
+	{
+		/** Aux for SFINAE detection of optional typedefs in RBA_OPTIONS */
+		template <class T> struct void_if_type { typedef void type; };
+
+		/** Evaluates to true if SENSOR_MODEL provides the optional fused residual + Jacobian evaluation observe_error_and_jacob() (see sensor_model) */
+		template <class SENSOR_MODEL, class POSE_T>
+		struct has_observe_error_and_jacob
+		{
+			typedef char yes_t[1];
+			typedef char no_t[2];
+			typedef bool (*fn_t)(
+				typename observation_traits<typename SENSOR_MODEL::OBS_T>::array_obs_t &,
+				typename SENSOR_MODEL::TJacobian_dh_dx &,
+				const typename observation_traits<typename SENSOR_MODEL::OBS_T>::array_obs_t &,
+				const POSE_T &,
+				const typename landmark_traits<typename SENSOR_MODEL::LANDMARK_T>::array_landmark_t &,
+				const typename SENSOR_MODEL::TObservationParams &);
+			template <fn_t> struct check { };
+
+			template <class U> static yes_t & test( check< &U::template observe_error_and_jacob<POSE_T> > * );
+			template <class U> static no_t  & test( ... );
+
+			static const bool value = sizeof(test<SENSOR_MODEL>(NULL))==sizeof(yes_t);
+		};
+
+		/** Evaluates to true if SENSOR_MODEL provides the observation function templated on the scalar type, eval_observation<T>(),
+		  * required for automatic differentiation (see \ref mrpt_srba_autodiff) */
+		template <class SENSOR_MODEL>
+		struct has_eval_observation
+		{
+			typedef char yes_t[1];
+			typedef char no_t[2];
+			typedef bool (*fn_t)(double *, const double *, const typename SENSOR_MODEL::TObservationParams &);
+			template <fn_t> struct check { };
+
+			template <class U> static yes_t & test( check< &U::template eval_observation<double> > * );
+			template <class U> static no_t  & test( ... );
+
+			static const bool value = sizeof(test<SENSOR_MODEL>(NULL))==sizeof(yes_t);
+		};
+	}
 
 	/** Types for the Jacobians:
 	  * \code
@@ -397,10 +938,20 @@ namespace srba
 		typedef TJacobianSymbolicInfo_dh_dAp<kf2kf_pose_t,LANDMARK_TYPE> jacob_dh_dAp_info_t;
 		typedef TJacobianSymbolicInfo_dh_df<kf2kf_pose_t,LANDMARK_TYPE>  jacob_dh_df_info_t;
 
-		typedef SparseBlockMatrix<double,OBS_DIMS,REL_POSE_DIMS,jacob_dh_dAp_info_t, false>  TSparseBlocksJacobians_dh_dAp;  //!< The "false" is since we don't need to "remap" indices
-		typedef SparseBlockMatrix<double,OBS_DIMS,LM_DIMS,jacob_dh_df_info_t,  true >   TSparseBlocksJacobians_dh_df;  // The "true" is to "remap" indices
+		typedef SparseBlockJacobian<double,OBS_DIMS,REL_POSE_DIMS,jacob_dh_dAp_info_t, false>  TSparseBlocksJacobians_dh_dAp;  //!< The "false" is since we don't need to "remap" indices
+		typedef SparseBlockJacobian<double,OBS_DIMS,LM_DIMS,jacob_dh_df_info_t,  true >   TSparseBlocksJacobians_dh_df;  // The "true" is to "remap" indices
 	};
 
+	namespace internal
+	{
+		/** Selects the storage for Hf: block-diagonal or generic block-sparse. */
+		template <bool BLOCK_DIAGONAL, typename Scalar, int LM_DIMS, class INFO>
+		struct select_hessian_f { typedef SparseBlockMatrix<Scalar,LM_DIMS,LM_DIMS,INFO,false> type; };
+
+		template <typename Scalar, int LM_DIMS, class INFO>
+		struct select_hessian_f<true,Scalar,LM_DIMS,INFO> { typedef BlockDiagonalMatrix<Scalar,LM_DIMS,INFO> type; };
+	}
+
 	/** Types for the Hessian blocks:
 	  * \code
 	  *       [  H_Ap    |  H_Apf  ]
@@ -421,14 +972,17 @@ namespace srba
 
 		// (the final "false" in all types is because we don't need remapping of indices in hessians)
 		typedef SparseBlockMatrix<double,REL_POSE_DIMS , REL_POSE_DIMS , hessian_Ap_info_t , false> TSparseBlocksHessian_Ap;
-		typedef SparseBlockMatrix<double,LM_DIMS       , LM_DIMS       , hessian_f_info_t  , false> TSparseBlocksHessian_f;
+		/** Point landmarks are never involved two at a time in one observation, so Hf is block-diagonal for them */
+		typedef typename internal::select_hessian_f<LANDMARK_TYPE::jacob_family==jacob_point_landmark, double,LM_DIMS,hessian_f_info_t>::type TSparseBlocksHessian_f;
 		typedef SparseBlockMatrix<double,REL_POSE_DIMS , LM_DIMS       , hessian_Apf_info_t, false> TSparseBlocksHessian_Apf;
 
+		typedef Eigen::Matrix<double,LM_DIMS,LM_DIMS> landmark_inf_matrix_t; //!< Information matrix of one landmark
+
 		/** The list with all the information matrices (estimation uncertainty) for each unknown landmark. */
 		typedef mrpt::utils::map_as_vector<
 			TLandmarkID,
-			typename TSparseBlocksHessian_f::matrix_t,
-			typename mrpt::aligned_containers<std::pair<TLandmarkID,typename TSparseBlocksHessian_f::matrix_t > >::deque_t> landmarks2infmatrix_t;
+			landmark_inf_matrix_t,
+			typename mrpt::aligned_containers<std::pair<TLandmarkID,landmark_inf_matrix_t > >::deque_t> landmarks2infmatrix_t;
 	};
 
 
@@ -446,6 +1000,9 @@ namespace srba
 
 		typedef typename kf2kf_traits_t::k2k_edge_t k2k_edge_t;
 
+		/** Information matrix (inverse of covariance) of one observation. Unaligned, since it's stored in std:: containers of user-given observations. */
+		typedef Eigen::Matrix<double,obs_t::OBS_DIMS,obs_t::OBS_DIMS,Eigen::DontAlign> obs_information_matrix_t;
+
 		/** Observations, as provided by the user. The following combinations are possible:
 		  *  \code
 		  *  +-----------+---------------------------------------------+---------------------------------+
@@ -473,7 +1030,7 @@ namespace srba
 		struct new_kf_observation_t
 		{
 			/** Default ctor */
-			new_kf_observation_t() : is_fixed(false), is_unknown_with_init_val(false) { feat_rel_pos.setZero(); }
+			new_kf_observation_t() : is_fixed(false), is_unknown_with_init_val(false), obs_information(obs_information_matrix_t::Identity()) { feat_rel_pos.setZero(); }
 
 			typename obs_traits_t::observation_t  obs;
 
@@ -488,6 +1045,9 @@ namespace srba
 
 			typename lm_traits_t::array_landmark_t feat_rel_pos; //!< Ignored unless \a is_fixed OR \a is_unknown_with_init_val are true (only one of them at once).
 
+			/** The information matrix (inverse of covariance) of this observation. Ignored unless RBA_OPTIONS::obs_noise_matrix_t=options::observation_noise_per_observation (Default: identity) */
+			obs_information_matrix_t obs_information;
+
 			/** Sets \a feat_rel_pos from any object that offers a [] operator and has the expected length "landmark_t::LM_DIMS" */
 			template <class REL_POS> inline void setRelPos(const REL_POS &pos) {
 				for (size_t i=0;i<landmark_t::LM_DIMS;i++) feat_rel_pos[i]=pos[i];
@@ -566,6 +1126,43 @@ namespace srba
 
 		typedef std::deque<keyframe_info>  keyframe_vector_t;  //!< Index are "TKeyFrameID" IDs. There's no NEED to make this a deque<> for preservation of references, but is an efficiency improvement
 
+		/** Reusable working space for find_path_bfs() and find_path_astar(). Per-KF entries are only meaningful if their stamp equals the
+		  * current search \a generation, so starting a new search does not require clearing (nor reallocating) anything. */
+		struct TPathSearchWorkspace
+		{
+			TPathSearchWorkspace() : generation(0) { }
+
+			unsigned int                    generation;
+			std::vector<unsigned int>       stamp[2];     //!< Index [0]: search from the source KF; [1]: from the target KF (only in bidirectional BFS)
+			std::vector<topo_dist_t>        dist[2];      //!< Distance from the source (or target) KF
+			std::vector<TKeyFrameID>        prev[2];      //!< Previous KF in the path from the source (or target) KF
+			std::vector<const k2k_edge_t*>  prev_edge[2]; //!< Edge between each KF and its \a prev
+			std::vector<TKeyFrameID>        queue[2];     //!< BFS queues (popped by advancing an index, not erased)
+			std::vector<topo_dist_t>        heuristic;    //!< A* only: the heuristic distance to the target KF
+
+			/** Starts a new search in a graph of \a nKFs keyframes. Amortized O(1) */
+			void new_search(const size_t nKFs)
+			{
+				if (++generation==0)
+				{	// Wrap around: really reset all stamps (once every 2^32 searches)
+					for (int s=0;s<2;s++) stamp[s].assign(stamp[s].size(),0);
+					generation = 1;
+				}
+				for (int s=0;s<2;s++)
+				{
+					if (stamp[s].size()<nKFs)
+					{
+						stamp[s].resize(nKFs,0);
+						dist[s].resize(nKFs);
+						prev[s].resize(nKFs);
+						prev_edge[s].resize(nKFs);
+					}
+					queue[s].clear();
+				}
+				if (heuristic.size()<nKFs) heuristic.resize(nKFs);
+			}
+		};
+
 		struct TSpanningTree
 		{
 			/** The definition seems complex but behaves just like: std::map< TKeyFrameID, std::map<TKeyFrameID,TSpanTreeEntry> > */
@@ -619,6 +1216,10 @@ namespace srba
 			  */
 			typename kf2kf_pose_traits<kf2kf_pose_t>::TRelativePosesForEachTarget num;
 
+			/** Working space for the path searches of update_symbolic_new_node(), kept between calls so inserting a KF
+			  * does not allocate nor clear O(#KFs) entries each time */
+			TPathSearchWorkspace path_search_ws;
+
 			/** @} */
 
 
@@ -679,20 +1280,49 @@ namespace srba
 		}; // end of TSpanningTree
 
 
+		/** Compact record of one dh_dAp block, enough to create it on demand (see TLinearSystem::dh_dAp_lazy) */
+		struct TLazyJacobBlock_dh_dAp
+		{
+			size_t       obs_idx;
+			TKeyFrameID  kf_d;            //!< See TJacobianSymbolicInfo_dh_dAp::kf_d
+			bool         edge_normal_dir; //!< See TJacobianSymbolicInfo_dh_dAp::edge_normal_dir
+			unsigned int anchor_version;  //!< The TLandmarkEntry::anchor_version of the observed landmark when this record was created (the record is obsolete if it changed)
+
+			TLazyJacobBlock_dh_dAp(const size_t obs_idx_, const TKeyFrameID kf_d_, const bool edge_normal_dir_, const unsigned int anchor_version_) :
+				obs_idx(obs_idx_), kf_d(kf_d_), edge_normal_dir(edge_normal_dir_), anchor_version(anchor_version_) { }
+		};
+
+		/** All the dh_dAp blocks of one k2k edge in compact form, plus whether they are currently materialized in TLinearSystem::dh_dAp */
+		struct TLazyJacobColumn_dh_dAp
+		{
+			std::vector<TLazyJacobBlock_dh_dAp> blocks; //!< In increasing order of observation index, except for those of re-anchored landmarks
+			size_t last_used; //!< Value of TLinearSystem::dh_dAp_usage_counter at the last optimization involving this edge (0: not materialized)
+
+			TLazyJacobColumn_dh_dAp() : last_used(0) { }
+		};
+
 		struct TLinearSystem
 		{
 			TLinearSystem() :
 				dh_dAp(),
-				dh_df()
+				dh_df(),
+				dh_dAp_usage_counter(0)
 			{
 			}
 
-			typename jacobian_traits<kf2kf_pose_t,landmark_t,obs_t>::TSparseBlocksJacobians_dh_dAp dh_dAp;   //!< Both symbolic & numeric info on the sparse Jacobians wrt. the edges
+			typename jacobian_traits<kf2kf_pose_t,landmark_t,obs_t>::TSparseBlocksJacobians_dh_dAp dh_dAp;   //!< Both symbolic & numeric info on the sparse Jacobians wrt. the edges. Columns are only materialized while their edge takes part in optimizations (see \a dh_dAp_lazy)
 			typename jacobian_traits<kf2kf_pose_t,landmark_t,obs_t>::TSparseBlocksJacobians_dh_df  dh_df;    //!< Both symbolic & numeric info on the sparse Jacobians wrt. the observations
 
+			std::deque<TLazyJacobColumn_dh_dAp> dh_dAp_lazy;          //!< Indexed by k2k edge ID (as the columns of \a dh_dAp): the blocks of each column, in compact form
+			std::vector<size_t>                 dh_dAp_materialized;  //!< IDs of the k2k edges whose column in \a dh_dAp is materialized
+			size_t                              dh_dAp_usage_counter; //!< Incremented with each RbaEngine::optimize_edges()
+
 			void clear() {
 				dh_dAp.clearAll();
 				dh_df.clearAll();
+				dh_dAp_lazy.clear();
+				dh_dAp_materialized.clear();
+				dh_dAp_usage_counter = 0;
 			}
 
 		}; // end of TLinearSystem
@@ -710,6 +1340,10 @@ namespace srba
 		  * Note that if gaps occur in the observed feature IDs, some pointers here will be NULL and some mem will be wasted, but in turn we have a O(1) search mechanism for all LMs. */
 		typename mrpt::aligned_containers<TLandmarkEntry>::deque_t   all_lms;
 
+		/** Reverse index of \a all_observations, indexed by landmark ID (as \a all_lms): the global indices of all the observations of each landmark,
+		  * in increasing order. Maintained by RbaEngine::add_observation(). \sa find_covisible_keyframes */
+		std::deque<std::vector<size_t> > lm_observations;
+
 		TSpanningTree            spanning_tree;
 		all_observations_deque_t all_observations;  //!< All raw observation data (k2f edges)
 		TLinearSystem            lin_system;        //!< The sparse linear system of equations
@@ -721,6 +1355,42 @@ namespace srba
 		  */
 		std::deque<char>       all_observations_Jacob_validity;
 
+		/** Its size grows simultaneously to all_observations. Holds the IRLS weight of each observation, as computed
+		  *  by RBA_OPTIONS::robust_kernel_t in the last evaluation of residuals. Only used if the robust kernel is enabled.
+		  */
+		std::deque<double>     all_observations_robust_weight;
+
+		/** Its size grows simultaneously to all_observations. Non-zero for observations rejected by the chi-square gating
+		  *  (see TSRBAParameters::outlier_rejection), which are ignored from then on. Can be reset to 0 by the user to re-enable them.
+		  */
+		std::deque<char>       all_observations_is_outlier;
+
+		typedef typename RBA_OPTIONS::obs_noise_matrix_t::noise_data_per_obs_t noise_data_per_obs_t;
+		/** Its size grows simultaneously to all_observations. Holds the data that RBA_OPTIONS::obs_noise_matrix_t needs for each
+		  *  observation (e.g. its information matrix), contiguous in memory and indexed by the global observation index.
+		  */
+		typename mrpt::aligned_containers<noise_data_per_obs_t>::vector_t all_observations_noise_data;
+
+		/** The Jacobian dh_dx of one observation, as evaluated together with its residual by sensor models with observe_error_and_jacob() */
+		struct TObsFusedJacobian
+		{
+			TObsFusedJacobian() : epoch(static_cast<size_t>(-1)), valid(false) { }
+
+			Eigen::Matrix<double,obs_t::OBS_DIMS,landmark_t::LM_DIMS>  dh_dx;
+			size_t  epoch; //!< Only valid while equal to RbaEngine's current linearization epoch (see RbaEngine::invalidate_transform_cache())
+			bool    valid; //!< false if dh_dx is ill-defined at this point (e.g. points behind a camera)
+
+			MRPT_MAKE_ALIGNED_OPERATOR_NEW  // Required by Eigen containers
+		};
+		/** Only for sensor models with the fused observe_error_and_jacob(): its size grows simultaneously to all_observations.
+		  *  Holds dh_dx as evaluated together with the residuals, so the Jacobians at an accepted linearization point don't need to evaluate it again.
+		  */
+		typename mrpt::aligned_containers<TObsFusedJacobian>::vector_t all_observations_fused_dh_dx;
+
+		/** Observations of landmarks left out of the linear system because their observer KF was not within the spanning tree of the landmark base KF,
+		  *  indexed by landmark ID. They join the system if the landmark is re-anchored to a nearer base KF (see RbaEngine::reanchor_landmark()). */
+		std::map<TLandmarkID,std::vector<size_t> > unlinked_observations;
+
 		/** List of KFs touched by new KF2KF edges in the previous timesteps. Used in determine_kf2kf_edges_to_create() to bootstrap initial relative poses. */
 		std::set<size_t>       last_timestep_touched_kfs;  
 		/** @} */
@@ -733,9 +1403,15 @@ namespace srba
 			unknown_lms_inf_matrices.clear();
 			known_lms.clear();
 			all_lms.clear();
+			lm_observations.clear();
 			spanning_tree.clear();
 			all_observations.clear();
+			all_observations_robust_weight.clear();
+			all_observations_noise_data.clear();
+			all_observations_is_outlier.clear();
+			all_observations_fused_dh_dx.clear();
 			lin_system.clear();
+			unlinked_observations.clear();
 			last_timestep_touched_kfs.clear();
 		}
 
@@ -744,18 +1420,56 @@ namespace srba
 			spanning_tree.m_parent=this; // Not passed as ctor argument to avoid compiler warnings...
 		}
 
-		/** Auxiliary, brute force (BFS) method for finding the shortest path between any two Keyframes.
+
+		/** Auxiliary, brute force method for finding the shortest path between any two Keyframes, with a bidirectional breadth-first search (BFS),
+		  *  which only explores the balls around both KFs of radius ~half their distance.
 		  * Use only when the distance between nodes can be larger than the maximum depth of incrementally-built spanning trees
 		  * \param[in,out] out_path_IDs (Ignored if ==NULL) Just leave this vector uninitialized at input, it'll be automatically initialized to the right size and values.
 		  * \param[in,out] out_path_edges (Ignored if ==NULL) Just like out_path_IDs, but here you'll receive the list of traversed edges, instead of the IDs of the visited KFs.
+		  * \param[in] aux_ws Auxiliary working space: if NULL, a temporary one is allocated for this call. Pass the same TPathSearchWorkspace object to
+		  *  successive calls to save the allocation and initialization of O(#KFs) memory in each search (use one per thread for concurrent searches).
+		  *  All the searches done internally by SRBA use persistent workspaces (e.g. TSpanningTree::path_search_ws).
 		  * \return false if no path was found.
+		  * \sa find_path_astar
 		  */
 		bool find_path_bfs(
+			const TKeyFrameID           from,
+			const TKeyFrameID           to,
+			std::vector<TKeyFrameID>  * out_path_IDs,
+			typename kf2kf_pose_traits<kf2kf_pose_t>::k2k_edge_vector_t * out_path_edges = NULL,
+			TPathSearchWorkspace      * aux_ws = NULL) const;
+
+		/** Like find_path_bfs(), but with an A* search guided by the distances in the symbolic spanning trees (\a spanning_tree.sym.next_edge):
+		  *  the distance to the target is exactly known for KFs whose spanning tree contains it, and is at least \a max_depth+1 otherwise.
+		  *  The search ends as soon as it reaches any KF whose spanning tree contains the target, following the tree from there on.
+		  *  Only use it when the symbolic spanning trees are up-to-date and were built with depth \a max_depth (RbaEngine::parameters.srba.max_tree_depth).
+		  *  See find_path_bfs() for \a aux_ws.
+		  * \sa find_path_bfs
+		  */
+		bool find_path_astar(
+			const TKeyFrameID           from,
+			const TKeyFrameID           to,
+			const topo_dist_t           max_depth,
+			std::vector<TKeyFrameID>  * out_path_IDs,
+			typename kf2kf_pose_traits<kf2kf_pose_t>::k2k_edge_vector_t * out_path_edges = NULL,
+			TPathSearchWorkspace      * aux_ws = NULL) const;
+
+		/** The former, unidirectional BFS implementation of find_path_bfs(), without any reusable working space. Only kept as a reference for benchmarking
+		  *  and testing, since it explores the whole ball around \a from with radius the distance to \a to. */
+		bool find_path_bfs_unidirectional(
 			const TKeyFrameID           from,
 			const TKeyFrameID           to,
 			std::vector<TKeyFrameID>  * out_path_IDs,
 			typename kf2kf_pose_traits<kf2kf_pose_t>::k2k_edge_vector_t * out_path_edges = NULL) const;
 
+		/** Finds all the KFs which share at least \a min_shared_lms observed landmarks with \a kf_id (which is not included), sorted in descending order
+		  *  by the number of shared landmarks. Runs in O(sum of the track lengths of the landmarks observed from \a kf_id) thanks to \a lm_observations.
+		  */
+		void find_covisible_keyframes(
+			const TKeyFrameID   kf_id,
+			const size_t        min_shared_lms,
+			base_sorted_lst_t & out_covisible_kfs) const;
+
 
 		/** Computes stats on the degree (# of adjacent nodes) of all the nodes in the graph. Runs in O(N) with N=# of keyframes */
 		void compute_all_node_degrees(
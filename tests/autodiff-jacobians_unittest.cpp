@@ -0,0 +1,136 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#include <srba.h>
+#include <mrpt/random.h>
+
+#include <gtest/gtest.h>
+
+using namespace srba;
+using namespace std;
+using namespace mrpt::random;
+
+const size_t NUM_RANDOM_PTS = 200;
+
+// A few fixed points, then random ones (some of them behind the cameras):
+template <class SENSOR_MODEL>
+void get_test_point(const size_t k, typename SENSOR_MODEL::array_landmark_t & xji_l)
+{
+	const double lst_pts[][3] = { {1.0,2.0,5.0}, {-3.0,0.5,2.0}, {0.2,-4.0,10.0} };
+	const size_t nFixed = sizeof(lst_pts)/sizeof(lst_pts[0]);
+	for (size_t i=0;i<SENSOR_MODEL::LM_DIMS;i++)
+		xji_l[i] = k<nFixed ? lst_pts[k][i] : randomGenerator.drawUniform(-10.0,10.0);
+}
+
+// Compare the Jacobian dh_dx obtained by automatic differentiation of eval_observation<>() against the analytic one:
+template <class SENSOR_MODEL>
+void check_autodiff_dh_dx(const typename SENSOR_MODEL::TObservationParams & params)
+{
+	randomGenerator.randomize(4321);
+	for (size_t k=0;k<NUM_RANDOM_PTS;k++)
+	{
+		typename SENSOR_MODEL::array_landmark_t xji_l;
+		get_test_point<SENSOR_MODEL>(k,xji_l);
+
+		typename SENSOR_MODEL::TJacobian_dh_dx dh_dx_analytic, dh_dx_autodiff;
+		const bool valid_analytic = SENSOR_MODEL::eval_jacob_dh_dx(dh_dx_analytic,xji_l,params);
+		const bool valid_autodiff = autodiff::eval_jacob_dh_dx<SENSOR_MODEL>(dh_dx_autodiff,xji_l,params);
+
+		EXPECT_EQ(valid_analytic,valid_autodiff);
+		if (!valid_analytic || !valid_autodiff) continue;
+
+		EXPECT_NEAR((dh_dx_analytic-dh_dx_autodiff).array().abs().maxCoeff(),0.0, 1e-9)
+			<< "analytic:\n" << dh_dx_analytic << "\nautodiff:\n" << dh_dx_autodiff;
+	}
+}
+
+// observe_error() and eval_observation<>() must evaluate the same h(x'). The sensor pose is the identity, so lm_pos=xji_l:
+template <class SENSOR_MODEL, class POSE_T>
+void check_observe_error_vs_eval_observation(const typename SENSOR_MODEL::TObservationParams & params)
+{
+	typedef typename observation_traits<typename SENSOR_MODEL::OBS_T>::array_obs_t  array_obs_t;
+	const POSE_T identity_pose;
+
+	randomGenerator.randomize(4321);
+	for (size_t k=0;k<NUM_RANDOM_PTS;k++)
+	{
+		typename SENSOR_MODEL::array_landmark_t xji_l;
+		get_test_point<SENSOR_MODEL>(k,xji_l);
+
+		array_obs_t z_obs;
+		for (size_t i=0;i<SENSOR_MODEL::OBS_DIMS;i++)
+			z_obs[i] = randomGenerator.drawUniform(-10.0,10.0);
+
+		array_obs_t err, h;
+		SENSOR_MODEL::observe_error(err,z_obs,identity_pose,xji_l,params);
+		SENSOR_MODEL::template eval_observation<double>(&h[0],&xji_l[0],params);
+
+		EXPECT_NEAR((z_obs-h-err).array().abs().maxCoeff(),0.0, 1e-12)
+			<< "xji_l: " << xji_l.transpose() << "\nh: " << h.transpose() << "\nerr: " << err.transpose();
+	}
+}
+
+// A rectified stereo camera (the analytic dh_dx assumes no rotation between both cameras):
+static observations::StereoCamera::TObservationParams get_stereo_params()
+{
+	observations::StereoCamera::TObservationParams stereo_params;
+	stereo_params.camera_calib.leftCamera.setIntrinsicParamsFromValues(500.0,450.0,320.0,240.0);
+	stereo_params.camera_calib.rightCamera.setIntrinsicParamsFromValues(510.0,460.0,315.0,245.0);
+	stereo_params.camera_calib.rightCameraPose = mrpt::poses::CPose3DQuat( mrpt::poses::CPose3D(0.12,0,0, 0,0,0) );
+	return stereo_params;
+}
+
+TEST(AutoDiff,SensorModelsJacobians)
+{
+	observations::MonocularCamera::TObservationParams cam_params;
+	cam_params.camera_calib.setIntrinsicParamsFromValues(500.0,450.0,320.0,240.0);
+	check_autodiff_dh_dx<sensor_model<landmarks::Euclidean3D,observations::MonocularCamera> >(cam_params);
+
+	check_autodiff_dh_dx<sensor_model<landmarks::Euclidean3D,observations::StereoCamera> >(get_stereo_params());
+	check_autodiff_dh_dx<sensor_model<landmarks::Euclidean3D,observations::Cartesian_3D> >(observations::Cartesian_3D::TObservationParams());
+	check_autodiff_dh_dx<sensor_model<landmarks::Euclidean2D,observations::Cartesian_2D> >(observations::Cartesian_2D::TObservationParams());
+	check_autodiff_dh_dx<sensor_model<landmarks::Euclidean3D,observations::RangeBearing_3D> >(observations::RangeBearing_3D::TObservationParams());
+	check_autodiff_dh_dx<sensor_model<landmarks::Euclidean2D,observations::RangeBearing_2D> >(observations::RangeBearing_2D::TObservationParams());
+}
+
+TEST(AutoDiff,SensorModelsObservationFunction)
+{
+	observations::MonocularCamera::TObservationParams cam_params;
+	cam_params.camera_calib.setIntrinsicParamsFromValues(500.0,450.0,320.0,240.0);
+	check_observe_error_vs_eval_observation<sensor_model<landmarks::Euclidean3D,observations::MonocularCamera>,mrpt::poses::CPose3D>(cam_params);
+
+	check_observe_error_vs_eval_observation<sensor_model<landmarks::Euclidean3D,observations::StereoCamera>,mrpt::poses::CPose3D>(get_stereo_params());
+	check_observe_error_vs_eval_observation<sensor_model<landmarks::Euclidean3D,observations::Cartesian_3D>,mrpt::poses::CPose3D>(observations::Cartesian_3D::TObservationParams());
+	check_observe_error_vs_eval_observation<sensor_model<landmarks::Euclidean2D,observations::Cartesian_2D>,mrpt::poses::CPose2D>(observations::Cartesian_2D::TObservationParams());
+	check_observe_error_vs_eval_observation<sensor_model<landmarks::Euclidean3D,observations::RangeBearing_3D>,mrpt::poses::CPose3D>(observations::RangeBearing_3D::TObservationParams());
+	check_observe_error_vs_eval_observation<sensor_model<landmarks::Euclidean2D,observations::RangeBearing_2D>,mrpt::poses::CPose2D>(observations::RangeBearing_2D::TObservationParams());
+}
+
+TEST(AutoDiff,DualArithmetic)
+{
+	typedef autodiff::dual<2> dual_t;
+	const dual_t x(0.7,0), y(-1.3,1);
+
+	// f(x,y) = sin(x)*y + x/y + sqrt(x*x+y*y)
+	const dual_t f = sin(x)*y + x/y + sqrt(x*x+y*y);
+	const double r = std::sqrt(0.7*0.7+1.3*1.3);
+	EXPECT_NEAR(f.a, std::sin(0.7)*(-1.3) + 0.7/(-1.3) + r, 1e-12);
+	EXPECT_NEAR(f.v[0], std::cos(0.7)*(-1.3) + 1.0/(-1.3) + 0.7/r, 1e-12);
+	EXPECT_NEAR(f.v[1], std::sin(0.7) - 0.7/(1.3*1.3) + (-1.3)/r, 1e-12);
+}
+
+// With SRBA_USE_AUTODIFF_JACOBIANS, sensor models without eval_observation<>() must fall back to their analytic dh_dx:
+TEST(AutoDiff,SensorModelsWithoutObservationFunction)
+{
+	EXPECT_TRUE ((internal::has_eval_observation<sensor_model<landmarks::Euclidean3D,observations::MonocularCamera> >::value));
+	EXPECT_TRUE ((internal::has_eval_observation<sensor_model<landmarks::Euclidean3D,observations::StereoCamera> >::value));
+	EXPECT_TRUE ((internal::has_eval_observation<sensor_model<landmarks::Euclidean2D,observations::RangeBearing_2D> >::value));
+	EXPECT_FALSE((internal::has_eval_observation<sensor_model<landmarks::RelativePoses2D,observations::RelativePoses_2D> >::value));
+	EXPECT_FALSE((internal::has_eval_observation<sensor_model<landmarks::RelativePoses3D,observations::RelativePoses_3D> >::value));
+}
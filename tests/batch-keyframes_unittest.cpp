@@ -0,0 +1,118 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#include <srba.h>
+#include "test_problems.h"
+
+#include <gtest/gtest.h>
+
+using namespace srba;
+using namespace std;
+
+struct RBA_OPTIONS_BATCH_KFS : public RBA_OPTIONS_DEFAULT
+{
+	// Default ECP (local_areas_fixed_size): new KFs are connected to the center of their area,
+	// so most new edges need an initial guess from the previous KFs.
+};
+
+typedef RbaEngine<
+	kf2kf_poses::SE2,             // Parameterization  of KF-to-KF poses
+	landmarks::Euclidean2D,       // Parameterization of landmark positions
+	observations::Cartesian_2D,   // Type of observations
+	RBA_OPTIONS_BATCH_KFS
+	>  my_srba_t;
+
+// A noise-free strip problem (see test_problems.h), inserted in batches of BATCH_SIZE KFs.
+const size_t NUM_KFS    = 15;
+const size_t NUM_LMS    = strip_num_lms(NUM_KFS);
+const size_t BATCH_SIZE = 3; // NUM_KFS is a multiple of this
+
+static void init_problem(my_srba_t &rba)
+{
+	rba.setVerbosityLevel(0);
+	rba.get_time_profiler().disable();
+	rba.parameters.srba.max_tree_depth     = 3;
+	rba.parameters.srba.max_optimize_depth = 3;
+	rba.parameters.srba.optimize_new_edges_alone = true;
+	rba.parameters.ecp.submap_size         = 5;
+}
+
+// Inserting KFs in batches must create the same edges (with the same initial guesses) than inserting them
+// one by one, and converge to the same solution:
+TEST(BatchKeyframes, SameAsOneByOne)
+{
+	my_srba_t rba_batch, rba_incr;
+	init_problem(rba_batch);
+	init_problem(rba_incr);
+
+	my_srba_t::new_kf_observations_batch_t batch;
+	my_srba_t::new_kf_info_vector_t infos_incr, infos_batch;
+
+	for (size_t kf=0;kf<NUM_KFS;kf++)
+	{
+		my_srba_t::new_kf_observations_t  list_obs;
+		strip_kf_observations<my_srba_t>(kf, NUM_LMS, 0.0 /* no noise */, list_obs);
+
+		infos_incr.push_back(my_srba_t::TNewKeyFrameInfo());
+		rba_incr.define_new_keyframe(list_obs, infos_incr.back(), true);
+
+		batch.push_back(list_obs);
+		if (batch.size()==BATCH_SIZE)
+		{
+			my_srba_t::new_kf_info_vector_t new_kf_infos;
+			rba_batch.define_new_keyframes(batch, new_kf_infos, true);
+			infos_batch.insert(infos_batch.end(), new_kf_infos.begin(), new_kf_infos.end());
+			batch.clear();
+		}
+	}
+	ASSERT_EQ(NUM_KFS, infos_batch.size());
+
+	// Same graph:
+	size_t nEdgesToInit = 0;
+	for (size_t kf=0;kf<NUM_KFS;kf++)
+	{
+		const my_srba_t::TNewKeyFrameInfo & ib = infos_batch[kf], & ii = infos_incr[kf];
+		EXPECT_EQ(ii.kf_id, ib.kf_id);
+		ASSERT_EQ(ii.created_edge_ids.size(), ib.created_edge_ids.size()) << "kf=" << kf;
+		for (size_t j=0;j<ii.created_edge_ids.size();j++)
+		{
+			const my_srba_t::k2k_edge_t & eb = rba_batch.get_rba_state().k2k_edges[ ib.created_edge_ids[j].id ];
+			const my_srba_t::k2k_edge_t & ei = rba_incr.get_rba_state().k2k_edges[ ii.created_edge_ids[j].id ];
+			EXPECT_EQ(ei.from, eb.from) << "kf=" << kf;
+			EXPECT_EQ(ei.to,   eb.to)   << "kf=" << kf;
+			EXPECT_EQ(ii.created_edge_ids[j].has_approx_init_val, ib.created_edge_ids[j].has_approx_init_val) << "kf=" << kf;
+			if (!ib.created_edge_ids[j].has_approx_init_val)
+			{
+				nEdgesToInit++;
+				// Initialized right after creating its KF, as in define_new_keyframe():
+				EXPECT_GT(ib.optimize_results_stg1.num_observations, 0u) << "kf=" << kf;
+			}
+		}
+	}
+	EXPECT_GT(nEdgesToInit, 0u);  // Otherwise, this test wouldn't test anything
+
+	// Same solution (the ground truth, since there is no noise):
+	for (TKeyFrameID kf=0;kf<NUM_KFS;kf++)
+	{
+		const my_srba_t::pose_t * p_batch = rba_batch.get_global_pose(kf,0), * p_incr = rba_incr.get_global_pose(kf,0);
+		ASSERT_TRUE(p_batch!=NULL && p_incr!=NULL);
+		EXPECT_NEAR(p_incr->x(),   p_batch->x(),   1e-4) << "kf=" << kf;
+		EXPECT_NEAR(p_incr->y(),   p_batch->y(),   1e-4) << "kf=" << kf;
+		EXPECT_NEAR(p_incr->phi(), p_batch->phi(), 1e-4) << "kf=" << kf;
+		EXPECT_NEAR(static_cast<double>(kf), p_batch->x(), 1e-4) << "kf=" << kf;
+	}
+	for (size_t lm=0;lm<NUM_LMS;lm++)
+	{
+		double x_batch,y_batch, x_incr,y_incr;
+		lm_global_pos(rba_batch,lm,x_batch,y_batch);
+		lm_global_pos(rba_incr,lm,x_incr,y_incr);
+		EXPECT_NEAR(x_incr,x_batch,1e-4) << "lm_id=" << lm;
+		EXPECT_NEAR(y_incr,y_batch,1e-4) << "lm_id=" << lm;
+	}
+}
@@ -0,0 +1,135 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#include <srba.h>
+#include "test_problems.h"
+#include <mrpt/math/wrap2pi.h>
+#include <algorithm>
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+using namespace srba;
+using namespace mrpt::utils;
+using namespace std;
+using mrpt::poses::CPose2D;
+
+struct RBA_OPTIONS : public RBA_OPTIONS_DEFAULT
+{
+	typedef options::observation_noise_constant_matrix<observations::RelativePoses_2D>   obs_noise_matrix_t;      // The sensor noise matrix is the same for all observations and equal to some given matrix
+};
+
+typedef RbaEngine<
+	kf2kf_poses::SE2,               // Parameterization  of KF-to-KF poses
+	landmarks::RelativePoses2D,     // Parameterization of landmark positions
+	observations::RelativePoses_2D, // Type of observations
+	RBA_OPTIONS
+	>  my_srba_t;
+
+// A polygon problem (see test_problems.h). With submaps of 5 KFs, the area centers are #0, #5, #10, ...
+const size_t NUM_SIDES = 20;
+
+static void init_problem(my_srba_t &rba)
+{
+	rba.get_time_profiler().disable();
+	rba.setVerbosityLevel( 0 );
+
+	rba.parameters.obs_noise.lambda.setIdentity();
+	rba.parameters.srba.max_tree_depth       =
+	rba.parameters.srba.max_optimize_depth   = 3;
+	rba.parameters.srba.coarse_layer         = true;
+	rba.parameters.ecp.submap_size           = 5;
+	rba.parameters.ecp.min_obs_to_loop_closure = 1;
+}
+
+// Max. position error of the coarse graph nodes wrt the ground truth
+static double max_center_error(const my_srba_t &rba)
+{
+	double max_err = 0;
+	const my_srba_t::TCoarseGraph & cg = rba.get_coarse_graph();
+	for (mrpt::graphs::CNetworkOfPoses2D::global_poses_t::const_iterator it=cg.graph.nodes.begin();it!=cg.graph.nodes.end();++it)
+	{
+		EXPECT_EQ(it->first % 5, 0u);
+		const CPose2D gt = polygon_gt_pose(it->first,NUM_SIDES);
+		max_err = std::max(max_err, std::sqrt( mrpt::utils::square(it->second.x()-gt.x()) + mrpt::utils::square(it->second.y()-gt.y()) ) );
+	}
+	return max_err;
+}
+
+TEST(CoarseGraph, LoopClosureReducesDrift)
+{
+	my_srba_t rba;
+	init_problem(rba);
+
+	double err_before_closure = 0;
+	for (size_t kf=0;kf<=NUM_SIDES;kf++)
+	{
+		my_srba_t::new_kf_observations_t  list_obs;
+		polygon_kf_observations<my_srba_t>(kf,NUM_SIDES,list_obs);
+
+		if (kf==NUM_SIDES)
+			err_before_closure = max_center_error(rba);
+
+		my_srba_t::TNewKeyFrameInfo new_kf_info;
+		rba.define_new_keyframe(list_obs, new_kf_info, true);
+
+		EXPECT_EQ(rba.get_coarse_graph().num_optimizations, kf<NUM_SIDES ? 0u : 1u) << "kf=" << kf;
+	}
+
+	// Nodes: only the area centers:
+	const my_srba_t::TCoarseGraph & cg = rba.get_coarse_graph();
+	EXPECT_EQ(cg.graph.nodes.size(), NUM_SIDES/5+1);
+	EXPECT_TRUE(cg.pending_k2k_edge_ids.empty());
+
+	const double err_after_closure = max_center_error(rba);
+	EXPECT_GT(err_before_closure, 0.1); // Make sure the odometry bias is noticeable
+	EXPECT_LT(err_after_closure, 0.5*err_before_closure);
+}
+
+TEST(CoarseGraph, BatchesOfKeyframes)
+{
+	my_srba_t rba_batch, rba_incr;
+	init_problem(rba_batch);
+	init_problem(rba_incr);
+
+	const size_t BATCH_SIZE = 3; // NUM_SIDES+1 is a multiple of this
+	my_srba_t::new_kf_observations_batch_t batch;
+	for (size_t kf=0;kf<=NUM_SIDES;kf++)
+	{
+		my_srba_t::new_kf_observations_t  list_obs;
+		polygon_kf_observations<my_srba_t>(kf,NUM_SIDES,list_obs);
+
+		my_srba_t::TNewKeyFrameInfo new_kf_info;
+		rba_incr.define_new_keyframe(list_obs, new_kf_info, true);
+
+		batch.push_back(list_obs);
+		if (batch.size()==BATCH_SIZE)
+		{
+			my_srba_t::new_kf_info_vector_t new_kf_infos;
+			rba_batch.define_new_keyframes(batch, new_kf_infos, true);
+			batch.clear();
+
+			// The coarse graph is only updated after optimizing the whole batch:
+			EXPECT_TRUE(rba_batch.get_coarse_graph().new_k2k_edge_ids.empty());
+		}
+	}
+
+	const my_srba_t::TCoarseGraph & cg_batch = rba_batch.get_coarse_graph();
+	const my_srba_t::TCoarseGraph & cg_incr  = rba_incr.get_coarse_graph();
+	EXPECT_EQ(cg_batch.num_optimizations, 1u);
+	ASSERT_EQ(cg_batch.graph.nodes.size(), cg_incr.graph.nodes.size());
+
+	for (mrpt::graphs::CNetworkOfPoses2D::global_poses_t::const_iterator it=cg_batch.graph.nodes.begin();it!=cg_batch.graph.nodes.end();++it)
+	{
+		const CPose2D & p_incr = cg_incr.graph.nodes.find(it->first)->second;
+		EXPECT_NEAR(it->second.x(), p_incr.x(), 1e-3) << "kf=" << it->first;
+		EXPECT_NEAR(it->second.y(), p_incr.y(), 1e-3) << "kf=" << it->first;
+		EXPECT_NEAR(mrpt::math::wrapToPi(it->second.phi()-p_incr.phi()), 0.0, 1e-3) << "kf=" << it->first;
+	}
+}
@@ -0,0 +1,132 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#include <srba.h>
+#include <cmath>
+#include <limits>
+
+#include <gtest/gtest.h>
+
+using namespace srba;
+using namespace std;
+
+struct RBA_OPTIONS_COVISIBILITY : public RBA_OPTIONS_DEFAULT
+{
+	typedef ecps::classic_linear_rba  edge_creation_policy_t;  // A plain chain of KFs
+};
+
+typedef RbaEngine<
+	kf2kf_poses::SE2,             // Parameterization  of KF-to-KF poses
+	landmarks::Euclidean2D,       // Parameterization of landmark positions
+	observations::Cartesian_2D,   // Type of observations
+	RBA_OPTIONS_COVISIBILITY
+	>  my_srba_t;
+
+// A straight trajectory along the X axis (KF #i at x=i), with landmarks at both sides seen from all the KFs
+// closer than SENSOR_RANGE in X. KF #REPEATED_KF observes landmark #REPEATED_LM twice.
+const size_t NUM_KFS      = 10;
+const size_t NUM_LMS      = 2*NUM_KFS;
+const double SENSOR_RANGE = 2.0;
+const size_t REPEATED_KF  = 3;
+const size_t REPEATED_LM  = 4;
+
+static double lm_x(const size_t lm_id) { return 0.5*lm_id; }
+static bool   is_visible(const size_t kf, const size_t lm) { return std::abs(lm_x(lm)-kf)<=SENSOR_RANGE; }
+
+static void build_problem(my_srba_t &rba)
+{
+	rba.setVerbosityLevel(0);
+	rba.get_time_profiler().disable();
+
+	for (size_t kf=0;kf<NUM_KFS;kf++)
+	{
+		my_srba_t::new_kf_observations_t  list_obs;
+		my_srba_t::new_kf_observation_t   obs_field;
+		obs_field.is_fixed = false;
+		obs_field.is_unknown_with_init_val = false;
+
+		for (size_t lm=0;lm<NUM_LMS;lm++)
+		{
+			if (!is_visible(kf,lm))
+				continue;
+			obs_field.obs.feat_id = lm;
+			obs_field.obs.obs_data.pt.x = lm_x(lm)-kf;
+			obs_field.obs.obs_data.pt.y = (lm%2) ? 2.0 : -2.0;
+			list_obs.push_back(obs_field);
+			if (kf==REPEATED_KF && lm==REPEATED_LM)
+				list_obs.push_back(obs_field);
+		}
+
+		my_srba_t::TNewKeyFrameInfo new_kf_info;
+		rba.define_new_keyframe(list_obs,new_kf_info,false /* no need to optimize */);
+	}
+}
+
+// Compare against a brute-force count of the shared landmarks, from the ground-truth visibility:
+static void check_covisibility(const my_srba_t &rba, const size_t min_shared_lms)
+{
+	for (TKeyFrameID kf=0;kf<NUM_KFS;kf++)
+	{
+		base_sorted_lst_t covisible;
+		rba.find_covisible_keyframes(kf,min_shared_lms,covisible);
+
+		std::map<TKeyFrameID,size_t> expected;
+		for (TKeyFrameID other=0;other<NUM_KFS;other++)
+		{
+			if (other==kf) continue;
+			size_t n=0;
+			for (size_t lm=0;lm<NUM_LMS;lm++)
+				if (is_visible(kf,lm) && is_visible(other,lm))
+					n++;
+			if (n>=min_shared_lms)
+				expected[other]=n;
+		}
+
+		EXPECT_EQ(expected.size(), covisible.size()) << "kf=" << kf;
+		size_t last_count = std::numeric_limits<size_t>::max();
+		for (base_sorted_lst_t::const_iterator it=covisible.begin();it!=covisible.end();++it)
+		{
+			EXPECT_LE(it->first, last_count) << "Not in descending order";
+			last_count = it->first;
+			ASSERT_TRUE(expected.count(it->second)) << "kf=" << kf << " other=" << it->second;
+			EXPECT_EQ(expected[it->second], it->first) << "kf=" << kf << " other=" << it->second;
+		}
+	}
+}
+
+TEST(CovisibleKeyframes, RepeatedObservationsCountOnce)
+{
+	my_srba_t rba;
+	build_problem(rba);
+
+	// The reverse index includes the repeated observation:
+	const my_srba_t::rba_problem_state_t & st = rba.get_rba_state();
+	size_t nObsRepeatedLM = 0;
+	for (size_t kf=0;kf<NUM_KFS;kf++)
+		if (is_visible(kf,REPEATED_LM)) nObsRepeatedLM++;
+	ASSERT_GT(st.lm_observations.size(), REPEATED_LM);
+	EXPECT_EQ(nObsRepeatedLM+1, st.lm_observations[REPEATED_LM].size());
+
+	check_covisibility(rba, 1);
+	check_covisibility(rba, 3);
+}
+
+TEST(CovisibleKeyframes, ClearResetsReverseIndex)
+{
+	my_srba_t rba;
+	build_problem(rba);
+	ASSERT_FALSE(rba.get_rba_state().lm_observations.empty());
+
+	rba.clear();
+	EXPECT_TRUE(rba.get_rba_state().lm_observations.empty());
+
+	// Rebuilding after clear() gives the same results (no stale observations left):
+	build_problem(rba);
+	check_covisibility(rba, 1);
+}
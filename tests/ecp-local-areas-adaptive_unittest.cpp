@@ -0,0 +1,97 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#include <srba.h>
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+using namespace srba;
+using namespace std;
+
+struct RBA_OPTIONS : public RBA_OPTIONS_DEFAULT
+{
+	typedef ecps::local_areas_adaptive  edge_creation_policy_t;
+};
+
+typedef RbaEngine<
+	kf2kf_poses::SE2,             // Parameterization  of KF-to-KF poses
+	landmarks::Euclidean2D,       // Parameterization of landmark positions
+	observations::Cartesian_2D,   // Type of observations
+	RBA_OPTIONS
+	>  my_srba_t;
+
+// A straight trajectory along the X axis, with landmarks every 0.5m at both sides
+// seen from all the KFs closer than SENSOR_RANGE in X: noise-free observations.
+const size_t NUM_KFS      = 40;
+const double SENSOR_RANGE = 4.0;
+
+// Returns the mean number of KFs per area
+static double run_trajectory(my_srba_t &rba, const double kf_step)
+{
+	rba.setVerbosityLevel(0);
+	rba.get_time_profiler().disable();
+
+	const size_t nLMs = static_cast<size_t>( (kf_step*NUM_KFS+SENSOR_RANGE)/0.5 );
+
+	for (size_t kf=0;kf<NUM_KFS;kf++)
+	{
+		const double kf_x = kf*kf_step;
+
+		my_srba_t::new_kf_observations_t  list_obs;
+		my_srba_t::new_kf_observation_t   obs_field;
+		obs_field.is_fixed = false;
+		obs_field.is_unknown_with_init_val = false;
+
+		for (size_t lm=0;lm<nLMs;lm++)
+		{
+			const double x = 0.5*lm, y = (lm%2) ? 2.0 : -2.0;
+			if (std::abs(x-kf_x)>SENSOR_RANGE)
+				continue;
+			obs_field.obs.feat_id = lm;
+			obs_field.obs.obs_data.pt.x = x-kf_x;
+			obs_field.obs.obs_data.pt.y = y;
+			list_obs.push_back(obs_field);
+		}
+
+		my_srba_t::TNewKeyFrameInfo new_kf_info;
+		rba.define_new_keyframe(list_obs,new_kf_info,true);
+	}
+
+	// Areas must be made of consecutive KFs, starting at their center:
+	size_t nAreas = 0;
+	for (TKeyFrameID kf=0;kf<NUM_KFS;kf++)
+	{
+		const TKeyFrameID center = rba.edge_creation_policy.get_center_kf_for_kf(kf,rba.parameters.ecp);
+		EXPECT_LE(center,kf);
+		if (center==kf)
+			nAreas++;
+		else EXPECT_EQ(center, rba.edge_creation_policy.get_center_kf_for_kf(kf-1,rba.parameters.ecp));
+	}
+	return double(NUM_KFS)/nAreas;
+}
+
+TEST(ECP_LocalAreasAdaptive, AreaSizeFollowsCovisibility)
+{
+	my_srba_t rba_slow, rba_fast;
+	const double mean_area_slow = run_trajectory(rba_slow, 0.2);
+	const double mean_area_fast = run_trajectory(rba_fast, 1.5);
+
+	EXPECT_GT(mean_area_slow, mean_area_fast);
+	EXPECT_LE(mean_area_slow, rba_slow.parameters.ecp.max_submap_size);
+	EXPECT_GE(mean_area_fast, rba_fast.parameters.ecp.min_submap_size);
+}
+
+TEST(ECP_LocalAreasAdaptive, ClearResetsAreas)
+{
+	my_srba_t rba;
+	run_trajectory(rba, 1.5);
+	rba.clear();
+	run_trajectory(rba, 1.5); // Would throw if the areas of the previous map were kept
+}
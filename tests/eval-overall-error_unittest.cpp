@@ -0,0 +1,80 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#include <srba.h>
+#include "test_problems.h"
+
+#include <gtest/gtest.h>
+
+using namespace srba;
+using namespace std;
+
+struct RBA_OPTIONS_EVAL_ERROR : public RBA_OPTIONS_DEFAULT
+{
+	typedef ecps::classic_linear_rba  edge_creation_policy_t;  // A plain chain of KFs
+};
+
+typedef RbaEngine<
+	kf2kf_poses::SE2,             // Parameterization  of KF-to-KF poses
+	landmarks::Euclidean2D,       // Parameterization of landmark positions
+	observations::Cartesian_2D,   // Type of observations
+	RBA_OPTIONS_EVAL_ERROR
+	>  my_srba_t;
+
+// A strip problem (see test_problems.h). KFs form a chain (no loops), so relative poses composed along the
+// complete spanning tree and along shortest paths must be the same.
+const size_t NUM_KFS      = 20;
+const double STD_NOISE    = 0.05;
+
+TEST(EvalOverallError, SingleSpanningTreeAndPerObservationErrors)
+{
+	my_srba_t rba;
+	rba.setVerbosityLevel(0);
+	rba.get_time_profiler().disable();
+	rba.parameters.srba.max_tree_depth     = 3;
+	rba.parameters.srba.max_optimize_depth = 3;
+
+	build_strip_problem(rba, NUM_KFS, STD_NOISE);
+
+	const size_t nObs = rba.get_rba_state().all_observations.size();
+
+	// Default: shortest paths, no per-observation output
+	const double err_default = rba.eval_overall_squared_error();
+	EXPECT_GT(err_default, 0.0);
+
+	// Per-observation errors, with several chunk sizes (the total must not depend on them):
+	const size_t lst_chunk_sizes[] = { 1, 7, 4096 };
+	for (size_t c=0;c<sizeof(lst_chunk_sizes)/sizeof(lst_chunk_sizes[0]);c++)
+	{
+		for (int single_st=0;single_st<2;single_st++)
+		{
+			for (TKeyFrameID root=0;root<NUM_KFS;root+=NUM_KFS/2)
+			{
+				std::vector<double> obs_sqerr(3, -1.0); // Must be overwritten
+				my_srba_t::TEvalOverallErrorParams params;
+				params.single_spanning_tree = (single_st!=0);
+				params.root_kf_id           = root;
+				params.parallel_chunk_size  = lst_chunk_sizes[c];
+				params.out_obs_sqerr        = &obs_sqerr;
+
+				const double err = rba.eval_overall_squared_error(params);
+				EXPECT_NEAR(err_default, err, 1e-9*err_default) << "single_spanning_tree=" << single_st << " root=" << root << " chunk_size=" << lst_chunk_sizes[c];
+
+				ASSERT_EQ(nObs, obs_sqerr.size());
+				double sum = 0;
+				for (size_t i=0;i<nObs;i++)
+				{
+					EXPECT_GE(obs_sqerr[i], 0.0);
+					sum += obs_sqerr[i];
+				}
+				EXPECT_NEAR(err, sum, 1e-9*err);
+			}
+		}
+	}
+}
@@ -18,13 +18,17 @@ using namespace mrpt::utils;
 using namespace std;
 
 // --------------------------------------------------------------------------------
-// Declare a typedef "my_srba_t" for easily referring to my RBA problem type:
+// Declare a template "my_srba_t" for easily referring to my RBA problem type:
 // --------------------------------------------------------------------------------
-typedef RbaEngine<
-	kf2kf_poses::SE3, // Parameterization  of KF-to-KF poses
-	landmarks::Euclidean3D, // Parameterization of landmark positions
-	observations::Cartesian_3D // Type of observations
-	>  my_srba_t;
+template <class KF2KF_POSE_TYPE>
+struct my_srba_t
+{
+	typedef RbaEngine<
+		KF2KF_POSE_TYPE, // Parameterization  of KF-to-KF poses (kf2kf_poses::SE3 or kf2kf_poses::SE3_fast)
+		landmarks::Euclidean3D, // Parameterization of landmark positions
+		observations::Cartesian_3D // Type of observations
+		>  type;
+};
 
 // --------------------------------------------------------------------------------
 // A test dataset. Generated with https://github.com/jlblancoc/recursive-world-toolkit 
@@ -43,10 +47,11 @@ basic_euclidean_dataset_entry_t  dummy_obs[] = {
  {    3,   4 , -2,  9 },
 };
 
-template <bool INVERSE_INCR>
+template <class KF2KF_POSE_TYPE, bool INVERSE_INCR>
 void run_test(const mrpt::poses::CPose3D &incr)
 {
-	my_srba_t rba;     //  Create an empty RBA problem
+	typedef typename my_srba_t<KF2KF_POSE_TYPE>::type srba_t;
+	srba_t rba;     //  Create an empty RBA problem
 
 	rba.get_time_profiler().disable();
 
@@ -65,8 +70,8 @@ void run_test(const mrpt::poses::CPose3D &incr)
 	// --------------------------------------------------------------------------------
 	// Define observations of KF #0:
 	// --------------------------------------------------------------------------------
-	my_srba_t::new_kf_observations_t  list_obs;
-	my_srba_t::new_kf_observation_t   obs_field;
+	typename srba_t::new_kf_observations_t  list_obs;
+	typename srba_t::new_kf_observation_t   obs_field;
 
 	obs_field.is_fixed = false;   // Landmarks have unknown relative positions (i.e. treat them as unknowns to be estimated)
 	obs_field.is_unknown_with_init_val = false; // We don't have any guess on the initial LM position (will invoke the inverse sensor model)
@@ -83,7 +88,7 @@ void run_test(const mrpt::poses::CPose3D &incr)
 
 	//  Here happens the main stuff: create Key-frames, build structures, run optimization, etc.
 	//  ============================================================================================
-	my_srba_t::TNewKeyFrameInfo new_kf_info;
+	typename srba_t::TNewKeyFrameInfo new_kf_info;
 	rba.define_new_keyframe(
 		list_obs,      // Input observations for the new KF
 		new_kf_info,   // Output info
@@ -172,7 +177,19 @@ TEST(MiniProblems,FixedTransformations)
 		const double *p = test_fixed_transfs[i];
 
 		const mrpt::poses::CPose3D incr(p[0],p[1],p[2],p[3],p[4],p[5]);
-		run_test<false>(incr);
-		run_test<true>(incr);
+		run_test<kf2kf_poses::SE3,false>(incr);
+		run_test<kf2kf_poses::SE3,true>(incr);
+	}
+}
+
+TEST(MiniProblems,FixedTransformationsSE3Fast)
+{
+	for (size_t i=0;i<sizeof(test_fixed_transfs)/sizeof(test_fixed_transfs[0]);i++)
+	{
+		const double *p = test_fixed_transfs[i];
+
+		const mrpt::poses::CPose3D incr(p[0],p[1],p[2],p[3],p[4],p[5]);
+		run_test<kf2kf_poses::SE3_fast,false>(incr);
+		run_test<kf2kf_poses::SE3_fast,true>(incr);
 	}
 }
@@ -0,0 +1,91 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#include <srba.h>
+#include "test_problems.h"
+#include <mrpt/math/wrap2pi.h>
+
+#include <gtest/gtest.h>
+
+using namespace srba;
+using namespace mrpt::utils;
+using namespace std;
+using mrpt::poses::CPose2D;
+
+struct RBA_OPTIONS_GLOBAL_POSES : public RBA_OPTIONS_DEFAULT
+{
+	typedef options::observation_noise_constant_matrix<observations::RelativePoses_2D>   obs_noise_matrix_t;
+};
+
+typedef RbaEngine<
+	kf2kf_poses::SE2,               // Parameterization  of KF-to-KF poses
+	landmarks::RelativePoses2D,     // Parameterization of landmark positions
+	observations::RelativePoses_2D, // Type of observations
+	RBA_OPTIONS_GLOBAL_POSES
+	>  my_srba_t;
+
+// A polygon problem (see test_problems.h): the biased odometry makes each optimization modify the edges,
+// and the loop closure at the last KF shortens the paths of the spanning tree from KF #0.
+const size_t NUM_SIDES = 16;
+
+// The cached global poses must match those of a complete spanning tree built from scratch:
+static void check_against_complete_spanning_tree(const my_srba_t &rba, const TKeyFrameID root_id, const size_t kf_step)
+{
+	my_srba_t::frameid2pose_map_t tree, cached;
+	rba.create_complete_spanning_tree(root_id, tree);
+	rba.get_global_poses(root_id, cached);
+
+	EXPECT_EQ(tree.size(), cached.size()) << "root=" << root_id << " kf_step=" << kf_step;
+	for (my_srba_t::frameid2pose_map_t::const_iterator it=tree.begin();it!=tree.end();++it)
+	{
+		const my_srba_t::pose_t * p = rba.get_global_pose(it->first, root_id);
+		ASSERT_TRUE(p!=NULL) << "kf=" << it->first;
+		EXPECT_NEAR(p->x(), it->second.pose.x(), 1e-9) << "kf=" << it->first << " root=" << root_id << " kf_step=" << kf_step;
+		EXPECT_NEAR(p->y(), it->second.pose.y(), 1e-9) << "kf=" << it->first << " root=" << root_id << " kf_step=" << kf_step;
+		EXPECT_NEAR(mrpt::math::wrapToPi(p->phi()-it->second.pose.phi()), 0.0, 1e-9) << "kf=" << it->first << " root=" << root_id << " kf_step=" << kf_step;
+
+		const my_srba_t::frameid2pose_map_t::const_iterator it_c = cached.find(it->first);
+		ASSERT_TRUE(it_c!=cached.end());
+		EXPECT_NEAR(it_c->second.pose.x(), it->second.pose.x(), 1e-9);
+		EXPECT_NEAR(it_c->second.pose.y(), it->second.pose.y(), 1e-9);
+	}
+}
+
+TEST(GlobalPoseCache, MatchesCompleteSpanningTree)
+{
+	my_srba_t rba;
+	rba.get_time_profiler().disable();
+	rba.setVerbosityLevel( 0 );
+	rba.parameters.obs_noise.lambda.setIdentity();
+	rba.parameters.srba.max_tree_depth       =
+	rba.parameters.srba.max_optimize_depth   = 3;
+	rba.parameters.ecp.submap_size           = 4;
+	rba.parameters.ecp.min_obs_to_loop_closure = 1;
+
+	for (size_t kf=0;kf<=NUM_SIDES;kf++)
+	{
+		my_srba_t::new_kf_observations_t  list_obs;
+		polygon_kf_observations<my_srba_t>(kf,NUM_SIDES,list_obs);
+
+		// Query before adding the KF, so the cache is updated incrementally with the optimized edges:
+		if (kf>0)
+		{
+			ASSERT_TRUE(rba.get_global_pose(kf-1,0)!=NULL);
+		}
+
+		my_srba_t::TNewKeyFrameInfo new_kf_info;
+		rba.define_new_keyframe(list_obs, new_kf_info, true);
+
+		check_against_complete_spanning_tree(rba, 0, kf);
+	}
+
+	// Other roots (complete rebuilds of the cache), and back to root #0:
+	check_against_complete_spanning_tree(rba, NUM_SIDES/2, NUM_SIDES);
+	check_against_complete_spanning_tree(rba, 0, NUM_SIDES);
+}
@@ -0,0 +1,157 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#include <srba.h>
+#include <mrpt/random.h>
+
+#include <gtest/gtest.h>
+
+using namespace srba;
+using namespace mrpt::random;
+using namespace std;
+
+typedef RbaEngine<
+	kf2kf_poses::SE3, // Parameterization  of KF-to-KF poses
+	landmarks::Euclidean3D, // Parameterization of landmark positions
+	observations::Cartesian_3D // Type of observations
+	>  my_srba_t;
+
+typedef my_srba_t::jacobian_traits_t::TSparseBlocksJacobians_dh_dAp::col_t  col_dh_dAp_t;
+typedef my_srba_t::jacobian_traits_t::TSparseBlocksJacobians_dh_df::col_t   col_dh_df_t;
+
+// Reference implementation: intersect every pair of Jacobian columns (i,j), and store the list of terms of each nonzero
+// block indexed by (storage column, storage row): (j,i) for the upper triangle of square Hessians, (i,j) (by rows) otherwise.
+template <class ENTRY, class COL_I, class COL_J>
+void build_symbolic_pairwise(map<pair<size_t,size_t>, vector<ENTRY> > & H, const vector<COL_I*> & cols_i, const vector<COL_J*> & cols_j, const bool upper_triangle)
+{
+	H.clear();
+	for (size_t i=0;i<cols_i.size();i++)
+	{
+		for (size_t j=(upper_triangle ? i:0);j<cols_j.size();j++)
+		{
+			vector<ENTRY> Hij;
+			typename COL_I::const_iterator it_i = cols_i[i]->begin();
+			typename COL_J::const_iterator it_j = cols_j[j]->begin();
+			while (it_i!=cols_i[i]->end() && it_j!=cols_j[j]->end())
+			{
+				if ( it_i->first < it_j->first ) ++it_i;
+				else if ( it_j->first < it_i->first ) ++it_j;
+				else
+				{
+					Hij.push_back( ENTRY(&it_i->second.num, &it_j->second.num, it_i->second.sym.is_valid,it_j->second.sym.is_valid, it_i->first ) );
+					++it_i; ++it_j;
+				}
+			}
+			if (!Hij.empty())
+				H[upper_triangle ? make_pair(j,i) : make_pair(i,j)].swap(Hij);
+		}
+	}
+}
+
+template <class HESS>
+void expect_same_symbolic(const HESS & H, const map<pair<size_t,size_t>, typename HESS::symbolic_t::list_jacob_blocks_t> & H_ref, const char *name)
+{
+	typedef typename HESS::symbolic_t::THessianSymbolicInfoEntry entry_t;
+
+	size_t nBlocks = 0;
+	for (size_t c=0;c<H.getColCount();c++)
+	{
+		const typename HESS::col_t & col = H.getCol(c);
+		for (typename HESS::col_t::const_iterator it=col.begin();it!=col.end();++it)
+		{
+			const typename HESS::symbolic_t & sym = it->second.sym;
+			if (!sym.num_jacob_blocks) continue;
+
+			// Blocks are numbered in storage order in the flat structure:
+			ASSERT_LT(nBlocks, H.symbolic_csr.getBlockCount()) << name;
+			EXPECT_EQ(H.symbolic_csr.blocks[nBlocks], &it->second) << name;
+			EXPECT_EQ(H.symbolic_csr.offsets[nBlocks], sym.first_jacob_block) << name;
+			EXPECT_EQ(H.symbolic_csr.offsets[nBlocks+1]-H.symbolic_csr.offsets[nBlocks], sym.num_jacob_blocks) << name;
+			nBlocks++;
+
+			typename map<pair<size_t,size_t>, vector<entry_t> >::const_iterator it_ref = H_ref.find(make_pair(c,it->first));
+			ASSERT_TRUE(it_ref!=H_ref.end()) << name << " col=" << c << " row=" << it->first;
+			const vector<entry_t> & l_ref = it_ref->second;
+			ASSERT_EQ(sym.num_jacob_blocks, l_ref.size()) << name << " col=" << c << " row=" << it->first;
+
+			const entry_t * l = H.symbolic_csr.getBlockTerms(sym);
+			for (size_t k=0;k<l_ref.size();k++)
+			{
+				EXPECT_EQ(l[k].J1, l_ref[k].J1);
+				EXPECT_EQ(l[k].J2, l_ref[k].J2);
+				EXPECT_EQ(l[k].J1_valid, l_ref[k].J1_valid);
+				EXPECT_EQ(l[k].J2_valid, l_ref[k].J2_valid);
+				EXPECT_EQ(l[k].obs_idx, l_ref[k].obs_idx);
+			}
+		}
+	}
+	EXPECT_EQ(nBlocks, H_ref.size()) << name;
+	EXPECT_EQ(nBlocks, H.symbolic_csr.getBlockCount()) << name;
+}
+
+// Random Jacobians where each observation depends on a random subset of k2k edges (as with a path in the
+// spanning tree) and on one landmark (Hf is then block-diagonal):
+void test_symbolic_vs_pairwise(const uint32_t random_seed, const size_t nUnknowns_k2k, const size_t nUnknowns_k2f, const size_t nObs)
+{
+	randomGenerator.randomize(random_seed);
+
+	my_srba_t::rba_problem_state_t::TLinearSystem  lin_system;
+	lin_system.dh_dAp.setColCount(nUnknowns_k2k);
+	lin_system.dh_df.setColCount(nUnknowns_k2f);
+
+	vector<char> obs_valid(nObs, 1);
+	for (size_t n=0;n<nObs;n++)
+	{
+		// Observation indices don't need to be contiguous:
+		const size_t obs_idx = 3*n + randomGenerator.drawUniform32bit()%3;
+
+		for (size_t i=0;i<nUnknowns_k2k;i++)
+			if (randomGenerator.drawUniform(0.0,1.0)<0.3)
+				lin_system.dh_dAp.getCol(i)[obs_idx].sym.is_valid = &obs_valid[n];
+
+		lin_system.dh_df.getCol( randomGenerator.drawUniform32bit()%nUnknowns_k2f )[obs_idx].sym.is_valid = &obs_valid[n];
+	}
+
+	vector<col_dh_dAp_t*> dh_dAp;
+	vector<col_dh_df_t*>  dh_df;
+	for (size_t i=0;i<nUnknowns_k2k;i++)
+		if (!lin_system.dh_dAp.getCol(i).empty())
+			dh_dAp.push_back( & lin_system.dh_dAp.getCol(i) );
+	for (size_t i=0;i<nUnknowns_k2f;i++)
+		if (!lin_system.dh_df.getCol(i).empty())
+			dh_df.push_back( & lin_system.dh_df.getCol(i) );
+
+	my_srba_t::hessian_traits_t::TSparseBlocksHessian_Ap  HAp;
+	my_srba_t::hessian_traits_t::TSparseBlocksHessian_f   Hf;
+	my_srba_t::hessian_traits_t::TSparseBlocksHessian_Apf HApf;
+
+	my_srba_t::sparse_hessian_build_symbolic(HAp,Hf,HApf, dh_dAp,dh_df);
+
+	map<pair<size_t,size_t>, my_srba_t::hessian_traits_t::TSparseBlocksHessian_Ap::symbolic_t::list_jacob_blocks_t>  HAp_ref;
+	map<pair<size_t,size_t>, my_srba_t::hessian_traits_t::TSparseBlocksHessian_f::symbolic_t::list_jacob_blocks_t>   Hf_ref;
+	map<pair<size_t,size_t>, my_srba_t::hessian_traits_t::TSparseBlocksHessian_Apf::symbolic_t::list_jacob_blocks_t> HApf_ref;
+
+	build_symbolic_pairwise(HAp_ref, dh_dAp,dh_dAp, true);
+	build_symbolic_pairwise(Hf_ref,  dh_df,dh_df, true);
+	build_symbolic_pairwise(HApf_ref,dh_dAp,dh_df, false); // Stored by rows
+
+	expect_same_symbolic(HAp,HAp_ref, "HAp");
+	expect_same_symbolic(Hf,Hf_ref, "Hf");
+	expect_same_symbolic(HApf,HApf_ref, "HApf");
+}
+
+TEST(HessianSymbolic,ObservationDrivenVsPairwise)
+{
+	for (uint32_t random_seed=1;random_seed<10;random_seed++)
+	{
+		test_symbolic_vs_pairwise(random_seed, 1,  5,  20);
+		test_symbolic_vs_pairwise(random_seed, 8, 30, 200);
+		test_symbolic_vs_pairwise(random_seed, 25, 100, 1000);
+	}
+}
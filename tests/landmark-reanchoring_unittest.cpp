@@ -0,0 +1,215 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#include <srba.h>
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+using namespace srba;
+using namespace std;
+
+struct RBA_OPTIONS : public RBA_OPTIONS_DEFAULT
+{
+	typedef ecps::classic_linear_rba  edge_creation_policy_t;  // A plain chain of KFs (see min_obs_to_loop_closure below)
+};
+
+typedef RbaEngine<
+	kf2kf_poses::SE2,             // Parameterization  of KF-to-KF poses
+	landmarks::Euclidean2D,       // Parameterization of landmark positions
+	observations::Cartesian_2D,   // Type of observations
+	RBA_OPTIONS
+	>  my_srba_t;
+
+// A straight trajectory along the X axis (KF #i at x=i), with landmarks at both sides
+// seen from all the KFs closer than SENSOR_RANGE in X: noise-free observations.
+const size_t NUM_KFS      = 12;
+const size_t NUM_LMS      = 30;
+const double SENSOR_RANGE = 4.0;
+
+static void lm_gt(const size_t lm_id, double &x, double &y)
+{
+	x = 0.5*lm_id;
+	y = (lm_id%2) ? 2.0 : -2.0;
+}
+
+static void build_problem(my_srba_t &rba, const bool reanchor)
+{
+	rba.setVerbosityLevel(0);
+	rba.get_time_profiler().disable();
+	rba.parameters.srba.max_tree_depth     = 2;
+	rba.parameters.srba.max_optimize_depth = 2;
+	rba.parameters.srba.reanchor_landmarks = reanchor;
+	rba.parameters.ecp.min_obs_to_loop_closure = 1000; // No loop closures: landmarks are seen from KFs beyond the spanning trees of their base KFs
+
+	for (size_t kf=0;kf<NUM_KFS;kf++)
+	{
+		my_srba_t::new_kf_observations_t  list_obs;
+		my_srba_t::new_kf_observation_t   obs_field;
+		obs_field.is_fixed = false;
+		obs_field.is_unknown_with_init_val = false;
+
+		for (size_t lm=0;lm<NUM_LMS;lm++)
+		{
+			double x,y;
+			lm_gt(lm,x,y);
+			if (std::abs(x-kf)>SENSOR_RANGE)
+				continue;
+			obs_field.obs.feat_id = lm;
+			obs_field.obs.obs_data.pt.x = x-kf;
+			obs_field.obs.obs_data.pt.y = y;
+			list_obs.push_back(obs_field);
+		}
+
+		my_srba_t::TNewKeyFrameInfo new_kf_info;
+		rba.define_new_keyframe(list_obs,new_kf_info,true);
+	}
+}
+
+static size_t count_unlinked_observations(const my_srba_t &rba)
+{
+	size_t n=0;
+	const std::map<TLandmarkID,std::vector<size_t> > & u = rba.get_rba_state().unlinked_observations;
+	for (std::map<TLandmarkID,std::vector<size_t> >::const_iterator it=u.begin();it!=u.end();++it)
+		n+=it->second.size();
+	return n;
+}
+
+static void lm_global_pos(const my_srba_t &rba, const TLandmarkID lm_id, double &x, double &y)
+{
+	const my_srba_t::TRelativeLandmarkPos & rfp = *rba.get_rba_state().all_lms[lm_id].rfp;
+	const my_srba_t::pose_t * base_pose = rba.get_global_pose(rfp.id_frame_base, 0);
+	ASSERT_(base_pose!=NULL)
+	base_pose->composePoint(rfp.pos[0],rfp.pos[1], x,y);
+}
+
+TEST(LandmarkReanchoring, AutomaticReanchoringLinksMoreObservations)
+{
+	my_srba_t rba_off, rba_on;
+	build_problem(rba_off,false);
+	build_problem(rba_on,true);
+
+	EXPECT_GT(count_unlinked_observations(rba_off), 0u);
+	EXPECT_LT(count_unlinked_observations(rba_on), count_unlinked_observations(rba_off));
+
+	// Landmarks must stay at the same place after being moved to other base KFs:
+	for (size_t lm=0;lm<NUM_LMS;lm++)
+	{
+		if (lm>=rba_on.get_rba_state().all_lms.size() || !rba_on.get_rba_state().all_lms[lm].rfp)
+			continue;
+		double x,y, gt_x,gt_y;
+		lm_global_pos(rba_on,lm,x,y);
+		lm_gt(lm,gt_x,gt_y);
+		EXPECT_NEAR(x,gt_x,1e-3) << "lm_id=" << lm;
+		EXPECT_NEAR(y,gt_y,1e-3) << "lm_id=" << lm;
+	}
+}
+
+TEST(LandmarkReanchoring, ManualReanchoringKeepsGlobalPosition)
+{
+	my_srba_t rba;
+	build_problem(rba,false);
+
+	const TLandmarkID lm_id = 8; // Seen from KFs #0-#8, with base KF #0
+	const TKeyFrameID old_base = rba.get_rba_state().all_lms[lm_id].rfp->id_frame_base;
+	const TKeyFrameID new_base = 6;
+	ASSERT_NE(old_base,new_base);
+
+	double x0,y0;
+	lm_global_pos(rba,lm_id,x0,y0);
+
+	EXPECT_TRUE(rba.reanchor_landmark(lm_id,new_base));
+	EXPECT_EQ(rba.get_rba_state().all_lms[lm_id].rfp->id_frame_base, new_base);
+
+	double x1,y1;
+	lm_global_pos(rba,lm_id,x1,y1);
+	EXPECT_NEAR(x0,x1,1e-9);
+	EXPECT_NEAR(y0,y1,1e-9);
+
+	// Wrt KF #6, only the observations from KFs #0-#3 are beyond the spanning tree (depth=2):
+	const std::map<TLandmarkID,std::vector<size_t> > & u = rba.get_rba_state().unlinked_observations;
+	const std::map<TLandmarkID,std::vector<size_t> >::const_iterator it = u.find(lm_id);
+	const size_t nUnlinked = (it==u.end()) ? 0 : it->second.size();
+	EXPECT_LE(nUnlinked, 4u);
+}
+
+// Range-bearing observations, so the information matrices of landmarks are not isotropic (as they would be with Cartesian_2D):
+typedef RbaEngine<
+	kf2kf_poses::SE2,
+	landmarks::Euclidean2D,
+	observations::RangeBearing_2D,
+	RBA_OPTIONS
+	>  my_srba_rb_t;
+
+TEST(LandmarkReanchoring, ManualReanchoringRotatesInformationMatrix)
+{
+	// Like build_problem(), but the KFs turn YAW_STEP radians each, so the frames of different KFs are rotated:
+	const double YAW_STEP = 0.2;
+
+	my_srba_rb_t rba;
+	rba.setVerbosityLevel(0);
+	rba.get_time_profiler().disable();
+	rba.parameters.srba.max_tree_depth     = 2;
+	rba.parameters.srba.max_optimize_depth = 2;
+	rba.parameters.srba.reanchor_landmarks = false;
+	rba.parameters.srba.cov_recovery       = crpLandmarksApprox;
+	rba.parameters.ecp.min_obs_to_loop_closure = 1000;
+
+	for (size_t kf=0;kf<NUM_KFS;kf++)
+	{
+		const mrpt::poses::CPose2D kf_pose(kf,0,YAW_STEP*kf);
+
+		my_srba_rb_t::new_kf_observations_t  list_obs;
+		my_srba_rb_t::new_kf_observation_t   obs_field;
+		obs_field.is_fixed = false;
+		obs_field.is_unknown_with_init_val = false;
+
+		for (size_t lm=0;lm<NUM_LMS;lm++)
+		{
+			double x,y;
+			lm_gt(lm,x,y);
+			if (std::abs(x-kf)>SENSOR_RANGE)
+				continue;
+			double lx,ly;
+			kf_pose.inverseComposePoint(x,y, lx,ly);
+			obs_field.obs.feat_id = lm;
+			obs_field.obs.obs_data.range = std::sqrt(lx*lx+ly*ly);
+			obs_field.obs.obs_data.yaw   = std::atan2(ly,lx);
+			list_obs.push_back(obs_field);
+		}
+
+		my_srba_rb_t::TNewKeyFrameInfo new_kf_info;
+		rba.define_new_keyframe(list_obs,new_kf_info,true);
+	}
+
+	// Any landmark with a recovered information matrix will do, e.g. the one with the largest ID:
+	const my_srba_rb_t::hessian_traits_t::landmarks2infmatrix_t & inf_mats = rba.get_rba_state().unknown_lms_inf_matrices;
+	ASSERT_FALSE(inf_mats.empty());
+	const TLandmarkID lm_id = inf_mats.size()-1;
+	ASSERT_TRUE(inf_mats.find(lm_id)!=inf_mats.end());
+	const my_srba_rb_t::hessian_traits_t::landmark_inf_matrix_t inf_old = inf_mats.find(lm_id)->second;
+
+	const TKeyFrameID old_base = rba.get_rba_state().all_lms[lm_id].rfp->id_frame_base;
+	const TKeyFrameID new_base = (old_base>=3) ? old_base-3 : old_base+3;
+	ASSERT_TRUE(rba.reanchor_landmark(lm_id,new_base));
+
+	my_srba_rb_t::hessian_traits_t::landmarks2infmatrix_t::const_iterator it_inf = inf_mats.find(lm_id);
+	ASSERT_TRUE(it_inf!=inf_mats.end());
+	const my_srba_rb_t::hessian_traits_t::landmark_inf_matrix_t inf_new = it_inf->second;
+
+	// Both must be the same information matrix once expressed in the global frame:
+	mrpt::math::CMatrixDouble22 R_old, R_new;
+	rba.get_global_pose(old_base,0)->getRotationMatrix(R_old);
+	rba.get_global_pose(new_base,0)->getRotationMatrix(R_new);
+
+	const Eigen::Matrix2d inf_old_global = R_old * inf_old * R_old.transpose();
+	const Eigen::Matrix2d inf_new_global = R_new * inf_new * R_new.transpose();
+	EXPECT_NEAR((inf_old_global-inf_new_global).norm(), 0.0, 1e-9*inf_old.norm()) << "inf_old_global:\n" << inf_old_global << "\ninf_new_global:\n" << inf_new_global;
+	EXPECT_GT((inf_old-inf_new).norm(), 1e-3*inf_old.norm()); // Base KFs 3 steps apart are rotated 3*YAW_STEP wrt each other
+}
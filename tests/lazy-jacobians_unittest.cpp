@@ -0,0 +1,114 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#include <srba.h>
+#include "test_problems.h"
+
+#include <gtest/gtest.h>
+
+using namespace srba;
+using namespace std;
+
+struct RBA_OPTIONS_LAZY_JACOBS : public RBA_OPTIONS_DEFAULT
+{
+};
+
+typedef RbaEngine<
+	kf2kf_poses::SE2,             // Parameterization  of KF-to-KF poses
+	landmarks::Euclidean2D,       // Parameterization of landmark positions
+	observations::Cartesian_2D,   // Type of observations
+	RBA_OPTIONS_LAZY_JACOBS
+	>  my_srba_t;
+
+typedef my_srba_t::rba_problem_state_t::TLinearSystem  lin_system_t;
+typedef my_srba_t::rba_problem_state_t::TLazyJacobColumn_dh_dAp  lazy_col_t;
+
+// A noisy strip problem (see test_problems.h):
+const size_t NUM_KFS   = 14;
+const size_t NUM_LMS   = strip_num_lms(NUM_KFS);
+const double STD_NOISE = 0.05;
+
+static void build_problem(my_srba_t &rba, const size_t release_after)
+{
+	rba.setVerbosityLevel(0);
+	rba.get_time_profiler().disable();
+	rba.parameters.srba.max_tree_depth     = 3;
+	rba.parameters.srba.max_optimize_depth = 3;
+	rba.parameters.srba.dh_dAp_release_after = release_after;
+	rba.parameters.obs_noise.std_noise_observations = STD_NOISE;
+	build_strip_problem(rba, NUM_KFS, STD_NOISE);
+}
+
+// Columns of dh_dAp freed after each optimization (release_after=1) and rebuilt on demand must end up identical to
+// those never freed once created (release_after=0, the eager behavior), and so must the optimization results:
+TEST(LazyJacobians, RematerializedSameAsEager)
+{
+	my_srba_t rba_eager, rba_lazy;
+	build_problem(rba_eager, 0);
+	build_problem(rba_lazy,  1);
+
+	const lin_system_t & ls_eager = rba_eager.get_rba_state().lin_system;
+	const lin_system_t & ls_lazy  = rba_lazy.get_rba_state().lin_system;
+	ASSERT_EQ(ls_eager.dh_dAp_lazy.size(), ls_lazy.dh_dAp_lazy.size());
+
+	// Look for an edge whose column was materialized and then released in the lazy engine:
+	size_t edge_id = static_cast<size_t>(-1);
+	for (size_t i=0;i<ls_lazy.dh_dAp_lazy.size() && edge_id==static_cast<size_t>(-1);i++)
+	{
+		const lazy_col_t & lc = ls_lazy.dh_dAp_lazy[i];
+		if (!lc.last_used && !lc.blocks.empty() && ls_eager.dh_dAp_lazy[i].last_used)
+			edge_id = i;
+	}
+	ASSERT_NE(edge_id, static_cast<size_t>(-1)) << "No released column: this test wouldn't test anything";
+	EXPECT_TRUE(ls_lazy.dh_dAp.getCol(edge_id).empty());
+	EXPECT_FALSE(ls_eager.dh_dAp.getCol(edge_id).empty());
+
+	// Optimize again around that edge, so it's re-materialized:
+	const TKeyFrameID root = rba_lazy.get_rba_state().k2k_edges[edge_id].from;
+	my_srba_t::TOptimizeExtraOutputInfo info_eager, info_lazy;
+	rba_eager.optimize_local_area(root, 1, info_eager);
+	rba_lazy.optimize_local_area(root, 1, info_lazy);
+	EXPECT_NE(0u, ls_lazy.dh_dAp_lazy[edge_id].last_used);
+
+	// Same dh_dAp blocks:
+	const my_srba_t::TSparseBlocksJacobians_dh_dAp::col_t & col_eager = ls_eager.dh_dAp.getCol(edge_id), & col_lazy = ls_lazy.dh_dAp.getCol(edge_id);
+	ASSERT_EQ(col_eager.size(), col_lazy.size());
+	ASSERT_FALSE(col_lazy.empty());
+	for (my_srba_t::TSparseBlocksJacobians_dh_dAp::col_t::const_iterator it_e=col_eager.begin(), it_l=col_lazy.begin(); it_e!=col_eager.end(); ++it_e, ++it_l)
+	{
+		EXPECT_EQ(it_e->first, it_l->first);
+		EXPECT_EQ(it_e->second.sym.obs_idx,         it_l->second.sym.obs_idx);
+		EXPECT_EQ(it_e->second.sym.k2k_edge_id,     it_l->second.sym.k2k_edge_id);
+		EXPECT_EQ(it_e->second.sym.kf_d,            it_l->second.sym.kf_d);
+		EXPECT_EQ(it_e->second.sym.kf_base,         it_l->second.sym.kf_base);
+		EXPECT_EQ(it_e->second.sym.edge_normal_dir, it_l->second.sym.edge_normal_dir);
+		EXPECT_EQ(it_e->second.sym.rel_pose_d1_from_obs==NULL, it_l->second.sym.rel_pose_d1_from_obs==NULL);
+		EXPECT_NEAR(0.0, (it_e->second.num - it_l->second.num).array().abs().maxCoeff(), 1e-9) << "obs_idx=" << it_e->first;
+	}
+
+	// Same optimization results:
+	EXPECT_EQ(info_eager.num_observations, info_lazy.num_observations);
+	EXPECT_NEAR(info_eager.total_sqr_error_final, info_lazy.total_sqr_error_final, 1e-9);
+	for (TKeyFrameID kf=0;kf<NUM_KFS;kf++)
+	{
+		const my_srba_t::pose_t * p_eager = rba_eager.get_global_pose(kf,0), * p_lazy = rba_lazy.get_global_pose(kf,0);
+		ASSERT_TRUE(p_eager!=NULL && p_lazy!=NULL);
+		EXPECT_NEAR(p_eager->x(),   p_lazy->x(),   1e-9) << "kf=" << kf;
+		EXPECT_NEAR(p_eager->y(),   p_lazy->y(),   1e-9) << "kf=" << kf;
+		EXPECT_NEAR(p_eager->phi(), p_lazy->phi(), 1e-9) << "kf=" << kf;
+	}
+	for (size_t lm=0;lm<NUM_LMS;lm++)
+	{
+		double x_eager,y_eager, x_lazy,y_lazy;
+		lm_global_pos(rba_eager,lm,x_eager,y_eager);
+		lm_global_pos(rba_lazy,lm,x_lazy,y_lazy);
+		EXPECT_NEAR(x_eager,x_lazy,1e-9) << "lm_id=" << lm;
+		EXPECT_NEAR(y_eager,y_lazy,1e-9) << "lm_id=" << lm;
+	}
+}
@@ -0,0 +1,103 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#include <srba.h>
+#include "test_problems.h"
+
+#include <gtest/gtest.h>
+
+using namespace srba;
+using namespace std;
+
+struct RBA_OPTIONS_LAZY_RELIN : public RBA_OPTIONS_DEFAULT
+{
+	typedef ecps::classic_linear_rba  edge_creation_policy_t;  // A plain chain of KFs
+};
+
+typedef RbaEngine<
+	kf2kf_poses::SE2,             // Parameterization  of KF-to-KF poses
+	landmarks::Euclidean2D,       // Parameterization of landmark positions
+	observations::Cartesian_2D,   // Type of observations
+	RBA_OPTIONS_LAZY_RELIN
+	>  my_srba_t;
+
+// A strip problem (see test_problems.h) with a few gross errors, so the robust kernel weights of some
+// observations keep changing during the optimization.
+const size_t NUM_KFS        = 12;
+const size_t NUM_LMS        = strip_num_lms(NUM_KFS);
+const double STD_NOISE      = 0.05;
+const double OUTLIER_OFFSET = 0.5;
+
+struct lazy_relin_hooks_t : public strip_problem_hooks_t
+{
+	size_t num_skipped_jacobs;
+	lazy_relin_hooks_t() : num_skipped_jacobs(0) { }
+
+	bool observation(const size_t kf, const size_t lm, my_srba_t::new_kf_observation_t &obs_field)
+	{
+		if (kf%4==3 && lm==2*(kf-1))
+		{
+			obs_field.obs.obs_data.pt.x += OUTLIER_OFFSET;
+			obs_field.obs.obs_data.pt.y += OUTLIER_OFFSET;
+		}
+		return true;
+	}
+	void new_kf(const my_srba_t::TNewKeyFrameInfo &new_kf_info)
+	{
+		num_skipped_jacobs += new_kf_info.optimize_results.num_relin_skipped_jacobians;
+	}
+};
+
+static void build_problem(my_srba_t &rba, const double relin_threshold, size_t &num_skipped_jacobs)
+{
+	rba.setVerbosityLevel(0);
+	rba.get_time_profiler().disable();
+	rba.parameters.srba.max_tree_depth     = 4;
+	rba.parameters.srba.max_optimize_depth = 4;
+	rba.parameters.srba.use_robust_kernel  = true;
+	rba.parameters.srba.max_iters          = 100;
+	rba.parameters.srba.max_error_per_obs_to_stop = 1e-12;
+	rba.parameters.srba.relinearize_threshold_k2k = relin_threshold;
+	rba.parameters.srba.relinearize_threshold_k2f = relin_threshold;
+	rba.parameters.obs_noise.std_noise_observations = STD_NOISE;
+
+	lazy_relin_hooks_t hooks;
+	build_strip_problem(rba, NUM_KFS, STD_NOISE, hooks);
+	num_skipped_jacobs = hooks.num_skipped_jacobs;
+}
+
+// Lazy and full relinearization must converge to the same solution, also with robust kernels
+// (whose IRLS weights change even for observations of unknowns which barely move).
+TEST(LazyRelinearization, SameSolutionAsFullRelinearizationWithRobustKernel)
+{
+	my_srba_t rba_full, rba_lazy;
+	size_t nSkippedFull, nSkippedLazy;
+	build_problem(rba_full, 0.0, nSkippedFull);
+	build_problem(rba_lazy, 1e-4, nSkippedLazy);
+
+	EXPECT_EQ(0u, nSkippedFull);
+	EXPECT_GT(nSkippedLazy, 0u);  // Otherwise, this test wouldn't test anything
+
+	for (TKeyFrameID kf=0;kf<NUM_KFS;kf++)
+	{
+		const my_srba_t::pose_t * p_full = rba_full.get_global_pose(kf,0), * p_lazy = rba_lazy.get_global_pose(kf,0);
+		ASSERT_TRUE(p_full!=NULL && p_lazy!=NULL);
+		EXPECT_NEAR(p_full->x(),   p_lazy->x(),   1e-3) << "kf=" << kf;
+		EXPECT_NEAR(p_full->y(),   p_lazy->y(),   1e-3) << "kf=" << kf;
+		EXPECT_NEAR(p_full->phi(), p_lazy->phi(), 1e-3) << "kf=" << kf;
+	}
+	for (size_t lm=0;lm<NUM_LMS;lm++)
+	{
+		double x_full,y_full, x_lazy,y_lazy;
+		lm_global_pos(rba_full,lm,x_full,y_full);
+		lm_global_pos(rba_lazy,lm,x_lazy,y_lazy);
+		EXPECT_NEAR(x_full,x_lazy,1e-3) << "lm_id=" << lm;
+		EXPECT_NEAR(y_full,y_lazy,1e-3) << "lm_id=" << lm;
+	}
+}
@@ -0,0 +1,109 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#include <srba.h>
+#include "test_problems.h"
+
+#include <gtest/gtest.h>
+
+using namespace srba;
+using namespace std;
+
+struct RBA_OPTIONS_NOISE_PER_OBS : public RBA_OPTIONS_DEFAULT
+{
+	typedef ecps::classic_linear_rba  edge_creation_policy_t;  // A plain chain of KFs
+	typedef options::observation_noise_per_observation<observations::Cartesian_2D>  obs_noise_matrix_t;  // Each observation has its own information matrix
+};
+
+typedef RbaEngine<
+	kf2kf_poses::SE2,             // Parameterization  of KF-to-KF poses
+	landmarks::Euclidean2D,       // Parameterization of landmark positions
+	observations::Cartesian_2D,   // Type of observations
+	RBA_OPTIONS_NOISE_PER_OBS
+	>  my_srba_t;
+
+typedef Eigen::Matrix2d  mat2_t;
+typedef Eigen::Vector2d  vec2_t;
+
+// A strip problem (see test_problems.h) without noise, but each observation has a different information matrix.
+// The last KF also sees a new landmark twice, with two inconsistent observations and information matrices:
+// its estimate must be their information-weighted mean, and the reported errors must be weighted likewise.
+const size_t NUM_KFS       = 8;
+const size_t NUM_LMS       = strip_num_lms(NUM_KFS);
+const TLandmarkID CONTESTED_LM_ID = NUM_LMS;
+
+static mat2_t contested_lambda(const size_t k)
+{
+	mat2_t L;
+	if (k==0) L << 100.0, 5.0,  5.0, 4.0;
+	else      L <<   1.0, 0.5,  0.5, 25.0;
+	return L;
+}
+static vec2_t contested_obs(const size_t k)
+{
+	return k==0 ? vec2_t(1.0,0.5) : vec2_t(1.4,0.1);
+}
+
+struct noise_per_obs_hooks_t : public strip_problem_hooks_t
+{
+	my_srba_t::TNewKeyFrameInfo last_kf_info;
+
+	bool observation(const size_t kf, const size_t lm, my_srba_t::new_kf_observation_t &obs_field)
+	{
+		const double s = 1.0+(kf+3*lm)%5;
+		obs_field.obs_information << s, 0.1*s,  0.1*s, 2.0/s;
+		return true;
+	}
+	void extra_observations(const size_t kf, my_srba_t::new_kf_observations_t &list_obs)
+	{
+		if (kf!=NUM_KFS-1)
+			return;
+		my_srba_t::new_kf_observation_t   obs_field;
+		obs_field.is_fixed = false;
+		obs_field.is_unknown_with_init_val = false;
+		for (size_t k=0;k<2;k++)
+		{
+			obs_field.obs.feat_id = CONTESTED_LM_ID;
+			obs_field.obs.obs_data.pt.x = contested_obs(k)[0];
+			obs_field.obs.obs_data.pt.y = contested_obs(k)[1];
+			obs_field.obs_information = contested_lambda(k);
+			list_obs.push_back(obs_field);
+		}
+	}
+	void new_kf(const my_srba_t::TNewKeyFrameInfo &new_kf_info) { last_kf_info = new_kf_info; }
+};
+
+TEST(NoisePerObservation, HeterogeneousInformationMatrices)
+{
+	my_srba_t rba;
+	rba.setVerbosityLevel(0);
+	rba.get_time_profiler().disable();
+	rba.parameters.srba.max_tree_depth     = 4;
+	rba.parameters.srba.max_optimize_depth = 4;
+	rba.parameters.srba.use_robust_kernel  = false;
+
+	noise_per_obs_hooks_t hooks;
+	build_strip_problem(rba, NUM_KFS, 0.0 /* no noise */, hooks);
+	const my_srba_t::TNewKeyFrameInfo & new_kf_info = hooks.last_kf_info;
+
+	// Expected: information-weighted mean of both observations, relative to the last KF:
+	const mat2_t L0 = contested_lambda(0), L1 = contested_lambda(1);
+	const vec2_t expected_pos = (L0+L1).inverse() * (L0*contested_obs(0) + L1*contested_obs(1));
+	const vec2_t r0 = contested_obs(0)-expected_pos, r1 = contested_obs(1)-expected_pos;
+	const double expected_sqerr = r0.dot(L0*r0) + r1.dot(L1*r1);
+
+	const my_srba_t::TRelativeLandmarkPos & rfp = *rba.get_rba_state().all_lms[CONTESTED_LM_ID].rfp;
+	EXPECT_EQ(NUM_KFS-1, rfp.id_frame_base);
+	EXPECT_NEAR(expected_pos[0], rfp.pos[0], 1e-6);
+	EXPECT_NEAR(expected_pos[1], rfp.pos[1], 1e-6);
+
+	// The rest of observations are consistent, so the only error left is that of the contested landmark:
+	EXPECT_NEAR(expected_sqerr, new_kf_info.optimize_results.total_sqr_error_final, 1e-6);
+	EXPECT_NEAR(expected_sqerr, rba.eval_overall_squared_error(), 1e-6);
+}
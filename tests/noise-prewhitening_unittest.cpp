@@ -0,0 +1,124 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#include <srba.h>
+#include "test_problems.h"
+
+#include <gtest/gtest.h>
+
+using namespace srba;
+using namespace std;
+
+template <class OBS_NOISE>
+struct RBA_OPTIONS_PREWHITEN : public RBA_OPTIONS_DEFAULT
+{
+	typedef ecps::classic_linear_rba  edge_creation_policy_t;  // A plain chain of KFs
+	typedef OBS_NOISE                 obs_noise_matrix_t;
+};
+
+template <class OBS_NOISE>
+struct srba_prewhiten_t
+{
+	typedef RbaEngine<
+		kf2kf_poses::SE2,             // Parameterization  of KF-to-KF poses
+		landmarks::Euclidean2D,       // Parameterization of landmark positions
+		observations::Cartesian_2D,   // Type of observations
+		RBA_OPTIONS_PREWHITEN<OBS_NOISE>
+		>  type;
+};
+
+// A strip problem (see test_problems.h) with non-diagonal information matrices (different for each observation,
+// if the noise model allows it).
+const size_t NUM_KFS      = 10;
+const size_t NUM_LMS      = strip_num_lms(NUM_KFS);
+const double STD_NOISE    = 0.05;
+
+// Only used by observation_noise_constant_matrix:
+template <class PARAMS> void set_constant_lambda(PARAMS &p) { MRPT_UNUSED_PARAM(p); }
+void set_constant_lambda(options::observation_noise_constant_matrix<observations::Cartesian_2D,false>::parameters_t &p) { p.lambda << 400.0, 120.0,  120.0, 100.0; }
+void set_constant_lambda(options::observation_noise_constant_matrix<observations::Cartesian_2D,true>::parameters_t &p)  { p.lambda << 400.0, 120.0,  120.0, 100.0; }
+
+struct prewhiten_hooks_t : public strip_problem_hooks_t
+{
+	template <class OBS_FIELD>
+	bool observation(const size_t kf, const size_t lm, OBS_FIELD &obs_field)
+	{
+		const double s = 100.0*(1.0+(kf+3*lm)%5);
+		obs_field.obs_information << s, 0.3*s,  0.3*s, 0.5*s; // Only used by observation_noise_per_observation
+		return true;
+	}
+};
+
+template <class RBA>
+void build_problem(RBA &rba)
+{
+	rba.setVerbosityLevel(0);
+	rba.get_time_profiler().disable();
+	rba.parameters.srba.max_tree_depth     = 4;
+	rba.parameters.srba.max_optimize_depth = 4;
+	rba.parameters.srba.use_robust_kernel  = false;
+	rba.parameters.srba.max_iters          = 100;
+	rba.parameters.srba.max_error_per_obs_to_stop = 1e-12;
+	set_constant_lambda(rba.parameters.obs_noise);
+
+	prewhiten_hooks_t hooks;
+	build_strip_problem(rba, NUM_KFS, STD_NOISE, hooks);
+}
+
+// Pre-whitening Jacobians and residuals is just another way of evaluating the same normal equations:
+// both variants of a noise model must converge to the same solution, with the same total error.
+template <class NOISE_PLAIN, class NOISE_PREWHITEN>
+void check_prewhiten_same_solution()
+{
+	typedef typename srba_prewhiten_t<NOISE_PLAIN>::type      srba_plain_t;
+	typedef typename srba_prewhiten_t<NOISE_PREWHITEN>::type  srba_white_t;
+	ASSERT_FALSE(NOISE_PLAIN::PREWHITEN_JACOBIANS);
+	ASSERT_TRUE(NOISE_PREWHITEN::PREWHITEN_JACOBIANS);
+
+	srba_plain_t rba_plain;
+	srba_white_t rba_white;
+	build_problem(rba_plain);
+	build_problem(rba_white);
+
+	for (TKeyFrameID kf=0;kf<NUM_KFS;kf++)
+	{
+		const typename srba_plain_t::pose_t * p_plain = rba_plain.get_global_pose(kf,0);
+		const typename srba_white_t::pose_t * p_white = rba_white.get_global_pose(kf,0);
+		ASSERT_TRUE(p_plain!=NULL && p_white!=NULL);
+		EXPECT_NEAR(p_plain->x(),   p_white->x(),   1e-6) << "kf=" << kf;
+		EXPECT_NEAR(p_plain->y(),   p_white->y(),   1e-6) << "kf=" << kf;
+		EXPECT_NEAR(p_plain->phi(), p_white->phi(), 1e-6) << "kf=" << kf;
+	}
+	for (size_t lm=0;lm<NUM_LMS;lm++)
+	{
+		double x_plain,y_plain, x_white,y_white;
+		lm_global_pos(rba_plain,lm,x_plain,y_plain);
+		lm_global_pos(rba_white,lm,x_white,y_white);
+		EXPECT_NEAR(x_plain,x_white,1e-6) << "lm_id=" << lm;
+		EXPECT_NEAR(y_plain,y_white,1e-6) << "lm_id=" << lm;
+	}
+
+	const double err_plain = rba_plain.eval_overall_squared_error(), err_white = rba_white.eval_overall_squared_error();
+	EXPECT_GT(err_plain, 0.0);
+	EXPECT_NEAR(err_plain, err_white, 1e-6*err_plain);
+}
+
+TEST(NoisePrewhitening, ConstantMatrixSameSolution)
+{
+	check_prewhiten_same_solution<
+		options::observation_noise_constant_matrix<observations::Cartesian_2D,false>,
+		options::observation_noise_constant_matrix<observations::Cartesian_2D,true> >();
+}
+
+TEST(NoisePrewhitening, PerObservationSameSolution)
+{
+	check_prewhiten_same_solution<
+		options::observation_noise_per_observation<observations::Cartesian_2D,false>,
+		options::observation_noise_per_observation<observations::Cartesian_2D,true> >();
+}
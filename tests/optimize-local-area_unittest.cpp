@@ -0,0 +1,102 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#include <srba.h>
+#include "test_problems.h"
+
+#include <gtest/gtest.h>
+#include <algorithm>
+
+using namespace srba;
+using namespace std;
+
+struct RBA_OPTIONS_OPT_LOCAL_AREA : public RBA_OPTIONS_DEFAULT
+{
+};
+
+typedef RbaEngine<
+	kf2kf_poses::SE2,             // Parameterization  of KF-to-KF poses
+	landmarks::Euclidean2D,       // Parameterization of landmark positions
+	observations::Cartesian_2D,   // Type of observations
+	RBA_OPTIONS_OPT_LOCAL_AREA
+	>  my_srba_t;
+
+const size_t NUM_KFS = 12;
+const size_t NUM_LMS = strip_num_lms(NUM_KFS);
+const topo_dist_t WIN_SIZE = 2;
+
+static void build_problem(my_srba_t &rba)
+{
+	rba.setVerbosityLevel(0);
+	rba.get_time_profiler().disable();
+	rba.parameters.srba.max_tree_depth     = 3;
+	rba.parameters.srba.max_optimize_depth = 3;
+	build_strip_problem(rba, NUM_KFS, 0.0 /* no noise */);
+}
+
+/** Runs a local area visitor from \a root_id, with the given working space */
+static void visit_local_area(const my_srba_t &rba, const TKeyFrameID root_id, stamped_array_t<size_t> &ws,
+	vector<size_t> &k2k_edges, vector<size_t> &lm_IDs, vector<size_t> &times_seen)
+{
+	const my_srba_t::TOptimizeLocalAreaParams params;
+	my_srba_t::VisitorOptimizeLocalArea visitor(rba.get_rba_state(),params,ws);
+	rba.bfs_visitor(root_id, WIN_SIZE, true, visitor, visitor, visitor, visitor);
+
+	k2k_edges = visitor.k2k_edges_to_optimize;
+	lm_IDs    = visitor.lm_IDs_to_optimize;
+	sort(k2k_edges.begin(),k2k_edges.end());
+	sort(lm_IDs.begin(),lm_IDs.end());
+
+	times_seen.resize(NUM_LMS);
+	for (size_t lm=0;lm<NUM_LMS;lm++)
+		times_seen[lm] = visitor.get_times_seen(lm);
+}
+
+// Successive visitors sharing one working space must find the same unknowns than with a fresh working space:
+TEST(OptimizeLocalArea, VisitorReusesWorkspace)
+{
+	my_srba_t rba;
+	build_problem(rba);
+
+	stamped_array_t<size_t> shared_ws;
+	for (TKeyFrameID root=1;root<NUM_KFS;root+=2)
+	{
+		vector<size_t> k2k_shared, lms_shared, seen_shared;
+		visit_local_area(rba, root, shared_ws, k2k_shared, lms_shared, seen_shared);
+
+		stamped_array_t<size_t> fresh_ws;
+		vector<size_t> k2k_fresh, lms_fresh, seen_fresh;
+		visit_local_area(rba, root, fresh_ws, k2k_fresh, lms_fresh, seen_fresh);
+
+		EXPECT_FALSE(lms_fresh.empty()) << "root=" << root;
+		EXPECT_TRUE(k2k_fresh==k2k_shared) << "root=" << root;
+		EXPECT_TRUE(lms_fresh==lms_shared) << "root=" << root;
+		EXPECT_TRUE(seen_fresh==seen_shared) << "root=" << root; // Counters don't accumulate across visitors
+	}
+}
+
+// optimize_local_area() reuses the engine working space: repeating it over the same area must consider the same unknowns.
+TEST(OptimizeLocalArea, RepeatedCallsSameUnknowns)
+{
+	my_srba_t rba;
+	build_problem(rba);
+
+	const TKeyFrameID root = NUM_KFS/2;
+	my_srba_t::TOptimizeExtraOutputInfo info_first;
+	rba.optimize_local_area(root, WIN_SIZE, info_first);
+	ASSERT_FALSE(info_first.optimized_landmark_indices.empty());
+
+	for (int i=0;i<3;i++)
+	{
+		my_srba_t::TOptimizeExtraOutputInfo info;
+		rba.optimize_local_area(root, WIN_SIZE, info);
+		EXPECT_TRUE(info.optimized_k2k_edge_indices==info_first.optimized_k2k_edge_indices) << "iter=" << i;
+		EXPECT_TRUE(info.optimized_landmark_indices==info_first.optimized_landmark_indices) << "iter=" << i;
+	}
+}
@@ -0,0 +1,138 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#include <srba.h>
+#include "test_problems.h"
+#include <set>
+
+#include <gtest/gtest.h>
+
+using namespace srba;
+using namespace std;
+
+struct RBA_OPTIONS_OUTLIERS : public RBA_OPTIONS_DEFAULT
+{
+	typedef ecps::classic_linear_rba  edge_creation_policy_t;  // A plain chain of KFs
+};
+
+typedef RbaEngine<
+	kf2kf_poses::SE2,             // Parameterization  of KF-to-KF poses
+	landmarks::Euclidean2D,       // Parameterization of landmark positions
+	observations::Cartesian_2D,   // Type of observations
+	RBA_OPTIONS_OUTLIERS
+	>  my_srba_t;
+
+// A strip problem (see test_problems.h) without noise, except a few gross outliers: observations from
+// KF #k of the landmark at x=k-1 (already seen from several KFs) displaced by OUTLIER_OFFSET.
+const size_t NUM_KFS        = 12;
+const size_t NUM_LMS        = strip_num_lms(NUM_KFS);
+const double STD_NOISE      = 0.1;
+const double OUTLIER_OFFSET = 1.2;  // ~ 3 times the chi-square threshold on the residual
+
+static bool is_outlier(const size_t kf, const size_t lm)
+{
+	return (kf==5 || kf==8 || kf==10) && lm==2*(kf-1);
+}
+
+struct outliers_hooks_t : public strip_problem_hooks_t
+{
+	bool inject_outliers;
+	std::vector<size_t> &reported_outliers;
+	outliers_hooks_t(bool inject, std::vector<size_t> &reported) : inject_outliers(inject), reported_outliers(reported) { }
+
+	bool observation(const size_t kf, const size_t lm, my_srba_t::new_kf_observation_t &obs_field)
+	{
+		if (!is_outlier(kf,lm))
+			return true;
+		if (!inject_outliers)
+			return false; // The clean problem doesn't have these observations at all
+		obs_field.obs.obs_data.pt.x += OUTLIER_OFFSET;
+		obs_field.obs.obs_data.pt.y += OUTLIER_OFFSET;
+		return true;
+	}
+	void new_kf(const my_srba_t::TNewKeyFrameInfo &new_kf_info)
+	{
+		const std::vector<size_t> & o = new_kf_info.optimize_results.outlier_obs_indices;
+		reported_outliers.insert(reported_outliers.end(), o.begin(), o.end());
+	}
+};
+
+// \param[out] reported_outliers All the TOptimizeExtraOutputInfo::outlier_obs_indices reported while building the problem.
+static void build_problem(my_srba_t &rba, const bool inject_outliers, std::vector<size_t> &reported_outliers)
+{
+	reported_outliers.clear();
+
+	rba.setVerbosityLevel(0);
+	rba.get_time_profiler().disable();
+	rba.parameters.srba.max_tree_depth     = 4;
+	rba.parameters.srba.max_optimize_depth = 4;
+	rba.parameters.srba.use_robust_kernel  = false;
+	rba.parameters.srba.outlier_rejection  = true;
+	rba.parameters.obs_noise.std_noise_observations = STD_NOISE;
+
+	outliers_hooks_t hooks(inject_outliers, reported_outliers);
+	build_strip_problem(rba, NUM_KFS, 0.0 /* no noise */, hooks);
+}
+
+TEST(OutlierRejection, GrossOutliersAreRejected)
+{
+	my_srba_t rba_clean, rba_outliers;
+	std::vector<size_t> reported_clean, reported_outliers;
+	build_problem(rba_clean, false, reported_clean);
+	build_problem(rba_outliers, true, reported_outliers);
+
+	EXPECT_TRUE(reported_clean.empty());
+
+	// The option must be restored after the internal re-run without gating:
+	EXPECT_TRUE(rba_outliers.parameters.srba.outlier_rejection);
+
+	// Exactly the injected observations must have been rejected:
+	const my_srba_t::rba_problem_state_t & st = rba_outliers.get_rba_state();
+	size_t nRejected = 0, nInjected = 0;
+	for (size_t i=0;i<st.all_observations.size();i++)
+	{
+		const bool injected = is_outlier(st.all_observations[i].obs.kf_id, st.all_observations[i].obs.obs.feat_id);
+		if (injected) nInjected++;
+		if (st.all_observations_is_outlier[i])
+		{
+			nRejected++;
+			EXPECT_TRUE(injected) << "Inlier rejected: obs_idx=" << i;
+		}
+	}
+	EXPECT_EQ(3u, nInjected);
+	EXPECT_EQ(nInjected, nRejected);
+
+	// ...and each one reported once, by the optimization which rejected it:
+	const std::set<size_t> reported_set(reported_outliers.begin(), reported_outliers.end());
+	EXPECT_EQ(reported_outliers.size(), reported_set.size());
+	EXPECT_EQ(nRejected, reported_outliers.size());
+	for (std::set<size_t>::const_iterator it=reported_set.begin();it!=reported_set.end();++it)
+	{
+		ASSERT_LT(*it, st.all_observations.size());
+		EXPECT_TRUE(st.all_observations_is_outlier[*it]) << "Reported but not disabled: obs_idx=" << *it;
+	}
+
+	// The solution of the inliers must match that of the clean problem:
+	for (TKeyFrameID kf=0;kf<NUM_KFS;kf++)
+	{
+		const my_srba_t::pose_t * p_clean = rba_clean.get_global_pose(kf,0), * p_out = rba_outliers.get_global_pose(kf,0);
+		ASSERT_TRUE(p_clean!=NULL && p_out!=NULL);
+		EXPECT_NEAR(p_clean->x(),   p_out->x(),   1e-3) << "kf=" << kf;
+		EXPECT_NEAR(p_clean->y(),   p_out->y(),   1e-3) << "kf=" << kf;
+		EXPECT_NEAR(p_clean->phi(), p_out->phi(), 1e-3) << "kf=" << kf;
+	}
+	for (size_t lm=0;lm<NUM_LMS;lm++)
+	{
+		double x_clean,y_clean, x_out,y_out;
+		lm_global_pos(rba_clean,lm,x_clean,y_clean);
+		lm_global_pos(rba_outliers,lm,x_out,y_out);
+		EXPECT_NEAR(x_clean,x_out,1e-3) << "lm_id=" << lm;
+		EXPECT_NEAR(y_clean,y_out,1e-3) << "lm_id=" << lm;
+	}
+}
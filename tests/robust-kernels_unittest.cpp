@@ -0,0 +1,152 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#include <srba.h>
+#include "test_problems.h"
+#include <algorithm>
+#include <limits>
+
+#include <gtest/gtest.h>
+
+using namespace srba;
+using namespace std;
+
+// Check that each kernel behaves as least-squares for small errors, and that the
+// IRLS weight is the derivative of the kernel wrt the squared error:
+template <class KERNEL>
+void check_kernel()
+{
+	const double k = 3.0;
+	double w;
+
+	EXPECT_NEAR(KERNEL::eval(1e-6,k,w), 1e-6, 1e-9);
+	EXPECT_NEAR(w, 1.0, 1e-4);
+
+	const double lst_s[] = { 0.5, 2.0, 8.5, 25.0, 100.0 };
+	for (size_t i=0;i<sizeof(lst_s)/sizeof(lst_s[0]);i++)
+	{
+		const double s = lst_s[i], ds = 1e-6;
+		double w_dummy;
+		const double num_deriv = (KERNEL::eval(s+ds,k,w_dummy)-KERNEL::eval(s-ds,k,w_dummy))/(2*ds);
+		KERNEL::eval(s,k,w);
+		EXPECT_NEAR(w, num_deriv, 1e-5) << "s=" << s;
+		EXPECT_GE(w, 0.0);
+		EXPECT_LE(w, 1.0);
+	}
+}
+
+TEST(RobustKernels,WeightsAreDerivatives)
+{
+	check_kernel<options::robust_kernel_none>();
+	check_kernel<options::robust_kernel_pseudo_huber>();
+	check_kernel<options::robust_kernel_huber>();
+	check_kernel<options::robust_kernel_cauchy>();
+	check_kernel<options::robust_kernel_tukey>();
+	check_kernel<options::robust_kernel_geman_mcclure>();
+}
+
+struct RBA_OPTIONS_IRLS : public RBA_OPTIONS_DEFAULT
+{
+	typedef ecps::classic_linear_rba              edge_creation_policy_t;  // A plain chain of KFs
+	typedef options::robust_kernel_geman_mcclure  robust_kernel_t;         // Redescending: gross outliers get a negligible weight
+};
+
+typedef RbaEngine<
+	kf2kf_poses::SE2,             // Parameterization  of KF-to-KF poses
+	landmarks::Euclidean2D,       // Parameterization of landmark positions
+	observations::Cartesian_2D,   // Type of observations
+	RBA_OPTIONS_IRLS
+	>  my_srba_irls_t;
+
+// A noise-free strip problem (see test_problems.h), except a few gross outliers: observations from
+// KF #k of the landmark at x=k-1 (already seen from several KFs) displaced by IRLS_OUTLIER_OFFSET.
+const size_t IRLS_NUM_KFS        = 12;
+const double IRLS_STD_NOISE      = 0.1;
+const double IRLS_OUTLIER_OFFSET = 3.0;  // Squared error ~1800, vs. kernel_param^2=25
+
+struct irls_outliers_hooks_t : public strip_problem_hooks_t
+{
+	bool inject_outliers;
+	irls_outliers_hooks_t(bool inject) : inject_outliers(inject) { }
+
+	bool observation(const size_t kf, const size_t lm, my_srba_irls_t::new_kf_observation_t &obs_field)
+	{
+		if (!((kf==5 || kf==8 || kf==10) && lm==2*(kf-1)))
+			return true;
+		if (!inject_outliers)
+			return false; // The clean problem doesn't have these observations at all
+		obs_field.obs.obs_data.pt.x += IRLS_OUTLIER_OFFSET;
+		obs_field.obs.obs_data.pt.y += IRLS_OUTLIER_OFFSET;
+		return true;
+	}
+};
+
+static void build_irls_problem(my_srba_irls_t &rba, const bool inject_outliers, const bool use_robust_kernel)
+{
+	rba.setVerbosityLevel(0);
+	rba.get_time_profiler().disable();
+	rba.parameters.srba.max_tree_depth     = 4;
+	rba.parameters.srba.max_optimize_depth = 4;
+	rba.parameters.srba.max_iters          = 100;
+	rba.parameters.srba.use_robust_kernel  = use_robust_kernel;
+	rba.parameters.srba.kernel_param       = 5.0;
+	rba.parameters.obs_noise.std_noise_observations = IRLS_STD_NOISE;
+
+	irls_outliers_hooks_t hooks(inject_outliers);
+	build_strip_problem(rba, IRLS_NUM_KFS, 0.0 /* no noise */, hooks);
+}
+
+// Max. distance between the KFs and landmarks of two problems
+static double max_solution_diff(const my_srba_irls_t &rba1, const my_srba_irls_t &rba2)
+{
+	double max_diff = 0;
+	for (TKeyFrameID kf=0;kf<IRLS_NUM_KFS;kf++)
+	{
+		const my_srba_irls_t::pose_t * p1 = rba1.get_global_pose(kf,0), * p2 = rba2.get_global_pose(kf,0);
+		if (!p1 || !p2) return std::numeric_limits<double>::max();
+		max_diff = std::max(max_diff, p1->distanceTo(*p2));
+	}
+	for (size_t lm=0;lm<strip_num_lms(IRLS_NUM_KFS);lm++)
+	{
+		double x1,y1, x2,y2;
+		lm_global_pos(rba1,lm,x1,y1);
+		lm_global_pos(rba2,lm,x2,y2);
+		max_diff = std::max(max_diff, std::sqrt( mrpt::utils::square(x1-x2)+mrpt::utils::square(y1-y2) ) );
+	}
+	return max_diff;
+}
+
+// End-to-end IRLS: with the robust kernel, a problem with gross outliers converges to the solution of the inliers alone.
+TEST(RobustKernels,IRLSConvergesToInlierSolution)
+{
+	my_srba_irls_t rba_clean, rba_robust, rba_lsq;
+	build_irls_problem(rba_clean,  false, false);
+	build_irls_problem(rba_robust, true,  true);
+	build_irls_problem(rba_lsq,    true,  false);
+
+	// The IRLS weights of the outliers, as left by the last evaluation of residuals, must be negligible:
+	const my_srba_irls_t::rba_problem_state_t & st = rba_robust.get_rba_state();
+	size_t nOutliers = 0;
+	for (size_t i=0;i<st.all_observations.size();i++)
+	{
+		const TKeyFrameID kf = st.all_observations[i].obs.kf_id;
+		const TLandmarkID lm = st.all_observations[i].obs.obs.feat_id;
+		if ((kf==5 || kf==8 || kf==10) && lm==2*(kf-1))
+		{
+			nOutliers++;
+			EXPECT_LT(st.all_observations_robust_weight[i], 1e-2) << "obs_idx=" << i;
+		}
+	}
+	EXPECT_EQ(3u, nOutliers);
+
+	const double diff_robust = max_solution_diff(rba_clean, rba_robust);
+	const double diff_lsq    = max_solution_diff(rba_clean, rba_lsq);
+	EXPECT_LT(diff_robust, 1e-2);
+	EXPECT_GT(diff_lsq, 5*diff_robust);  // Make sure the outliers do matter without the robust kernel
+}
@@ -278,6 +278,96 @@ protected:
 
 	}
 
+
+	/** Fills random Jacobians for 1 k2k edge and \a nLMs landmarks, each one seen from both KFs. The blocks of the first \a nPerturbed
+	  * landmarks are scaled, so their Hessian blocks differ from those of the same seed with nPerturbed=0 */
+	static void fill_random_jacobians(
+		my_srba_t::rba_problem_state_t::TLinearSystem &lin_system,
+		const uint32_t random_seed,
+		const size_t nLMs,
+		const size_t nPerturbed)
+	{
+		static char valid_true = 1;
+		randomGenerator.randomize(random_seed);
+
+		lin_system.dh_dAp.setColCount(1);
+		lin_system.dh_df.setColCount(nLMs);
+		size_t idx_obs = 0;
+		for (size_t nKF=0;nKF<=1;nKF++)
+		{
+			for (size_t nLM=0;nLM<nLMs;nLM++)
+			{
+				const double scale = (nLM<nPerturbed) ? 2.0 : 1.0;
+				if (nKF==1)
+				{
+					my_srba_t::jacobian_traits_t::TSparseBlocksJacobians_dh_dAp::col_t & dh_dAp_i = lin_system.dh_dAp.getCol(0);
+					randomGenerator.drawGaussian1DMatrix( dh_dAp_i[idx_obs].num );
+					dh_dAp_i[idx_obs].num *= scale;
+					dh_dAp_i[idx_obs].sym.is_valid = &valid_true;
+				}
+				my_srba_t::jacobian_traits_t::TSparseBlocksJacobians_dh_df::col_t & dh_df_j = lin_system.dh_df.getCol(nLM);
+				randomGenerator.drawGaussian1DMatrix( dh_df_j[idx_obs].num );
+				dh_df_j[idx_obs].num *= scale;
+				dh_df_j[idx_obs].sym.is_valid = &valid_true;
+
+				idx_obs++;
+			}
+		}
+	}
+
+	/** Builds the Schur reduced system of the given Jacobians and returns the full (Ap and features) step, using the given
+	  * persistent cache of landmark terms (or one owned by the Schur object if NULL) */
+	static Eigen::VectorXd schur_step(
+		my_srba_t::rba_problem_state_t::TLinearSystem &lin_system,
+		my_srba_t::schur_landmark_cache_t *cache,
+		const double lambda)
+	{
+		vector<my_srba_t::jacobian_traits_t::TSparseBlocksJacobians_dh_dAp::col_t*> dh_dAp;
+		vector<my_srba_t::jacobian_traits_t::TSparseBlocksJacobians_dh_df::col_t*>  dh_df;
+		vector<size_t> Ap_ids, f_ids;
+		for (size_t i=0;i<lin_system.dh_dAp.getColCount();i++) {
+			dh_dAp.push_back( & lin_system.dh_dAp.getCol(i) );
+			Ap_ids.push_back(i);
+		}
+		for (size_t i=0;i<lin_system.dh_df.getColCount();i++) {
+			dh_df.push_back( & lin_system.dh_df.getCol(i) );
+			f_ids.push_back(i);
+		}
+
+		my_srba_t::hessian_traits_t::TSparseBlocksHessian_Ap  HAp;
+		my_srba_t::hessian_traits_t::TSparseBlocksHessian_f   Hf;
+		my_srba_t::hessian_traits_t::TSparseBlocksHessian_Apf HApf;
+		my_srba_t::sparse_hessian_build_symbolic(HAp,Hf,HApf, dh_dAp,dh_df);
+
+		my_srba_t rba;
+		rba.sparse_hessian_update_numeric(HAp);
+		rba.sparse_hessian_update_numeric(Hf);
+		rba.sparse_hessian_update_numeric(HApf);
+
+		const size_t idx_start_f = 6*dh_dAp.size();
+		Eigen::VectorXd  minus_grad(idx_start_f + 3*dh_df.size());
+		minus_grad.setOnes();
+
+		SchurComplement<
+			my_srba_t::hessian_traits_t::TSparseBlocksHessian_Ap,
+			my_srba_t::hessian_traits_t::TSparseBlocksHessian_f,
+			my_srba_t::hessian_traits_t::TSparseBlocksHessian_Apf
+			>
+			schur_compl(HAp,Hf,HApf, &minus_grad[0], &minus_grad[idx_start_f], cache, &Ap_ids, &f_ids);
+
+		schur_compl.numeric_build_reduced_system(lambda);
+
+		CMatrixDouble dense_HAp;
+		HAp.getAsDense(dense_HAp, true /* force symmetry */);
+		Eigen::MatrixXd HAp_lambda = dense_HAp;
+		for (size_t i=0;i<idx_start_f;i++)
+			HAp_lambda(i,i)+=lambda;
+
+		Eigen::VectorXd delta(minus_grad.size());
+		delta.head(idx_start_f) = HAp_lambda.ldlt().solve( minus_grad.head(idx_start_f) );
+		schur_compl.numeric_solve_for_features(&delta[0], &delta[idx_start_f]);
+		return delta;
+	}
 };
 
 
@@ -358,3 +448,45 @@ TEST_F(SchurTests,DenseVsSparseCheck_5k2k_30k2f)
 		test_schur_dense_vs_sparse(&gir,NULL );
 	}
 }
+
+// Schur terms reused from a persistent cache (warmed up with a partly different system) must give the same step as a fresh computation:
+TEST_F(SchurTests,PersistentLandmarkCacheSameStep)
+{
+	const size_t nLMs = 20, nPerturbed = 5;
+	const double lambda = 1e-2;
+
+	for (uint32_t random_seed=1;random_seed<5;random_seed++)
+	{
+		my_srba_t::rba_problem_state_t::TLinearSystem  lin_fresh, lin_warm, lin_reused;
+		fill_random_jacobians(lin_fresh,  random_seed, nLMs, 0);
+		fill_random_jacobians(lin_warm,   random_seed, nLMs, nPerturbed);
+		fill_random_jacobians(lin_reused, random_seed, nLMs, 0);
+
+		const Eigen::VectorXd step_fresh = schur_step(lin_fresh, NULL, lambda);
+
+		my_srba_t::schur_landmark_cache_t cache;
+		cache.new_usage();
+		schur_step(lin_warm, &cache, lambda);
+		EXPECT_EQ(nLMs, cache.size());
+
+		cache.new_usage();
+		const size_t reused_before = cache.num_reused, recomputed_before = cache.num_recomputed;
+		const Eigen::VectorXd step_reused = schur_step(lin_reused, &cache, lambda);
+
+		// Only the blocks of perturbed landmarks (Hf + HApf) must have been recomputed:
+		EXPECT_EQ(2*nPerturbed, cache.num_recomputed-recomputed_before);
+		EXPECT_EQ(2*(nLMs-nPerturbed), cache.num_reused-reused_before);
+
+		EXPECT_NEAR( (step_fresh-step_reused).array().abs().maxCoeff()/step_fresh.array().abs().maxCoeff(),0, 1e-10)
+			<< "step_fresh: " << step_fresh.transpose() << endl
+			<< "step_reused: " << step_reused.transpose() << endl;
+
+		// Aging: entries are freed after not being used in the given number of usages:
+		cache.new_usage();
+		cache.release_unused(2);
+		EXPECT_EQ(nLMs, cache.size());
+		cache.new_usage();
+		cache.release_unused(2);
+		EXPECT_EQ(0u, cache.size());
+	}
+}
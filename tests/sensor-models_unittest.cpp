@@ -0,0 +1,84 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#include <srba.h>
+#include <mrpt/random.h>
+
+#include <gtest/gtest.h>
+
+using namespace srba;
+using namespace std;
+using namespace mrpt::random;
+
+static void random_pose(mrpt::poses::CPose3D &p)
+{
+	p = mrpt::poses::CPose3D(
+		randomGenerator.drawUniform(-5.0,5.0),randomGenerator.drawUniform(-5.0,5.0),randomGenerator.drawUniform(-5.0,5.0),
+		randomGenerator.drawUniform(-M_PI,M_PI),randomGenerator.drawUniform(-0.5,0.5),randomGenerator.drawUniform(-0.5,0.5) );
+}
+static void random_pose(mrpt::poses::CPose2D &p)
+{
+	p = mrpt::poses::CPose2D(randomGenerator.drawUniform(-5.0,5.0),randomGenerator.drawUniform(-5.0,5.0),randomGenerator.drawUniform(-M_PI,M_PI));
+}
+
+template <class ARRAY>
+static void pose_compose_point(const mrpt::poses::CPose3D &p, const ARRAY &g, ARRAY &l) { p.composePoint(g[0],g[1],g[2], l[0],l[1],l[2]); }
+template <class ARRAY>
+static void pose_compose_point(const mrpt::poses::CPose2D &p, const ARRAY &g, ARRAY &l) { p.composePoint(g[0],g[1], l[0],l[1]); }
+
+// The fused observe_error_and_jacob() must give exactly the same than observe_error() + eval_jacob_dh_dx():
+template <class SENSOR_MODEL, class POSE_T>
+void check_fused_obs_jacob(const typename SENSOR_MODEL::TObservationParams & params)
+{
+	typedef typename observation_traits<typename SENSOR_MODEL::OBS_T>::array_obs_t  array_obs_t;
+
+	EXPECT_TRUE((internal::has_observe_error_and_jacob<SENSOR_MODEL,POSE_T>::value));
+
+	randomGenerator.randomize(1234);
+	for (size_t k=0;k<200;k++)
+	{
+		POSE_T pose;
+		random_pose(pose);
+
+		typename SENSOR_MODEL::array_landmark_t lm_pos, xji_l;
+		for (size_t i=0;i<SENSOR_MODEL::LM_DIMS;i++)
+			lm_pos[i] = randomGenerator.drawUniform(-10.0,10.0);
+		pose_compose_point(pose,lm_pos,xji_l);
+
+		array_obs_t z_obs;
+		for (size_t i=0;i<SENSOR_MODEL::OBS_DIMS;i++)
+			z_obs[i] = randomGenerator.drawUniform(-10.0,10.0);
+
+		array_obs_t err_separate, err_fused;
+		typename SENSOR_MODEL::TJacobian_dh_dx dh_dx_separate, dh_dx_fused;
+		SENSOR_MODEL::observe_error(err_separate,z_obs,pose,lm_pos,params);
+		const bool valid_separate = SENSOR_MODEL::eval_jacob_dh_dx(dh_dx_separate,xji_l,params);
+		const bool valid_fused    = SENSOR_MODEL::observe_error_and_jacob(err_fused,dh_dx_fused,z_obs,pose,lm_pos,params);
+
+		EXPECT_EQ(valid_separate,valid_fused) << "k=" << k;
+		EXPECT_NEAR((err_separate-err_fused).array().abs().maxCoeff(),0.0, 1e-12)
+			<< "k=" << k << "\nseparate: " << err_separate.transpose() << "\nfused: " << err_fused.transpose();
+		if (!valid_separate || !valid_fused) continue;
+
+		EXPECT_NEAR((dh_dx_separate-dh_dx_fused).array().abs().maxCoeff(),0.0, 1e-12)
+			<< "k=" << k << "\nseparate:\n" << dh_dx_separate << "\nfused:\n" << dh_dx_fused;
+	}
+}
+
+TEST(SensorModels,FusedErrorAndJacobian)
+{
+	observations::MonocularCamera::TObservationParams cam_params;
+	cam_params.camera_calib.setIntrinsicParamsFromValues(500.0,450.0,320.0,240.0);
+	check_fused_obs_jacob<sensor_model<landmarks::Euclidean3D,observations::MonocularCamera>,mrpt::poses::CPose3D>(cam_params);
+
+	check_fused_obs_jacob<sensor_model<landmarks::Euclidean3D,observations::Cartesian_3D>,mrpt::poses::CPose3D>(observations::Cartesian_3D::TObservationParams());
+	check_fused_obs_jacob<sensor_model<landmarks::Euclidean2D,observations::Cartesian_2D>,mrpt::poses::CPose2D>(observations::Cartesian_2D::TObservationParams());
+	check_fused_obs_jacob<sensor_model<landmarks::Euclidean3D,observations::RangeBearing_3D>,mrpt::poses::CPose3D>(observations::RangeBearing_3D::TObservationParams());
+	check_fused_obs_jacob<sensor_model<landmarks::Euclidean2D,observations::RangeBearing_2D>,mrpt::poses::CPose2D>(observations::RangeBearing_2D::TObservationParams());
+}
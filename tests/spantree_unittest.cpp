@@ -196,6 +196,14 @@ void test_spantree_topology(
 
 			EXPECT_EQ(found_path.size(), st_ij.distance);
 
+			// All path search methods must find paths of the same length:
+			std::vector<TKeyFrameID>  found_path_astar, found_path_unidir;
+			EXPECT_TRUE(rba.find_path_astar(kf, dst_kf, found_path_astar));
+			EXPECT_TRUE(rba.get_rba_state().find_path_bfs_unidirectional(kf, dst_kf, &found_path_unidir));
+			EXPECT_EQ(found_path.size(), found_path_astar.size());
+			EXPECT_EQ(found_path.size(), found_path_unidir.size());
+			EXPECT_EQ(dst_kf, found_path_astar.back());
+
 			// and the final check: both reconstructions must lead to the same relative poses!
 			// -------------------------------------------------------------------------------
 			const mrpt::poses::CPose3D &rel_pose_complete_st = it->second.pose;
@@ -220,6 +228,27 @@ void test_spantree_topology(
 		}
 	}
 
+	// Compare path search methods between random KFs, also beyond the depth of spanning trees:
+	my_srba_t::TPathSearchWorkspace path_search_ws; // Reused between searches
+	for (size_t i=0;i<nKFs;i++)
+	{
+		TKeyFrameID kf1,kf2;
+		randomGenerator.drawUniformUnsignedIntRange(kf1,0,nKFs-1);
+		randomGenerator.drawUniformUnsignedIntRange(kf2,0,nKFs-1);
+
+		std::vector<TKeyFrameID>  path_bfs, path_astar, path_unidir, path_bfs_ws, path_astar_ws;
+		EXPECT_TRUE(rba.find_path_bfs(kf1, kf2, path_bfs));
+		EXPECT_TRUE(rba.find_path_astar(kf1, kf2, path_astar));
+		EXPECT_TRUE(rba.find_path_bfs(kf1, kf2, path_bfs_ws, &path_search_ws));
+		EXPECT_TRUE(rba.find_path_astar(kf1, kf2, path_astar_ws, &path_search_ws));
+		EXPECT_EQ(path_bfs, path_bfs_ws) << "Path " << kf1 << " <-> " << kf2 << endl;
+		EXPECT_EQ(path_astar, path_astar_ws) << "Path " << kf1 << " <-> " << kf2 << endl;
+		EXPECT_TRUE(rba.get_rba_state().find_path_bfs_unidirectional(kf1, kf2, &path_unidir));
+		EXPECT_EQ(path_unidir.size(), path_bfs.size()) << "Path " << kf1 << " <-> " << kf2 << endl;
+		EXPECT_EQ(path_unidir.size(), path_astar.size()) << "Path " << kf1 << " <-> " << kf2 << endl;
+		if (!path_bfs.empty()) EXPECT_EQ(kf2, path_bfs.back());
+		if (!path_astar.empty()) EXPECT_EQ(kf2, path_astar.back());
+	}
 }
 
 size_t Ns[5]={10, 50, 300};
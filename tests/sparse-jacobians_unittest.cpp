@@ -0,0 +1,76 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#include <srba.h>
+
+#include <gtest/gtest.h>
+
+using namespace srba;
+using namespace std;
+
+typedef RbaEngine<
+	kf2kf_poses::SE3, // Parameterization  of KF-to-KF poses
+	landmarks::Euclidean3D, // Parameterization of landmark positions
+	observations::Cartesian_3D // Type of observations
+	>  my_srba_t;
+
+typedef my_srba_t::jacobian_traits_t::TSparseBlocksJacobians_dh_dAp::col_t  col_t;
+
+static void expect_rows(const col_t &col, const size_t *rows, const size_t nRows)
+{
+	EXPECT_EQ(col.size(), nRows);
+	size_t k=0;
+	for (col_t::const_iterator it=col.begin();it!=col.end();++it,++k)
+	{
+		ASSERT_LT(k, nRows);
+		EXPECT_EQ(it->first, rows[k]);
+		EXPECT_EQ(it->second.sym.obs_idx, rows[k]);
+	}
+	EXPECT_EQ(k, nRows);
+}
+
+// Sorted appends & inserts, tombstones skipped by iterators, revival and compaction:
+TEST(SparseJacobians,ColumnInsertEraseCompact)
+{
+	col_t col;
+	EXPECT_TRUE(col.empty());
+
+	const size_t lst_rows[] = { 2, 5, 9, 14, 20 };
+	for (size_t i=0;i<5;i++)
+		col[lst_rows[i]].sym.obs_idx = lst_rows[i];
+	col[7].sym.obs_idx = 7; // Insertion in the middle
+
+	const size_t rows1[] = { 2, 5, 7, 9, 14, 20 };
+	expect_rows(col, rows1, 6);
+
+	EXPECT_TRUE(col.erase(2));
+	EXPECT_TRUE(col.erase(9));
+	EXPECT_FALSE(col.erase(9));
+	EXPECT_FALSE(col.erase(8));
+	EXPECT_EQ(col.num_erased(), 2u);
+	EXPECT_TRUE(col.find(9)==col.end());
+	EXPECT_EQ(col.find(14)->first, 14u);
+
+	const size_t rows2[] = { 5, 7, 14, 20 };
+	expect_rows(col, rows2, 4);
+
+	// Revive a tombstone:
+	col[9].sym.obs_idx = 9;
+	EXPECT_EQ(col.num_erased(), 1u);
+	const size_t rows3[] = { 5, 7, 9, 14, 20 };
+	expect_rows(col, rows3, 5);
+
+	// Erasing more than half triggers compaction:
+	EXPECT_TRUE(col.erase(5));
+	EXPECT_TRUE(col.erase(7));
+	EXPECT_TRUE(col.erase(20));
+	EXPECT_EQ(col.num_erased(), 0u);
+	const size_t rows4[] = { 9, 14 };
+	expect_rows(col, rows4, 2);
+}
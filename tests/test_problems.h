@@ -0,0 +1,166 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#pragma once
+
+// Synthetic problems shared by several unit tests.
+
+#include <srba.h>
+#include <mrpt/poses/CPose2D.h>
+#include <cmath>
+
+// ------------------------------------------------------------------------------------------------------------------
+//  "Strip" problem: a straight trajectory along the X axis (KF #i at x=i), with landmarks at both sides
+//  (LM #j at x=j/2, y=+-2) seen from all the KFs closer than STRIP_SENSOR_RANGE in X.
+//  For RbaEngine's with SE2 KF-to-KF poses, Euclidean2D landmarks and Cartesian_2D observations.
+// ------------------------------------------------------------------------------------------------------------------
+const double STRIP_SENSOR_RANGE = 3.0;
+
+/** Number of landmarks in a strip of \a nKFs KFs, such that all of them are seen from at least 2 KFs */
+inline size_t strip_num_lms(const size_t nKFs) { return 2*(nKFs-2)+1; }
+
+/** Ground truth position of landmark \a lm */
+inline void strip_lm_gt_pos(const size_t lm, double &x, double &y)
+{
+	x = 0.5*lm;
+	y = (lm%2) ? 2.0 : -2.0;
+}
+
+/** Deterministic pseudo-random noise in [-std_noise,std_noise], for the coordinate \a coord of the observation of \a lm from \a kf */
+inline double strip_fake_noise(const double std_noise, const size_t kf, const size_t lm, const size_t coord)
+{
+	return std_noise * std::sin(12.9898*kf + 78.233*lm + 37.719*coord);
+}
+
+/** Customization points of build_strip_problem(). Tests derive from this struct and redefine (hide) the methods they need. */
+struct strip_problem_hooks_t
+{
+	/** Called for each observation before adding it: may modify it, or return false to drop it */
+	template <class OBS_FIELD> bool observation(const size_t kf, const size_t lm, OBS_FIELD &obs_field) { MRPT_UNUSED_PARAM(kf); MRPT_UNUSED_PARAM(lm); MRPT_UNUSED_PARAM(obs_field); return true; }
+	/** Called with all the observations of KF \a kf, before inserting it */
+	template <class OBS_LIST> void extra_observations(const size_t kf, OBS_LIST &list_obs) { MRPT_UNUSED_PARAM(kf); MRPT_UNUSED_PARAM(list_obs); }
+	/** Called after inserting each KF */
+	template <class KF_INFO> void new_kf(const KF_INFO &new_kf_info) { MRPT_UNUSED_PARAM(new_kf_info); }
+};
+
+/** Observations of KF \a kf of a strip with \a nLMs landmarks, with noise of amplitude \a std_noise. See strip_problem_hooks_t::observation() */
+template <class RBA, class HOOKS>
+void strip_kf_observations(const size_t kf, const size_t nLMs, const double std_noise, typename RBA::new_kf_observations_t &list_obs, HOOKS &hooks)
+{
+	list_obs.clear();
+
+	typename RBA::new_kf_observation_t   obs_field;
+	obs_field.is_fixed = false;
+	obs_field.is_unknown_with_init_val = false;
+
+	for (size_t lm=0;lm<nLMs;lm++)
+	{
+		double x,y;
+		strip_lm_gt_pos(lm,x,y);
+		if (std::abs(x-kf)>STRIP_SENSOR_RANGE)
+			continue;
+
+		obs_field.obs.feat_id = lm;
+		obs_field.obs.obs_data.pt.x = x-kf + strip_fake_noise(std_noise,kf,lm,0);
+		obs_field.obs.obs_data.pt.y = y    + strip_fake_noise(std_noise,kf,lm,1);
+		if (hooks.observation(kf,lm,obs_field))
+			list_obs.push_back(obs_field);
+	}
+	hooks.extra_observations(kf,list_obs);
+}
+
+template <class RBA>
+void strip_kf_observations(const size_t kf, const size_t nLMs, const double std_noise, typename RBA::new_kf_observations_t &list_obs)
+{
+	strip_problem_hooks_t no_hooks;
+	strip_kf_observations<RBA>(kf,nLMs,std_noise,list_obs,no_hooks);
+}
+
+/** Inserts the \a nKFs KFs of a strip one by one, optimizing after each one. \a rba parameters must be set beforehand. */
+template <class RBA, class HOOKS>
+void build_strip_problem(RBA &rba, const size_t nKFs, const double std_noise, HOOKS &hooks)
+{
+	const size_t nLMs = strip_num_lms(nKFs);
+	for (size_t kf=0;kf<nKFs;kf++)
+	{
+		typename RBA::new_kf_observations_t  list_obs;
+		strip_kf_observations<RBA>(kf,nLMs,std_noise,list_obs,hooks);
+
+		typename RBA::TNewKeyFrameInfo new_kf_info;
+		rba.define_new_keyframe(list_obs,new_kf_info,true);
+		hooks.new_kf(new_kf_info);
+	}
+}
+
+template <class RBA>
+void build_strip_problem(RBA &rba, const size_t nKFs, const double std_noise)
+{
+	strip_problem_hooks_t no_hooks;
+	build_strip_problem(rba,nKFs,std_noise,no_hooks);
+}
+
+/** Global position of a 2D landmark, wrt KF #0 */
+template <class RBA>
+void lm_global_pos(const RBA &rba, const srba::TLandmarkID lm_id, double &x, double &y)
+{
+	const typename RBA::TRelativeLandmarkPos & rfp = *rba.get_rba_state().all_lms[lm_id].rfp;
+	const typename RBA::pose_t * base_pose = rba.get_global_pose(rfp.id_frame_base, 0);
+	ASSERT_(base_pose!=NULL)
+	base_pose->composePoint(rfp.pos[0],rfp.pos[1], x,y);
+}
+
+// ------------------------------------------------------------------------------------------------------------------
+//  "Polygon" problem: relative graph-SLAM along a regular polygon of N sides. KF #i observes KF #(i-1) with a biased
+//  odometry, and the last KF (#N), back at the pose of KF #0, observes it too (without bias): a loop closure.
+//  For RbaEngine's with SE2 KF-to-KF poses, RelativePoses2D landmarks and RelativePoses_2D observations.
+// ------------------------------------------------------------------------------------------------------------------
+const double POLYGON_ODOM_SCALE_BIAS = 1.02;
+const double POLYGON_ODOM_YAW_BIAS   = mrpt::utils::DEG2RAD(1.0);
+
+/** Ground truth pose of KF \a kf, along a polygon of \a nSides sides */
+inline mrpt::poses::CPose2D polygon_gt_pose(const size_t kf, const size_t nSides)
+{
+	mrpt::poses::CPose2D p;
+	const mrpt::poses::CPose2D step(1.0,0.0,mrpt::utils::DEG2RAD(360.0/nSides));
+	for (size_t i=0;i<kf;i++) p = p + step;
+	return p;
+}
+
+/** Observations of KF \a kf, along a polygon of \a nSides sides */
+template <class RBA>
+void polygon_kf_observations(const size_t kf, const size_t nSides, typename RBA::new_kf_observations_t &list_obs)
+{
+	list_obs.clear();
+
+	// To emulate graph-SLAM, each keyframe MUST have exactly ONE fixed "fake landmark", representing its pose:
+	typename RBA::new_kf_observation_t obs_field;
+	obs_field.is_fixed = true;
+	obs_field.obs.feat_id = kf; // Feature ID == keyframe ID
+	obs_field.obs.obs_data.x = obs_field.obs.obs_data.y = obs_field.obs.obs_data.yaw = 0; // Ignored
+	list_obs.push_back( obs_field );
+
+	obs_field.is_fixed = false;
+	obs_field.is_unknown_with_init_val = false;
+
+	if (kf>0)
+	{
+		const mrpt::poses::CPose2D rel = polygon_gt_pose(kf-1,nSides) - polygon_gt_pose(kf,nSides); // Pose of the observed KF as seen from "kf"
+		obs_field.obs.feat_id      = kf-1;
+		obs_field.obs.obs_data.x   = rel.x()*POLYGON_ODOM_SCALE_BIAS;
+		obs_field.obs.obs_data.y   = rel.y()*POLYGON_ODOM_SCALE_BIAS;
+		obs_field.obs.obs_data.yaw = rel.phi()+POLYGON_ODOM_YAW_BIAS;
+		list_obs.push_back( obs_field );
+	}
+	if (kf==nSides)
+	{
+		obs_field.obs.feat_id      = 0; // Loop closure: same pose than KF #0
+		obs_field.obs.obs_data.x = obs_field.obs.obs_data.y = obs_field.obs.obs_data.yaw = 0;
+		list_obs.push_back( obs_field );
+	}
+}
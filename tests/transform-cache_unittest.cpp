@@ -0,0 +1,69 @@
+/* +---------------------------------------------------------------------------+
+   |                     Mobile Robot Programming Toolkit (MRPT)               |
+   |                          http://www.mrpt.org/                             |
+   |                                                                           |
+   | Copyright (c) 2005-2015, Individual contributors, see AUTHORS file        |
+   | See: http://www.mrpt.org/Authors - All rights reserved.                   |
+   | Released under BSD License. See details in http://www.mrpt.org/License    |
+   +---------------------------------------------------------------------------+ */
+
+#include <srba.h>
+#include "test_problems.h"
+
+#include <gtest/gtest.h>
+
+using namespace srba;
+using namespace std;
+
+struct RBA_OPTIONS_TRANSFORM_CACHE : public RBA_OPTIONS_DEFAULT
+{
+	typedef ecps::classic_linear_rba  edge_creation_policy_t;  // A plain chain of KFs: relative poses along the spanning trees are the shortest paths
+};
+
+typedef RbaEngine<
+	kf2kf_poses::SE2,             // Parameterization  of KF-to-KF poses
+	landmarks::Euclidean2D,       // Parameterization of landmark positions
+	observations::Cartesian_2D,   // Type of observations
+	RBA_OPTIONS_TRANSFORM_CACHE
+	>  my_srba_t;
+
+// A strip problem (see test_problems.h), with all the landmarks within the spanning trees. Observations have a
+// deterministic "noise", so each optimization updates the edges.
+const size_t NUM_KFS      = 12;
+const double STD_NOISE    = 0.05;
+
+static void build_problem(my_srba_t &rba)
+{
+	rba.setVerbosityLevel(0);
+	rba.get_time_profiler().disable();
+	rba.parameters.srba.max_tree_depth     = 4;
+	rba.parameters.srba.max_optimize_depth = 4;
+	rba.parameters.srba.use_robust_kernel  = false;
+
+	build_strip_problem(rba, NUM_KFS, STD_NOISE);
+}
+
+// The squared errors evaluated by the optimizer (with cached relative transformations) must match those evaluated
+// from scratch from the complete spanning trees, after the edges have been updated by previous optimizations:
+TEST(TransformCache, CachedMatchesUncachedAfterEdgeUpdates)
+{
+	my_srba_t rba;
+	build_problem(rba);
+
+	my_srba_t::TOptimizeLocalAreaParams opt_params;
+	opt_params.dont_optimize_landmarks_seen_less_than_n_times = 1;
+
+	for (int pass=0;pass<3;pass++)
+	{
+		const double sqerr_before = rba.eval_overall_squared_error();
+
+		my_srba_t::TOptimizeExtraOutputInfo info;
+		rba.optimize_local_area(NUM_KFS-1, NUM_KFS, info, opt_params);
+		ASSERT_EQ(rba.get_rba_state().all_observations.size(), info.num_observations);
+
+		const double sqerr_after = rba.eval_overall_squared_error();
+
+		EXPECT_NEAR(info.total_sqr_error_init,  sqerr_before, 1e-9*(1.0+sqerr_before)) << "pass=" << pass;
+		EXPECT_NEAR(info.total_sqr_error_final, sqerr_after,  1e-9*(1.0+sqerr_after))  << "pass=" << pass;
+	}
+}